@@ -408,6 +408,12 @@ public:
                 CLAP_DEBUG ("process: time %d, expression channel %d key %d to %f\n", event->time, expr_event->channel, expr_event->key, expr_event->value);
                 midi_synth->add_pitch_expression_event (event->time, expr_event->value, expr_event->channel, expr_event->key);
               }
+            else if (expr_event->expression_id == CLAP_NOTE_EXPRESSION_PAN)
+              {
+                /* clap pan: 0 = left, 0.5 = center, 1 = right */
+                CLAP_DEBUG ("process: time %d, pan expression channel %d key %d to %f\n", event->time, expr_event->channel, expr_event->key, expr_event->value);
+                midi_synth->add_pan_expression_event (event->time, expr_event->value * 2 - 1, expr_event->channel, expr_event->key);
+              }
           }
         /* FIXME: handle transport events */
       }
@@ -440,10 +446,7 @@ public:
 
     terminated_voice_handler.process = process;
 
-    midi_synth->process (outputs[0], process->frames_count, &terminated_voice_handler);
-
-    std::copy (outputs[0], outputs[0] + process->frames_count, outputs[1]);
-    /* this can be optimized */
+    midi_synth->process (outputs[0], outputs[1], process->frames_count, &terminated_voice_handler);
     return CLAP_PROCESS_CONTINUE;
   }
   /*--- state ---*/
@@ -5,6 +5,7 @@
 #include "smmorphplan.hh"
 #include "smutils.hh"
 #include "smcheckbox.hh"
+#include "smconfig.hh"
 
 using namespace SpectMorph;
 
@@ -17,6 +18,10 @@ MorphOutputView::MorphOutputView (Widget *parent, MorphOutput *morph_output, Mor
 {
   hide_tool_buttons(); // no fold/close for output
 
+  // unison spread is only rendered by the spectral bus, which is enabled in the config file
+  const Config cfg;
+  spectral_bus = cfg.spectral_bus();
+
   source_combobox = new ComboBoxOperator (body_widget, morph_output->morph_plan(),
     [](MorphOperator *op) {
       return (op->output_type() == MorphOperator::OUTPUT_AUDIO);
@@ -38,6 +43,7 @@ MorphOutputView::MorphOutputView (Widget *parent, MorphOutput *morph_output, Mor
   pv_unison        = add_property_view (MorphOutput::P_UNISON, op_layout);
   pv_unison_voices = add_property_view (MorphOutput::P_UNISON_VOICES, op_layout);
   pv_unison_detune = add_property_view (MorphOutput::P_UNISON_DETUNE, op_layout);
+  pv_unison_spread = add_property_view (MorphOutput::P_UNISON_SPREAD, op_layout);
 
   // ADSR
   pv_adsr = add_property_view (MorphOutput::P_ADSR, op_layout);
@@ -156,6 +162,9 @@ MorphOutputView::update_visible()
   pv_vibrato_frequency->set_visible (vibrato);
   pv_vibrato_attack->set_visible (vibrato);
 
+  /* voices using filter, portamento or vibrato are never rendered by the spectral bus */
+  pv_unison_spread->set_visible (unison && spectral_bus && !filter && !portamento && !vibrato);
+
   op_layout.activate();
   signal_size_changed();
 }
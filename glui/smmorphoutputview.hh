@@ -22,6 +22,7 @@ class MorphOutputView : public MorphOperatorView
   PropertyView               *pv_unison;
   PropertyView               *pv_unison_voices;
   PropertyView               *pv_unison_detune;
+  PropertyView               *pv_unison_spread;
 
   PropertyView               *pv_adsr;
   PropertyView               *pv_adsr_skip;
@@ -56,6 +57,8 @@ class MorphOutputView : public MorphOperatorView
 
   OutputADSRWidget           *output_adsr_widget;
 
+  bool                        spectral_bus;
+
 
   OperatorLayout              op_layout;
 
@@ -43,6 +43,11 @@ MorphPlanControl::MorphPlanControl (Widget *parent, MorphPlan *plan) :
   inst_status = new Label (this, "");
   grid.add_widget (inst_status, 2, voffset, 40, 2);
 
+  voffset += 2;
+
+  voice_status_label = new Label (this, "");
+  grid.add_widget (voice_status_label, 2, voffset, 40, 2);
+
   voffset += 2;
   m_view_height = voffset + 1;
 
@@ -86,6 +91,24 @@ void
 MorphPlanControl::on_voice_status_changed (VoiceStatus *voice_status)
 {
   midi_led->set_on (voice_status->n_voices() != 0);
+
+  string text = string_locale_printf ("Voices: %u  Load: %.0f%%", voice_status->n_voices(), voice_status->load() * 100);
+  if (voice_status->voice_budget() >= 0)
+    text += string_printf ("  Budget: %d", voice_status->voice_budget());
+  if (voice_status->stolen_voices() || voice_status->faded_voices())
+    text += string_printf ("  Stolen: %d", voice_status->stolen_voices() + voice_status->faded_voices());
+  if (voice_status->unison_reduced())
+    text += "  Unison reduced";
+  if (voice_status->culled_partials() > 0)
+    text += string_locale_printf ("  Culled: %.0f%%", voice_status->culled_partials() * 100);
+  if (voice_status->lod_boost_db() > 0)
+    text += string_locale_printf (" (+%.0f dB)", voice_status->lod_boost_db());
+
+  if (voice_status->overload())
+    voice_status_label->set_color (Color (1.0, 0.0, 0.0));
+  else
+    voice_status_label->set_color (ThemeColor::TEXT);
+  voice_status_label->set_text (text);
 }
 
 void
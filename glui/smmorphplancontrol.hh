@@ -22,6 +22,7 @@ class MorphPlanControl : public Frame
   Slider      *volume_slider = nullptr;
   Led         *midi_led = nullptr;
   Label       *inst_status = nullptr;
+  Label       *voice_status_label = nullptr;
   double       m_view_height;
 
   void update_volume_label (double volume);
@@ -223,7 +223,11 @@ MorphWavSourceView::on_update_progress()
   bool rebuild_active = project->rebuild_active (morph_wav_source->object_id());
 
   if (rebuild_active)
-    progress_bar->set_value (-1);
+    {
+      /* show how many samples are encoded, or busy indicator if the job was replaced */
+      const double progress = project->rebuild_progress (morph_wav_source->object_id());
+      progress_bar->set_value (progress >= 0 ? progress : -1);
+    }
   else
     progress_bar->set_value (1);
 
@@ -19,6 +19,16 @@ class VoiceStatus
   std::vector<float>     controls[MorphPlan::N_CONTROL_INPUTS];
   const OperatorRoleMap *op_role_map;
 
+  /* voice scheduler */
+  float                  m_load = 0;
+  int                    m_voice_budget = -1;
+  int                    m_stolen_voices = 0;  // total since start
+  int                    m_faded_voices = 0;
+  bool                   m_overload = false;   // budget exceeded since the last event
+  bool                   m_unison_reduced = false;
+  float                  m_culled_partials = 0;
+  float                  m_lod_boost_db = 0;
+
   float
   get_control_value (Property& property, int i, MorphOperator::ControlType control_type, MorphOperator *control_op)
   {
@@ -86,6 +96,19 @@ public:
         control_value_map_clear = true;
         changed = true;
       }
+    auto vs_event = dynamic_cast<VoiceSchedulerEvent *> (ne);
+    if (vs_event)
+      {
+        m_load = vs_event->load;
+        m_voice_budget = vs_event->voice_budget;
+        m_stolen_voices += vs_event->stolen_voices;
+        m_faded_voices += vs_event->faded_voices;
+        m_overload = vs_event->overload_blocks > 0;
+        m_unison_reduced = vs_event->unison_reduced;
+        m_culled_partials = vs_event->culled_partials;
+        m_lod_boost_db = vs_event->lod_boost_db;
+        changed = true;
+      }
     return changed;
   }
   std::vector<float>
@@ -123,6 +146,46 @@ public:
   {
     return voices.size();
   }
+  float
+  load() const
+  {
+    return m_load;
+  }
+  int
+  voice_budget() const
+  {
+    return m_voice_budget;
+  }
+  int
+  stolen_voices() const
+  {
+    return m_stolen_voices;
+  }
+  int
+  faded_voices() const
+  {
+    return m_faded_voices;
+  }
+  bool
+  overload() const
+  {
+    return m_overload;
+  }
+  bool
+  unison_reduced() const
+  {
+    return m_unison_reduced;
+  }
+  float
+  culled_partials() const
+  {
+    return m_culled_partials;
+  }
+  float
+  lod_boost_db() const
+  {
+    return m_lod_boost_db;
+  }
 };
 
 }
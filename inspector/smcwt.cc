@@ -9,6 +9,8 @@
 
 #include <vector>
 #include <complex>
+#include <atomic>
+#include <memory>
 
 #include "smfft.hh"
 #include "smmain.hh"
@@ -17,6 +19,7 @@
 #include "smfftthread.hh"
 #include "smutils.hh"
 #include "smalignedarray.hh"
+#include "smparallel.hh"
 #include <math.h>
 
 using std::vector;
@@ -195,23 +198,78 @@ freq_to_width (double freq, const AnalysisParams& params)
   return MAX (2, sm_round_positive (width));
 }
 
+static vector<float>
+band_freqs (const AnalysisParams& params)
+{
+  vector<float> freqs;
+  for (float freq = params.cwt_freq_resolution; freq < 22050; freq += params.cwt_freq_resolution)
+    freqs.push_back (freq);
+  return freqs;
+}
+
+size_t
+CWT::n_bands (const AnalysisParams& params)
+{
+  return band_freqs (params).size();
+}
+
+size_t
+CWT::band_length (size_t signal_size)
+{
+  return (signal_size + 15) / 16;
+}
+
+/**
+ * Computes one line of results for each frequency band. The bands are analyzed
+ * in parallel; if the analysis is aborted (because the command is obsolete),
+ * the lines of the bands which were not analyzed are empty.
+ */
 vector< vector<float> >
-CWT::analyze (const vector<float>& asignal, const AnalysisParams& params, FFTThread *fft_thread)
+CWT::analyze (const vector<float>& asignal, const AnalysisParams& params, FFTThread *fft_thread, const BandDoneFunc& band_done)
 {
-  vector< vector<float> > results;
+  const vector<float> freqs = band_freqs (params);
+
+  vector< vector<float> > results (freqs.size());
 
   // pad data with zeros to make moving average filter work properly
   const int MAX_WIDTH = freq_to_width (params.cwt_freq_resolution, params);
   const size_t ORDER = 7;
   const int PADDING = (ORDER + 1) * MAX_WIDTH;
   vector<float> signal (asignal.size() + PADDING * 2);
-  AlignedArray<float,16> sin_values (signal.size()), cos_values (signal.size());
-  vector<float> mod_signal_c (signal.size() * 2);
-  vector<float> new_mod_signal_c (signal.size() * 2);
   std::copy (asignal.begin(), asignal.end(), signal.begin() + PADDING);
 
-  for (float freq = params.cwt_freq_resolution; freq < 22050; freq += params.cwt_freq_resolution)
+  /* per thread buffers: limit the number of threads for long signals, to limit memory usage */
+  struct Buffers
+  {
+    AlignedArray<float,16> sin_values, cos_values;
+    vector<float>          mod_signal_c, new_mod_signal_c;
+
+    Buffers (size_t n) :
+      sin_values (n), cos_values (n), mod_signal_c (n * 2), new_mod_signal_c (n * 2)
     {
+    }
+  };
+  const size_t buffer_bytes = signal.size() * 6 * sizeof (float);
+  const size_t n_threads = max<size_t> (1, std::min (parallel_default_threads(), 1000 * 1000 * 1000 / buffer_bytes));
+
+  vector<std::unique_ptr<Buffers>> buffers (n_threads);
+  std::atomic<size_t> n_done { 0 };
+  std::atomic<bool>   obsolete { false };
+
+  parallel_for (n_threads, freqs.size(), [&] (size_t worker, size_t band)
+    {
+      if (obsolete.load (std::memory_order_relaxed))
+        return;
+
+      if (!buffers[worker])
+        buffers[worker].reset (new Buffers (signal.size()));
+
+      auto& sin_values       = buffers[worker]->sin_values;
+      auto& cos_values       = buffers[worker]->cos_values;
+      auto& mod_signal_c     = buffers[worker]->mod_signal_c;
+      auto& new_mod_signal_c = buffers[worker]->new_mod_signal_c;
+
+      const float freq = freqs[band];
       const int WIDTH = freq_to_width (freq, params);
 
       VectorSinParams vsp;
@@ -229,6 +287,12 @@ CWT::analyze (const vector<float>& asignal, const AnalysisParams& params, FFTThr
           mod_signal_c[i * 2 + 1] = sin_values[i] * signal[i];   // imag
         }
 
+      /* the filter doesn't write the values at the start/end of new_mod_signal_c, so clear
+       * values from the band computed before by this thread (the result must not depend
+       * on which thread computes which band)
+       */
+      std::fill (new_mod_signal_c.begin(), new_mod_signal_c.end(), 0);
+
       /* filter a few times with moving average filter -> approximates exp() window function */
       for (size_t n = 0; n < ORDER; n++)
         {
@@ -257,11 +321,14 @@ CWT::analyze (const vector<float>& asignal, const AnalysisParams& params, FFTThr
           // abs (d * m)
           line.push_back (sqrtf (re * re + im * im));
         }
-      results.push_back (line);
-      signal_progress (freq / 22050.0);
+      results[band] = line;
+      if (band_done)
+        band_done (results, band);
+
+      Q_EMIT signal_progress (double (++n_done) / freqs.size());
 
       if (fft_thread && fft_thread->command_is_obsolete()) // abort if user changed params
-        break;
-    }
+        obsolete.store (true);
+    });
   return results;
 }
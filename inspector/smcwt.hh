@@ -4,6 +4,7 @@
 #define SPECTMORPH_CWT_HH
 
 #include <vector>
+#include <functional>
 
 #include <QObject>
 
@@ -17,10 +18,17 @@ class CWT : public QObject
 {
   Q_OBJECT
 public:
-  std::vector< std::vector<float> > analyze (const std::vector<float>& signal, const AnalysisParams& params, FFTThread *fft_thread = 0);
+  /* called (from the analysis threads) after each frequency band is complete */
+  typedef std::function<void (const std::vector< std::vector<float> >& results, size_t band)> BandDoneFunc;
+
+  std::vector< std::vector<float> > analyze (const std::vector<float>& signal, const AnalysisParams& params, FFTThread *fft_thread = 0,
+                                             const BandDoneFunc& band_done = nullptr);
   std::vector< std::vector<float> > analyze_slow (const std::vector<float>& signal, FFTThread *fft_thread = 0);
   void make_png (std::vector< std::vector<float> >& results);
 
+  static size_t n_bands (const AnalysisParams& params);
+  static size_t band_length (size_t signal_size);
+
 signals:
   void signal_progress (double progress);
 };
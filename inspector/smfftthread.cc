@@ -5,6 +5,8 @@
 #include "smfft.hh"
 #include "smcwt.hh"
 #include "smblockutils.hh"
+#include "smparallel.hh"
+#include "smutils.hh"
 
 #include <QSocketNotifier>
 
@@ -14,10 +16,13 @@
 #include <unistd.h>
 #include <errno.h>
 
+#include <atomic>
+
 using namespace SpectMorph;
 
 using std::vector;
 using std::max;
+using std::min;
 
 void
 FFTThread::run()
@@ -50,6 +55,9 @@ FFTThread::run()
           Command *c = commands.back();
           commands.pop_back();
 
+          have_partial_result = false;
+          partial_tiles.clear();
+
           // delete commands we're not going to execute
           for (vector<Command *>::iterator ci = commands.begin(); ci != commands.end(); ci++)
             delete (*ci);
@@ -88,6 +96,51 @@ FFTThread::set_command_progress (double progress)
     ;
 }
 
+/**
+ * Starts the incomplete image for the command which is currently executed, so
+ * that the view can be updated before the analysis is done. The view image is
+ * cleared and then updated with the tiles passed to add_partial_result().
+ */
+void
+FFTThread::start_partial_result (size_t width, size_t height)
+{
+  QMutexLocker lock (&command_mutex);
+  if (!commands.empty())
+    return;
+
+  have_partial_result = false;
+  partial_tiles.clear();
+  partial_width = width;
+  partial_height = height;
+  partial_reset = true;
+}
+
+/**
+ * Adds a tile to the incomplete image; the pixels are moved out of the tile, so
+ * no image data is copied while holding the lock. The main thread is only woken
+ * up if wakeup is true. This is ignored if the command is obsolete.
+ */
+void
+FFTThread::add_partial_result (ImageTile& tile, bool wakeup)
+{
+  QMutexLocker lock (&command_mutex);
+  if (!commands.empty())
+    return;
+
+  partial_tiles.push_back (std::move (tile));
+
+  // wakeup main thread
+  if (wakeup)
+    {
+      have_partial_result = true;
+      while (write (main_thread_wakeup_pfds[1], "W", 1) != 1)
+        ;
+    }
+}
+
+/* lines which are not done yet are black */
+static const int MISSING_PIXEL = -200 * 256;
+
 static FFTThread *the_instance = NULL;
 
 FFTThread::FFTThread()
@@ -141,44 +194,108 @@ AnalysisCommand::set_progress (double progress)
   fft_thread->set_command_progress (progress);
 }
 
+void
+AnalysisCommand::start_lines (size_t new_n_lines, float min_value, size_t width, size_t height)
+{
+  n_lines = new_n_lines;
+  n_lines_done = 0;
+  max_value = min_value;
+  partial_result_time = get_time();
+
+  fft_thread->start_partial_result (width, height);
+}
+
+/**
+ * Called (from any analysis thread) when the lines start ... end - 1 of the
+ * result (frames or frequency bands) are complete. The new lines are drawn
+ * into a tile (outside the lock, so the other threads can continue with the
+ * analysis) which is sent to the FFTThread, so the view is updated while the
+ * analysis is running. The view is woken up at most every 0.25 seconds.
+ */
+void
+AnalysisCommand::lines_done (size_t start, size_t end, float lines_max_value, const DrawTileFunc& draw_tile)
+{
+  float done_max_value;
+  bool  wakeup = false;
+  {
+    std::lock_guard<std::mutex> lock (lines_mutex);
+
+    n_lines_done += end - start;
+    max_value = max (max_value, lines_max_value);
+
+    set_progress (double (n_lines_done) / n_lines);
+
+    if (n_lines_done == n_lines) // final result will be sent by FFTThread
+      return;
+
+    const double now = get_time();
+    if (now - partial_result_time >= 0.25)
+      {
+        partial_result_time = now;
+        wakeup = true;
+      }
+    done_max_value = max_value;
+  }
+  FFTThread::ImageTile tile;
+  tile.max_value = done_max_value;
+  draw_tile (tile, done_max_value);
+
+  fft_thread->add_partial_result (tile, wakeup);
+}
+
+void
+AnalysisCommand::draw_cwt_line (PixelArray& image, const vector<float>& band_result, size_t y, float max_value)
+{
+  int *p = image.get_pixels() + y * image.get_rowstride();
+  for (size_t x = 0; x < image.get_width(); x++)
+    p[x] = (value_scale (band_result[x]) - max_value) * 256;  // 8 bits fixed point
+}
+
 void
 AnalysisCommand::execute_cwt()
 {
   CWT cwt;
 
   const vector<float>& signal = wav_data.samples();
+  const size_t n_bands = CWT::n_bands (analysis_params);
+  const size_t width = CWT::band_length (signal.size());
 
-  connect (&cwt, SIGNAL (signal_progress (double)), this, SLOT (set_progress (double)));
+  start_lines (n_bands, -200, width, n_bands);
 
   vector< vector<float> > results;
-  results = cwt.analyze (signal, analysis_params, fft_thread);
-
-  size_t width = 0;
-  size_t height = results.size();
-  if (!results.empty())
-    width = results[0].size();
+  results = cwt.analyze (signal, analysis_params, fft_thread,
+    [&] (const vector< vector<float> >& band_results, size_t band)
+      {
+        float band_max_value = -200;
+        for (auto value : band_results[band])
+          band_max_value = max (band_max_value, value_scale (value));
+
+        lines_done (band, band + 1, band_max_value, [&] (FFTThread::ImageTile& tile, float max_value)
+          {
+            tile.y = n_bands - 1 - band;
+            tile.pixels.resize (width, 1);
+            draw_cwt_line (tile.pixels, band_results[band], 0, max_value);
+          });
+      });
+  if (fft_thread->command_is_obsolete())  // result will not be used
+    return;
+
+  image.resize (width, n_bands);
+  for (size_t band = 0; band < n_bands; band++)
+    draw_cwt_line (image, results[band], n_bands - 1 - band, max_value);
+}
 
-  image.resize (width, height);
+void
+AnalysisCommand::draw_fft_line (PixelArray& image, size_t x, const FFTResult& result, float max_value)
+{
+  const size_t height = image.get_height();
+  const size_t row_stride = image.get_rowstride();
 
-  float max_value = -200;
-  for (vector< vector<float> >::iterator fi = results.begin(); fi != results.end(); fi++)
-    {
-      for (vector<float>::iterator mi = fi->begin(); mi != fi->end(); mi++)
-        {
-          *mi = value_scale (*mi);
-          max_value = max (max_value, *mi);
-        }
-    }
-  int    *p = image.get_pixels();
-  size_t  row_stride = image.get_rowstride();
-  for (size_t y = 0; y < height; y++)
+  int *p = image.get_pixels() + x;
+  for (size_t m = 0; m < height; m++)
     {
-      for (size_t x = 0; x < results[y].size(); x++)
-        {
-          const size_t src_y = (height - 1 - y);
-          p[x] = (results[src_y][x] - max_value) * 256;  // 8 bits fixed point
-        }
-      p += row_stride;
+      int y = height - 1 - m;
+      p[row_stride * y] = (result.mags[m] - max_value) * 256;  // 8 bits fixed point
     }
 }
 
@@ -207,9 +324,6 @@ AnalysisCommand::execute()
   size_t zeropad = 4;
   size_t fft_size = block_size * zeropad;
 
-  float *fft_in = FFT::new_array_float (fft_size);
-  float *fft_out = FFT::new_array_float (fft_size);
-
   for (guint i = 0; i < window.size(); i++)
     {
       if (i < frame_size)
@@ -229,74 +343,95 @@ AnalysisCommand::execute()
         window[i] = 0;
     }
 
-
+  vector<double> frame_pos_ms;
   double len_ms = wav_data.n_values() * 1000.0 / wav_data.mix_freq();
   for (double pos_ms = analysis_params.frame_step_ms * 0.5 - analysis_params.frame_size_ms; pos_ms < len_ms; pos_ms += analysis_params.frame_step_ms)
+    frame_pos_ms.push_back (pos_ms);
+
+  results.resize (frame_pos_ms.size());
+  start_lines (results.size(), 0, results.size(), fft_size / 2);
+
+  /* per thread fft buffers */
+  const size_t n_threads = parallel_default_threads();
+  vector<float *> fft_in (n_threads), fft_out (n_threads);
+  for (size_t t = 0; t < n_threads; t++)
     {
-      const int64 pos = pos_ms / 1000.0 * wav_data.mix_freq();
-      const int64 n_values = wav_data.n_values();
+      fft_in[t] = FFT::new_array_float (fft_size);
+      fft_out[t] = FFT::new_array_float (fft_size);
+    }
 
-      /* start with zero block, so the incomplete blocks at start|end are zeropadded */
-      vector<float> block (block_size);
+  /* the frames are computed in tiles of consecutive frames, so that the view can
+   * show the image of the tiles which are done while the analysis is running
+   */
+  const size_t tile_frames = 64;
+  const size_t n_tiles = (results.size() + tile_frames - 1) / tile_frames;
 
-      for (int64 offset = 0; offset < (int64) block.size(); offset++)
-        {
-          if (pos + offset >= 0 && pos + offset < n_values)
-            block[offset] = wav_data[pos + offset];
-        }
-      Block::mul (block_size, &block[0], &window[0]);
-      for (size_t i = 0; i < fft_size; i++)
-        {
-          if (i < block_size)
-            fft_in[i] = block[i];
-          else
-            fft_in[i] = 0;
-        }
-      FFT::fftar_float (fft_size, fft_in, fft_out);
-      FFTResult result;
-      fft_out[1] = 0; // special packing
-      for (size_t i = 0; i < fft_size; i += 2)
-        {
-          double re = fft_out[i];
-          double im = fft_out[i + 1];
+  std::atomic<bool> obsolete { false };
+  parallel_for (n_threads, n_tiles, [&] (size_t worker, size_t tile)
+    {
+      if (obsolete.load (std::memory_order_relaxed))
+        return;
 
-          result.mags.push_back (value_scale (sqrt (re * re + im * im)));
-        }
-      results.push_back (result);
+      const size_t start = tile * tile_frames;
+      const size_t end = min (start + tile_frames, results.size());
+      float tile_max_value = 0;
+      for (size_t frame = start; frame < end; frame++)
+        {
+          const int64 pos = frame_pos_ms[frame] / 1000.0 * wav_data.mix_freq();
+          const int64 n_values = wav_data.n_values();
 
-      set_progress (CLAMP (pos_ms / len_ms, 0.0, 1.0));
+          /* start with zero block, so the incomplete blocks at start|end are zeropadded */
+          vector<float> block (block_size);
 
-      if (fft_thread->command_is_obsolete())      // abort analysis if user requested a new one
-        break;
-    }
+          for (int64 offset = 0; offset < (int64) block.size(); offset++)
+            {
+              if (pos + offset >= 0 && pos + offset < n_values)
+                block[offset] = wav_data[pos + offset];
+            }
+          Block::mul (block_size, &block[0], &window[0]);
+          for (size_t i = 0; i < fft_size; i++)
+            {
+              if (i < block_size)
+                fft_in[worker][i] = block[i];
+              else
+                fft_in[worker][i] = 0;
+            }
+          FFT::fftar_float (fft_size, fft_in[worker], fft_out[worker]);
+          FFTResult& result = results[frame];
+          fft_out[worker][1] = 0; // special packing
+          for (size_t i = 0; i < fft_size; i += 2)
+            {
+              double re = fft_out[worker][i];
+              double im = fft_out[worker][i + 1];
 
-  FFT::free_array_float (fft_in);
-  FFT::free_array_float (fft_out);
+              result.mags.push_back (value_scale (sqrt (re * re + im * im)));
+              tile_max_value = max (tile_max_value, result.mags.back());
+            }
+        }
+      lines_done (start, end, tile_max_value, [&] (FFTThread::ImageTile& tile, float max_value)
+        {
+          tile.x = start;
+          tile.pixels.resize (end - start, fft_size / 2);
+          for (size_t frame = start; frame < end; frame++)
+            draw_fft_line (tile.pixels, frame - start, results[frame], max_value);
+        });
 
-  size_t height = 0;
-  if (!results.empty())
-    height = results[0].mags.size();
+      if (fft_thread->command_is_obsolete())      // abort analysis if user requested a new one
+        obsolete.store (true);
+    });
 
-  image.resize (results.size(), height);
-  float max_value = 0;
-  for (vector<FFTResult>::const_iterator fi = results.begin(); fi != results.end(); fi++)
+  for (size_t t = 0; t < n_threads; t++)
     {
-      for (vector<float>::const_iterator mi = fi->mags.begin(); mi != fi->mags.end(); mi++)
-        {
-          max_value = max (max_value, *mi);
-        }
+      FFT::free_array_float (fft_in[t]);
+      FFT::free_array_float (fft_out[t]);
     }
-  int    *p = image.get_pixels();
-  size_t  row_stride = image.get_rowstride();
+
+  if (obsolete.load())  // result will not be used
+    return;
+
+  image.resize (results.size(), results.empty() ? 0 : fft_size / 2);
   for (size_t frame = 0; frame < results.size(); frame++)
-    {
-      for (size_t m = 0; m < results[frame].mags.size(); m++)
-        {
-          int y = results[frame].mags.size() - 1 - m;
-          p[row_stride * y] = (results[frame].mags[m] - max_value) * 256;  // 8 bits fixed point
-        }
-      p++;
-    }
+    draw_fft_line (image, frame, results[frame], max_value);
 }
 
 void
@@ -305,11 +440,19 @@ FFTThread::compute_image (const WavData& wav_data, const AnalysisParams& params)
   QMutexLocker lock (&command_mutex);
   commands.push_back (new AnalysisCommand (wav_data, params, this));
 
+  have_partial_result = false;
+  partial_tiles.clear();
+  partial_reset = false;
+
   // wakeup FFT thread
   while (write (fft_thread_wakeup_pfds[1], "W", 1) != 1)
     ;
 }
 
+/**
+ * Updates the view image (returns true if it was changed). Partial results only
+ * draw the new tiles, so image must be the same image for every call.
+ */
 bool
 FFTThread::get_result (PixelArray& image)
 {
@@ -335,13 +478,75 @@ FFTThread::get_result (PixelArray& image)
   if (!command_results.empty())
     {
       AnalysisCommand *ac = dynamic_cast<AnalysisCommand *> (command_results[0]);
-      image = ac->image;
+      image = std::move (ac->image);
       delete ac;
       command_results.erase (command_results.begin());
 
+      have_partial_result = false;
+      partial_tiles.clear();
+      partial_reset = false;
       return true;
     }
-  return false;
+  if (!have_partial_result)
+    return false;
+
+  /* update the view image with the new tiles outside the lock */
+  vector<ImageTile> tiles;
+  tiles.swap (partial_tiles);
+
+  const bool reset = partial_reset;
+  partial_reset = false;
+  have_partial_result = false;
+
+  const size_t width = partial_width;
+  const size_t height = partial_height;
+
+  lock.unlock();
+
+  if (reset)
+    {
+      image.resize (width, height);
+      std::fill (image.pixels.begin(), image.pixels.end(), MISSING_PIXEL);
+      partial_image_empty = true;
+    }
+  for (auto& tile : tiles)
+    apply_tile (image, tile);
+
+  return true;
+}
+
+/*
+ * copies a tile into the view image: since the maximum value only grows during
+ * the analysis, the pixels of the image (or the tile) are adjusted if the tile
+ * was drawn with a different maximum value than the image
+ */
+void
+FFTThread::apply_tile (PixelArray& image, ImageTile& tile)
+{
+  if (partial_image_empty)
+    {
+      partial_max_value = tile.max_value;
+      partial_image_empty = false;
+    }
+  if (tile.max_value > partial_max_value)
+    {
+      const int delta = (partial_max_value - tile.max_value) * 256;
+      for (auto& p : image.pixels)
+        p += delta;
+
+      partial_max_value = tile.max_value;
+    }
+  const int tile_delta = (tile.max_value - partial_max_value) * 256;
+
+  PixelArray& pixels = tile.pixels;
+  for (size_t y = 0; y < pixels.get_height(); y++)
+    {
+      const int *src = pixels.get_pixels() + y * pixels.get_rowstride();
+      int *dest = image.get_pixels() + (tile.y + y) * image.get_rowstride() + tile.x;
+
+      for (size_t x = 0; x < pixels.get_width(); x++)
+        dest[x] = src[x] + tile_delta;
+    }
 }
 
 void
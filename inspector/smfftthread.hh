@@ -11,6 +11,8 @@
 #include <QMutex>
 
 #include <thread>
+#include <mutex>
+#include <functional>
 
 namespace SpectMorph
 {
@@ -23,11 +25,31 @@ public:
     virtual void execute() = 0;
   };
 
+  /* part of the incomplete image of the running command */
+  struct ImageTile
+  {
+    size_t      x = 0;
+    size_t      y = 0;
+    float       max_value = 0;    // pixels are relative to this value
+    PixelArray  pixels;
+  };
+
 protected:
   QMutex                  command_mutex;
   std::vector<Command *>  commands;
   std::vector<Command *>  command_results;
   double                  command_progress;
+  std::vector<ImageTile>  partial_tiles;        // new tiles of the running command
+  size_t                  partial_width = 0;
+  size_t                  partial_height = 0;
+  bool                    partial_reset = false;
+  bool                    have_partial_result = false;
+
+  /* only used by the main thread */
+  float                   partial_max_value = 0;
+  bool                    partial_image_empty = true;
+
+  void apply_tile (PixelArray& image, ImageTile& tile);
 
   int                     fft_thread_wakeup_pfds[2];
   int                     main_thread_wakeup_pfds[2];
@@ -39,6 +61,8 @@ public:
   ~FFTThread();
 
   void set_command_progress (double progress);
+  void start_partial_result (size_t width, size_t height);
+  void add_partial_result (ImageTile& tile, bool wakeup);
   bool command_is_obsolete();
 
   void run();
@@ -58,6 +82,21 @@ signals:
 class AnalysisCommand : public FFTThread::Command
 {
   Q_OBJECT
+
+  /* progressive results: frames (FFT) or frequency bands (CWT) are computed in parallel */
+  typedef std::function<void (FFTThread::ImageTile& tile, float max_value)> DrawTileFunc;
+
+  std::mutex              lines_mutex;
+  size_t                  n_lines = 0;
+  size_t                  n_lines_done = 0;
+  float                   max_value = 0;
+  double                  partial_result_time = 0;
+
+  void start_lines (size_t n_lines, float min_value, size_t width, size_t height);
+  void lines_done (size_t start, size_t end, float lines_max_value, const DrawTileFunc& draw_tile);
+  void draw_fft_line (PixelArray& image, size_t x, const FFTResult& result, float max_value);
+  void draw_cwt_line (PixelArray& image, const std::vector<float>& band_result, size_t y, float max_value);
+
 public:
   FFTThread              *fft_thread;
   WavData                 wav_data;
@@ -70,6 +70,19 @@ ADSREnvelope::done() const
   return (state == State::DONE);
 }
 
+double
+ADSREnvelope::current_level() const
+{
+  return done() ? 0 : level;
+}
+
+/* maximum level until the end of the note: the level only increases during attack */
+double
+ADSREnvelope::max_level() const
+{
+  return state == State::ATTACK ? 1 : current_level();
+}
+
 void
 ADSREnvelope::compute_slope_params (int len, float start_x, float end_x, State param_state)
 {
@@ -35,6 +35,8 @@ public:
   void retrigger();
   void release();
   bool done() const;
+  double current_level() const;
+  double max_level() const;
   void process (size_t n_values, float *values);
 
   // test only
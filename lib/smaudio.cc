@@ -45,6 +45,10 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
 {
   SpectMorph::AudioBlock *audio_block = NULL;
 
+  /* with AUDIO_MAP_FRAMES, each frame is parsed into packed_block, then appended to the frame store */
+  AudioFrameStore::Builder frame_store_builder;
+  AudioBlock               packed_block;
+
   InFile ifile (file);
 
   string section;
@@ -59,7 +63,7 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
   if (ifile.file_version() != SPECTMORPH_BINARY_FILE_VERSION)
     return Error::Code::FORMAT_INVALID;
 
-  if (load_options == AUDIO_SKIP_DEBUG)
+  if (load_options == AUDIO_SKIP_DEBUG || load_options == AUDIO_MAP_FRAMES)
     {
       ifile.add_skip_event ("original_fft");
       ifile.add_skip_event ("debug_samples");
@@ -75,9 +79,21 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
           if (section == "frame")
             {
               assert (audio_block == NULL);
-              assert (contents_pos < contents.size());
 
-              audio_block = &contents[contents_pos];
+              if (load_options == AUDIO_MAP_FRAMES)
+                {
+                  /* clear, but keep capacity to avoid allocations for each frame */
+                  packed_block.freqs.clear();
+                  packed_block.mags.clear();
+                  packed_block.phases.clear();
+                  packed_block.noise.clear();
+                  audio_block = &packed_block;
+                }
+              else
+                {
+                  assert (contents_pos < contents.size());
+                  audio_block = &contents[contents_pos];
+                }
             }
         }
       else if (ifile.event() == InFile::END_SECTION)
@@ -86,6 +102,9 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
             {
               assert (audio_block);
 
+              if (load_options == AUDIO_MAP_FRAMES)
+                frame_store_builder.add (packed_block);
+
               contents_pos++;
               audio_block = NULL;
             }
@@ -114,7 +133,8 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
                   int frame_count = ifile.event_int();
 
                   contents.clear();
-                  contents.resize (frame_count);
+                  if (load_options != AUDIO_MAP_FRAMES)
+                    contents.resize (frame_count);
                   contents_pos = 0;
                 }
               else
@@ -226,9 +246,30 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
         }
       ifile.next_event();
     }
+  if (load_options == AUDIO_MAP_FRAMES)
+    frame_store = frame_store_builder.finish();
+
   return Error::Code::NONE;
 }
 
+/**
+ * This function moves the frame data from contents to a (read-only) frame store,
+ * which needs less memory and is faster to access during playback.
+ */
+void
+Audio::pack_frames()
+{
+  if (frame_store)
+    return;
+
+  AudioFrameStore::Builder builder;
+  for (const auto& block : contents)
+    builder.add (block);
+
+  frame_store = builder.finish();
+  contents = std::vector<AudioBlock>(); // free memory
+}
+
 SpectMorph::Audio::Audio()
 {
   leak_debugger.add (this);
@@ -266,6 +307,31 @@ SpectMorph::Audio::save (GenericOut *file) const
   OutFile of (file, "SpectMorph::Audio", SPECTMORPH_BINARY_FILE_VERSION);
   assert (of.open_ok());
 
+  save_header (of, frame_count());
+
+  AudioBlock mapped_block;
+  for (size_t i = 0; i < frame_count(); i++)
+    {
+      if (frame_store)
+        {
+          frame_store->to_audio_block (i, mapped_block);
+          save_block (of, mapped_block);
+        }
+      else
+        {
+          save_block (of, contents[i]);
+        }
+    }
+  return Error::Code::NONE;
+}
+
+/**
+ * Writes the header section of a SM-File; it must be followed by exactly
+ * \p n_frames save_block() calls for the frames.
+ */
+void
+Audio::save_header (OutFile& of, size_t n_frames) const
+{
   of.begin_section ("header");
   of.write_float ("mix_freq", mix_freq);
   of.write_float ("frame_size_ms", frame_size_ms);
@@ -279,32 +345,32 @@ SpectMorph::Audio::save (GenericOut *file) const
   of.write_int ("loop_start", loop_start);
   of.write_int ("loop_end", loop_end);
   of.write_int ("zero_values_at_start", zero_values_at_start);
-  of.write_int ("frame_count", contents.size());
+  of.write_int ("frame_count", n_frames);
   of.write_int ("sample_count", sample_count);
   of.write_float_block ("original_samples", original_samples);
   of.end_section();
+}
 
-  for (size_t i = 0; i < contents.size(); i++)
-    {
-      // ensure that freqs are sorted (we need that for LiveDecoder)
-      int old_freq = -1;
-
-      for (size_t f = 0; f < contents[i].freqs.size(); f++)
-        {
-          assert (contents[i].freqs[f] >= old_freq);
-          old_freq = contents[i].freqs[f];
-        }
+void
+Audio::save_block (OutFile& of, const AudioBlock& block)
+{
+  // ensure that freqs are sorted (we need that for LiveDecoder)
+  int old_freq = -1;
 
-      of.begin_section ("frame");
-      of.write_uint16_block ("noise", contents[i].noise);
-      of.write_uint16_block ("freqs", contents[i].freqs);
-      of.write_uint16_block ("mags", contents[i].mags);
-      of.write_uint16_block ("phases", contents[i].phases);
-      of.write_float_block ("original_fft", contents[i].original_fft);
-      of.write_float_block ("debug_samples", contents[i].debug_samples);
-      of.end_section();
+  for (size_t f = 0; f < block.freqs.size(); f++)
+    {
+      assert (block.freqs[f] >= old_freq);
+      old_freq = block.freqs[f];
     }
-  return Error::Code::NONE;
+
+  of.begin_section ("frame");
+  of.write_uint16_block ("noise", block.noise);
+  of.write_uint16_block ("freqs", block.freqs);
+  of.write_uint16_block ("mags", block.mags);
+  of.write_uint16_block ("phases", block.phases);
+  of.write_float_block ("original_fft", block.original_fft);
+  of.write_float_block ("debug_samples", block.debug_samples);
+  of.end_section();
 }
 
 Audio *
@@ -5,6 +5,7 @@
 
 #include <vector>
 
+#include "smaudioframestore.hh"
 #include "smgenericin.hh"
 #include "smgenericout.hh"
 #include "smmath.hh"
@@ -16,6 +17,8 @@
 namespace SpectMorph
 {
 
+class OutFile;
+
 /**
  * \brief Block of audio data, encoded in SpectMorph parametric format
  *
@@ -61,12 +64,26 @@ public:
   {
     return sm_idb2factor (noise[i]);
   }
+
+  AudioFrameView
+  view() const
+  {
+    AudioFrameView view;
+    view.freqs      = freqs.data();
+    view.mags       = mags.data();
+    view.phases     = phases.empty() ? nullptr : phases.data();
+    view.noise      = noise.data();
+    view.n_partials = freqs.size();
+    view.n_noise    = noise.size();
+    return view;
+  }
 };
 
 enum AudioLoadOptions
 {
   AUDIO_LOAD_DEBUG,
-  AUDIO_SKIP_DEBUG
+  AUDIO_SKIP_DEBUG,
+  AUDIO_MAP_FRAMES  // like AUDIO_SKIP_DEBUG, but store read-only frames in Audio::frame_store (mapped for flat files)
 };
 
 /**
@@ -75,6 +92,10 @@ enum AudioLoadOptions
  * This class contains the information the SpectMorph::Encoder creates for a wav file. The
  * time dependant parameters are stored in contents, as a vector of audio frames; the
  * parameters that are the same for all frames are stored in this class.
+ *
+ * Audio objects loaded with AUDIO_MAP_FRAMES have no contents; their (read-only)
+ * frames are accessed via frame_store instead. Code that only needs to read frames
+ * should use frame_count() and frame() to work for both cases.
  */
 class Audio
 {
@@ -108,12 +129,35 @@ public:
   std::vector<float> original_samples;            //!< original time domain signal as samples (debugging only)
   float    original_samples_norm_db = 0;          //!< normalization factor to be applied to original samples
   std::vector<AudioBlock> contents;               //!< the actual frame data
+  std::shared_ptr<AudioFrameStore> frame_store;   //!< memory mapped frame data (replaces contents if set)
+
+  size_t
+  frame_count() const
+  {
+    return frame_store ? frame_store->size() : contents.size();
+  }
+  /* unique identifier for a frame: pointer to frame data, which does not change while the Audio object exists */
+  const void *
+  frame_id (size_t i) const
+  {
+    return frame_store ? frame_store->frame_id (i) : &contents[i];
+  }
+  AudioFrameView
+  frame (size_t i) const
+  {
+    return frame_store ? frame_store->frame (i) : contents[i].view();
+  }
+  void pack_frames();
 
   Error load (const std::string& filename, AudioLoadOptions load_options = AUDIO_LOAD_DEBUG);
   Error load (SpectMorph::GenericIn *file, AudioLoadOptions load_options = AUDIO_LOAD_DEBUG);
   Error save (const std::string& filename) const;
   Error save (SpectMorph::GenericOut *file) const;
 
+  /* incremental saving (for the streaming encoder): header first, then n_frames blocks */
+  void save_header (OutFile& of, size_t n_frames) const;
+  static void save_block (OutFile& of, const AudioBlock& block);
+
   Audio *clone() const; // create a deep copy
 
   static bool loop_type_to_string (LoopType loop_type, std::string& s);
@@ -0,0 +1,126 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smaudioframestore.hh"
+#include "smaudio.hh"
+#include "smleakdebugger.hh"
+
+using namespace SpectMorph;
+
+static LeakDebugger leak_debugger ("SpectMorph::AudioFrameStore");
+
+AudioFrameStore::AudioFrameStore (std::shared_ptr<void> backing, const Frame *frames, size_t n_frames,
+                                  const uint16_t *freqs, const uint16_t *mags, const uint16_t *phases, const uint16_t *noise) :
+  m_backing (backing),
+  m_frames (frames),
+  m_n_frames (n_frames),
+  m_freqs (freqs),
+  m_mags (mags),
+  m_phases (phases),
+  m_noise (noise)
+{
+  leak_debugger.add (this);
+}
+
+AudioFrameStore::~AudioFrameStore()
+{
+  leak_debugger.del (this);
+}
+
+void
+AudioFrameStore::to_audio_block (size_t i, AudioBlock& block) const
+{
+  block.freqs.assign (freqs (i), freqs (i) + n_partials (i));
+  block.mags.assign (mags (i), mags (i) + n_partials (i));
+  block.phases.assign (phases (i), phases (i) + n_partials (i));
+  block.noise.assign (noise (i), noise (i) + n_noise (i));
+
+  if (m_debug)
+    {
+      const DebugFrame& d = m_debug->frames[i];
+      const float *original_fft = m_debug->original_fft.data() + d.original_fft_start;
+      const float *debug_samples = m_debug->debug_samples.data() + d.debug_samples_start;
+
+      block.original_fft.assign (original_fft, original_fft + d.n_original_fft);
+      block.debug_samples.assign (debug_samples, debug_samples + d.n_debug_samples);
+    }
+  else
+    {
+      block.original_fft.clear();
+      block.debug_samples.clear();
+    }
+}
+
+AudioFrameStore::Builder::Builder() :
+  m_pools (std::make_shared<Pools>())
+{
+}
+
+AudioFrameStore::Builder::~Builder()
+{
+}
+
+void
+AudioFrameStore::Builder::add (const AudioBlock& block)
+{
+  Pools& pools = *m_pools;
+
+  Frame frame;
+  frame.partials_start = pools.freqs.size();
+  frame.n_partials     = block.freqs.size();
+  frame.noise_start    = pools.noise.size();
+  frame.n_noise        = block.noise.size();
+  pools.frames.push_back (frame);
+
+  pools.freqs.insert (pools.freqs.end(), block.freqs.begin(), block.freqs.end());
+  pools.mags.insert (pools.mags.end(), block.mags.begin(), block.mags.end());
+
+  /* phases are optional in AudioBlock; the store always has one phase per partial */
+  if (block.phases.size() == block.freqs.size())
+    pools.phases.insert (pools.phases.end(), block.phases.begin(), block.phases.end());
+  else
+    pools.phases.resize (pools.freqs.size());
+
+  pools.noise.insert (pools.noise.end(), block.noise.begin(), block.noise.end());
+
+  if (!block.original_fft.empty() || !block.debug_samples.empty())
+    {
+      if (!m_debug)
+        {
+          /* frames before the first frame with debug data have none */
+          m_debug.reset (new DebugStore());
+          m_debug->frames.resize (pools.frames.size() - 1, DebugFrame {});
+        }
+    }
+  if (m_debug)
+    {
+      DebugFrame d;
+      d.original_fft_start  = m_debug->original_fft.size();
+      d.n_original_fft      = block.original_fft.size();
+      d.debug_samples_start = m_debug->debug_samples.size();
+      d.n_debug_samples     = block.debug_samples.size();
+      m_debug->frames.push_back (d);
+
+      m_debug->original_fft.insert (m_debug->original_fft.end(), block.original_fft.begin(), block.original_fft.end());
+      m_debug->debug_samples.insert (m_debug->debug_samples.end(), block.debug_samples.begin(), block.debug_samples.end());
+    }
+}
+
+std::shared_ptr<AudioFrameStore>
+AudioFrameStore::Builder::finish()
+{
+  Pools& pools = *m_pools;
+
+  /* release memory reserved by vector growth */
+  pools.frames.shrink_to_fit();
+  pools.freqs.shrink_to_fit();
+  pools.mags.shrink_to_fit();
+  pools.phases.shrink_to_fit();
+  pools.noise.shrink_to_fit();
+
+  auto store = std::make_shared<AudioFrameStore> (m_pools, pools.frames.data(), pools.frames.size(),
+                                                  pools.freqs.data(), pools.mags.data(), pools.phases.data(), pools.noise.data());
+  store->m_debug = std::move (m_debug);
+
+  m_pools = std::make_shared<Pools>();
+  return store;
+}
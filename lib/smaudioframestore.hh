@@ -0,0 +1,200 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_AUDIO_FRAME_STORE_HH
+#define SPECTMORPH_AUDIO_FRAME_STORE_HH
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "smmath.hh"
+#include "smutils.hh"
+
+namespace SpectMorph
+{
+
+class AudioBlock;
+
+/**
+ * \brief Read-only view of the data of one audio frame
+ *
+ * This provides the same accessors as AudioBlock, but doesn't own the data, so
+ * frames from different storage types (AudioBlock, RTAudioBlock, AudioFrameStore)
+ * can be read without copying.
+ */
+class AudioFrameView
+{
+public:
+  const uint16_t *freqs = nullptr;
+  const uint16_t *mags = nullptr;
+  const uint16_t *phases = nullptr;  // nullptr if the frame has no phase information
+  const uint16_t *noise = nullptr;
+  size_t          n_partials = 0;
+  size_t          n_noise = 0;
+
+  double
+  freqs_f (size_t i) const
+  {
+    return sm_ifreq2freq (freqs[i]);
+  }
+
+  double
+  mags_f (size_t i) const
+  {
+    return sm_idb2factor (mags[i]);
+  }
+
+  double
+  phases_f (size_t i) const
+  {
+    const double factor = 2.0 * M_PI / 65536.0;
+    return phases[i] * factor;
+  }
+
+  double
+  noise_f (size_t i) const
+  {
+    return sm_idb2factor (noise[i]);
+  }
+};
+
+/**
+ * \brief Read-only frame data of an Audio object, stored in contiguous pools
+ *
+ * Instead of one AudioBlock (with one std::vector per field) per frame, all
+ * frames share four pools (freqs, mags, phases, noise); a frame table stores
+ * the position of each frame in the pools. The pools either point into a
+ * memory mapped file (which is kept alive by the backing object), or are
+ * owned by the store (see Builder).
+ *
+ * Debug data (original_fft, debug_samples) is rarely needed, so it is kept
+ * in a separate cold store, to keep it out of the caches during playback.
+ */
+class AudioFrameStore
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (AudioFrameStore);
+public:
+  struct Frame
+  {
+    uint32_t partials_start;  //!< index of the first partial in freqs/mags/phases pools
+    uint32_t n_partials;      //!< number of partials
+    uint32_t noise_start;     //!< index of the first noise band in the noise pool
+    uint32_t n_noise;         //!< number of noise bands
+  };
+  class Builder;
+
+private:
+  struct DebugFrame
+  {
+    size_t original_fft_start;
+    size_t n_original_fft;
+    size_t debug_samples_start;
+    size_t n_debug_samples;
+  };
+  struct DebugStore
+  {
+    std::vector<DebugFrame> frames;
+    std::vector<float>      original_fft;
+    std::vector<float>      debug_samples;
+  };
+
+  std::shared_ptr<void>       m_backing;
+  std::unique_ptr<DebugStore> m_debug;
+  const Frame                *m_frames = nullptr;
+  size_t                      m_n_frames = 0;
+  const uint16_t             *m_freqs = nullptr;
+  const uint16_t             *m_mags = nullptr;
+  const uint16_t             *m_phases = nullptr;
+  const uint16_t             *m_noise = nullptr;
+
+public:
+  AudioFrameStore (std::shared_ptr<void> backing, const Frame *frames, size_t n_frames,
+                   const uint16_t *freqs, const uint16_t *mags, const uint16_t *phases, const uint16_t *noise);
+  ~AudioFrameStore();
+
+  size_t
+  size() const
+  {
+    return m_n_frames;
+  }
+  const void *
+  frame_id (size_t i) const
+  {
+    return m_frames + i;
+  }
+  size_t
+  n_partials (size_t i) const
+  {
+    return m_frames[i].n_partials;
+  }
+  size_t
+  n_noise (size_t i) const
+  {
+    return m_frames[i].n_noise;
+  }
+  const uint16_t *
+  freqs (size_t i) const
+  {
+    return m_freqs + m_frames[i].partials_start;
+  }
+  const uint16_t *
+  mags (size_t i) const
+  {
+    return m_mags + m_frames[i].partials_start;
+  }
+  const uint16_t *
+  phases (size_t i) const
+  {
+    return m_phases + m_frames[i].partials_start;
+  }
+  const uint16_t *
+  noise (size_t i) const
+  {
+    return m_noise + m_frames[i].noise_start;
+  }
+  AudioFrameView
+  frame (size_t i) const
+  {
+    const Frame& f = m_frames[i];
+
+    AudioFrameView view;
+    view.freqs      = m_freqs + f.partials_start;
+    view.mags       = m_mags + f.partials_start;
+    view.phases     = m_phases + f.partials_start;
+    view.noise      = m_noise + f.noise_start;
+    view.n_partials = f.n_partials;
+    view.n_noise    = f.n_noise;
+    return view;
+  }
+
+  void to_audio_block (size_t i, AudioBlock& block) const;
+};
+
+/**
+ * \brief Packs frames into a new AudioFrameStore which owns the pools
+ */
+class AudioFrameStore::Builder
+{
+  struct Pools
+  {
+    std::vector<Frame>    frames;
+    std::vector<uint16_t> freqs;
+    std::vector<uint16_t> mags;
+    std::vector<uint16_t> phases;
+    std::vector<uint16_t> noise;
+  };
+  std::shared_ptr<Pools>      m_pools;
+  std::unique_ptr<DebugStore> m_debug;
+
+public:
+  Builder();
+  ~Builder();
+
+  void add (const AudioBlock& block);
+  std::shared_ptr<AudioFrameStore> finish();
+};
+
+}
+
+#endif
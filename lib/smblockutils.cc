@@ -1,6 +1,8 @@
 // Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
 
 #include "smblockutils.hh"
+#include "smmath.hh"
+#include "smmain.hh"
 
 using namespace SpectMorph;
 
@@ -54,3 +56,62 @@ Block::range (guint           n_values,
   min_value = minv;
   max_value = maxv;
 }
+
+/*
+ * out_left  += in_left  * gain_left
+ * out_right += in_right * gain_right
+ *
+ * where both gains are ramped linearly from start to end during the block
+ * (the end gain is reached at the last value), to avoid zipper noise if the
+ * gain changes between blocks; for mono input, in_left and in_right can be
+ * the same buffer
+ */
+void
+Block::mix_stereo (guint        n_values,
+                   float       *out_left,
+                   float       *out_right,
+                   const float *in_left,
+                   const float *in_right,
+                   float        gain_left_start,
+                   float        gain_left_end,
+                   float        gain_right_start,
+                   float        gain_right_end)
+{
+  if (!n_values)
+    return;
+
+  const float delta_left = (gain_left_end - gain_left_start) / n_values;
+  const float delta_right = (gain_right_end - gain_right_start) / n_values;
+
+  guint i = 0;
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+  if (sm_sse())
+    {
+      /* the loop carried ramp position would prevent auto vectorization, so we do it by hand */
+      const __m128 start_left4 = _mm_set_ps (gain_left_start, gain_left_start, gain_left_start, gain_left_start);
+      const __m128 start_right4 = _mm_set_ps (gain_right_start, gain_right_start, gain_right_start, gain_right_start);
+      const __m128 delta_left4 = _mm_set_ps (delta_left, delta_left, delta_left, delta_left);
+      const __m128 delta_right4 = _mm_set_ps (delta_right, delta_right, delta_right, delta_right);
+      const __m128 four = _mm_set_ps (4, 4, 4, 4);
+
+      __m128 pos = _mm_set_ps (4, 3, 2, 1);
+      for (; i + 4 <= n_values; i += 4)
+        {
+          const __m128 gain_left = _mm_add_ps (start_left4, _mm_mul_ps (delta_left4, pos));
+          const __m128 gain_right = _mm_add_ps (start_right4, _mm_mul_ps (delta_right4, pos));
+
+          _mm_storeu_ps (out_left + i, _mm_add_ps (_mm_loadu_ps (out_left + i), _mm_mul_ps (_mm_loadu_ps (in_left + i), gain_left)));
+          _mm_storeu_ps (out_right + i, _mm_add_ps (_mm_loadu_ps (out_right + i), _mm_mul_ps (_mm_loadu_ps (in_right + i), gain_right)));
+
+          pos = _mm_add_ps (pos, four);
+        }
+    }
+#endif
+  for (; i < n_values; i++)
+    {
+      const float pos = i + 1;
+
+      out_left[i] += in_left[i] * (gain_left_start + delta_left * pos);
+      out_right[i] += in_right[i] * (gain_right_start + delta_right * pos);
+    }
+}
@@ -23,6 +23,15 @@ public:
                        const float    *ivalues,
                        float&          min_value,
                        float&          max_value);
+  static void  mix_stereo (guint        n_values,
+                           float       *out_left,
+                           float       *out_right,
+                           const float *in_left,
+                           const float *in_right,
+                           float        gain_left_start,
+                           float        gain_left_end,
+                           float        gain_right_start,
+                           float        gain_right_end);
 };
 
 }
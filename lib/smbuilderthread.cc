@@ -30,6 +30,7 @@ struct BuilderThread::Job
   int                                  object_id = 0;
   std::function<void(WavSet *wav_set)> done_func;
   std::atomic<bool>                    atomic_quit { false };
+  std::atomic<double>                  atomic_progress { 0 };
 
   Job (WavSetBuilder *builder, int object_id, const std::function<void(WavSet *wav_set)>& done_func) :
     builder (builder),
@@ -45,6 +46,10 @@ BuilderThread::add_job (WavSetBuilder *builder, int object_id, const std::functi
   Job *job = new Job (builder, object_id, done_func);
 
   builder->set_kill_function ([job]() { return job->atomic_quit.load(); });
+  builder->set_progress_function ([job] (size_t n_done, size_t n_total)
+    {
+      job->atomic_progress.store (double (n_done) / n_total);
+    });
 
   std::lock_guard<std::mutex> lg (mutex);
   todo.emplace_back (job);
@@ -68,6 +73,17 @@ BuilderThread::search_job (int object_id)
   return false;
 }
 
+/* fraction of the samples that are encoded (0 ... 1), or -1 if there is no job for object_id */
+double
+BuilderThread::job_progress (int object_id)
+{
+  std::lock_guard<std::mutex> lg (mutex);
+  for (auto& job : todo)
+    if (job->object_id == object_id && !job->atomic_quit.load())
+      return job->atomic_progress.load();
+  return -1;
+}
+
 void
 BuilderThread::kill_all_jobs()
 {
@@ -39,6 +39,7 @@ public:
   void   add_job (WavSetBuilder *builder, int object_id, const std::function<void(WavSet *wav_set)>& done_func);
   size_t job_count();
   bool   search_job (int object_id);
+  double job_progress (int object_id);
   void   kill_all_jobs();
   void   kill_jobs_by_id (int object_id);
 };
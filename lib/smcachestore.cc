@@ -0,0 +1,548 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smcachestore.hh"
+
+#include <algorithm>
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#ifdef SM_OS_WINDOWS
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+/* the files are only used on one machine, so all values are stored in native byte order */
+namespace
+{
+
+const char   INDEX_MAGIC[8]  = { 'S', 'M', 'C', 'I', 'D', 'X', '0', '1' };
+const char   RECORD_MAGIC[4] = { 'S', 'M', 'C', 'R' };
+const uint32 N_SLOTS         = 8192;
+
+/* we lock one byte beyond the end of the index file, so that the lock doesn't
+ * interfere with accessing the file (windows locks are mandatory)
+ */
+const uint32 LOCK_OFFSET     = 1 << 30;
+
+enum SlotState : uint32
+{
+  SLOT_EMPTY   = 0,
+  SLOT_USED    = 1,
+  SLOT_DELETED = 2   // removed entry: lookups need to continue probing
+};
+
+struct IndexHeader
+{
+  char   magic[8];
+  uint32 n_slots;
+  uint32 n_used;
+  uint32 n_deleted;
+  uint32 reserved;
+  uint64 pack_size;    // end of valid data in pack file
+  uint64 data_size;    // size of the records of all used slots
+  uint64 clock;        // access counter for LRU
+};
+
+struct IndexSlot
+{
+  char   key_hash[40]; // sha1 hash of key (hex)
+  uint32 state;
+  uint32 reserved;
+  uint64 offset;       // record position in pack file
+  uint64 size;         // data size (without record header)
+  uint64 last_access;
+};
+
+struct RecordHeader
+{
+  char   magic[4];
+  uint32 reserved;
+  uint64 size;
+  char   key_hash[40];
+  char   data_hash[40];
+};
+
+uint32
+slot_hash (const string& key_hash)
+{
+  uint32 h = 0;
+  for (char c : key_hash)
+    h = h * 31 + (unsigned char) c;
+  return h;
+}
+
+uint64
+record_size (const IndexSlot& slot)
+{
+  return sizeof (RecordHeader) + slot.size;
+}
+
+}
+
+/* index file: mapped into memory and locked while the object exists */
+class CacheStore::Index
+{
+  int     m_fd = -1;
+  bool    m_locked = false;
+  void   *m_mem = nullptr;
+  size_t  m_mem_size = 0;
+#ifdef SM_OS_WINDOWS
+  HANDLE  m_mapping = nullptr;
+#endif
+
+  bool lock();
+  void unlock();
+  bool map();
+  void unmap();
+
+public:
+  IndexHeader *header = nullptr;
+  IndexSlot   *slots = nullptr;
+
+  ~Index();
+
+  bool        open (const string& filename);
+  void        reset();
+  void        rehash();
+
+  IndexSlot  *find (const string& key_hash);
+  IndexSlot  *find_free (const string& key_hash);
+  void        remove (IndexSlot *slot);
+};
+
+bool
+CacheStore::Index::lock()
+{
+#ifdef SM_OS_WINDOWS
+  OVERLAPPED overlapped = {};
+  overlapped.Offset = LOCK_OFFSET;
+  m_locked = LockFileEx ((HANDLE) _get_osfhandle (m_fd), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+#else
+  struct flock fl = {};
+  fl.l_type   = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start  = LOCK_OFFSET;
+  fl.l_len    = 1;
+
+  int result;
+  while ((result = fcntl (m_fd, F_SETLKW, &fl)) == -1 && errno == EINTR)
+    ;
+  m_locked = (result == 0);
+#endif
+  return m_locked;
+}
+
+void
+CacheStore::Index::unlock()
+{
+  if (!m_locked)
+    return;
+
+#ifdef SM_OS_WINDOWS
+  OVERLAPPED overlapped = {};
+  overlapped.Offset = LOCK_OFFSET;
+  UnlockFileEx ((HANDLE) _get_osfhandle (m_fd), 0, 1, 0, &overlapped);
+#else
+  struct flock fl = {};
+  fl.l_type   = F_UNLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start  = LOCK_OFFSET;
+  fl.l_len    = 1;
+  fcntl (m_fd, F_SETLK, &fl);
+#endif
+  m_locked = false;
+}
+
+bool
+CacheStore::Index::map()
+{
+#ifdef SM_OS_WINDOWS
+  m_mapping = CreateFileMapping ((HANDLE) _get_osfhandle (m_fd), nullptr, PAGE_READWRITE, 0, 0, nullptr);
+  if (!m_mapping)
+    return false;
+
+  m_mem = MapViewOfFile (m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_mem_size);
+#else
+  m_mem = mmap (nullptr, m_mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (m_mem == MAP_FAILED)
+    m_mem = nullptr;
+#endif
+  return m_mem != nullptr;
+}
+
+void
+CacheStore::Index::unmap()
+{
+#ifdef SM_OS_WINDOWS
+  if (m_mem)
+    UnmapViewOfFile (m_mem);
+  if (m_mapping)
+    CloseHandle (m_mapping);
+  m_mapping = nullptr;
+#else
+  if (m_mem)
+    munmap (m_mem, m_mem_size);
+#endif
+  m_mem = nullptr;
+}
+
+bool
+CacheStore::Index::open (const string& filename)
+{
+  m_fd = g_open (filename.c_str(), O_RDWR | O_CREAT | O_BINARY, 0664);
+  if (m_fd < 0)
+    return false;
+
+  if (!lock())
+    return false;
+
+  m_mem_size = sizeof (IndexHeader) + N_SLOTS * sizeof (IndexSlot);
+
+  /* new file or incompatible index: (re-)create it */
+  struct stat st;
+  const bool valid_size = fstat (m_fd, &st) == 0 && size_t (st.st_size) == m_mem_size;
+  if (!valid_size)
+    {
+      if (ftruncate (m_fd, 0) != 0 || ftruncate (m_fd, m_mem_size) != 0)
+        return false;
+    }
+  if (!map())
+    return false;
+
+  header = static_cast<IndexHeader *> (m_mem);
+  slots  = reinterpret_cast<IndexSlot *> (header + 1);
+
+  if (!valid_size || memcmp (header->magic, INDEX_MAGIC, sizeof (INDEX_MAGIC)) != 0 || header->n_slots != N_SLOTS)
+    reset();
+
+  return true;
+}
+
+CacheStore::Index::~Index()
+{
+  unmap();
+  unlock();
+
+  if (m_fd >= 0)
+    close (m_fd);
+}
+
+void
+CacheStore::Index::reset()
+{
+  memset (m_mem, 0, m_mem_size);
+  memcpy (header->magic, INDEX_MAGIC, sizeof (INDEX_MAGIC));
+  header->n_slots = N_SLOTS;
+}
+
+IndexSlot *
+CacheStore::Index::find (const string& key_hash)
+{
+  uint32 pos = slot_hash (key_hash) % N_SLOTS;
+  for (uint32 i = 0; i < N_SLOTS; i++)
+    {
+      IndexSlot& slot = slots[pos];
+      if (slot.state == SLOT_EMPTY)
+        return nullptr;
+      if (slot.state == SLOT_USED && key_hash.compare (0, string::npos, slot.key_hash, sizeof (slot.key_hash)) == 0)
+        return &slot;
+
+      pos = (pos + 1) % N_SLOTS;
+    }
+  return nullptr;
+}
+
+IndexSlot *
+CacheStore::Index::find_free (const string& key_hash)
+{
+  uint32 pos = slot_hash (key_hash) % N_SLOTS;
+  for (uint32 i = 0; i < N_SLOTS; i++)
+    {
+      IndexSlot& slot = slots[pos];
+      if (slot.state != SLOT_USED)
+        return &slot;
+
+      pos = (pos + 1) % N_SLOTS;
+    }
+  return nullptr;
+}
+
+void
+CacheStore::Index::remove (IndexSlot *slot)
+{
+  header->data_size -= record_size (*slot);
+  header->n_used--;
+  header->n_deleted++;
+
+  slot->state = SLOT_DELETED;
+}
+
+/* get rid of deleted slots, which make probing slower */
+void
+CacheStore::Index::rehash()
+{
+  vector<IndexSlot> used;
+  for (uint32 i = 0; i < N_SLOTS; i++)
+    {
+      if (slots[i].state == SLOT_USED)
+        used.push_back (slots[i]);
+    }
+  memset (slots, 0, N_SLOTS * sizeof (IndexSlot));
+  for (const auto& slot : used)
+    *find_free (string (slot.key_hash, sizeof (slot.key_hash))) = slot;
+
+  header->n_deleted = 0;
+}
+
+CacheStore::CacheStore (const string& dirname, const string& name, uint64 max_size) :
+  m_index_filename (dirname + "/" + name + ".idx"),
+  m_pack_filename (dirname + "/" + name + ".pack"),
+  m_max_size (max_size)
+{
+}
+
+bool
+CacheStore::read_entry_L (Index& index, const string& key_hash, vector<unsigned char>& data)
+{
+  IndexSlot *slot = index.find (key_hash);
+  if (!slot)
+    return false;
+
+  bool ok = false;
+  FILE *pack = g_fopen (m_pack_filename.c_str(), "rb");
+  if (pack)
+    {
+      RecordHeader record;
+      if (fseek (pack, slot->offset, SEEK_SET) == 0 &&
+          fread (&record, sizeof (record), 1, pack) == 1 &&
+          memcmp (record.magic, RECORD_MAGIC, sizeof (RECORD_MAGIC)) == 0 &&
+          memcmp (record.key_hash, slot->key_hash, sizeof (record.key_hash)) == 0 &&
+          record.size == slot->size)
+        {
+          data.resize (record.size);
+          if (fread (data.data(), 1, data.size(), pack) == data.size())
+            ok = sha1_hash (data.data(), data.size()).compare (0, string::npos, record.data_hash, sizeof (record.data_hash)) == 0;
+        }
+      fclose (pack);
+    }
+  if (ok)
+    slot->last_access = ++index.header->clock;
+  else
+    index.remove (slot); // damaged entry
+
+  return ok;
+}
+
+bool
+CacheStore::lookup (const string& key, vector<unsigned char>& data)
+{
+  const double start_time = get_time();
+
+  std::lock_guard<std::mutex> lg (m_mutex);
+
+  Index index;
+  const bool found = index.open (m_index_filename) && read_entry_L (index, sha1_hash (key), data);
+
+  const double time = get_time() - start_time;
+  m_stats.lookup_time += time;
+  m_stats.max_lookup_time = std::max (m_stats.max_lookup_time, time);
+  if (found)
+    m_stats.hits++;
+  else
+    m_stats.misses++;
+
+  return found;
+}
+
+/* remove least recently used entries to make room for a new record */
+bool
+CacheStore::make_room_L (Index& index, uint64 new_record_size)
+{
+  IndexHeader *header = index.header;
+
+  vector<IndexSlot *> used;
+  for (uint32 i = 0; i < N_SLOTS; i++)
+    {
+      if (index.slots[i].state == SLOT_USED)
+        used.push_back (&index.slots[i]);
+    }
+  std::sort (used.begin(), used.end(), [] (const IndexSlot *a, const IndexSlot *b) {
+    return a->last_access < b->last_access;
+  });
+
+  /* keep the hash table at most half full, so probing is fast */
+  for (IndexSlot *slot : used)
+    {
+      if (header->data_size + new_record_size <= m_max_size && header->n_used < N_SLOTS / 2)
+        break;
+
+      index.remove (slot);
+      m_stats.evictions++;
+    }
+  if (header->n_used + header->n_deleted >= N_SLOTS * 3 / 4)
+    index.rehash();
+
+  if (header->pack_size - header->data_size > m_max_size / 2)
+    return compact_L (index);
+
+  return true;
+}
+
+/* copy all used records to a new pack file, to get rid of removed entries */
+bool
+CacheStore::compact_L (Index& index)
+{
+  vector<IndexSlot *> used;
+  for (uint32 i = 0; i < N_SLOTS; i++)
+    {
+      if (index.slots[i].state == SLOT_USED)
+        used.push_back (&index.slots[i]);
+    }
+  std::sort (used.begin(), used.end(), [] (const IndexSlot *a, const IndexSlot *b) {
+    return a->offset < b->offset;
+  });
+
+  const string tmp_filename = m_pack_filename + ".tmp";
+
+  FILE *old_pack = g_fopen (m_pack_filename.c_str(), "rb");
+  FILE *new_pack = g_fopen (tmp_filename.c_str(), "wb");
+
+  bool ok = old_pack && new_pack;
+
+  vector<unsigned char> buffer;
+  uint64 new_pack_size = 0;
+  for (IndexSlot *slot : used)
+    {
+      if (!ok)
+        break;
+
+      buffer.resize (record_size (*slot));
+      ok = fseek (old_pack, slot->offset, SEEK_SET) == 0 &&
+           fread (buffer.data(), 1, buffer.size(), old_pack) == buffer.size() &&
+           fwrite (buffer.data(), 1, buffer.size(), new_pack) == buffer.size();
+
+      slot->offset = new_pack_size;
+      new_pack_size += buffer.size();
+    }
+  if (old_pack)
+    fclose (old_pack);
+  if (new_pack && fclose (new_pack) != 0)
+    ok = false;
+
+  if (ok)
+    ok = g_rename (tmp_filename.c_str(), m_pack_filename.c_str()) == 0;
+
+  if (!ok)
+    {
+      /* offsets are no longer valid: start with an empty cache */
+      g_unlink (tmp_filename.c_str());
+      index.reset();
+      return true;
+    }
+  index.header->pack_size = new_pack_size;
+  return true;
+}
+
+bool
+CacheStore::insert (const string& key, const vector<unsigned char>& data)
+{
+  std::lock_guard<std::mutex> lg (m_mutex);
+
+  const string key_hash = sha1_hash (key);
+  const uint64 new_record_size = sizeof (RecordHeader) + data.size();
+  if (new_record_size > m_max_size)
+    return false;
+
+  Index index;
+  if (!index.open (m_index_filename))
+    return false;
+
+  IndexSlot *slot = index.find (key_hash);
+  if (slot) // keys are content addressed: same key means same data
+    {
+      slot->last_access = ++index.header->clock;
+      return true;
+    }
+  if (!make_room_L (index, new_record_size))
+    return false;
+
+  FILE *pack = g_fopen (m_pack_filename.c_str(), "r+b");
+  if (!pack)
+    pack = g_fopen (m_pack_filename.c_str(), "w+b");
+  if (!pack)
+    return false;
+
+  /* pack file was removed or truncated: all entries are gone */
+  if (fseek (pack, 0, SEEK_END) != 0 || uint64 (ftell (pack)) < index.header->pack_size)
+    index.reset();
+
+  RecordHeader record;
+  memset (&record, 0, sizeof (record));
+  memcpy (record.magic, RECORD_MAGIC, sizeof (RECORD_MAGIC));
+  record.size = data.size();
+  memcpy (record.key_hash, key_hash.data(), sizeof (record.key_hash));
+  memcpy (record.data_hash, sha1_hash (data.data(), data.size()).data(), sizeof (record.data_hash));
+
+  /* append: anything after pack_size is left over from failed writes */
+  bool ok = fseek (pack, index.header->pack_size, SEEK_SET) == 0 &&
+            fwrite (&record, sizeof (record), 1, pack) == 1 &&
+            fwrite (data.data(), 1, data.size(), pack) == data.size();
+  if (fclose (pack) != 0)
+    ok = false;
+
+  if (!ok)
+    return false;
+
+  slot = index.find_free (key_hash);
+  if (slot->state == SLOT_DELETED)
+    index.header->n_deleted--;
+
+  memcpy (slot->key_hash, key_hash.data(), sizeof (slot->key_hash));
+  slot->state       = SLOT_USED;
+  slot->offset      = index.header->pack_size;
+  slot->size        = data.size();
+  slot->last_access = ++index.header->clock;
+
+  index.header->n_used++;
+  index.header->pack_size += new_record_size;
+  index.header->data_size += new_record_size;
+
+  m_stats.inserts++;
+  return true;
+}
+
+void
+CacheStore::clear()
+{
+  std::lock_guard<std::mutex> lg (m_mutex);
+
+  Index index;
+  if (index.open (m_index_filename))
+    {
+      index.reset();
+      g_unlink (m_pack_filename.c_str());
+    }
+}
+
+CacheStore::Stats
+CacheStore::stats()
+{
+  std::lock_guard<std::mutex> lg (m_mutex);
+
+  return m_stats;
+}
@@ -0,0 +1,68 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_CACHE_STORE_HH
+#define SPECTMORPH_CACHE_STORE_HH
+
+#include "smutils.hh"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SpectMorph
+{
+
+/**
+ * \brief Persistent key/value store for cache data
+ *
+ * All entries are stored in one append-only pack file, and a fixed size hash
+ * index (which is mmapped) maps the sha1 hash of each key to the position of
+ * the data in the pack file. Every access locks the index file, so several
+ * processes (like plugin instances) can use the same store at the same time.
+ *
+ * If the total size of the entries exceeds the size limit, the least recently
+ * used entries are removed. The pack file is compacted if it contains too
+ * much data from removed entries.
+ *
+ * File locks only work between processes: use one CacheStore object per store
+ * within a process (it is thread safe).
+ */
+class CacheStore
+{
+public:
+  struct Stats
+  {
+    uint64 hits            = 0;
+    uint64 misses          = 0;
+    uint64 inserts         = 0;
+    uint64 evictions       = 0;
+    double lookup_time     = 0;   // total time for all lookups in seconds
+    double max_lookup_time = 0;
+  };
+
+private:
+  class Index;
+
+  std::string m_index_filename;
+  std::string m_pack_filename;
+  uint64      m_max_size;
+  std::mutex  m_mutex;
+  Stats       m_stats;
+
+  bool  read_entry_L (Index& index, const std::string& key_hash, std::vector<unsigned char>& data);
+  bool  make_room_L (Index& index, uint64 record_size);
+  bool  compact_L (Index& index);
+
+public:
+  CacheStore (const std::string& dirname, const std::string& name, uint64 max_size);
+
+  bool  lookup (const std::string& key, std::vector<unsigned char>& data);
+  bool  insert (const std::string& key, const std::vector<unsigned char>& data);
+  void  clear();
+
+  Stats stats();
+};
+
+}
+
+#endif
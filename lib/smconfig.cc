@@ -30,6 +30,42 @@ Config::Config()
         {
           m_zoom = i;
         }
+      else if (cfg_parser.command ("render_threads", i))
+        {
+          m_render_threads = i;
+        }
+      else if (cfg_parser.command ("noise_texture", i))
+        {
+          m_noise_texture = i;
+        }
+      else if (cfg_parser.command ("filter_batch", i))
+        {
+          m_filter_batch = i;
+        }
+      else if (cfg_parser.command ("spectral_bus", i))
+        {
+          m_spectral_bus = i;
+        }
+      else if (cfg_parser.command ("voice_steal", s))
+        {
+          m_voice_steal = s;
+        }
+      else if (cfg_parser.command ("voice_cpu_budget", i))
+        {
+          m_voice_cpu_budget = i;
+        }
+      else if (cfg_parser.command ("voice_reduce_unison", i))
+        {
+          m_voice_reduce_unison = i;
+        }
+      else if (cfg_parser.command ("lod_threshold_db", i))
+        {
+          m_lod_threshold_db = i;
+        }
+      else if (cfg_parser.command ("lod_max_partials", i))
+        {
+          m_lod_max_partials = i;
+        }
       else if (cfg_parser.command ("debug", s))
         {
           m_debug.push_back (s);
@@ -61,6 +97,114 @@ Config::set_zoom (int z)
   m_zoom = z;
 }
 
+int
+Config::render_threads() const
+{
+  return m_render_threads;
+}
+
+void
+Config::set_render_threads (int n)
+{
+  m_render_threads = n;
+}
+
+bool
+Config::noise_texture() const
+{
+  return m_noise_texture;
+}
+
+void
+Config::set_noise_texture (bool enable)
+{
+  m_noise_texture = enable;
+}
+
+bool
+Config::filter_batch() const
+{
+  return m_filter_batch;
+}
+
+void
+Config::set_filter_batch (bool enable)
+{
+  m_filter_batch = enable;
+}
+
+bool
+Config::spectral_bus() const
+{
+  return m_spectral_bus;
+}
+
+void
+Config::set_spectral_bus (bool enable)
+{
+  m_spectral_bus = enable;
+}
+
+string
+Config::voice_steal() const
+{
+  return m_voice_steal;
+}
+
+void
+Config::set_voice_steal (const string& policy)
+{
+  m_voice_steal = policy;
+}
+
+int
+Config::voice_cpu_budget() const
+{
+  return m_voice_cpu_budget;
+}
+
+void
+Config::set_voice_cpu_budget (int percent)
+{
+  m_voice_cpu_budget = percent;
+}
+
+bool
+Config::voice_reduce_unison() const
+{
+  return m_voice_reduce_unison;
+}
+
+void
+Config::set_voice_reduce_unison (bool enable)
+{
+  m_voice_reduce_unison = enable;
+}
+
+int
+Config::lod_threshold_db() const
+{
+  return m_lod_threshold_db;
+}
+
+void
+Config::set_lod_threshold_db (int db)
+{
+  m_lod_threshold_db = db;
+}
+
+int
+Config::lod_max_partials() const
+{
+  return m_lod_max_partials;
+}
+
+void
+Config::set_lod_max_partials (int n)
+{
+  m_lod_max_partials = n;
+}
+
 vector<string>
 Config::debug()
 {
@@ -90,6 +234,15 @@ Config::store()
   fprintf (file, "# this file is automatically updated by SpectMorph\n");
   fprintf (file, "# it can be manually edited, however, if you do that, be careful\n");
   fprintf (file, "zoom %d\n", m_zoom);
+  fprintf (file, "render_threads %d\n", m_render_threads);
+  fprintf (file, "noise_texture %d\n", m_noise_texture ? 1 : 0);
+  fprintf (file, "filter_batch %d\n", m_filter_batch ? 1 : 0);
+  fprintf (file, "spectral_bus %d\n", m_spectral_bus ? 1 : 0);
+  fprintf (file, "voice_steal \"%s\"\n", m_voice_steal.c_str());
+  fprintf (file, "voice_cpu_budget %d\n", m_voice_cpu_budget);
+  fprintf (file, "voice_reduce_unison %d\n", m_voice_reduce_unison ? 1 : 0);
+  fprintf (file, "lod_threshold_db %d\n", m_lod_threshold_db);
+  fprintf (file, "lod_max_partials %d\n", m_lod_max_partials);
 
   for (auto area : m_debug)
     fprintf (file, "debug %s\n", area.c_str());
@@ -13,6 +13,15 @@ namespace SpectMorph
 class Config
 {
   int                      m_zoom = 100;
+  int                      m_render_threads = 1;
+  bool                     m_noise_texture = false;
+  bool                     m_filter_batch = false;
+  bool                     m_spectral_bus = false;  // adds SpectralBus::latency() to the notes on the bus (~21 ms at 48 kHz)
+  std::string              m_voice_steal = "none";
+  int                      m_voice_cpu_budget = 0;
+  bool                     m_voice_reduce_unison = true;
+  int                      m_lod_threshold_db = 0;
+  int                      m_lod_max_partials = 0;
   std::vector<std::string> m_debug;
   std::string              m_font;
   std::string              m_font_bold;
@@ -24,6 +33,33 @@ public:
   int   zoom() const;
   void  set_zoom (int z);
 
+  int   render_threads() const;
+  void  set_render_threads (int n);
+
+  bool  noise_texture() const;
+  void  set_noise_texture (bool enable);
+
+  bool  filter_batch() const;
+  void  set_filter_batch (bool enable);
+
+  bool  spectral_bus() const;
+  void  set_spectral_bus (bool enable);
+
+  std::string voice_steal() const;
+  void        set_voice_steal (const std::string& policy);
+
+  int   voice_cpu_budget() const;
+  void  set_voice_cpu_budget (int percent);
+
+  bool  voice_reduce_unison() const;
+  void  set_voice_reduce_unison (bool enable);
+
+  int   lod_threshold_db() const;
+  void  set_lod_threshold_db (int db);
+
+  int   lod_max_partials() const;
+  void  set_lod_max_partials (int n);
+
   std::vector<std::string> debug();
 
   std::string font() const;
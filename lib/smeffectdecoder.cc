@@ -40,6 +40,16 @@ public:
   {
     return state == State::DONE;
   }
+  double
+  current_level() const
+  {
+    return state == State::DONE ? 0 : level;
+  }
+  double
+  max_level() const
+  {
+    return current_level();
+  }
   void
   process (size_t n_values, float *values)
   {
@@ -170,10 +180,8 @@ EffectDecoder::set_config (const MorphOutput::Config *cfg, LiveDecoderSource *so
   chain_decoder.enable_noise (cfg->noise);
   chain_decoder.enable_sines (cfg->sines);
 
-  if (cfg->unison) // unison?
-    chain_decoder.set_unison_voices (cfg->unison_voices, cfg->unison_detune);
-  else
-    chain_decoder.set_unison_voices (1, 0);
+  this->cfg = cfg;
+  update_unison();
 
   chain_decoder.set_vibrato (cfg->vibrato, cfg->vibrato_depth, cfg->vibrato_frequency, cfg->vibrato_attack);
 
@@ -189,6 +197,32 @@ EffectDecoder::set_config (const MorphOutput::Config *cfg, LiveDecoderSource *so
     chain_decoder.set_filter (nullptr);
 
   filter_enabled = cfg->filter;
+  vibrato_enabled = cfg->vibrato;
+}
+
+void
+EffectDecoder::update_unison()
+{
+  int voices = cfg->unison ? cfg->unison_voices : 1;
+  if (unison_limit > 0)
+    voices = std::min (voices, unison_limit);
+
+  if (voices > 1) // unison?
+    chain_decoder.set_unison_voices (voices, cfg->unison_detune, cfg->unison_spread / 100);
+  else
+    chain_decoder.set_unison_voices (1, 0);
+}
+
+/* limit the number of unison voices (to save cpu time), 0 means no limit */
+void
+EffectDecoder::set_unison_limit (int max_voices)
+{
+  if (max_voices == unison_limit)
+    return;
+
+  unison_limit = max_voices;
+  if (cfg)
+    update_unison();
 }
 
 void
@@ -213,12 +247,112 @@ EffectDecoder::process (RTMemoryArea& rt_memory_area,
                         const float  *freq_in,
                         float        *audio_out)
 {
+  /* voice was moved from the spectral bus to per voice rendering */
+  if (spectrum_release_pos >= 0)
+    {
+      release();
+      spectrum_release_pos = -1;
+    }
+  update_lod();
   chain_decoder.process (rt_memory_area, n_values, freq_in, audio_out);
 
+  float *envelope_out = audio_out;
+  if (filter_job && filter_job->filter)
+    {
+      if (n_values <= FilterJob::MAX_VALUES)
+        {
+          /* filtering has been deferred: store envelope, FilterBatch applies it after filtering */
+          std::fill_n (filter_job->envelope, n_values, 1.0f);
+          filter_job->envelope_audio = audio_out;
+          filter_job->n_envelope = n_values;
+
+          envelope_out = filter_job->envelope;
+        }
+      else
+        {
+          live_decoder_filter.flush_job();
+        }
+    }
   if (adsr_enabled)
-    adsr_envelope->process (n_values, audio_out);
+    adsr_envelope->process (n_values, envelope_out);
   else
-    simple_envelope->process (n_values, audio_out);
+    simple_envelope->process (n_values, envelope_out);
+}
+
+void
+EffectDecoder::set_filter_job (FilterJob *job)
+{
+  filter_job = job;
+  live_decoder_filter.set_job (job);
+}
+
+/*
+ * spectral bus mode: called after retrigger(), the first frame is centered
+ * start_offset samples before the start of the note
+ */
+void
+EffectDecoder::start_spectrum (size_t start_offset)
+{
+  spectrum_frame_pos = -int (start_offset);
+  spectrum_env_pos = 0;
+  spectrum_release_pos = -1;
+  spectrum_env = 0;
+
+  chain_decoder.start_spectrum (start_offset);
+}
+
+void
+EffectDecoder::process_spectrum (RTMemoryArea& rt_memory_area,
+                                 size_t        hop_size,
+                                 float         freq,
+                                 float         gain_left,
+                                 float         gain_right,
+                                 SpectralBus  *bus)
+{
+  /* the frame is weighted with the envelope value at its center (frames before
+   * the start of the note use the first value); since the frames overlap, the
+   * overlap-add interpolates the gain between the frame centers
+   */
+  const size_t env_end = std::max (spectrum_frame_pos, 0) + 1;
+
+  float envelope[hop_size + AVOID_ARRAY_UB];
+  while (spectrum_env_pos < env_end)
+    {
+      size_t n = std::min (env_end - spectrum_env_pos, hop_size);
+      if (spectrum_release_pos >= 0)
+        {
+          /* start the release at the exact position of the note off event */
+          if (spectrum_env_pos >= uint64 (spectrum_release_pos))
+            {
+              release();
+              spectrum_release_pos = -1;
+            }
+          else
+            {
+              n = std::min<size_t> (n, spectrum_release_pos - spectrum_env_pos);
+            }
+        }
+      std::fill (envelope, envelope + n, 1.0f);
+
+      if (adsr_enabled)
+        adsr_envelope->process (n, envelope);
+      else
+        simple_envelope->process (n, envelope);
+
+      spectrum_env = envelope[n - 1];
+      spectrum_env_pos += n;
+    }
+  spectrum_frame_pos += hop_size;
+
+  update_lod();
+  chain_decoder.process_spectrum (rt_memory_area, freq, gain_left * spectrum_env, gain_right * spectrum_env, bus);
+}
+
+bool
+EffectDecoder::spectral_bus_ok() const
+{
+  /* filter and vibrato need sample accurate processing */
+  return !filter_enabled && !vibrato_enabled;
 }
 
 void
@@ -233,6 +367,19 @@ EffectDecoder::release()
   live_decoder_filter.release();
 }
 
+/*
+ * spectral bus mode: release the envelope release_pos samples after the start
+ * of the note (envelope values up to the next frame center are computed in advance)
+ */
+void
+EffectDecoder::release_spectrum (size_t release_pos)
+{
+  if (release_pos <= spectrum_env_pos)
+    release();
+  else
+    spectrum_release_pos = release_pos;
+}
+
 bool
 EffectDecoder::done()
 {
@@ -242,6 +389,53 @@ EffectDecoder::done()
     return simple_envelope->done();
 }
 
+/*
+ * level of detail: threshold is relative to the loudest partial of a voice
+ * playing at full level; partials of quieter voices are culled earlier
+ */
+void
+EffectDecoder::set_lod (float threshold, int max_partials)
+{
+  lod_threshold = threshold;
+  lod_max_partials = max_partials;
+}
+
+void
+EffectDecoder::update_lod()
+{
+  if (lod_threshold > 0)
+    {
+      const double max_level = adsr_enabled ? adsr_envelope->max_level() : simple_envelope->max_level();
+
+      chain_decoder.set_lod (lod_threshold / std::max (max_level, 1e-3), lod_max_partials);
+    }
+  else
+    {
+      chain_decoder.set_lod (0, lod_max_partials);
+    }
+}
+
+void
+EffectDecoder::set_noise_seed (int seed)
+{
+  chain_decoder.set_noise_seed (seed);
+}
+
+void
+EffectDecoder::collect_lod_stats (uint64& rendered_partials, uint64& culled_partials)
+{
+  chain_decoder.collect_lod_stats (rendered_partials, culled_partials);
+}
+
+double
+EffectDecoder::envelope_level() const
+{
+  if (adsr_enabled)
+    return adsr_envelope->current_level();
+  else
+    return simple_envelope->current_level();
+}
+
 double
 EffectDecoder::time_offset_ms() const
 {
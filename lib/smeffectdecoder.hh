@@ -27,8 +27,23 @@ class EffectDecoder
   bool                                  adsr_enabled = false;
 
   bool                                  filter_enabled = false;
+  bool                                  vibrato_enabled = false;
   LiveDecoderFilter                     live_decoder_filter;
   float                                 current_freq = 440;
+  FilterJob                            *filter_job = nullptr;
+  const MorphOutput::Config            *cfg = nullptr;
+  int                                   unison_limit = 0;
+  float                                 lod_threshold = 0;
+  int                                   lod_max_partials = 0;
+
+  /* spectral bus: envelope timeline, 0 is the start of the note */
+  int                                   spectrum_frame_pos = 0;     // center of the next frame
+  size_t                                spectrum_env_pos = 0;       // number of envelope values computed
+  int64                                 spectrum_release_pos = -1;  // pending release, -1: none
+  float                                 spectrum_env = 0;           // envelope value at last frame center
+
+  void update_unison();
+  void update_lod();
 
 public:
   EffectDecoder (MorphOutputModule *output_module, float mix_freq);
@@ -41,8 +56,23 @@ public:
                 size_t        n_values,
                 const float  *freq_in,
                 float        *audio_out);
+  void start_spectrum (size_t start_offset);
+  void process_spectrum (RTMemoryArea& rt_memory_area,
+                         size_t        hop_size,
+                         float         freq,
+                         float         gain_left,
+                         float         gain_right,
+                         SpectralBus  *bus);
+  bool spectral_bus_ok() const;
+  void set_filter_job (FilterJob *job);
+  void set_unison_limit (int max_voices);
+  void set_lod (float threshold, int max_partials);
+  void set_noise_seed (int seed);
+  void collect_lod_stats (uint64& rendered_partials, uint64& culled_partials);
   void release();
+  void release_spectrum (size_t release_pos);
   bool done();
+  double envelope_level() const;
 
   double time_offset_ms() const;
 };
@@ -9,6 +9,8 @@
 #include "smblockutils.hh"
 #include "smalignedarray.hh"
 #include "smrandom.hh"
+#include "smparallel.hh"
+#include "smoutfile.hh"
 #include "config.h"
 
 #include <math.h>
@@ -19,7 +21,9 @@
 #include <map>
 #include <algorithm>
 #include <memory>
+#include <atomic>
 #include <cinttypes>
+#include <numeric>
 
 using namespace SpectMorph;
 using std::vector;
@@ -29,7 +33,7 @@ using std::max;
 using std::complex;
 
 static double
-magnitude (vector<float>::iterator i)
+magnitude (vector<float>::const_iterator i)
 {
   return sqrt (*i * *i + *(i+1) * *(i+1));
 }
@@ -249,6 +253,18 @@ EncoderParams::set_kill_function (const std::function<bool()>& new_kill_function
   kill_function = new_kill_function;
 }
 
+void
+EncoderParams::set_n_threads (size_t new_n_threads)
+{
+  n_threads = std::max<size_t> (new_n_threads, 1);
+}
+
+void
+EncoderParams::set_profile (bool new_profile)
+{
+  profile = new_profile;
+}
+
 /**
  * Constructor which initializes the Encoders parameters.
  */
@@ -273,81 +289,146 @@ Encoder::Encoder (const EncoderParams& enc_params)
   optimal_attack.attack_end_ms = 0;
 }
 
+/**
+ * This function runs one encoder step for all frames, using enc_params.n_threads threads.
+ * The function must only modify data of its own frame, so that the result is the same
+ * as for serial encoding. The kill function is only called from the calling thread.
+ *
+ * \returns false if the encoder was killed (some frames may not have been processed then)
+ */
+bool
+Encoder::for_each_frame (const char *where, uint64_t kill_check_mask,
+                         const std::function<void (size_t worker, size_t frame)>& function)
+{
+  return for_each_frame (where, kill_check_mask, 0, audio_blocks.size(), function);
+}
+
+/**
+ * Like for_each_frame() above, but only for the frames start_frame ... end_frame - 1.
+ */
+bool
+Encoder::for_each_frame (const char *where, uint64_t kill_check_mask, size_t start_frame, size_t end_frame,
+                         const std::function<void (size_t worker, size_t frame)>& function)
+{
+  std::atomic<bool> was_killed { false };
+
+  parallel_for (enc_params.n_threads, end_frame - start_frame,
+    [&] (size_t worker, size_t index)
+      {
+        if (was_killed.load (std::memory_order_relaxed))
+          return;
+
+        const size_t frame = start_frame + index;
+        function (worker, frame);
+
+        if (worker == 0 && killed (where, frame & kill_check_mask))
+          was_killed.store (true);
+      });
+  return !was_killed.load();
+}
+
+namespace
+{
+
+/* per thread buffers for the FFT based encoder steps */
+struct FFTBuffers
+{
+  vector<float *> in;
+  vector<float *> out;
+
+  FFTBuffers (size_t n_threads, size_t fft_size)
+  {
+    for (size_t t = 0; t < n_threads; t++)
+      {
+        in.push_back (FFT::new_array_float (fft_size));
+        out.push_back (FFT::new_array_float (fft_size));
+      }
+  }
+  ~FFTBuffers()
+  {
+    for (auto p : in)
+      FFT::free_array_float (p);
+    for (auto p : out)
+      FFT::free_array_float (p);
+  }
+};
+
+}
+
 /**
  * This function computes the short-time-fourier-transform (STFT) of the input
  * signal using a window to cut the individual frames out of the sample.
  */
 void
-Encoder::compute_stft (const WavData& multi_channel_wav_data, int channel)
+Encoder::compute_stft (const WavData& wav_data, int channel)
 {
   /* deinterleave multi channel signal */
-  vector<float> single_channel_signal;
+  const size_t n_channels = wav_data.n_channels();
 
-  const size_t n_channels = multi_channel_wav_data.n_channels();
-  for (size_t i = channel; i < multi_channel_wav_data.n_values(); i += n_channels)
-    single_channel_signal.push_back (multi_channel_wav_data[i]);
+  original_samples.clear();
+  for (size_t i = channel; i < wav_data.n_values(); i += n_channels)
+    original_samples.push_back (wav_data[i]);
 
-  original_samples = single_channel_signal;
+  /* encode single channel, with zero values prepended */
+  zero_values_at_start = enc_params.frame_size - enc_params.frame_step / 2;
+  sample_count = original_samples.size() + zero_values_at_start;
 
-  WavData wav_data (single_channel_signal, 1, multi_channel_wav_data.mix_freq(), multi_channel_wav_data.bit_depth());
+  const uint64 n_frames = (sample_count + enc_params.frame_step - 1) / enc_params.frame_step;
+  audio_blocks.resize (n_frames);
 
-  /* encode single channel */
-  zero_values_at_start = enc_params.frame_size - enc_params.frame_step / 2;
-  vector<float> zero_values (zero_values_at_start);
+  FFTBuffers fft (enc_params.n_threads, enc_params.block_size * enc_params.zeropad);
 
-  wav_data.prepend (zero_values);
+  for_each_frame ("_stft", 63, [&] (size_t worker, size_t frame)
+    {
+      compute_stft_frame (wav_data, channel, frame, fft.in[worker], fft.out[worker], audio_blocks[frame], true);
+    });
+}
 
-  const uint64 n_values   = wav_data.n_values();
+/**
+ * This function computes the zeropadded FFT of one frame (stored in noise, and
+ * in original_fft if requested) and the samples of the frame (debug_samples).
+ */
+void
+Encoder::compute_stft_frame (const WavData& wav_data, int channel, uint64 frame, float *fft_in, float *fft_out,
+                             EncoderBlock& audio_block, bool store_original_fft)
+{
   const size_t frame_size = enc_params.frame_size;
   const size_t block_size = enc_params.block_size;
-  const int    zeropad    = enc_params.zeropad;
-  const auto&  window     = enc_params.window;
-
-  sample_count = n_values;
+  const size_t fft_size   = block_size * enc_params.zeropad;
+  const size_t n_channels = wav_data.n_channels();
+  const uint64 n_samples  = wav_data.n_values() / n_channels;
 
-  vector<double> in (block_size * zeropad), out (block_size * zeropad + 2);
+  /* position in the signal with zero_values_at_start zero values prepended */
+  const uint64 pos = frame * enc_params.frame_step;
 
-  float *fft_in = FFT::new_array_float (in.size());
-  float *fft_out = FFT::new_array_float (in.size());
+  /* start with zero block, so the incomplete blocks at end are zeropadded */
+  vector<float> block (block_size);
 
-  for (uint64 pos = 0; pos < n_values; pos += enc_params.frame_step)
+  for (size_t offset = 0; offset < block.size(); offset++)
     {
-      EncoderBlock audio_block;
-
-      /* start with zero block, so the incomplete blocks at end are zeropadded */
-      vector<float> block (block_size);
-
-      for (size_t offset = 0; offset < block.size(); offset++)
-        {
-          if (pos + offset < wav_data.n_values())
-            block[offset] = wav_data[pos + offset];
-        }
-      vector<float> debug_samples (block.begin(), block.end());
-      Block::mul (enc_params.block_size, &block[0], &window[0]);
-
-      int j = in.size() - enc_params.frame_size / 2;
-      for (vector<float>::const_iterator i = block.begin(); i != block.end(); i++)
-        in[(j++) % in.size()] = *i;
+      if (pos + offset >= zero_values_at_start && pos + offset - zero_values_at_start < n_samples)
+        block[offset] = wav_data[(pos + offset - zero_values_at_start) * n_channels + channel];
+    }
+  audio_block.debug_samples.assign (block.begin(), block.begin() + frame_size);
+  Block::mul (block_size, &block[0], &enc_params.window[0]);
 
-      std::copy (in.begin(), in.end(), fft_in);
-      FFT::fftar_float (in.size(), fft_in, fft_out);
-      std::copy (fft_out, fft_out + in.size(), out.begin());
+  std::fill (fft_in, fft_in + fft_size, 0);
 
-      out[block_size * zeropad] = out[1];
-      out[block_size * zeropad + 1] = 0;
-      out[1] = 0;
+  size_t j = fft_size - frame_size / 2;
+  for (vector<float>::const_iterator i = block.begin(); i != block.end(); i++)
+    fft_in[(j++) % fft_size] = *i;
 
-      audio_block.noise.assign (out.begin(), out.end()); // <- will be overwritten by noise spectrum later on
-      audio_block.original_fft.assign (out.begin(), out.end());
-      audio_block.debug_samples.assign (debug_samples.begin(), debug_samples.begin() + frame_size);
+  FFT::fftar_float (fft_size, fft_in, fft_out);
 
-      audio_blocks.push_back (audio_block);
+  vector<float>& out = audio_block.noise; // <- will be overwritten by noise spectrum later on
+  out.assign (fft_out, fft_out + fft_size);
+  out.resize (fft_size + 2);
+  out[fft_size] = out[1];
+  out[fft_size + 1] = 0;
+  out[1] = 0;
 
-      if (killed ("_stft", audio_blocks.size() & 63))
-        break; // break to avoid leaking fft_in, fft_out
-    }
-  FFT::free_array_float (fft_in);
-  FFT::free_array_float (fft_out);
+  if (store_original_fft)
+    audio_block.original_fft = out;
 }
 
 namespace
@@ -378,11 +459,53 @@ public:
 
 }
 
+static double
+max_magnitude (const vector<float>& spectrum, size_t fft_size)
+{
+  double max_mag = 0;
+  for (size_t d = 2; d < fft_size; d += 2)
+    max_mag = max (max_mag, magnitude (spectrum.begin() + d));
+
+  return max_mag;
+}
+
 /**
  * This function searches for peaks in the frame ffts. These are stored in frame_tracksels.
  */
 void
 Encoder::search_local_maxima()
+{
+  const size_t fft_size = enc_params.block_size * enc_params.zeropad;
+
+  // initialize tracksel structure
+  frame_tracksels.clear();
+  frame_tracksels.resize (audio_blocks.size());
+
+  // find maximum of all values (per frame in parallel, then over all frames)
+  vector<double> frame_max_mag (audio_blocks.size());
+  bool ok = for_each_frame ("_maxima", 15, [&] (size_t worker, size_t n)
+    {
+      frame_max_mag[n] = max_magnitude (audio_blocks[n].noise, fft_size);
+    });
+  if (!ok)
+    return;
+
+  double max_mag = 0;
+  for (auto m : frame_max_mag)
+    max_mag = max (max_mag, m);
+
+  for_each_frame ("_maxima", 15, [&] (size_t worker, size_t n)
+    {
+      search_local_maxima_frame (n, audio_blocks[n], max_mag, frame_tracksels[n]);
+    });
+}
+
+/**
+ * This function searches for peaks in the fft of one frame; the magnitudes are
+ * relative to max_mag, the maximum magnitude of all frames.
+ */
+void
+Encoder::search_local_maxima_frame (uint64 n, const EncoderBlock& audio_block, double max_mag, vector<Tracksel>& tracksels)
 {
   const size_t block_size = enc_params.block_size;
   const size_t frame_size = enc_params.frame_size;
@@ -396,132 +519,112 @@ Encoder::search_local_maxima()
     window_weight += window[i];
   const double window_scale = 2.0 / window_weight;
 
-  // initialize tracksel structure
-  frame_tracksels.clear();
-  frame_tracksels.resize (audio_blocks.size());
-
-  // find maximum of all values
-  double max_mag = 0;
-  for (size_t n = 0; n < audio_blocks.size(); n++)
-    {
-      for (size_t d = 2; d < block_size * zeropad; d += 2)
-	{
-	  max_mag = max (max_mag, magnitude (audio_blocks[n].noise.begin() + d));
-	}
-    }
+  vector<double> mag_values (audio_block.noise.size() / 2);
+  for (size_t d = 0; d < block_size * zeropad; d += 2)
+    mag_values[d / 2] = magnitude (audio_block.noise.begin() + d);
 
-  for (size_t n = 0; n < audio_blocks.size(); n++)
+  for (size_t d = 2; d < block_size * zeropad; d += 2)
     {
-      vector<double> mag_values (audio_blocks[n].noise.size() / 2);
-      for (size_t d = 0; d < block_size * zeropad; d += 2)
-        mag_values[d / 2] = magnitude (audio_blocks[n].noise.begin() + d);
-
-      for (size_t d = 2; d < block_size * zeropad; d += 2)
-	{
 #if 0
-	  double phase = atan2 (*(audio_blocks[n]->noise.begin() + d),
-	                        *(audio_blocks[n]->noise.begin() + d + 1)) / 2 / M_PI;  /* range [-0.5 .. 0.5] */
+      double phase = atan2 (*(audio_block.noise.begin() + d),
+                            *(audio_block.noise.begin() + d + 1)) / 2 / M_PI;  /* range [-0.5 .. 0.5] */
 #endif
-          enum { PEAK_NONE, PEAK_SINGLE, PEAK_DOUBLE } peak_type = PEAK_NONE;
+      enum { PEAK_NONE, PEAK_SINGLE, PEAK_DOUBLE } peak_type = PEAK_NONE;
 
-          if (mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+1])   /* search for peaks in fft magnitudes */
+      if (mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+1])   /* search for peaks in fft magnitudes */
+        {
+          /* single peak is the common case, where the magnitude of the middle value is
+           * larger than the magnitude of the left and right neighbour
+           */
+          peak_type = PEAK_SINGLE;
+        }
+      else
+        {
+          double epsilon_fact = 1.0 + 1e-8;
+          if (mag_values[d/2] < mag_values[d/2+1] * epsilon_fact && mag_values[d/2] * epsilon_fact > mag_values[d/2 + 1]
+          &&  mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+2])
             {
-              /* single peak is the common case, where the magnitude of the middle value is
-               * larger than the magnitude of the left and right neighbour
+              /* double peak is a special case, where two values in the spectrum have (almost) equal magnitude
+               * in this case, this magnitude must be larger than the value left and right of the _two_
+               * maximal values in the spectrum
                */
-              peak_type = PEAK_SINGLE;
-            }
-          else
-            {
-              double epsilon_fact = 1.0 + 1e-8;
-              if (mag_values[d/2] < mag_values[d/2+1] * epsilon_fact && mag_values[d/2] * epsilon_fact > mag_values[d/2 + 1]
-              &&  mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+2])
-                {
-                  /* double peak is a special case, where two values in the spectrum have (almost) equal magnitude
-                   * in this case, this magnitude must be larger than the value left and right of the _two_
-                   * maximal values in the spectrum
-                   */
-                  peak_type = PEAK_DOUBLE;
-                }
+              peak_type = PEAK_DOUBLE;
             }
+        }
 
-          const double mag2 = db_from_factor (mag_values[d / 2] / max_mag, -100);
-          debug ("dbspectrum:%zd %f\n", n, mag2);
+      const double mag2 = db_from_factor (mag_values[d / 2] / max_mag, -100);
+      debug ("dbspectrum:%" PRId64 " %f\n", n, mag2);
 
-          if (peak_type != PEAK_NONE)
+      if (peak_type != PEAK_NONE)
+        {
+          if (mag2 > -90)
             {
-              if (mag2 > -90)
-                {
-                  size_t ds, de;
-                  for (ds = d / 2 - 1; ds > 0 && mag_values[ds] < mag_values[ds + 1]; ds--);
-                  for (de = d / 2 + 1; de < (mag_values.size() - 1) && mag_values[de] > mag_values[de + 1]; de++);
+              size_t ds, de;
+              for (ds = d / 2 - 1; ds > 0 && mag_values[ds] < mag_values[ds + 1]; ds--);
+              for (de = d / 2 + 1; de < (mag_values.size() - 1) && mag_values[de] > mag_values[de + 1]; de++);
 
-                  const double normalized_peak_width = (de - ds) * frame_size / double (block_size * zeropad);
+              const double normalized_peak_width = (de - ds) * frame_size / double (block_size * zeropad);
 
-                  bool peak_ok;
-                  double value;
-                  if (enc_params.get_param ("peak-width", value))
-                    peak_ok = normalized_peak_width > value;
-                  else
-                    peak_ok = normalized_peak_width > 2.9;
+              bool peak_ok;
+              double value;
+              if (enc_params.get_param ("peak-width", value))
+                peak_ok = normalized_peak_width > value;
+              else
+                peak_ok = normalized_peak_width > 2.9;
 
-                  if (peak_ok)
+              if (peak_ok)
+                {
+                  const double mag1 = db_from_factor (mag_values[d / 2 - 1] / max_mag, -100);
+                  const double mag3 = db_from_factor (mag_values[d / 2 + 1] / max_mag, -100);
+                  //double freq = d / 2 * mix_freq / (block_size * zeropad); /* bin frequency */
+
+                  QInterpolator mag_interp (mag1, mag2, mag3);
+                  double x_max = mag_interp.x_max();
+                  double tfreq = (d / 2 + x_max) * mix_freq / (block_size * zeropad);
+
+                  double peak_mag_db = mag_interp.eval (x_max);
+                  double peak_mag = db_to_factor (peak_mag_db) * max_mag;
+
+                  // use the interpolation formula for the complex values to find the phase
+                  QInterpolator re_interp (audio_block.noise[d-2], audio_block.noise[d], audio_block.noise[d+2]);
+                  QInterpolator im_interp (audio_block.noise[d-1], audio_block.noise[d+1], audio_block.noise[d+3]);
+/*
+                  if (mag2 > -20)
+                    printf ("%f %f %f %f %f\n", phase, last_phase[d], phase_diff, phase_diff * mix_freq / (block_size * zeropad) * overlap, tfreq);
+*/
+                  Tracksel tracksel;
+                  tracksel.frame = n;
+                  tracksel.d = d;
+                  tracksel.freq = tfreq;
+                  tracksel.mag = peak_mag * window_scale;
+                  tracksel.mag2 = mag2;
+                  tracksel.next = 0;
+                  tracksel.prev = 0;
+
+                  const double re_mag = re_interp.eval (x_max);
+                  const double im_mag = im_interp.eval (x_max);
+                  double phase = atan2 (im_mag, re_mag) + 0.5 * M_PI;
+                  // correct for the odd-centered analysis
                     {
-                      const double mag1 = db_from_factor (mag_values[d / 2 - 1] / max_mag, -100);
-                      const double mag3 = db_from_factor (mag_values[d / 2 + 1] / max_mag, -100);
-                      //double freq = d / 2 * mix_freq / (block_size * zeropad); /* bin frequency */
-
-                      QInterpolator mag_interp (mag1, mag2, mag3);
-                      double x_max = mag_interp.x_max();
-                      double tfreq = (d / 2 + x_max) * mix_freq / (block_size * zeropad);
-
-                      double peak_mag_db = mag_interp.eval (x_max);
-                      double peak_mag = db_to_factor (peak_mag_db) * max_mag;
-
-                      // use the interpolation formula for the complex values to find the phase
-                      QInterpolator re_interp (audio_blocks[n].noise[d-2], audio_blocks[n].noise[d], audio_blocks[n].noise[d+2]);
-                      QInterpolator im_interp (audio_blocks[n].noise[d-1], audio_blocks[n].noise[d+1], audio_blocks[n].noise[d+3]);
-    /*
-                      if (mag2 > -20)
-                        printf ("%f %f %f %f %f\n", phase, last_phase[d], phase_diff, phase_diff * mix_freq / (block_size * zeropad) * overlap, tfreq);
-    */
-                      Tracksel tracksel;
-                      tracksel.frame = n;
-                      tracksel.d = d;
-                      tracksel.freq = tfreq;
-                      tracksel.mag = peak_mag * window_scale;
-                      tracksel.mag2 = mag2;
-                      tracksel.next = 0;
-                      tracksel.prev = 0;
-
-                      const double re_mag = re_interp.eval (x_max);
-                      const double im_mag = im_interp.eval (x_max);
-                      double phase = atan2 (im_mag, re_mag) + 0.5 * M_PI;
-                      // correct for the odd-centered analysis
-                        {
-                          phase -= (frame_size - 1) / 2.0 / mix_freq * tracksel.freq * 2 * M_PI;
-                          phase = normalize_phase (phase);
-                        }
-                      tracksel.phase = phase;
-
-                      // FIXME: need a different criterion here
-                      // mag2 > -30 doesn't track all partials
-                      // mag2 > -60 tracks lots of junk, too
-                      if (mag2 > -90 && tracksel.freq > 10)
-                        frame_tracksels[n].push_back (tracksel);
-
-                      if (peak_type == PEAK_DOUBLE)
-                        d += 2;
+                      phase -= (frame_size - 1) / 2.0 / mix_freq * tracksel.freq * 2 * M_PI;
+                      phase = normalize_phase (phase);
                     }
+                  tracksel.phase = phase;
+
+                  // FIXME: need a different criterion here
+                  // mag2 > -30 doesn't track all partials
+                  // mag2 > -60 tracks lots of junk, too
+                  if (mag2 > -90 && tracksel.freq > 10)
+                    tracksels.push_back (tracksel);
+
+                  if (peak_type == PEAK_DOUBLE)
+                    d += 2;
                 }
+            }
 #if 0
-              last_phase[d] = phase;
+          last_phase[d] = phase;
 #endif
-            }
-	}
-
-      if (killed ("_maxima", n & 15))
-        return;
+        }
     }
 }
 
@@ -547,85 +650,89 @@ partial_index_cmp (const PeakIndex& a, const PeakIndex& b)
   return a.freq < b.freq;
 }
 
-/**
- * This function links the spectral peaks (contained in the Tracksel structure)
- * of successive frames together by setting the prev and next pointers. It
- * tries to minimize the frequency difference between the peaks that are linked
- * together, while using a threshold of 5% frequency derivation.
- */
-void
-Encoder::link_partials()
+static void
+link_frame_partials (vector<Tracksel>& current_tracksels, vector<Tracksel>& next_tracksels)
 {
-  for (size_t n = 0; n + 1 < audio_blocks.size(); n++)
+  // build sorted index for this frame
+  vector<PeakIndex> current_index;
+  for (vector<Tracksel>::iterator i = current_tracksels.begin(); i != current_tracksels.end(); i++)
+    current_index.push_back (PeakIndex (i->freq, i));
+  sort (current_index.begin(), current_index.end(), partial_index_cmp);
+
+  // build sorted index for next frame
+  vector<PeakIndex> next_index;
+  for (vector<Tracksel>::iterator i = next_tracksels.begin(); i != next_tracksels.end(); i++)
+    next_index.push_back (PeakIndex (i->freq, i));
+  sort (next_index.begin(), next_index.end(), partial_index_cmp);
+
+  vector<PeakIndex>::iterator ci = current_index.begin();
+  vector<PeakIndex>::iterator ni = next_index.begin();
+  if (ni != next_index.end())    // if current or next frame are empty (no peaks) there is nothing to do
     {
-      // build sorted index for this frame
-      vector<PeakIndex> current_index;
-      for (vector<Tracksel>::iterator i = frame_tracksels[n].begin(); i != frame_tracksels[n].end(); i++)
-        current_index.push_back (PeakIndex (i->freq, i));
-      sort (current_index.begin(), current_index.end(), partial_index_cmp);
-
-      // build sorted index for next frame
-      vector<PeakIndex> next_index;
-      for (vector<Tracksel>::iterator i = frame_tracksels[n + 1].begin(); i != frame_tracksels[n + 1].end(); i++)
-        next_index.push_back (PeakIndex (i->freq, i));
-      sort (next_index.begin(), next_index.end(), partial_index_cmp);
-
-      vector<PeakIndex>::iterator ci = current_index.begin();
-      vector<PeakIndex>::iterator ni = next_index.begin();
-      if (ni != next_index.end())    // if current or next frame are empty (no peaks) there is nothing to do
+      while (ci != current_index.end())
         {
-          while (ci != current_index.end())
+          /*
+           * increment ni as long as incrementing it makes ni point to a
+           * better (closer) peak below ci's frequency
+           */
+          vector<PeakIndex>::iterator inc_ni;
+          do
             {
-              /*
-               * increment ni as long as incrementing it makes ni point to a
-               * better (closer) peak below ci's frequency
-               */
-              vector<PeakIndex>::iterator inc_ni;
-              do
-                {
-                  inc_ni = ni + 1;
-                  if (inc_ni < next_index.end() && inc_ni->freq < ci->freq)
-                    ni = inc_ni;
-                }
-              while (ni == inc_ni);
-
-              /*
-               * possible candidates for a match are
-               * - ni      - which contains the greatest peak with a smaller frequency than ci->freq
-               * - ni + 1  - which contains the smallest peak with a greater frequency that ci->freq
-               * => choose the candidate which is closer to ci->freq
-               */
-              vector<PeakIndex>::iterator besti = ni;
-              if (ni + 1 < next_index.end() && fabs (ci->freq - (ni + 1)->freq) < fabs (ci->freq - ni->freq))
-                besti = ni + 1;
-
-              const double delta = fabs (ci->freq - besti->freq) / ci->freq;
-              if (delta < 0.05) /* less than 5% frequency derivation */
+              inc_ni = ni + 1;
+              if (inc_ni < next_index.end() && inc_ni->freq < ci->freq)
+                ni = inc_ni;
+            }
+          while (ni == inc_ni);
+
+          /*
+           * possible candidates for a match are
+           * - ni      - which contains the greatest peak with a smaller frequency than ci->freq
+           * - ni + 1  - which contains the smallest peak with a greater frequency that ci->freq
+           * => choose the candidate which is closer to ci->freq
+           */
+          vector<PeakIndex>::iterator besti = ni;
+          if (ni + 1 < next_index.end() && fabs (ci->freq - (ni + 1)->freq) < fabs (ci->freq - ni->freq))
+            besti = ni + 1;
+
+          const double delta = fabs (ci->freq - besti->freq) / ci->freq;
+          if (delta < 0.05) /* less than 5% frequency derivation */
+            {
+              if (!besti->prev || besti->prev_delta > delta)
                 {
-                  if (!besti->prev || besti->prev_delta > delta)
-                    {
-                      besti->prev = &(*ci);
-                      besti->prev_delta = delta;
-                    }
+                  besti->prev = &(*ci);
+                  besti->prev_delta = delta;
                 }
-              ci++;
             }
+          ci++;
+        }
 
-          /* link best matches (with the smallest frequency derivation) */
-          for (ni = next_index.begin(); ni != next_index.end(); ni++)
+      /* link best matches (with the smallest frequency derivation) */
+      for (ni = next_index.begin(); ni != next_index.end(); ni++)
+        {
+          if (ni->prev)
             {
-              if (ni->prev)
-                {
-                  Tracksel *crosslink_a = &(*ni->prev->i);
-                  Tracksel *crosslink_b = &(*ni->i);
-                  crosslink_a->next = crosslink_b;
-                  crosslink_b->prev = crosslink_a;
-                }
+              Tracksel *crosslink_a = &(*ni->prev->i);
+              Tracksel *crosslink_b = &(*ni->i);
+              crosslink_a->next = crosslink_b;
+              crosslink_b->prev = crosslink_a;
             }
         }
     }
 }
 
+/**
+ * This function links the spectral peaks (contained in the Tracksel structure)
+ * of successive frames together by setting the prev and next pointers. It
+ * tries to minimize the frequency difference between the peaks that are linked
+ * together, while using a threshold of 5% frequency derivation.
+ */
+void
+Encoder::link_partials()
+{
+  for (size_t n = 0; n + 1 < audio_blocks.size(); n++)
+    link_frame_partials (frame_tracksels[n], frame_tracksels[n + 1]);
+}
+
 /**
  * This function validates that the partials found by the peak linking have
  * good quality.
@@ -669,72 +776,72 @@ Encoder::validate_partials()
  */
 void
 Encoder::spectral_subtract()
+{
+  FFTBuffers fft (enc_params.n_threads, enc_params.block_size * enc_params.zeropad);
+
+  for_each_frame ("_subtract", 7, [&] (size_t worker, uint64 frame)
+    {
+      spectral_subtract_frame (frame, audio_blocks[frame], fft.in[worker], fft.out[worker]);
+    });
+}
+
+void
+Encoder::spectral_subtract_frame (uint64 frame, EncoderBlock& audio_block, float *fft_in, float *fft_out)
 {
   const size_t block_size = enc_params.block_size;
   const size_t frame_size = enc_params.frame_size;
   const size_t zeropad    = enc_params.zeropad;
   const auto&  window     = enc_params.window;
 
-  float *fft_in = FFT::new_array_float (block_size * zeropad);
-  float *fft_out = FFT::new_array_float (block_size * zeropad);
-
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  AlignedArray<float,16> signal (frame_size);
+  for (size_t i = 0; i < audio_block.freqs.size(); i++)
     {
-      AlignedArray<float,16> signal (frame_size);
-      for (size_t i = 0; i < audio_blocks[frame].freqs.size(); i++)
-	{
-          const double freq = audio_blocks[frame].freqs[i];
-	  const double mag = audio_blocks[frame].mags[i];
-	  const double phase = audio_blocks[frame].phases[i];
-
-          VectorSinParams params;
-          params.mix_freq = enc_params.mix_freq;
-          params.freq = freq;
-          params.phase = phase;
-          params.mag = mag;
-          params.mode = VectorSinParams::ADD;
-
-          fast_vector_sinf (params, &signal[0], &signal[frame_size]);
-	}
-      vector<double> out (block_size * zeropad + 2);
-      // apply window
-      std::fill (fft_in, fft_in + block_size * zeropad, 0);
-      for (size_t k = 0; k < frame_size; k++)
-        fft_in[k] = window[k] * signal[k];
-      // FFT
-      FFT::fftar_float (block_size * zeropad, fft_in, fft_out);
-      std::copy (fft_out, fft_out + block_size * zeropad, out.begin());
-      out[block_size * zeropad] = out[1];
-      out[block_size * zeropad + 1] = 0;
-      out[1] = 0;
-
-      // subtract spectrum from audio spectrum
-      for (size_t d = 0; d < block_size * zeropad; d += 2)
-	{
-	  double re = out[d], im = out[d + 1];
-	  double sub_mag = sqrt (re * re + im * im);
-	  debug ("subspectrum:%" PRId64 " %g\n", frame, sub_mag);
+      const double freq = audio_block.freqs[i];
+      const double mag = audio_block.mags[i];
+      const double phase = audio_block.phases[i];
 
-	  double mag = magnitude (audio_blocks[frame].noise.begin() + d);
-	  debug ("spectrum:%" PRId64 " %g\n", frame, mag);
-	  if (mag > 0)
-	    {
-	      audio_blocks[frame].noise[d] /= mag;
-	      audio_blocks[frame].noise[d + 1] /= mag;
-	      mag -= sub_mag;
-	      if (mag < 0)
-		mag = 0;
-	      audio_blocks[frame].noise[d] *= mag;
-	      audio_blocks[frame].noise[d + 1] *= mag;
-	    }
-	  debug ("finalspectrum:%" PRId64 " %g\n", frame, mag);
-	}
+      VectorSinParams params;
+      params.mix_freq = enc_params.mix_freq;
+      params.freq = freq;
+      params.phase = phase;
+      params.mag = mag;
+      params.mode = VectorSinParams::ADD;
 
-      if (killed ("_subtract", frame & 7))
-        return;
+      fast_vector_sinf (params, &signal[0], &signal[frame_size]);
+    }
+  vector<double> out (block_size * zeropad + 2);
+  // apply window
+  std::fill (fft_in, fft_in + block_size * zeropad, 0);
+  for (size_t k = 0; k < frame_size; k++)
+    fft_in[k] = window[k] * signal[k];
+  // FFT
+  FFT::fftar_float (block_size * zeropad, fft_in, fft_out);
+  std::copy (fft_out, fft_out + block_size * zeropad, out.begin());
+  out[block_size * zeropad] = out[1];
+  out[block_size * zeropad + 1] = 0;
+  out[1] = 0;
+
+  // subtract spectrum from audio spectrum
+  for (size_t d = 0; d < block_size * zeropad; d += 2)
+    {
+      double re = out[d], im = out[d + 1];
+      double sub_mag = sqrt (re * re + im * im);
+      debug ("subspectrum:%" PRId64 " %g\n", frame, sub_mag);
+
+      double mag = magnitude (audio_block.noise.begin() + d);
+      debug ("spectrum:%" PRId64 " %g\n", frame, mag);
+      if (mag > 0)
+        {
+          audio_block.noise[d] /= mag;
+          audio_block.noise[d + 1] /= mag;
+          mag -= sub_mag;
+          if (mag < 0)
+            mag = 0;
+          audio_block.noise[d] *= mag;
+          audio_block.noise[d + 1] *= mag;
+        }
+      debug ("finalspectrum:%" PRId64 " %g\n", frame, mag);
     }
-  FFT::free_array_float (fft_in);
-  FFT::free_array_float (fft_out);
 }
 
 template<class AIter, class BIter>
@@ -751,7 +858,7 @@ float_vector_delta (AIter ai, AIter aend, BIter bi)
 }
 
 static void
-refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, int frame, const vector<float>& window)
+refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, const vector<float>& window)
 {
   const size_t frame_size = audio_block.debug_samples.size();
 
@@ -782,101 +889,86 @@ refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, int frame,
       fast_vector_sinf (params, &all_sines[0], &all_sines[frame_size]);
     }
 
-  double max_mag;
-  size_t partial = 0;
-  do
+  /* each partial is refined independently (against the signal without all other
+   * partials), in order of decreasing magnitude; partials with equal magnitude
+   * keep their relative order, and partials without magnitude are dropped
+   */
+  vector<size_t> order;
+  for (size_t i = 0; i < audio_block.freqs.size(); i++)
     {
-      max_mag = 0;
-      // search biggest partial
-      for (size_t i = 0; i < audio_block.freqs.size(); i++)
-        {
-          const double mag = audio_block.mags[i];
-
-          if (mag > max_mag)
-            {
-              partial = i;
-              max_mag = mag;
-            }
-        }
-      // compute reconstruction of that partial
-      if (max_mag > 0)
-        {
-          // remove partial, so we only do each partial once
-          double f = audio_block.freqs[partial];
-
-          audio_block.mags[partial] = 0;
-
-          double phase;
-          // determine "perfect" phase and magnitude instead of using interpolated fft phase
-          double x_re = 0;
-          double x_im = 0;
+      if (audio_block.mags[i] > 0)
+        order.push_back (i);
+    }
+  std::stable_sort (order.begin(), order.end(), [&] (size_t a, size_t b) {
+    return audio_block.mags[a] > audio_block.mags[b];
+  });
 
-          VectorSinParams params;
+  for (size_t partial : order)
+    {
+      const double f = audio_block.freqs[partial];
+      const double mag = audio_block.mags[partial];
 
-          params.mix_freq = mix_freq;
-          params.freq = f;
-          params.mag = 1;
-          params.phase = -((frame_size - 1) / 2.0) * f / mix_freq * 2.0 * M_PI;
-          params.phase = normalize_phase (params.phase);
-          params.mode = VectorSinParams::REPLACE;
+      // determine "perfect" phase and magnitude instead of using interpolated fft phase
+      double x_re = 0;
+      double x_im = 0;
 
-          fast_vector_sincosf (params, &sin_vec[0], &sin_vec[frame_size], &cos_vec[0]);
+      VectorSinParams params;
 
-          params.freq  = f;
-          params.mag   = max_mag;
-          params.phase = audio_block.phases[partial];
-          params.mode  = VectorSinParams::REPLACE;
+      params.mix_freq = mix_freq;
+      params.freq = f;
+      params.mag = 1;
+      params.phase = -((frame_size - 1) / 2.0) * f / mix_freq * 2.0 * M_PI;
+      params.phase = normalize_phase (params.phase);
+      params.mode = VectorSinParams::REPLACE;
 
-          fast_vector_sinf (params, &sines[0], &sines[frame_size]);
+      fast_vector_sincosf (params, &sin_vec[0], &sin_vec[frame_size], &cos_vec[0]);
 
-          for (size_t n = 0; n < frame_size; n++)
-            {
-              double v = audio_block.debug_samples[n] - all_sines[n] + sines[n];
-              v *= window[n];
-
-              // multiply windowed signal with complex exp function from fourier transform:
-              //
-              //   v * exp (-j * x) = v * (cos (x) - j * sin (x))
-              x_re += v * cos_vec[n];
-              x_im -= v * sin_vec[n];
-            }
+      params.freq  = f;
+      params.mag   = mag;
+      params.phase = audio_block.phases[partial];
+      params.mode  = VectorSinParams::REPLACE;
 
-          // correct influence of mirrored window (caused by negative frequency component)
-          params.mix_freq = mix_freq;
-          params.freq = 2 * f;
-          params.mag = 1;
-          params.phase = -((frame_size - 1) / 2.0) * (2 * f) / mix_freq * 2.0 * M_PI + 0.5 * M_PI;
-          params.phase = normalize_phase (params.phase);
-          params.mode = VectorSinParams::REPLACE;
-          fast_vector_sinf (params, &cos_vec[0], &cos_vec[frame_size]);
+      fast_vector_sinf (params, &sines[0], &sines[frame_size]);
 
-          double w2omega = 0;
-          for (size_t n = 0; n < frame_size; n++)
-            w2omega += window[n] * cos_vec[n];
-
-          x_re *= 2 / (window_weight + w2omega);
-          x_im *= 2 / (window_weight - w2omega);
-
-          // compute final magnitude & phase
-          double magnitude = sqrt (x_re * x_re + x_im * x_im);
-          phase = atan2 (x_im, x_re) + 0.5 * M_PI;
-          phase -= (frame_size - 1) / 2.0 / mix_freq * f * 2 * M_PI;
-          phase = normalize_phase (phase);
-
-          // restore partial => sines; keep params.freq & params.mix_freq
-          params.freq = f;
-          params.phase = phase;
-          params.mag = magnitude;
-          params.mode = VectorSinParams::ADD;
-          fast_vector_sinf (params, &sines[0], &sines[frame_size]);
-
-          // store refined freq, mag and phase
-          good_freqs.push_back (f);
-          good_mags.push_back (magnitude);
-          good_phases.push_back (phase);
+      for (size_t n = 0; n < frame_size; n++)
+        {
+          double v = audio_block.debug_samples[n] - all_sines[n] + sines[n];
+          v *= window[n];
+
+          // multiply windowed signal with complex exp function from fourier transform:
+          //
+          //   v * exp (-j * x) = v * (cos (x) - j * sin (x))
+          x_re += v * cos_vec[n];
+          x_im -= v * sin_vec[n];
         }
+
+      // correct influence of mirrored window (caused by negative frequency component)
+      params.mix_freq = mix_freq;
+      params.freq = 2 * f;
+      params.mag = 1;
+      params.phase = -((frame_size - 1) / 2.0) * (2 * f) / mix_freq * 2.0 * M_PI + 0.5 * M_PI;
+      params.phase = normalize_phase (params.phase);
+      params.mode = VectorSinParams::REPLACE;
+      fast_vector_sinf (params, &cos_vec[0], &cos_vec[frame_size]);
+
+      double w2omega = 0;
+      for (size_t n = 0; n < frame_size; n++)
+        w2omega += window[n] * cos_vec[n];
+
+      x_re *= 2 / (window_weight + w2omega);
+      x_im *= 2 / (window_weight - w2omega);
+
+      // compute final magnitude & phase
+      double magnitude = sqrt (x_re * x_re + x_im * x_im);
+      double phase = atan2 (x_im, x_re) + 0.5 * M_PI;
+      phase -= (frame_size - 1) / 2.0 / mix_freq * f * 2 * M_PI;
+      phase = normalize_phase (phase);
+
+      // store refined freq, mag and phase
+      good_freqs.push_back (f);
+      good_mags.push_back (magnitude);
+      good_phases.push_back (phase);
     }
-  while (max_mag > 0);
 
   audio_block.freqs = good_freqs;
   audio_block.mags = good_mags;
@@ -884,51 +976,12 @@ refine_sine_params_fast (EncoderBlock& audio_block, double mix_freq, int frame,
 }
 
 static void
-remove_small_partials (EncoderBlock& audio_block)
+optimize_frame (EncoderBlock& audio_block, int optimization_level, const EncoderParams& enc_params)
 {
-  /*
-   * this function mainly serves to eliminate side peaks introduced by windowing
-   * since these side peaks are typically much smaller than the main peak, we can
-   * get rid of them by comparing peaks to the nearest peak, and removing them
-   * if the nearest peak is much larger
-   */
-  vector<double> dbmags;
-  for (vector<float>::iterator mi = audio_block.mags.begin(); mi != audio_block.mags.end(); mi++)
-    dbmags.push_back (db_from_factor (*mi, -200));
-
-  vector<bool> remove (dbmags.size());
-
-  for (size_t i = 0; i < dbmags.size(); i++)
-    {
-      for (size_t j = 0; j < dbmags.size(); j++)
-        {
-          if (i != j)
-            {
-              double octaves = log (abs (audio_block.freqs[i] - audio_block.freqs[j])) / log (2);
-              double mask = -30 - 15 * octaves; /* theoretical values -31 and -18 */
-              if (dbmags[j] < dbmags[i] + mask)
-                ;
-                // remove[j] = true;
-            }
-        }
-    }
-
-  vector<float> good_freqs;
-  vector<float> good_mags;
-  vector<float> good_phases;
+  if (optimization_level >= 1) // redo FFT estmates, only better
+    refine_sine_params_fast (audio_block, enc_params.mix_freq, enc_params.window);
 
-  for (size_t i = 0; i < dbmags.size(); i++)
-    {
-      if (!remove[i])
-        {
-          good_freqs.push_back (audio_block.freqs[i]);
-          good_mags.push_back (audio_block.mags[i]);
-          good_phases.push_back (audio_block.phases[i]);
-        }
-    }
-  audio_block.freqs = good_freqs;
-  audio_block.mags = good_mags;
-  audio_block.phases = good_phases;
+  // removing side peaks introduced by windowing (small partials next to much larger ones) is disabled
 }
 
 /**
@@ -938,18 +991,10 @@ remove_small_partials (EncoderBlock& audio_block)
 void
 Encoder::optimize_partials (int optimization_level)
 {
-  const double mix_freq = enc_params.mix_freq;
-
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  for_each_frame ("_optimize", 7, [&] (size_t worker, size_t frame)
     {
-      if (optimization_level >= 1) // redo FFT estmates, only better
-        refine_sine_params_fast (audio_blocks[frame], mix_freq, frame, enc_params.window);
-
-      remove_small_partials (audio_blocks[frame]);
-
-      if (killed ("_optimize"))
-        return;
-    }
+      optimize_frame (audio_blocks[frame], optimization_level, enc_params);
+    });
 }
 
 static double
@@ -1083,6 +1128,15 @@ xnoise_envelope_to_spectrum (int frame,
  */
 void
 Encoder::approx_noise()
+{
+  for_each_frame ("_noise", 7, [&] (size_t worker, uint64 frame)
+    {
+      approx_noise_frame (frame, audio_blocks[frame]);
+    });
+}
+
+void
+Encoder::approx_noise_frame (uint64 frame, EncoderBlock& audio_block)
 {
   const size_t block_size = enc_params.block_size;
   const size_t frame_size = enc_params.frame_size;
@@ -1096,115 +1150,159 @@ Encoder::approx_noise()
   // sum_w2 is the average influence of the window (w[x]^2), multiplied with frame_size
   const double norm = 0.5 * enc_params.mix_freq * sum_w2;
 
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
-    {
-      vector<double> noise_envelope (Audio::N_NOISE_BANDS);
-      vector<double> spectrum (audio_blocks[frame].noise.begin(), audio_blocks[frame].noise.end());
-
-      /* A complex FFT would preserve the energy of the input signal exactly; the difference to
-       * our (real) FFT is that every value in the complex spectrum occurs twice, once as "positive"
-       * frequency, once as "negative" frequency - except for two spectrum values: the value
-       * for frequency 0, and the value for frequency mix_freq / 2.
-       *
-       * To make this FFT energy preserving, we scale those values with a factor of sqrt (2) so
-       * that their energy is twice as big (energy == squared value). Then we scale the whole
-       * thing with a factor of 0.5, and we get an energy preserving transformation.
-       */
-      spectrum[0] /= sqrt (2);
-      spectrum[spectrum.size() - 2] /= sqrt (2);
-
-      approximate_noise_spectrum (frame, enc_params.mix_freq, spectrum, noise_envelope, norm);
-
-      /// DEBUG CODE {
-      const size_t fft_size = block_size * zeropad;
-      const double debug_norm = fft_size * 0.5 * sum_w2;
-
-      vector<double> approx_spectrum (fft_size);
-      xnoise_envelope_to_spectrum (frame, enc_params.mix_freq, noise_envelope, approx_spectrum, norm);
-      for (size_t i = 0; i < approx_spectrum.size(); i += 2)
-        debug ("spect_approx:%" PRId64 " %g\n", frame, approx_spectrum[i]);
-
-      double spect_energy = 0;
-      for (vector<double>::iterator si = approx_spectrum.begin(); si != approx_spectrum.end(); si++)
-        spect_energy += *si * *si / debug_norm;
-
-      double b4_energy = 0;
-      for (vector<double>::iterator si = spectrum.begin(); si != spectrum.end(); si++)
-        b4_energy += *si * *si / debug_norm;
-
-      double r_energy = 0;
-      for (vector<float>::iterator ri = audio_blocks[frame].debug_samples.begin(); ri != audio_blocks[frame].debug_samples.end(); ri++)
-        r_energy += *ri * *ri / audio_blocks[frame].debug_samples.size();
-
-      debug ("noiseenergy:%" PRId64 " %f %f %f\n", frame, spect_energy, b4_energy, r_energy);
-      /// } DEBUG_CODE
-      audio_blocks[frame].noise.assign (noise_envelope.begin(), noise_envelope.end());
-
-      if (killed ("_noise", frame & 7))
-        return;
-    }
+  vector<double> noise_envelope (Audio::N_NOISE_BANDS);
+  vector<double> spectrum (audio_block.noise.begin(), audio_block.noise.end());
+
+  /* A complex FFT would preserve the energy of the input signal exactly; the difference to
+   * our (real) FFT is that every value in the complex spectrum occurs twice, once as "positive"
+   * frequency, once as "negative" frequency - except for two spectrum values: the value
+   * for frequency 0, and the value for frequency mix_freq / 2.
+   *
+   * To make this FFT energy preserving, we scale those values with a factor of sqrt (2) so
+   * that their energy is twice as big (energy == squared value). Then we scale the whole
+   * thing with a factor of 0.5, and we get an energy preserving transformation.
+   */
+  spectrum[0] /= sqrt (2);
+  spectrum[spectrum.size() - 2] /= sqrt (2);
+
+  approximate_noise_spectrum (frame, enc_params.mix_freq, spectrum, noise_envelope, norm);
+
+  /// DEBUG CODE {
+  const size_t fft_size = block_size * zeropad;
+  const double debug_norm = fft_size * 0.5 * sum_w2;
+
+  vector<double> approx_spectrum (fft_size);
+  xnoise_envelope_to_spectrum (frame, enc_params.mix_freq, noise_envelope, approx_spectrum, norm);
+  for (size_t i = 0; i < approx_spectrum.size(); i += 2)
+    debug ("spect_approx:%" PRId64 " %g\n", frame, approx_spectrum[i]);
+
+  double spect_energy = 0;
+  for (vector<double>::iterator si = approx_spectrum.begin(); si != approx_spectrum.end(); si++)
+    spect_energy += *si * *si / debug_norm;
+
+  double b4_energy = 0;
+  for (vector<double>::iterator si = spectrum.begin(); si != spectrum.end(); si++)
+    b4_energy += *si * *si / debug_norm;
+
+  double r_energy = 0;
+  for (vector<float>::iterator ri = audio_block.debug_samples.begin(); ri != audio_block.debug_samples.end(); ri++)
+    r_energy += *ri * *ri / audio_block.debug_samples.size();
+
+  debug ("noiseenergy:%" PRId64 " %f %f %f\n", frame, spect_energy, b4_energy, r_energy);
+  /// } DEBUG_CODE
+  audio_block.noise.assign (noise_envelope.begin(), noise_envelope.end());
 }
 
+/*
+ * Data that doesn't depend on the attack parameters, computed once before the
+ * search for the optimal attack envelope
+ */
+struct Encoder::AttackSignal
+{
+  vector< vector<double> > unscaled_signal;  // sine reconstruction of the first frames
+  vector<double>           orig_signal;
+  vector<double>           tail_error;       // orig_signal - decoded_signal for frames without envelope
+};
+
+/*
+ * The frames before the attack end depend on the attack envelope, all other
+ * frames are simply windowed. So we only compute the signal up to the end of
+ * the last frame with an envelope, and use precomputed errors for the rest.
+ *
+ * All values are computed with the same expressions in the same order as for
+ * the complete signal, so the error doesn't depend on how much we skip.
+ */
 double
-Encoder::attack_error (const vector< vector<double> >& unscaled_signal, const Attack& attack, vector<double>& out_scale)
+Encoder::attack_error (const AttackSignal& signal, const Attack& attack, vector<double>& decoded_signal, vector<double>& out_scale) const
 {
+  const auto& unscaled_signal = signal.unscaled_signal;
   const size_t frames = unscaled_signal.size();
-  double total_error = 0;
-  vector<double> decoded_signal (enc_params.frame_size + enc_params.frame_step * frames);
-  vector<double> orig_signal (decoded_signal.size());
+  const size_t frame_step = enc_params.frame_step;
 
   const auto& window = enc_params.window;
 
+  auto sample_ms = [&] (size_t f, size_t n) {
+    return f * enc_params.frame_step_ms + n * 1000.0 / enc_params.mix_freq;
+  };
+
+  /* frames from first_full_frame on have env = 1 and scale = 1 for all samples */
+  size_t first_full_frame = 0;
+  while (first_full_frame < frames && sample_ms (first_full_frame, 0) < attack.attack_end_ms)
+    first_full_frame++;
+
+  const size_t end = first_full_frame ? (first_full_frame - 1) * frame_step + unscaled_signal[first_full_frame - 1].size() : 0;
+
+  decoded_signal.assign (end, 0);
+
   for (size_t f = 0; f < frames; f++)
     {
       const vector<double>& frame_signal = unscaled_signal[f];
-      size_t zero_values = 0;
       double scale = 1.0;
 
-      for (size_t n = 0; n < frame_signal.size(); n++)
+      if (f >= first_full_frame)
         {
-          const double n_ms = f * enc_params.frame_step_ms + n * 1000.0 / enc_params.mix_freq;
-          double env;
-          if (n_ms < attack.attack_start_ms)
-            {
-              env = 0;
-              zero_values++;
+          /* envelope is 1.0 for the whole frame */
+          for (size_t n = 0; n < frame_signal.size() && f * frame_step + n < end; n++)
+            decoded_signal[f * frame_step + n] += frame_signal[n] * window[n];
 
-              size_t samples_in_frame = frame_signal.size() - zero_values;
-              if (samples_in_frame < (frame_signal.size() / 8))
-                {
-                  /* if we have very few samples in frame, the partials will
-                   * not be reliable, so in this case we cancel out the frame
-                   */
-                  scale = 0;
-                }
-              else
-                {
-                  /* based on an incomplete frame, we boost the partials
-                   * to obtain an estimate for one whole frame
-                   */
-                  scale = frame_signal.size() / double (samples_in_frame);
-                }
-            }
-          else if (n_ms < attack.attack_end_ms)  // during attack
-            {
-              const double attack_len_ms = attack.attack_end_ms - attack.attack_start_ms;
+          out_scale[f] = scale;
+          continue;
+        }
 
-              env = (n_ms - attack.attack_start_ms) / attack_len_ms;
+      /* frames before first_full_frame end at or before end */
+      double *decoded = decoded_signal.data() + f * frame_step;
+
+      /* sample_ms() is monotonic: frame is [ zero values | attack | after attack ] */
+      size_t zero_values = 0;
+      while (zero_values < frame_signal.size() && sample_ms (f, zero_values) < attack.attack_start_ms)
+        zero_values++;
+
+      size_t attack_end = zero_values;
+      while (attack_end < frame_signal.size() && sample_ms (f, attack_end) < attack.attack_end_ms)
+        attack_end++;
+
+      if (zero_values)
+        {
+          size_t samples_in_frame = frame_signal.size() - zero_values;
+          if (samples_in_frame < (frame_signal.size() / 8))
+            {
+              /* if we have very few samples in frame, the partials will
+               * not be reliable, so in this case we cancel out the frame
+               */
+              scale = 0;
             }
-          else // after attack
+          else
             {
-              env = 1.0;
+              /* based on an incomplete frame, we boost the partials
+               * to obtain an estimate for one whole frame
+               */
+              scale = frame_signal.size() / double (samples_in_frame);
             }
-          decoded_signal[f * enc_params.frame_step + n] += frame_signal[n] * scale * env * window[n];
-          orig_signal[f * enc_params.frame_step + n] = audio_blocks[f].debug_samples[n];
         }
+      /* zero values: env = 0, nothing to add */
+
+      const double attack_len_ms = attack.attack_end_ms - attack.attack_start_ms;
+      for (size_t n = zero_values; n < attack_end; n++)
+        {
+          const double env = (sample_ms (f, n) - attack.attack_start_ms) / attack_len_ms;
+
+          decoded[n] += frame_signal[n] * scale * env * window[n];
+        }
+      for (size_t n = attack_end; n < frame_signal.size(); n++)
+        decoded[n] += frame_signal[n] * scale * window[n];
+
       out_scale[f] = scale;
     }
-  for (size_t i = 0; i < decoded_signal.size(); i++)
+
+  double total_error = 0;
+  for (size_t i = 0; i < end; i++)
+    {
+      double error = signal.orig_signal[i] - decoded_signal[i];
+      total_error += error * error;
+    }
+  for (size_t i = end; i < signal.tail_error.size(); i++)
     {
-      double error = orig_signal[i] - decoded_signal[i];
-      //printf ("%d %f %f\n", i,orig_signal[i], decoded_signal[i]);
+      double error = signal.tail_error[i];
       total_error += error * error;
     }
   return total_error;
@@ -1213,6 +1311,12 @@ Encoder::attack_error (const vector< vector<double> >& unscaled_signal, const At
 /**
  * This function computes the optimal attack parameters, by finding the optimal
  * attack envelope (attack_start_ms and attack_end_ms) given the data.
+ *
+ * The search is a random walk, where each step depends on whether the previous
+ * candidates were accepted. To use more than one thread, we evaluate a batch of
+ * candidates in parallel, assuming that none of them will be accepted. If one is,
+ * the candidates after it are discarded. This way the result is exactly the
+ * same as for serial search.
  */
 void
 Encoder::compute_attack_params()
@@ -1221,9 +1325,10 @@ Encoder::compute_attack_params()
 
   const double mix_freq   = enc_params.mix_freq;
   const size_t frame_size = enc_params.frame_size;
-  const size_t frames = MIN (20, audio_blocks.size());
+  const size_t frames = MIN (ATTACK_FRAMES, audio_blocks.size());
 
-  vector< vector<double> > unscaled_signal;
+  AttackSignal signal;
+  auto& unscaled_signal = signal.unscaled_signal;
   for (size_t f = 0; f < frames; f++)
     {
       const EncoderBlock& audio_block = audio_blocks[f];
@@ -1249,6 +1354,21 @@ Encoder::compute_attack_params()
       unscaled_signal.push_back (frame_signal);
     }
 
+  /* original signal and the part of the decoded signal without attack envelope */
+  vector<double> decoded_signal (enc_params.frame_size + enc_params.frame_step * frames);
+  signal.orig_signal.resize (decoded_signal.size());
+  for (size_t f = 0; f < frames; f++)
+    {
+      for (size_t n = 0; n < unscaled_signal[f].size(); n++)
+        {
+          decoded_signal[f * enc_params.frame_step + n] += unscaled_signal[f][n] * enc_params.window[n];
+          signal.orig_signal[f * enc_params.frame_step + n] = audio_blocks[f].debug_samples[n];
+        }
+    }
+  signal.tail_error.resize (decoded_signal.size());
+  for (size_t i = 0; i < decoded_signal.size(); i++)
+    signal.tail_error[i] = signal.orig_signal[i] - decoded_signal[i];
+
   /* make attack envelope deterministically return the same result for the same input every time */
   Random random;
   random.set_seed (42);
@@ -1256,58 +1376,120 @@ Encoder::compute_attack_params()
   Attack attack;
   int no_modification = 0;
   double error = 1e7;
-  vector<double> scale (frames);
 
   double zero_values_at_start_ms = zero_values_at_start / mix_freq * 1000;
   attack.attack_start_ms = zero_values_at_start_ms;
   attack.attack_end_ms = zero_values_at_start_ms + 10;
+
+  struct Candidate
+  {
+    Attack attack;
+    Random random;      // state after generating this candidate
+    bool   valid;
+    double error;
+  };
+  const size_t n_threads = enc_params.n_threads;
+  const size_t batch_size = n_threads > 1 ? n_threads * 16 : 1;
+
+  /* the threads are reused for all batches */
+  ParallelWorkers workers (n_threads);
+
+  vector<Candidate> batch;
+  vector<vector<double>> worker_decoded_signal (n_threads);
+  vector<vector<double>> worker_scale (n_threads, vector<double> (frames));
+
+  bool   have_last_attack = false;
+  Attack last_attack;   // last candidate we computed the error for
+
   while (no_modification < 3000)
     {
-      double R;
-      Attack new_attack = attack;
-      if (no_modification < 500)
-        R = 100;
-      else if (no_modification < 1000)
-        R = 20;
-      else if (no_modification < 1500)
-        R = 1;
-      else if (no_modification < 2000)
-        R = 0.2;
-      else if (no_modification < 2500)
-        R = 0.01;
-      else
-        R = 0.002;
+      /* generate candidates, assuming that all of them will be rejected */
+      batch.clear();
+      int batch_no_modification = no_modification;
+      while (batch.size() < batch_size && batch_no_modification < 3000)
+        {
+          const int nm = batch_no_modification;
+          double R;
+          Attack new_attack = attack;
+          if (nm < 500)
+            R = 100;
+          else if (nm < 1000)
+            R = 20;
+          else if (nm < 1500)
+            R = 1;
+          else if (nm < 2000)
+            R = 0.2;
+          else if (nm < 2500)
+            R = 0.01;
+          else
+            R = 0.002;
+
+          new_attack.attack_start_ms += random.random_double_range (-R, R);
+          new_attack.attack_end_ms += random.random_double_range (-R, R);
 
-      new_attack.attack_start_ms += random.random_double_range (-R, R);
-      new_attack.attack_end_ms += random.random_double_range (-R, R);
+          // constrain attack to at least 5ms to avoid clickiness at start
+          new_attack.attack_end_ms = max (new_attack.attack_end_ms, new_attack.attack_start_ms + 5);
 
-      // constrain attack to at least 5ms to avoid clickiness at start
-      new_attack.attack_end_ms = max (new_attack.attack_end_ms, new_attack.attack_start_ms + 5);
+          Candidate candidate;
+          candidate.attack = new_attack;
+          candidate.random = random;
+          candidate.valid = new_attack.attack_start_ms < new_attack.attack_end_ms &&
+                            new_attack.attack_start_ms >= zero_values_at_start_ms &&
+                            new_attack.attack_end_ms < 200;
+          candidate.error = 0;
+          batch.push_back (candidate);
 
-      if (new_attack.attack_start_ms < new_attack.attack_end_ms &&
-          new_attack.attack_start_ms >= zero_values_at_start_ms &&
-          new_attack.attack_end_ms < 200)
+          if (candidate.valid)
+            batch_no_modification++;
+        }
+      workers.parallel_for (batch.size(), [&] (size_t worker, size_t i)
+        {
+          if (batch[i].valid)
+            batch[i].error = attack_error (signal, batch[i].attack, worker_decoded_signal[worker], worker_scale[worker]);
+        });
+
+      for (const Candidate& candidate : batch)
         {
-          const double new_error = attack_error (unscaled_signal, new_attack, scale);
+          /* continue random walk after this candidate */
+          random = candidate.random;
+
+          bool accepted = false;
+          if (candidate.valid)
+            {
 #if 0
-          printf ("attack=<%f, %f> error=%.17g new_attack=<%f, %f> new_arror=%.17g\n", attack.attack_start_ms, attack.attack_end_ms, error,
-                                                                                       new_attack.attack_start_ms, new_attack.attack_end_ms, new_error);
+              printf ("attack=<%f, %f> error=%.17g new_attack=<%f, %f> new_arror=%.17g\n", attack.attack_start_ms, attack.attack_end_ms, error,
+                                                                                           candidate.attack.attack_start_ms, candidate.attack.attack_end_ms, candidate.error);
 #endif
-          if (new_error < error)
-            {
-              error = new_error;
-              attack = new_attack;
+              have_last_attack = true;
+              last_attack = candidate.attack;
 
-              no_modification = 0;
-            }
-          else
-            {
-              no_modification++;
+              if (candidate.error < error)
+                {
+                  error = candidate.error;
+                  attack = candidate.attack;
+
+                  no_modification = 0;
+                  accepted = true;
+                }
+              else
+                {
+                  no_modification++;
+                }
             }
+          if (killed ("_attack", killed_iteration++ & 63))
+            return;
+
+          /* the remaining candidates were generated for the old attack */
+          if (accepted)
+            break;
         }
-      if (killed ("_attack", killed_iteration++ & 63))
-        return;
     }
+
+  /* scale of the last candidate we tried (as serial search computes it) */
+  vector<double> scale (frames);
+  if (have_last_attack)
+    attack_error (signal, last_attack, decoded_signal, scale);
+
   for (size_t f = 0; f < frames; f++)
     {
       for (size_t i = 0; i < audio_blocks[f].mags.size(); i++)
@@ -1329,42 +1511,46 @@ pd_cmp (const PartialData& p1, const PartialData& p2)
   return p1.freq < p2.freq;
 }
 
-void
-Encoder::sort_freqs()
+static void
+sort_frame_freqs (EncoderBlock& audio_block)
 {
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
-    {
-      // sort partials by frequency
-      vector<PartialData> pvec;
+  // sort partials by frequency
+  vector<PartialData> pvec;
 
-      for (size_t p = 0; p < audio_blocks[frame].freqs.size(); p++)
-        {
-          PartialData pd;
-          pd.freq = audio_blocks[frame].freqs[p];
-          pd.mag = audio_blocks[frame].mags[p];
-          pd.phase = audio_blocks[frame].phases[p];
-          pvec.push_back (pd);
-        }
-      sort (pvec.begin(), pvec.end(), pd_cmp);
+  for (size_t p = 0; p < audio_block.freqs.size(); p++)
+    {
+      PartialData pd;
+      pd.freq = audio_block.freqs[p];
+      pd.mag = audio_block.mags[p];
+      pd.phase = audio_block.phases[p];
+      pvec.push_back (pd);
+    }
+  sort (pvec.begin(), pvec.end(), pd_cmp);
 
-      // replace partial data with sorted partial data
-      audio_blocks[frame].freqs.clear();
-      audio_blocks[frame].mags.clear();
-      audio_blocks[frame].phases.clear();
+  // replace partial data with sorted partial data
+  audio_block.freqs.clear();
+  audio_block.mags.clear();
+  audio_block.phases.clear();
 
-      for (vector<PartialData>::const_iterator pi = pvec.begin(); pi != pvec.end(); pi++)
+  for (vector<PartialData>::const_iterator pi = pvec.begin(); pi != pvec.end(); pi++)
+    {
+      // attack envelope computation produces some partials with mag = 0; we don't need to store these
+      if (pi->mag != 0)
         {
-          // attack envelope computation produces some partials with mag = 0; we don't need to store these
-          if (pi->mag != 0)
-            {
-              audio_blocks[frame].freqs.push_back (pi->freq);
-              audio_blocks[frame].mags.push_back (pi->mag);
-              audio_blocks[frame].phases.push_back (pi->phase);
-            }
+          audio_block.freqs.push_back (pi->freq);
+          audio_block.mags.push_back (pi->mag);
+          audio_block.phases.push_back (pi->phase);
         }
     }
 }
 
+void
+Encoder::sort_freqs()
+{
+  for (auto& audio_block : audio_blocks)
+    sort_frame_freqs (audio_block);
+}
+
 /**
  * This function calls all steps necessary for encoding in the right order.
  *
@@ -1376,46 +1562,74 @@ bool
 Encoder::encode (const WavData& wav_data, int channel, int optimization_level,
                  bool attack, bool track_sines)
 {
+  const double start_time = get_time();
+  double stage_start_time = start_time;
+
+  auto profile = [&] (const char *stage)
+    {
+      if (enc_params.profile)
+        {
+          const double now = get_time();
+          fprintf (stderr, "encoder profile: %-10s %10.2f ms\n", stage, (now - stage_start_time) * 1000);
+          stage_start_time = now;
+        }
+    };
+
   compute_stft (wav_data, channel);
+  profile ("stft");
   if (killed ("stft"))
     return false;
 
   if (track_sines)
     {
       search_local_maxima();
+      profile ("maxima");
       if (killed ("maxima"))
         return false;
 
       link_partials();
+      profile ("link");
       if (killed ("link"))
         return false;
 
       validate_partials();
+      profile ("validate");
       if (killed ("validate"))
         return false;
 
       optimize_partials (optimization_level);
+      profile ("optimize");
       if (killed ("optimize"))
         return false;
 
       spectral_subtract();
+      profile ("subtract");
       if (killed ("subtract"))
         return false;
     }
   approx_noise();
+  profile ("noise");
   if (killed ("noise"))
     return false;
 
   if (attack)
-    compute_attack_params();
+    {
+      compute_attack_params();
+      profile ("attack");
+    }
 
   if (killed ("attack"))
     return false;
 
   sort_freqs();
+  profile ("sort");
   if (killed ("sort"))
     return false;
 
+  if (enc_params.profile)
+    fprintf (stderr, "encoder profile: %-10s %10.2f ms (%zd frames, %zd threads, peak memory %.1f MB)\n", "total",
+             (get_time() - start_time) * 1000, audio_blocks.size(), enc_params.n_threads, sm_peak_memory_usage() / 1e6);
+
   return true;
 }
 
@@ -1519,14 +1733,7 @@ Encoder::save_as_audio()
 {
   Audio *audio = new Audio();
 
-  audio->fundamental_freq = enc_params.fundamental_freq;
-  audio->mix_freq = enc_params.mix_freq;
-  audio->frame_size_ms = enc_params.frame_size_ms;
-  audio->frame_step_ms = enc_params.frame_step_ms;
-  audio->attack_start_ms = optimal_attack.attack_start_ms;
-  audio->attack_end_ms = optimal_attack.attack_end_ms;
-  audio->zero_values_at_start = zero_values_at_start;
-  audio->zeropad = enc_params.zeropad;
+  setup_audio_header (*audio);
 
   for (vector<EncoderBlock>::iterator ai = audio_blocks.begin(); ai != audio_blocks.end(); ai++)
     {
@@ -1537,21 +1744,252 @@ Encoder::save_as_audio()
       block.debug_samples = ai->debug_samples;
       audio->contents.push_back (block);
     }
-  audio->sample_count = sample_count;
   audio->original_samples = original_samples;
+  return audio;
+}
+
+/**
+ * This function sets all parameters of an Audio object that are not frame
+ * data or original samples.
+ */
+void
+Encoder::setup_audio_header (Audio& audio)
+{
+  audio.fundamental_freq = enc_params.fundamental_freq;
+  audio.mix_freq = enc_params.mix_freq;
+  audio.frame_size_ms = enc_params.frame_size_ms;
+  audio.frame_step_ms = enc_params.frame_step_ms;
+  audio.attack_start_ms = optimal_attack.attack_start_ms;
+  audio.attack_end_ms = optimal_attack.attack_end_ms;
+  audio.zero_values_at_start = zero_values_at_start;
+  audio.zeropad = enc_params.zeropad;
+  audio.sample_count = sample_count;
+
   if (loop_start >= 0 && loop_end >= 0 && loop_type != Audio::LOOP_NONE)
     {
-      audio->loop_type = loop_type;
-      audio->loop_start = loop_start;
-      audio->loop_end = loop_end;
+      audio.loop_type = loop_type;
+      audio.loop_start = loop_start;
+      audio.loop_end = loop_end;
 
-      if (audio->loop_type == Audio::LOOP_TIME_FORWARD || audio->loop_type == Audio::LOOP_TIME_PING_PONG)
+      if (audio.loop_type == Audio::LOOP_TIME_FORWARD || audio.loop_type == Audio::LOOP_TIME_PING_PONG)
         {
-          audio->loop_start += zero_values_at_start;
-          audio->loop_end += zero_values_at_start;
+          audio.loop_start += zero_values_at_start;
+          audio.loop_end += zero_values_at_start;
         }
     }
-  return audio;
+}
+
+/**
+ * This function encodes the input like encode() and writes the result to \p out,
+ * but it doesn't keep the data of all frames in memory, so it can be used for
+ * inputs of any length.
+ *
+ * The frames are processed in chunks: the FFT of the frames is computed and
+ * the peaks are linked to the peaks of the previous frame, then the frames are
+ * finished (optimize, subtract, noise) and written. Only the first frames are
+ * held back until the attack parameters are known. The peak search needs the
+ * maximum magnitude of all frames, so there is one pass over all frames to
+ * compute this before.
+ *
+ * The output is the same as saving the result of encode() with the debug data
+ * (original_fft, debug_samples) and the original samples stripped.
+ *
+ * \returns false if the encoder was killed (then the output is incomplete)
+ */
+bool
+Encoder::encode_stream (const WavData& wav_data, int channel, int optimization_level,
+                        bool attack, bool track_sines, GenericOut *out)
+{
+  const double start_time = get_time();
+  double stage_start_time = start_time;
+
+  auto profile = [&] (const char *stage)
+    {
+      if (enc_params.profile)
+        {
+          const double now = get_time();
+          fprintf (stderr, "encoder profile: %-10s %10.2f ms\n", stage, (now - stage_start_time) * 1000);
+          stage_start_time = now;
+        }
+    };
+
+  zero_values_at_start = enc_params.frame_size - enc_params.frame_step / 2;
+  sample_count = wav_data.n_values() / wav_data.n_channels() + zero_values_at_start;
+  original_samples.clear();
+  audio_blocks.clear();
+
+  const uint64 n_frames   = (sample_count + enc_params.frame_step - 1) / enc_params.frame_step;
+  const size_t chunk_size = max<size_t> (64, enc_params.n_threads * 16);
+
+  FFTBuffers fft (enc_params.n_threads, enc_params.block_size * enc_params.zeropad);
+  vector<EncoderBlock> blocks (chunk_size);
+
+  /* first pass: maximum magnitude of all frames (for search_local_maxima_frame) */
+  double max_mag = 0;
+  if (track_sines)
+    {
+      vector<double> frame_max_mag (chunk_size);
+      for (uint64 chunk_start = 0; chunk_start < n_frames; chunk_start += chunk_size)
+        {
+          const uint64 chunk_end = std::min<uint64> (chunk_start + chunk_size, n_frames);
+
+          bool ok = for_each_frame ("_maxima", 15, chunk_start, chunk_end, [&] (size_t worker, size_t frame)
+            {
+              EncoderBlock& block = blocks[frame - chunk_start];
+
+              compute_stft_frame (wav_data, channel, frame, fft.in[worker], fft.out[worker], block, false);
+              frame_max_mag[frame - chunk_start] = max_magnitude (block.noise, enc_params.block_size * enc_params.zeropad);
+            });
+          if (!ok)
+            return false;
+
+          for (uint64 frame = chunk_start; frame < chunk_end; frame++)
+            max_mag = max (max_mag, frame_max_mag[frame - chunk_start]);
+        }
+      profile ("maxima");
+    }
+
+  OutFile of (out, "SpectMorph::Audio", SPECTMORPH_BINARY_FILE_VERSION);
+  assert (of.open_ok());
+
+  auto write_block = [&] (EncoderBlock& block)
+    {
+      sort_frame_freqs (block);
+
+      AudioBlock audio_block;
+      convert_freqs_mags_phases (block, audio_block, enc_params);
+      convert_noise (block.noise, audio_block.noise);
+      Audio::save_block (of, audio_block);
+    };
+  /* the header contains the attack parameters, so the first frames are kept in audio_blocks until they are known */
+  bool header_written = false;
+  auto write_header = [&] ()
+    {
+      if (attack)
+        {
+          compute_attack_params();
+          if (killed ("attack"))
+            return false;
+        }
+      Audio audio;
+      setup_audio_header (audio);
+      audio.save_header (of, n_frames);
+
+      for (auto& block : audio_blocks)
+        write_block (block);
+
+      audio_blocks.clear();
+      header_written = true;
+      return true;
+    };
+
+  /* each tracksel belongs to the track of the first frame it is linked to, identified
+   * by (first frame, index in first frame); validate_partials() adds the partials in
+   * this order, so we sort by track start to get the same result
+   */
+  typedef std::pair<uint64, size_t> TrackStart;
+
+  vector<vector<Tracksel>> tracksels (chunk_size);
+  vector<Tracksel>         prev_tracksels;     // last frame before the current frame
+  vector<TrackStart>       prev_track_start;
+  vector<TrackStart>       track_start;
+  vector<size_t>           order;
+
+  for (uint64 chunk_start = 0; chunk_start < n_frames; chunk_start += chunk_size)
+    {
+      const uint64 chunk_end = std::min<uint64> (chunk_start + chunk_size, n_frames);
+
+      bool ok = for_each_frame ("_stream", 7, chunk_start, chunk_end, [&] (size_t worker, size_t frame)
+        {
+          EncoderBlock& block = blocks[frame - chunk_start];
+
+          block.freqs.clear();
+          block.mags.clear();
+          block.phases.clear();
+          compute_stft_frame (wav_data, channel, frame, fft.in[worker], fft.out[worker], block, false);
+
+          tracksels[frame - chunk_start].clear();
+          if (track_sines)
+            search_local_maxima_frame (frame, block, max_mag, tracksels[frame - chunk_start]);
+        });
+      if (!ok)
+        return false;
+
+      if (track_sines)
+        {
+          for (uint64 frame = chunk_start; frame < chunk_end; frame++)
+            {
+              vector<Tracksel>& current_tracksels = tracksels[frame - chunk_start];
+              EncoderBlock&     block = blocks[frame - chunk_start];
+
+              link_frame_partials (prev_tracksels, current_tracksels);
+
+              track_start.resize (current_tracksels.size());
+              for (size_t i = 0; i < current_tracksels.size(); i++)
+                {
+                  const Tracksel *prev = current_tracksels[i].prev;
+                  if (prev)
+                    track_start[i] = prev_track_start[prev - &prev_tracksels[0]];
+                  else
+                    track_start[i] = TrackStart (frame, i);
+                }
+              order.resize (current_tracksels.size());
+              std::iota (order.begin(), order.end(), 0);
+              std::sort (order.begin(), order.end(), [&] (size_t a, size_t b) { return track_start[a] < track_start[b]; });
+
+              for (auto i : order)
+                {
+                  block.freqs.push_back (current_tracksels[i].freq);
+                  block.mags.push_back (current_tracksels[i].mag);
+                  block.phases.push_back (current_tracksels[i].phase);
+                }
+              /* prev pointers of the next frame will point to prev_tracksels */
+              prev_tracksels.swap (current_tracksels);
+              prev_track_start.swap (track_start);
+            }
+        }
+
+      ok = for_each_frame ("_stream", 7, chunk_start, chunk_end, [&] (size_t worker, size_t frame)
+        {
+          EncoderBlock& block = blocks[frame - chunk_start];
+
+          if (track_sines)
+            {
+              optimize_frame (block, optimization_level, enc_params);
+              spectral_subtract_frame (frame, block, fft.in[worker], fft.out[worker]);
+            }
+          approx_noise_frame (frame, block);
+        });
+      if (!ok)
+        return false;
+
+      for (uint64 frame = chunk_start; frame < chunk_end; frame++)
+        {
+          EncoderBlock& block = blocks[frame - chunk_start];
+
+          if (attack && frame < ATTACK_FRAMES)
+            {
+              /* compute_attack_params() needs debug_samples */
+              audio_blocks.push_back (block);
+            }
+          else
+            {
+              if (!header_written && !write_header())
+                return false;
+
+              write_block (block);
+            }
+        }
+    }
+  if (!header_written && !write_header())
+    return false;
+
+  profile ("stream");
+  if (enc_params.profile)
+    fprintf (stderr, "encoder profile: %-10s %10.2f ms (%zd frames, %zd threads, peak memory %.1f MB)\n", "total",
+             (get_time() - start_time) * 1000, size_t (n_frames), enc_params.n_threads, sm_peak_memory_usage() / 1e6);
+
+  return true;
 }
 
 void
@@ -7,9 +7,11 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <functional>
 
 #include "smaudio.hh"
 #include "smwavdata.hh"
+#include "smgenericout.hh"
 
 namespace SpectMorph
 {
@@ -61,6 +63,12 @@ public:
   /** allow termination during encode() */
   std::function<bool()> kill_function;
 
+  /** number of threads for the frame parallel encoder steps (the result doesn't depend on this) */
+  size_t  n_threads = 1;
+
+  /** print the time needed for each encoder step to stderr */
+  bool    profile = false;
+
   bool add_config_entry (const std::string& param, const std::string& value);
 
   bool load_config (const std::string& filename);
@@ -74,6 +82,12 @@ public:
 
   /** to be able to terminate encoder before we are done */
   void set_kill_function (const std::function<bool()>& kill_function);
+
+  /** use multiple threads for encoding */
+  void set_n_threads (size_t n_threads);
+
+  /** report encoder performance */
+  void set_profile (bool profile);
 };
 
 struct Tracksel {
@@ -120,7 +134,10 @@ class Encoder
     double attack_start_ms;
     double attack_end_ms;
   };
-  double attack_error (const std::vector< std::vector<double> >& unscaled_signal, const Attack& attack, std::vector<double>& out_scale);
+  struct AttackSignal;
+  double attack_error (const AttackSignal& signal, const Attack& attack, std::vector<double>& decoded_signal, std::vector<double>& out_scale) const;
+
+  static constexpr size_t ATTACK_FRAMES = 20; //!< compute_attack_params() only uses the first frames
 
   // single encoder steps:
   void compute_stft (const WavData& wav_data, int channel);
@@ -133,6 +150,14 @@ class Encoder
   void compute_attack_params();
   void sort_freqs();
 
+  // per frame parts of the encoder steps (shared by encode() and encode_stream()):
+  void compute_stft_frame (const WavData& wav_data, int channel, uint64 frame, float *fft_in, float *fft_out,
+                           EncoderBlock& audio_block, bool store_original_fft);
+  void search_local_maxima_frame (uint64 frame, const EncoderBlock& audio_block, double max_mag,
+                                  std::vector<Tracksel>& tracksels);
+  void spectral_subtract_frame (uint64 frame, EncoderBlock& audio_block, float *fft_in, float *fft_out);
+  void approx_noise_frame (uint64 frame, EncoderBlock& audio_block);
+
   inline bool
   killed (const char *where, uint64_t z = 0)
   {
@@ -143,6 +168,11 @@ class Encoder
 
     return enc_params.kill_function && enc_params.kill_function();
   }
+  bool for_each_frame (const char *where, uint64_t kill_check_mask,
+                       const std::function<void (size_t worker, size_t frame)>& function);
+  bool for_each_frame (const char *where, uint64_t kill_check_mask, size_t start_frame, size_t end_frame,
+                       const std::function<void (size_t worker, size_t frame)>& function);
+  void setup_audio_header (Audio& audio);
 
   Attack                               optimal_attack;
   size_t                               zero_values_at_start;
@@ -160,6 +190,10 @@ public:
   bool encode (const WavData& wav_data, int channel, int optimization_level,
                bool attack, bool track_sines);
 
+  // encoding for long inputs: writes a stripped model while encoding, without storing all frames
+  bool encode_stream (const WavData& wav_data, int channel, int optimization_level,
+                      bool attack, bool track_sines, GenericOut *out);
+
   static std::string version(); // changes if encoder algorithm changed (for cache invalidation)
 
   void set_loop (Audio::LoopType loop_type, int loop_start, int loop_end);
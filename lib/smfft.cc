@@ -95,16 +95,21 @@ FFT::fftar_float (size_t N, float *in, float *out, PlanMode plan_mode)
   if (!plan)
     {
       std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N);
-      float *plan_out = new_array_float (N);
-      plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
+      if (!plan) /* another thread may have created the plan while we were waiting for the lock */
         {
-          plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
+          fftwf_plan new_plan;
+          float *plan_in = new_array_float (N);
+          float *plan_out = new_array_float (N);
+          new_plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode));
+          if (!new_plan) /* missing from wisdom -> create plan and save it */
+            {
+              new_plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+              save_wisdom();
+            }
+          free_array_float (plan_out);
+          free_array_float (plan_in);
+          plan = new_plan;
         }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
     }
   fftwf_execute_dft_r2c (plan, in, (fftwf_complex *) out);
 
@@ -121,16 +126,21 @@ FFT::fftsr_float (size_t N, float *in, float *out, PlanMode plan_mode)
   if (!plan)
     {
       std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N);
-      float *plan_out = new_array_float (N);
-      plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
+      if (!plan) /* another thread may have created the plan while we were waiting for the lock */
         {
-          plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
+          fftwf_plan new_plan;
+          float *plan_in = new_array_float (N);
+          float *plan_out = new_array_float (N);
+          new_plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode));
+          if (!new_plan) /* missing from wisdom -> create plan and save it */
+            {
+              new_plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+              save_wisdom();
+            }
+          free_array_float (plan_out);
+          free_array_float (plan_in);
+          plan = new_plan;
         }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
     }
   in[N] = in[1];
   in[N+1] = 0;
@@ -151,18 +161,23 @@ FFT::fftsr_destructive_float (size_t N, float *in, float *out, PlanMode plan_mod
   if (!plan)
     {
       std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      int xplan_flags = plan_flags (plan_mode) & ~FFTW_PRESERVE_INPUT;
-      float *plan_in = new_array_float (N);
-      float *plan_out = new_array_float (N);
-      plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, xplan_flags);
-      if (!plan) /* missing from wisdom -> create plan and save it */
+      if (!plan) /* another thread may have created the plan while we were waiting for the lock */
         {
-          plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out,
-                                        xplan_flags & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
+          fftwf_plan new_plan;
+          int xplan_flags = plan_flags (plan_mode) & ~FFTW_PRESERVE_INPUT;
+          float *plan_in = new_array_float (N);
+          float *plan_out = new_array_float (N);
+          new_plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, xplan_flags);
+          if (!new_plan) /* missing from wisdom -> create plan and save it */
+            {
+              new_plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out,
+                                                xplan_flags & ~FFTW_WISDOM_ONLY);
+              save_wisdom();
+            }
+          free_array_float (plan_out);
+          free_array_float (plan_in);
+          plan = new_plan;
         }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
     }
   in[N] = in[1];
   in[N+1] = 0;
@@ -180,19 +195,24 @@ FFT::fftac_float (size_t N, float *in, float *out, PlanMode plan_mode)
   if (!plan)
     {
       std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N * 2);
-      float *plan_out = new_array_float (N * 2);
-
-      plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                FFTW_FORWARD, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
+      if (!plan) /* another thread may have created the plan while we were waiting for the lock */
         {
-          plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                    FFTW_FORWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
+          fftwf_plan new_plan;
+          float *plan_in = new_array_float (N * 2);
+          float *plan_out = new_array_float (N * 2);
+
+          new_plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
+                                        FFTW_FORWARD, plan_flags (plan_mode));
+          if (!new_plan) /* missing from wisdom -> create plan and save it */
+            {
+              new_plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
+                                            FFTW_FORWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+              save_wisdom();
+            }
+          free_array_float (plan_out);
+          free_array_float (plan_in);
+          plan = new_plan;
         }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
     }
 
   fftwf_execute_dft (plan, (fftwf_complex *)in, (fftwf_complex *)out);
@@ -207,19 +227,24 @@ FFT::fftsc_float (size_t N, float *in, float *out, PlanMode plan_mode)
   if (!plan)
     {
       std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N * 2);
-      float *plan_out = new_array_float (N * 2);
-
-      plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                FFTW_BACKWARD, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
+      if (!plan) /* another thread may have created the plan while we were waiting for the lock */
         {
-          plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                    FFTW_BACKWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
+          fftwf_plan new_plan;
+          float *plan_in = new_array_float (N * 2);
+          float *plan_out = new_array_float (N * 2);
+
+          new_plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
+                                        FFTW_BACKWARD, plan_flags (plan_mode));
+          if (!new_plan) /* missing from wisdom -> create plan and save it */
+            {
+              new_plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
+                                            FFTW_BACKWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+              save_wisdom();
+            }
+          free_array_float (plan_out);
+          free_array_float (plan_in);
+          plan = new_plan;
         }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
     }
   fftwf_execute_dft (plan, (fftwf_complex *)in, (fftwf_complex *)out);
 }
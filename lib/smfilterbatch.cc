@@ -0,0 +1,126 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smfilterbatch.hh"
+#include "smlivedecoderfilter.hh"
+
+#include <algorithm>
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+void
+FilterJob::clear_segments()
+{
+  filter = nullptr;
+  n_segments = 0;
+  n_params = 0;
+}
+
+void
+FilterJob::apply_envelope()
+{
+  for (uint i = 0; i < n_envelope; i++)
+    envelope_audio[i] *= envelope[i];
+
+  envelope_audio = nullptr;
+  n_envelope = 0;
+}
+
+FilterBatch::FilterBatch (size_t max_jobs) :
+  m_jobs (max_jobs),
+  m_job_output (max_jobs * FilterJob::MAX_VALUES)
+{
+  m_pending.reserve (max_jobs);
+  m_group_start.reserve (max_jobs + 1);
+}
+
+size_t
+FilterBatch::max_jobs() const
+{
+  return m_jobs.size();
+}
+
+FilterJob *
+FilterBatch::job (size_t job)
+{
+  assert (job < m_jobs.size());
+  return &m_jobs[job];
+}
+
+float *
+FilterBatch::job_output (size_t job)
+{
+  assert (job < m_jobs.size());
+  return &m_job_output[job * FilterJob::MAX_VALUES];
+}
+
+void
+FilterBatch::clear()
+{
+  m_pending.clear();
+  m_group_start.clear();
+}
+
+void
+FilterBatch::add_pending (FilterJob *job)
+{
+  assert (job->filter && m_pending.size() < m_jobs.size());
+  m_pending.push_back (job);
+}
+
+static bool
+job_less (const FilterJob *a, const FilterJob *b)
+{
+  /* jobs that are equal according to this function can be processed together */
+  const int mode_a = a->filter->batch_mode();
+  const int mode_b = b->filter->batch_mode();
+  if (mode_a != mode_b)
+    return mode_a < mode_b;
+
+  if (a->n_segments != b->n_segments)
+    return a->n_segments < b->n_segments;
+
+  for (uint s = 0; s < a->n_segments; s++)
+    {
+      if (a->segments[s].n_values != b->segments[s].n_values)
+        return a->segments[s].n_values < b->segments[s].n_values;
+    }
+  return false;
+}
+
+size_t
+FilterBatch::make_groups()
+{
+  /* std::sort doesn't allocate memory (the order of equal jobs doesn't affect the output) */
+  std::sort (m_pending.begin(), m_pending.end(), job_less);
+
+  m_group_start.clear();
+  for (size_t j = 0; j < m_pending.size(); j++)
+    {
+      if (m_group_start.empty() ||
+          j - m_group_start.back() == LiveDecoderFilter::BATCH_LANES ||
+          job_less (m_pending[j - 1], m_pending[j]))
+        {
+          m_group_start.push_back (j);
+        }
+    }
+  const size_t n_groups = m_group_start.size();
+  m_group_start.push_back (m_pending.size());
+
+  return n_groups;
+}
+
+void
+FilterBatch::process_group (size_t group)
+{
+  assert (group + 1 < m_group_start.size());
+
+  FilterJob **jobs = &m_pending[m_group_start[group]];
+  const size_t n_jobs = m_group_start[group + 1] - m_group_start[group];
+
+  LiveDecoderFilter::process_jobs (jobs, n_jobs);
+
+  for (size_t j = 0; j < n_jobs; j++)
+    jobs[j]->apply_envelope();
+}
@@ -0,0 +1,91 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smutils.hh"
+#include "smalignedarray.hh"
+
+#include <vector>
+
+namespace SpectMorph
+{
+
+class LiveDecoderFilter;
+
+/*
+ * FilterJob records the filter work of one voice for one block: instead of
+ * filtering immediately, LiveDecoderFilter stores the audio pointer and the
+ * filter parameters of each segment, and the voice envelope (which needs to
+ * be applied after filtering) is stored as well
+ */
+class FilterJob
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (FilterJob);
+public:
+  static constexpr uint MAX_VALUES   = 1024;  // max number of values per block
+  static constexpr uint MAX_SEGMENTS = 32;
+
+  struct Segment
+  {
+    float *audio;
+    uint   n_values;
+    bool   const_params;    // true: use freq, reso, drive for all values
+    float  freq;
+    float  reso;
+    float  drive;
+    uint   params_offset;   // false: per value parameters start at freq_in/reso_in/drive_in + params_offset
+  };
+  LiveDecoderFilter *filter = nullptr;  // filter that deferred the segments (or nullptr if nothing is deferred)
+  Segment            segments[MAX_SEGMENTS];
+  uint               n_segments = 0;
+  float              freq_in[MAX_VALUES];
+  float              reso_in[MAX_VALUES];
+  float              drive_in[MAX_VALUES];
+  uint               n_params = 0;
+
+  float             *envelope_audio = nullptr;
+  float              envelope[MAX_VALUES];
+  uint               n_envelope = 0;
+
+  FilterJob() = default;
+
+  void clear_segments();
+  void apply_envelope();
+};
+
+/*
+ * FilterBatch runs the deferred filter jobs of many voices
+ *
+ *  - make_groups() sorts the jobs so that jobs which can be processed together
+ *    (same filter type, same mode, same segment sizes) are next to each other,
+ *    and splits them into groups of up to LiveDecoderFilter::BATCH_LANES jobs
+ *  - process_group() runs one group, using one SIMD lane per voice; groups are
+ *    independent, so they can be processed by different threads
+ *
+ * the filter output is exactly the same as filtering each voice on its own; the
+ * envelope gain is rounded to float before it is applied, so the final voice
+ * output can differ in the last bit
+ */
+class FilterBatch
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (FilterBatch);
+
+  std::vector<FilterJob>   m_jobs;
+  AlignedArray<float, 16>  m_job_output;
+  std::vector<FilterJob *> m_pending;       // jobs with deferred segments, for the current block
+  std::vector<size_t>      m_group_start;   // group g contains m_pending[m_group_start[g]] ... m_pending[m_group_start[g + 1] - 1]
+
+public:
+  FilterBatch (size_t max_jobs);
+
+  size_t     max_jobs() const;
+  FilterJob *job (size_t job);
+  float     *job_output (size_t job);
+
+  void   clear();
+  void   add_pending (FilterJob *job);
+  size_t make_groups();
+  void   process_group (size_t group);
+};
+
+}
@@ -0,0 +1,458 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smflatwavset.hh"
+#include "smgenericin.hh"
+#include "smstdioout.hh"
+
+#include <map>
+#include <string.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+using std::map;
+
+/*
+ * File layout (all values in native byte order, which is checked on load):
+ *
+ *   FileHeader
+ *   WaveEntry[n_waves]
+ *   AudioEntry[n_audios]
+ *   per audio: AudioFrameStore::Frame[n_frames], freqs, mags, phases, noise, original_samples
+ *   strings: uint32 length, followed by the characters
+ *
+ * Every array starts at a 16 byte aligned offset, so after mapping the file
+ * (which is page aligned), all arrays can be accessed in place.
+ */
+namespace
+{
+
+constexpr char      FLAT_MAGIC[8] = "SMFLATW";
+constexpr uint32_t  FLAT_BYTE_ORDER = 0x01020304;
+constexpr uint32_t  FLAT_VERSION = 1;
+constexpr uint32_t  NO_AUDIO = 0xffffffff;
+constexpr size_t    FLAT_ALIGN = 16;
+
+struct FileHeader
+{
+  char      magic[8];
+  uint32_t  byte_order;
+  uint32_t  version;
+  uint64_t  file_size;
+  uint32_t  n_waves;
+  uint32_t  n_audios;
+  uint64_t  name_offset;
+  uint64_t  short_name_offset;
+  uint64_t  waves_offset;
+  uint64_t  audios_offset;
+};
+
+struct WaveEntry
+{
+  int32_t   midi_note;
+  int32_t   channel;
+  int32_t   velocity_range_min;
+  int32_t   velocity_range_max;
+  uint32_t  audio_index;
+  uint32_t  padding;
+  uint64_t  path_offset;
+};
+
+struct AudioEntry
+{
+  float     fundamental_freq;
+  float     mix_freq;
+  float     frame_size_ms;
+  float     frame_step_ms;
+  float     attack_start_ms;
+  float     attack_end_ms;
+  float     original_samples_norm_db;
+  int32_t   zeropad;
+  int32_t   loop_type;
+  int32_t   loop_start;
+  int32_t   loop_end;
+  int32_t   zero_values_at_start;
+  int32_t   sample_count;
+  uint32_t  n_frames;
+  uint64_t  n_partials;
+  uint64_t  n_noise;
+  uint64_t  n_original_samples;
+  uint64_t  frames_offset;
+  uint64_t  freqs_offset;
+  uint64_t  mags_offset;
+  uint64_t  phases_offset;
+  uint64_t  noise_offset;
+  uint64_t  original_samples_offset;
+};
+
+class FlatWriter
+{
+  vector<unsigned char> m_data;
+public:
+  size_t
+  alloc (size_t n_bytes)
+  {
+    size_t offset = (m_data.size() + FLAT_ALIGN - 1) / FLAT_ALIGN * FLAT_ALIGN;
+    m_data.resize (offset + n_bytes);
+    return offset;
+  }
+  template<class T> size_t
+  append (const T *data, size_t n)
+  {
+    size_t offset = alloc (n * sizeof (T));
+    if (n)
+      memcpy (&m_data[offset], data, n * sizeof (T));
+    return offset;
+  }
+  size_t
+  append_string (const string& s)
+  {
+    uint32_t len = s.size();
+    size_t offset = alloc (sizeof (len) + len);
+    memcpy (&m_data[offset], &len, sizeof (len));
+    memcpy (&m_data[offset + sizeof (len)], s.data(), len);
+    return offset;
+  }
+  template<class T> T *
+  at (size_t offset)
+  {
+    return reinterpret_cast<T *> (&m_data[offset]);
+  }
+  vector<unsigned char>&
+  data()
+  {
+    return m_data;
+  }
+};
+
+class FlatReader
+{
+  const unsigned char *m_data;
+  uint64_t             m_size;
+public:
+  FlatReader (const unsigned char *data, uint64_t size) :
+    m_data (data),
+    m_size (size)
+  {
+  }
+  /* returns nullptr if the array is not completely inside the file or misaligned */
+  template<class T> const T *
+  array (uint64_t offset, uint64_t n) const
+  {
+    if (offset > m_size || offset % alignof (T) != 0 || n > (m_size - offset) / sizeof (T))
+      return nullptr;
+    return reinterpret_cast<const T *> (m_data + offset);
+  }
+  bool
+  string_at (uint64_t offset, string& s) const
+  {
+    const uint32_t *len = array<uint32_t> (offset, 1);
+    if (!len)
+      return false;
+
+    const char *chars = array<char> (offset + sizeof (uint32_t), *len);
+    if (!chars)
+      return false;
+
+    s.assign (chars, *len);
+    return true;
+  }
+};
+
+void
+write_audio (FlatWriter& writer, size_t entry_offset, const Audio& audio)
+{
+  vector<AudioFrameStore::Frame> frames;
+  vector<uint16_t> freqs, mags, phases, noise;
+
+  AudioBlock mapped_block;
+  for (size_t i = 0; i < audio.frame_count(); i++)
+    {
+      const AudioBlock *block = &mapped_block;
+      if (audio.frame_store)
+        audio.frame_store->to_audio_block (i, mapped_block);
+      else
+        block = &audio.contents[i];
+
+      // LiveDecoder needs sorted freqs; unlike the InFile loader, the flat loader doesn't check this
+      for (size_t p = 1; p < block->freqs.size(); p++)
+        assert (block->freqs[p - 1] <= block->freqs[p]);
+
+      assert (block->mags.size() == block->freqs.size());
+      assert (block->phases.size() == block->freqs.size());
+
+      AudioFrameStore::Frame frame;
+      frame.partials_start = freqs.size();
+      frame.n_partials     = block->freqs.size();
+      frame.noise_start    = noise.size();
+      frame.n_noise        = block->noise.size();
+      frames.push_back (frame);
+
+      freqs.insert (freqs.end(), block->freqs.begin(), block->freqs.end());
+      mags.insert (mags.end(), block->mags.begin(), block->mags.end());
+      phases.insert (phases.end(), block->phases.begin(), block->phases.end());
+      noise.insert (noise.end(), block->noise.begin(), block->noise.end());
+    }
+
+  /* append may reallocate, so we compute all offsets before getting the entry pointer */
+  const size_t frames_offset           = writer.append (frames.data(), frames.size());
+  const size_t freqs_offset            = writer.append (freqs.data(), freqs.size());
+  const size_t mags_offset             = writer.append (mags.data(), mags.size());
+  const size_t phases_offset           = writer.append (phases.data(), phases.size());
+  const size_t noise_offset            = writer.append (noise.data(), noise.size());
+  const size_t original_samples_offset = writer.append (audio.original_samples.data(), audio.original_samples.size());
+
+  AudioEntry *entry = writer.at<AudioEntry> (entry_offset);
+  entry->fundamental_freq         = audio.fundamental_freq;
+  entry->mix_freq                 = audio.mix_freq;
+  entry->frame_size_ms            = audio.frame_size_ms;
+  entry->frame_step_ms            = audio.frame_step_ms;
+  entry->attack_start_ms          = audio.attack_start_ms;
+  entry->attack_end_ms            = audio.attack_end_ms;
+  entry->original_samples_norm_db = audio.original_samples_norm_db;
+  entry->zeropad                  = audio.zeropad;
+  entry->loop_type                = audio.loop_type;
+  entry->loop_start               = audio.loop_start;
+  entry->loop_end                 = audio.loop_end;
+  entry->zero_values_at_start     = audio.zero_values_at_start;
+  entry->sample_count             = audio.sample_count;
+  entry->n_frames                 = frames.size();
+  entry->n_partials               = freqs.size();
+  entry->n_noise                  = noise.size();
+  entry->n_original_samples       = audio.original_samples.size();
+  entry->frames_offset            = frames_offset;
+  entry->freqs_offset             = freqs_offset;
+  entry->mags_offset              = mags_offset;
+  entry->phases_offset            = phases_offset;
+  entry->noise_offset             = noise_offset;
+  entry->original_samples_offset  = original_samples_offset;
+}
+
+Error
+load_audio (const FlatReader& reader, const AudioEntry& entry, std::shared_ptr<void> backing, Audio& audio)
+{
+  auto frames           = reader.array<AudioFrameStore::Frame> (entry.frames_offset, entry.n_frames);
+  auto freqs            = reader.array<uint16_t> (entry.freqs_offset, entry.n_partials);
+  auto mags             = reader.array<uint16_t> (entry.mags_offset, entry.n_partials);
+  auto phases           = reader.array<uint16_t> (entry.phases_offset, entry.n_partials);
+  auto noise            = reader.array<uint16_t> (entry.noise_offset, entry.n_noise);
+  auto original_samples = reader.array<float> (entry.original_samples_offset, entry.n_original_samples);
+
+  if (!frames || !freqs || !mags || !phases || !noise || !original_samples)
+    return Error::Code::PARSE_ERROR;
+
+  /* only validate the frame table here: reading all partials would page in the whole file */
+  for (size_t i = 0; i < entry.n_frames; i++)
+    {
+      const AudioFrameStore::Frame& frame = frames[i];
+
+      if (frame.partials_start > entry.n_partials || frame.n_partials > entry.n_partials - frame.partials_start)
+        return Error::Code::PARSE_ERROR;
+      if (frame.noise_start > entry.n_noise || frame.n_noise > entry.n_noise - frame.noise_start)
+        return Error::Code::PARSE_ERROR;
+    }
+
+  audio.fundamental_freq         = entry.fundamental_freq;
+  audio.mix_freq                 = entry.mix_freq;
+  audio.frame_size_ms            = entry.frame_size_ms;
+  audio.frame_step_ms            = entry.frame_step_ms;
+  audio.attack_start_ms          = entry.attack_start_ms;
+  audio.attack_end_ms            = entry.attack_end_ms;
+  audio.original_samples_norm_db = entry.original_samples_norm_db;
+  audio.zeropad                  = entry.zeropad;
+  audio.loop_type                = static_cast<Audio::LoopType> (entry.loop_type);
+  audio.loop_start               = entry.loop_start;
+  audio.loop_end                 = entry.loop_end;
+  audio.zero_values_at_start     = entry.zero_values_at_start;
+  audio.sample_count             = entry.sample_count;
+  audio.original_samples.assign (original_samples, original_samples + entry.n_original_samples);
+  audio.frame_store = std::make_shared<AudioFrameStore> (backing, frames, entry.n_frames, freqs, mags, phases, noise);
+
+  return Error::Code::NONE;
+}
+
+Error
+load_wav_set (WavSet& wav_set, const unsigned char *data, size_t size, std::shared_ptr<void> backing, AudioLoadOptions load_options)
+{
+  FlatReader reader (data, size);
+
+  const FileHeader *header = reader.array<FileHeader> (0, 1);
+  if (!header || memcmp (header->magic, FLAT_MAGIC, sizeof (FLAT_MAGIC)) != 0)
+    return Error::Code::FORMAT_INVALID;
+
+  if (header->byte_order != FLAT_BYTE_ORDER || header->version != FLAT_VERSION)
+    return Error::Code::FORMAT_INVALID;
+
+  if (header->file_size != size)
+    return Error::Code::PARSE_ERROR;
+
+  auto wave_entries  = reader.array<WaveEntry> (header->waves_offset, header->n_waves);
+  auto audio_entries = reader.array<AudioEntry> (header->audios_offset, header->n_audios);
+  if (!wave_entries || !audio_entries)
+    return Error::Code::PARSE_ERROR;
+
+  if (!reader.string_at (header->name_offset, wav_set.name) || !reader.string_at (header->short_name_offset, wav_set.short_name))
+    return Error::Code::PARSE_ERROR;
+
+  /* check waves before loading any Audio, so we don't need to clean up on errors */
+  vector<WavSetWave> waves (header->n_waves);
+  for (size_t i = 0; i < waves.size(); i++)
+    {
+      const WaveEntry& entry = wave_entries[i];
+
+      if (entry.audio_index != NO_AUDIO && entry.audio_index >= header->n_audios)
+        return Error::Code::PARSE_ERROR;
+
+      if (!reader.string_at (entry.path_offset, waves[i].path))
+        return Error::Code::PARSE_ERROR;
+
+      waves[i].midi_note          = entry.midi_note;
+      waves[i].channel            = entry.channel;
+      waves[i].velocity_range_min = entry.velocity_range_min;
+      waves[i].velocity_range_max = entry.velocity_range_max;
+    }
+
+  vector<std::unique_ptr<Audio>> audios;
+  for (size_t i = 0; i < header->n_audios; i++)
+    {
+      audios.emplace_back (new Audio());
+
+      Audio& audio = *audios.back();
+      Error error = load_audio (reader, audio_entries[i], backing, audio);
+      if (error)
+        return error;
+
+      if (load_options != AUDIO_MAP_FRAMES)
+        {
+          /* materialize frames: the result can be modified like Audio loaded from an InFile */
+          audio.contents.resize (audio.frame_count());
+          for (size_t f = 0; f < audio.contents.size(); f++)
+            audio.frame_store->to_audio_block (f, audio.contents[f]);
+
+          audio.frame_store.reset();
+        }
+    }
+
+  /* ownership of all Audio objects used by some wave is passed to the WavSet (see WavSet::clear) */
+  for (size_t i = 0; i < waves.size(); i++)
+    {
+      if (wave_entries[i].audio_index != NO_AUDIO)
+        waves[i].audio = audios[wave_entries[i].audio_index].get();
+    }
+  for (auto& audio : audios)
+    {
+      for (const auto& wave : waves)
+        if (wave.audio == audio.get())
+          {
+            audio.release();
+            break;
+          }
+    }
+  wav_set.waves = waves;
+  return Error::Code::NONE;
+}
+
+}
+
+bool
+FlatWavSet::is_flat_file (const string& filename)
+{
+  std::unique_ptr<GenericIn> file (GenericIn::open (filename));
+  if (!file)
+    return false;
+
+  char magic[sizeof (FLAT_MAGIC)];
+  return file->read (magic, sizeof (magic)) == sizeof (magic) && memcmp (magic, FLAT_MAGIC, sizeof (magic)) == 0;
+}
+
+Error
+FlatWavSet::load (WavSet& wav_set, const string& filename, AudioLoadOptions load_options)
+{
+  wav_set.clear();
+
+  std::shared_ptr<GenericIn> file (GenericIn::open (filename));
+  if (!file)
+    return Error::Code::FILE_NOT_FOUND;
+
+  size_t size;
+  const unsigned char *data = file->mmap_mem (size);
+  if (data)
+    {
+      /* the mapping stays alive as long as some AudioFrameStore references it */
+      return load_wav_set (wav_set, data, size, file, load_options);
+    }
+
+  /* no mmap available (SPECTMORPH_NOMMAP): read the file into memory, which is aligned enough for all arrays */
+  auto mem = std::make_shared<vector<unsigned char>>();
+  unsigned char buffer[64 * 1024];
+  int len;
+  while ((len = file->read (buffer, sizeof (buffer))) > 0)
+    mem->insert (mem->end(), buffer, buffer + len);
+
+  return load_wav_set (wav_set, mem->data(), mem->size(), mem, load_options);
+}
+
+Error
+FlatWavSet::save (const WavSet& wav_set, const string& filename)
+{
+  FlatWriter writer;
+
+  map<const Audio *, uint32_t> audio_index;
+  vector<const Audio *> audios;
+  for (const auto& wave : wav_set.waves)
+    {
+      if (wave.audio && !audio_index.count (wave.audio))
+        {
+          audio_index[wave.audio] = audios.size();
+          audios.push_back (wave.audio);
+        }
+    }
+
+  const size_t header_offset = writer.alloc (sizeof (FileHeader));
+  const size_t waves_offset  = writer.alloc (sizeof (WaveEntry) * wav_set.waves.size());
+  const size_t audios_offset = writer.alloc (sizeof (AudioEntry) * audios.size());
+
+  for (size_t i = 0; i < audios.size(); i++)
+    write_audio (writer, audios_offset + i * sizeof (AudioEntry), *audios[i]);
+
+  for (size_t i = 0; i < wav_set.waves.size(); i++)
+    {
+      const WavSetWave& wave = wav_set.waves[i];
+      const size_t path_offset = writer.append_string (wave.path);
+
+      WaveEntry *entry = writer.at<WaveEntry> (waves_offset + i * sizeof (WaveEntry));
+      entry->midi_note          = wave.midi_note;
+      entry->channel            = wave.channel;
+      entry->velocity_range_min = wave.velocity_range_min;
+      entry->velocity_range_max = wave.velocity_range_max;
+      entry->audio_index        = wave.audio ? audio_index[wave.audio] : NO_AUDIO;
+      entry->padding            = 0;
+      entry->path_offset        = path_offset;
+    }
+  const size_t name_offset       = writer.append_string (wav_set.name);
+  const size_t short_name_offset = writer.append_string (wav_set.short_name);
+
+  FileHeader *header = writer.at<FileHeader> (header_offset);
+  memcpy (header->magic, FLAT_MAGIC, sizeof (FLAT_MAGIC));
+  header->byte_order        = FLAT_BYTE_ORDER;
+  header->version           = FLAT_VERSION;
+  header->file_size         = writer.data().size();
+  header->n_waves           = wav_set.waves.size();
+  header->n_audios          = audios.size();
+  header->name_offset       = name_offset;
+  header->short_name_offset = short_name_offset;
+  header->waves_offset      = waves_offset;
+  header->audios_offset     = audios_offset;
+
+  std::unique_ptr<GenericOut> out (StdioOut::open (filename));
+  if (!out)
+    return Error::Code::FILE_NOT_FOUND;
+
+  const vector<unsigned char>& data = writer.data();
+  if (out->write (data.data(), data.size()) != int (data.size()))
+    return Error (string_printf ("error writing flat wav set '%s'", filename.c_str()));
+
+  return Error::Code::NONE;
+}
@@ -0,0 +1,32 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_FLAT_WAVSET_HH
+#define SPECTMORPH_FLAT_WAVSET_HH
+
+#include "smwavset.hh"
+
+namespace SpectMorph
+{
+
+/**
+ * \brief Flat (memory mappable) on-disk format for WavSet objects
+ *
+ * The frame data of each Audio is stored in contiguous, aligned arrays (one for
+ * each of freqs, mags, phases and noise) plus a frame table, so loading does not
+ * need to parse anything per frame: with AUDIO_MAP_FRAMES, the file is mapped and
+ * the frames are accessed via Audio::frame_store, pages are only read from disk
+ * when a frame is played. Debug information (original_fft, debug_samples) is not
+ * stored in flat files.
+ */
+namespace FlatWavSet
+{
+
+bool  is_flat_file (const std::string& filename);
+Error load (WavSet& wav_set, const std::string& filename, AudioLoadOptions load_options);
+Error save (const WavSet& wav_set, const std::string& filename);
+
+}
+
+}
+
+#endif
@@ -4,11 +4,13 @@
 #include "smmath.hh"
 #include "smfft.hh"
 #include "smblockutils.hh"
+#include "smmain.hh"
 #include <assert.h>
 #include <stdio.h>
 
 #include <map>
 #include <mutex>
+#include <atomic>
 
 using namespace SpectMorph;
 
@@ -17,6 +19,7 @@ using std::map;
 
 static std::mutex table_mutex;
 static map<size_t, IFFTSynthTable *> table_for_block_size;
+static std::atomic<uint64> fft_counter; // for benchmarks
 
 namespace SpectMorph {
   vector<float> IFFTSynth::sin_table;
@@ -59,7 +62,14 @@ IFFTSynth::IFFTSynth (size_t block_size, double mix_freq, WindowType win_type) :
             {
               int pos = i * 256 - freq_frac;
               table->win_trans.push_back (wspectrum[abs (pos * 2)]);
+
+              // same value for real and imaginary part of the bin
+              table->win_trans_cs.push_back (wspectrum[abs (pos * 2)]);
+              table->win_trans_cs.push_back (wspectrum[abs (pos * 2)]);
             }
+          // pad to a multiple of four floats; the padding adds zeros to the spectrum
+          while (table->win_trans_cs.size() % IFFTSynthTable::CS_STRIDE)
+            table->win_trans_cs.push_back (0);
         }
       FFT::free_array_float (win);
       FFT::free_array_float (wspectrum);
@@ -100,6 +110,7 @@ IFFTSynth::get_samples (float      *samples,
                         OutputMode  output_mode)
 {
   FFT::fftsr_destructive_float (block_size, fft_in, fft_out);
+  fft_counter.fetch_add (1, std::memory_order_relaxed);
 
   if (win_scale)
     Block::mul (block_size, fft_out, win_scale);
@@ -120,6 +131,53 @@ IFFTSynth::get_samples (float      *samples,
     }
 }
 
+/*
+ * renders a batch of partials; the result is the same as calling render_partial
+ * for each partial, but with SSE the 9 complex bins of a partial are updated
+ * with five vector operations (instead of 18 scalar ones)
+ */
+void
+IFFTSynth::render_partials (size_t n_partials, const float *freqs, const float *mags, const float *phases)
+{
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+  if (sm_sse())
+    {
+      const int range = 4;
+      const float *win_trans_cs = table->win_trans_cs.data();
+
+      for (size_t p = 0; p < n_partials; p++)
+        {
+          const int freq256 = sm_round_positive (freqs[p] * freq256_factor);
+          const int ibin = freq256 >> 8;
+
+          float phase_rcmag, phase_rsmag;
+          partial_rotation (freq256, mags[p], phases[p], phase_rcmag, phase_rsmag);
+
+          /* the padding means we write up to fft_in[2 * (ibin + range) + 3], which
+           * is still inside the fft_in array (block_size + 2 floats) for the non
+           * corner case
+           */
+          if (ibin > range && 2 * (ibin + range) < static_cast<int> (block_size))
+            {
+              float *sp = fft_in + 2 * (ibin - range);
+              const float *wp = win_trans_cs + (freq256 & 0xff) * IFFTSynthTable::CS_STRIDE;
+              const __m128 rcs = _mm_set_ps (phase_rsmag, phase_rcmag, phase_rsmag, phase_rcmag);
+
+              for (int i = 0; i < IFFTSynthTable::CS_STRIDE; i += 4)
+                _mm_storeu_ps (sp + i, _mm_add_ps (_mm_loadu_ps (sp + i), _mm_mul_ps (rcs, _mm_loadu_ps (wp + i))));
+            }
+          else
+            {
+              render_rotated (freq256, phase_rcmag, phase_rsmag);
+            }
+        }
+      return;
+    }
+#endif
+  for (size_t p = 0; p < n_partials; p++)
+    render_partial (freqs[p], mags[p], phases[p]);
+}
+
 double
 IFFTSynth::quantized_freq (double mf_freq)
 {
@@ -136,3 +194,9 @@ IFFTSynth::precompute_tables()
   // trigger fftw planning which can be slow
   FFT::fftsr_destructive_float (block_size, fft_in, fft_out);
 }
+
+uint64
+IFFTSynth::fft_count()
+{
+  return fft_counter.load (std::memory_order_relaxed);
+}
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "smmath.hh"
+#include "smutils.hh"
 
 namespace SpectMorph {
 
@@ -33,6 +34,9 @@ class IFFTSynth
 
   static std::vector<float> sin_table;
 
+  inline void partial_rotation (int freq256, double mag, double phase, float& phase_rcmag, float& phase_rsmag);
+  inline void render_rotated (int freq256, float phase_rcmag, float phase_rsmag);
+
 public:
   enum WindowType { WIN_BLACKMAN_HARRIS_92, WIN_HANNING };
   enum OutputMode { REPLACE, ADD };
@@ -53,29 +57,28 @@ public:
   }
 
   inline void render_partial (double freq, double mag, double phase);
+  void render_partials (size_t n_partials, const float *freqs, const float *mags, const float *phases);
   void get_samples (float *samples, OutputMode output_mode = REPLACE);
   void precompute_tables();
 
   double quantized_freq (double freq);
+
+  static uint64 fft_count(); // number of get_samples() calls of all IFFTSynth instances
 };
 
 struct IFFTSynthTable
 {
   std::vector<float> win_trans;
+  std::vector<float> win_trans_cs; // win_trans with each entry duplicated (for re/im), padded for SSE
+
+  static constexpr int CS_STRIDE = 20;
 
   float             *win_scale;
 };
 
 inline void
-IFFTSynth::render_partial (double mf_freq, double mag, double phase)
+IFFTSynth::partial_rotation (int freq256, double mag, double phase, float& phase_rcmag, float& phase_rsmag)
 {
-  const int range = 4;
-
-  const int freq256 = sm_round_positive (mf_freq * freq256_factor);
-  const int ibin = freq256 >> 8;
-  float *sp = fft_in + 2 * (ibin - range);
-  const float *wmag_p = &table->win_trans[(freq256 & 0xff) * (range * 2 + 1)];
-
   const float nmag = mag * mag_norm;
 
   // rotation for initial phase; scaling for magnitude
@@ -88,9 +91,19 @@ IFFTSynth::render_partial (double mf_freq, double mag, double phase)
   int iphase_adjust = freq256 * SIN_TABLE_SIZE / 512 + (SIN_TABLE_SIZE - SIN_TABLE_SIZE / 4);
   iarg += iphase_adjust;
 
-  const float phase_rsmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
+  phase_rsmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
   iarg += SIN_TABLE_SIZE / 4;
-  const float phase_rcmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
+  phase_rcmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
+}
+
+inline void
+IFFTSynth::render_rotated (int freq256, float phase_rcmag, float phase_rsmag)
+{
+  const int range = 4;
+
+  const int ibin = freq256 >> 8;
+  float *sp = fft_in + 2 * (ibin - range);
+  const float *wmag_p = &table->win_trans[(freq256 & 0xff) * (range * 2 + 1)];
 
   /* compute FFT spectrum modifications */
   if (ibin > range && 2 * (ibin + range) < static_cast<int> (block_size))
@@ -137,6 +150,16 @@ IFFTSynth::render_partial (double mf_freq, double mag, double phase)
     }
 }
 
+inline void
+IFFTSynth::render_partial (double mf_freq, double mag, double phase)
+{
+  const int freq256 = sm_round_positive (mf_freq * freq256_factor);
+
+  float phase_rcmag, phase_rsmag;
+  partial_rotation (freq256, mag, phase, phase_rcmag, phase_rsmag);
+  render_rotated (freq256, phase_rcmag, phase_rsmag);
+}
+
 }
 
 #endif
@@ -1,7 +1,6 @@
 // Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
 
 #include "sminstenccache.hh"
-#include "smbinbuffer.hh"
 #include "sminstencoder.hh"
 #include "smmmapin.hh"
 #include "smmemout.hh"
@@ -14,7 +13,6 @@
 #include <assert.h>
 #include <unistd.h>
 #include <glib/gstdio.h>
-#include <utime.h>
 
 using namespace SpectMorph;
 
@@ -43,9 +41,9 @@ InstEncCache::CacheData::~CacheData()
 }
 
 InstEncCache::InstEncCache() :
-  cache_file_re ("inst_enc_[0-9a-f]{8}_[0-9a-f]{8}_[0-9]+_[0-9a-f]{40}$")
+  store (new CacheStore (sm_get_user_dir (USER_DIR_CACHE), "inst_enc", 100 * 1000 * 1000)) // 100 MB total cache size
 {
-  delete_old_files();
+  delete_legacy_files();
 }
 
 InstEncCache*
@@ -54,114 +52,6 @@ InstEncCache::the()
   return Global::inst_enc_cache();
 }
 
-void
-InstEncCache::cache_save_L (const string& key)
-{
-  const CacheData& cache_data = cache[key];
-
-  BinBuffer buffer;
-
-  buffer.write_start ("SpectMorphCache");
-  buffer.write_string (cache_data.version.c_str());
-  buffer.write_int (cache_data.data.size());
-  buffer.write_string (sha1_hash (&cache_data.data[0], cache_data.data.size()).c_str());
-  buffer.write_end();
-
-  vector<string> files;
-  Error error = read_dir (sm_get_user_dir (USER_DIR_CACHE), files);
-  for (auto filename : files)
-    {
-      if (regex_search (filename, cache_file_re)) /* avoid unlink on something that we shouldn't delete */
-        {
-          if (filename.size() > key.size() && filename.compare (0, key.size(), key) == 0)
-            {
-              unlink (cache_filename (filename).c_str());
-            }
-        }
-    }
-
-  string out_filename = cache_filename (key) + "_" + cache_data.version;
-  FILE *outf = fopen (out_filename.c_str(), "wb");
-  if (outf)
-    {
-      for (auto ch : buffer.to_string())
-        fputc (ch, outf);
-      fputc (0, outf);
-      const unsigned char *ptr = cache_data.data.data();
-      fwrite (ptr, 1, cache_data.data.size(), outf);
-      fclose (outf);
-    }
-}
-
-static bool
-ends_with (const string& value, const string& ending)
-{
-  if (ending.size() > value.size())
-    return false;
-
-  return std::equal (ending.rbegin(), ending.rend(), value.rbegin());
-}
-
-void
-InstEncCache::cache_try_load_L (const string& cache_key, const string& need_version)
-{
-  GenericIn *in_file = nullptr;
-  string     abs_filename;
-
-  vector<string> files;
-  Error error = read_dir (sm_get_user_dir (USER_DIR_CACHE), files);
-  for (auto filename : files)
-    {
-      if (regex_search (filename, cache_file_re))
-        {
-          if (ends_with (filename, need_version))
-            {
-              abs_filename = cache_filename (filename);
-              in_file = GenericIn::open (abs_filename);
-              if (in_file)
-                break;
-            }
-        }
-    }
-
-  if (!in_file)  // no cache entry
-    return;
-
-  // read header (till zero char)
-  string header_str;
-  int ch;
-  while ((ch = in_file->get_byte()) > 0)
-    header_str += char (ch);
-
-  BinBuffer buffer;
-  buffer.from_string (header_str);
-
-  string type       = buffer.read_start_inplace();
-  string version    = buffer.read_string_inplace();
-  int    data_size  = buffer.read_int();
-  string data_hash  = buffer.read_string_inplace();
-
-  if (version == need_version)
-    {
-      vector<unsigned char> data (data_size);
-      if (in_file->read (&data[0], data.size()) == data_size)
-        {
-          string load_data_hash = sha1_hash (&data[0], data.size());
-          if (load_data_hash == data_hash)
-            {
-              cache[cache_key].version = version;
-              cache[cache_key].data    = std::move (data);
-
-              /* bump mtime on successful load; this information is used during
-               * InstEncCache::delete_old_files() to remove the oldest cache files
-               */
-              g_utime (abs_filename.c_str(), nullptr);
-            }
-        }
-    }
-  delete in_file;
-}
-
 static string
 mk_version (const string& wav_data_hash, int midi_note, int iclipstart, int iclipend, Instrument::EncoderConfig& cfg)
 {
@@ -227,31 +117,48 @@ InstEncCache::encode (Group *group, const WavData& wav_data, const string& wav_d
   return audio;
 }
 
+static Audio *
+load_audio (vector<unsigned char>& data)
+{
+  GenericIn *in = MMapIn::open_mem (&data[0], &data[data.size()]);
+  Audio     *audio = new Audio;
+  Error      error = audio->load (in);
+
+  delete in;
+
+  if (!error)
+    return audio;
+
+  delete audio;
+  return nullptr;
+}
+
 Audio *
 InstEncCache::cache_lookup (const string& cache_key, const string& version)
 {
-  std::lock_guard<std::mutex> lg (cache_mutex);
-  if (cache[cache_key].version != version)
-    {
-      cache_try_load_L (cache_key, version);
-    }
-  if (cache[cache_key].version == version) // cache hit (in memory)
-    {
-      vector<unsigned char>& data = cache[cache_key].data;
-      cache[cache_key].read_stamp = cache_read_stamp++;
+  {
+    std::lock_guard<std::mutex> lg (cache_mutex);
+    if (cache[cache_key].version == version) // cache hit (in memory)
+      {
+        cache[cache_key].read_stamp = cache_read_stamp++;
+        memory_hits++;
 
-      GenericIn *in = MMapIn::open_mem (&data[0], &data[data.size()]);
-      Audio     *audio = new Audio;
-      Error      error = audio->load (in);
+        return load_audio (cache[cache_key].data);
+      }
+  }
 
-      delete in;
+  /* the disk cache is content addressed: entries can be shared between groups and processes */
+  vector<unsigned char> data;
+  if (!store->lookup (version, data))
+    return nullptr;
 
-      if (!error)
-        return audio;
+  std::lock_guard<std::mutex> lg (cache_mutex);
 
-      delete audio;
-    }
-  return nullptr;
+  cache[cache_key].version    = version;
+  cache[cache_key].data       = std::move (data);
+  cache[cache_key].read_stamp = cache_read_stamp++;
+
+  return load_audio (cache[cache_key].data);
 }
 
 void
@@ -262,6 +169,9 @@ InstEncCache::cache_add (const string& cache_key, const string& version, const A
 
   audio->save (&audio_mem_out);
 
+  /* the store enforces its size limit */
+  store->insert (version, data);
+
   // LOCK cache: store entry
   std::lock_guard<std::mutex> lg (cache_mutex);
 
@@ -269,14 +179,9 @@ InstEncCache::cache_add (const string& cache_key, const string& version, const A
   cache[cache_key].data       = data;
   cache[cache_key].read_stamp = cache_read_stamp++;
 
-  cache_save_L (cache_key);
-
-  /* enforce size limits and expire cache data from time to time */
+  /* expire cache data from time to time */
   if ((cache_read_stamp % 10) == 0)
-    {
-      delete_old_files();
-      delete_old_memory_L();
-    }
+    delete_old_memory_L();
 }
 
 void
@@ -287,6 +192,18 @@ InstEncCache::clear()
   cache.clear();
 }
 
+InstEncCache::Stats
+InstEncCache::stats()
+{
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> lg (cache_mutex);
+    stats.memory_hits = memory_hits;
+  }
+  stats.disk = store->stats();
+  return stats;
+}
+
 InstEncCache::Group *
 InstEncCache::create_group()
 {
@@ -296,54 +213,22 @@ InstEncCache::create_group()
   return g;
 }
 
+/* older versions used one file per cache entry */
 void
-InstEncCache::delete_old_files()
+InstEncCache::delete_legacy_files()
 {
-  struct Status
-  {
-    string abs_filename;
-    uint64 mtime = 0;
-    size_t size = 0;
-  };
   vector<string> files;
-  vector<Status> file_status;
-
   Error error = read_dir (sm_get_user_dir (USER_DIR_CACHE), files);
   if (error)
     return;
 
+  /* using a regexp here avoids deleting unrelated files; even if something is
+   * misconfigured this should make calling unlink() relatively safe */
+  const regex legacy_file_re ("^inst_enc_[0-9a-f]{8}_[0-9a-f]{8}_[0-9]+_[0-9a-f]{40}$");
   for (auto filename : files)
     {
-      Status status;
-      status.abs_filename = cache_filename (filename);
-      GStatBuf stbuf;
-      if (g_stat (status.abs_filename.c_str(), &stbuf) == 0)
-        {
-          status.mtime = stbuf.st_mtime;
-          status.size  = stbuf.st_size;;
-          file_status.push_back (status);
-        }
-    }
-  std::sort (file_status.begin(), file_status.end(),
-    [](const Status& st1, const Status& st2)
-      {
-        /* sort: start with newest entries */
-        return st1.mtime > st2.mtime;
-      });
-
-  const size_t max_total_size = 100 * 1000 * 1000; // 100 MB total cache size
-  size_t total_size = 0;
-  for (auto status : file_status)
-    {
-      /* using a regexp here avoids deleting unrelated files; even if something is
-       * misconfigured this should make calling unlink() relatively safe */
-      if (regex_search (status.abs_filename, cache_file_re))
-        {
-          total_size += status.size;
-          if (total_size > max_total_size)
-            unlink (status.abs_filename.c_str());
-          // printf ("%s %" PRIu64 " %zd %zd\n", status.abs_filename.c_str(), status.mtime, status.size, total_size);
-        }
+      if (regex_search (filename, legacy_file_re))
+        unlink (cache_filename (filename).c_str());
     }
 }
 
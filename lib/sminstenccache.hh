@@ -6,9 +6,10 @@
 #include "smwavdata.hh"
 #include "smencoder.hh"
 #include "sminstrument.hh"
+#include "smcachestore.hh"
 
 #include <mutex>
-#include <regex>
+#include <memory>
 
 namespace SpectMorph
 {
@@ -27,18 +28,22 @@ class InstEncCache
 
   std::map<std::string, CacheData> cache;
   std::mutex                       cache_mutex;
-  const std::regex                 cache_file_re;
   uint64                           cache_read_stamp = 0;
+  uint64                           memory_hits = 0;
+  std::unique_ptr<CacheStore>      store;
 
-  void        cache_save_L (const std::string& key);
-  void        cache_try_load_L (const std::string& key, const std::string& need_version);
   Audio      *cache_lookup (const std::string& cache_key, const std::string& version);
   void        cache_add (const std::string& cache_key, const std::string& version, const Audio *audio);
 
-  void        delete_old_files();
+  void        delete_legacy_files();
   void        delete_old_memory_L();
 
 public:
+  struct Stats
+  {
+    uint64            memory_hits = 0;
+    CacheStore::Stats disk;         // lookups that were not in memory
+  };
   class Group
   {
   public:
@@ -50,6 +55,7 @@ public:
                       const std::function<bool()>& kill_function);
   void        clear();
   Group      *create_group();
+  Stats       stats();
 
   InstEncCache();
 
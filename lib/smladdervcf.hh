@@ -3,6 +3,11 @@
 #pragma once
 
 #include "smpandaresampler.hh"
+#include "smmatharm.hh"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #include <array>
 #include <algorithm>
@@ -19,6 +24,13 @@ public:
   enum Mode {
     LP1, LP2, LP3, LP4
   };
+  /* filter coefficients for one input sample (used by process_lanes) */
+  struct Coeffs
+  {
+    float b0, b1, a1;
+    float res;
+    float pre_scale, post_scale;
+  };
 private:
   struct Channel {
     float x1, x2, x3, x4;
@@ -189,6 +201,22 @@ private:
 
     return x * (27.0f + x * x) / (27.0f + 9.0f * x * x);
   }
+  void
+  setup_coeffs (Coeffs& coeffs, float freq)
+  {
+    const float fc = std::clamp (freq, clamp_freq_min_, clamp_freq_max_) * freq_scale_factor_;
+    const float g = 0.9892f * fc - 0.4342f * fc * fc + 0.1381f * fc * fc * fc - 0.0202f * fc * fc * fc * fc;
+    coeffs.b0 = g * (1 / 1.3f);
+    coeffs.b1 = g * (0.3f / 1.3f);
+    coeffs.a1 = g - 1;
+
+    float res = fparams_.reso;
+    res *= 1.0029f + 0.0526f * fc - 0.0926f * fc * fc + 0.0218f * fc * fc * fc;
+    coeffs.res = res;
+
+    coeffs.pre_scale = fparams_.pre_scale;
+    coeffs.post_scale = fparams_.post_scale;
+  }
   /*
    * This ladder filter implementation is mainly based on
    *
@@ -199,14 +227,13 @@ private:
   template<Mode MODE, bool STEREO> inline void
   run (float *left, float *right, float freq, uint n_samples)
   {
-    const float fc = std::clamp (freq, clamp_freq_min_, clamp_freq_max_) * freq_scale_factor_;
-    const float g = 0.9892f * fc - 0.4342f * fc * fc + 0.1381f * fc * fc * fc - 0.0202f * fc * fc * fc * fc;
-    const float b0 = g * (1 / 1.3f);
-    const float b1 = g * (0.3f / 1.3f);
-    const float a1 = g - 1;
+    Coeffs coeffs;
+    setup_coeffs (coeffs, freq);
 
-    float res = fparams_.reso;
-    res *= 1.0029f + 0.0526f * fc - 0.0926f * fc * fc + 0.0218f * fc * fc * fc;
+    const float b0 = coeffs.b0;
+    const float b1 = coeffs.b1;
+    const float a1 = coeffs.a1;
+    const float res = coeffs.res;
 
     for (uint os = 0; os < n_samples; os++)
       {
@@ -387,6 +414,234 @@ public:
         n_samples -= todo;
       }
   }
+  /*
+   * Batched processing: up to LANES mono filters with the same mode can be
+   * processed at once, using one SIMD lane per filter. This produces the same
+   * output as calling process_block() for each filter (left channel only):
+   *
+   *  - compute_coeffs() computes the filter coefficients for each input sample
+   *  - upsample() computes the oversampled filter input
+   *  - process_lanes() runs the filters on the oversampled input (in place)
+   *  - downsample() computes the filter output
+   */
+  static constexpr uint LANES = 4;
+
+  void
+  compute_coeffs (uint         n_samples,
+                  Coeffs      *coeffs,
+                  const float *freq_in = nullptr,
+                  const float *reso_in = nullptr,
+                  const float *drive_in = nullptr)
+  {
+    /* this needs to match process_block() / do_process_block() exactly */
+    while (n_samples)
+      {
+        const uint todo = std::min (n_samples, MAX_BLOCK_SIZE);
+
+        if (!fparams_valid_)
+          {
+            setup_reso_drive (fparams_, reso_in ? reso_in[0] : reso_, drive_in ? drive_in[0] : drive_);
+            fparams_valid_ = true;
+          }
+        if (reso_in || drive_in)
+          {
+            uint n_remaining_samples = todo;
+            while (n_remaining_samples)
+              {
+                const uint block_todo = std::min<uint> (n_remaining_samples, 64);
+
+                FParams fparams_end;
+                setup_reso_drive (fparams_end, reso_in ? reso_in[block_todo - 1] : reso_, drive_in ? drive_in[block_todo - 1] : drive_);
+
+                float todo_inv = 1.f / block_todo;
+                float delta_pre_scale = (fparams_end.pre_scale - fparams_.pre_scale) * todo_inv;
+                float delta_post_scale = (fparams_end.post_scale - fparams_.post_scale) * todo_inv;
+                float delta_reso = (fparams_end.reso - fparams_.reso) * todo_inv;
+
+                for (uint i = 0; i < block_todo; i++)
+                  {
+                    fparams_.pre_scale += delta_pre_scale;
+                    fparams_.post_scale += delta_post_scale;
+                    fparams_.reso += delta_reso;
+
+                    setup_coeffs (*coeffs++, freq_in ? freq_in[i] : freq_);
+                  }
+
+                n_remaining_samples -= block_todo;
+
+                if (freq_in)
+                  freq_in += block_todo;
+                if (reso_in)
+                  reso_in += block_todo;
+                if (drive_in)
+                  drive_in += block_todo;
+              }
+          }
+        else
+          {
+            for (uint i = 0; i < todo; i++)
+              setup_coeffs (*coeffs++, freq_in ? freq_in[i] : freq_);
+
+            if (freq_in)
+              freq_in += todo;
+          }
+        n_samples -= todo;
+      }
+  }
+  void
+  upsample (uint n_samples, const float *input, float *over_samples)
+  {
+    channels_[0].res_up->process_block (input, n_samples, over_samples);
+  }
+  void
+  downsample (uint n_samples, const float *over_samples, float *output)
+  {
+    channels_[0].res_down->process_block (over_samples, over_ * n_samples, output);
+  }
+  Mode
+  mode() const
+  {
+    return mode_;
+  }
+  uint
+  oversample() const
+  {
+    return over_;
+  }
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+private:
+  template<Mode MODE> static void
+  process_lanes_mode (Channel **channels, const Coeffs **coeffs, float **over_samples, uint n_samples)
+  {
+    auto load_state = [&] (float Channel::*member) {
+      return _mm_set_ps (channels[3]->*member, channels[2]->*member, channels[1]->*member, channels[0]->*member);
+    };
+    auto store_state = [&] (float Channel::*member, __m128 value) {
+      alignas (16) float f[4];
+      _mm_storeu_ps (f, value);
+      for (uint l = 0; l < LANES; l++)
+        channels[l]->*member = f[l];
+    };
+    __m128 x1 = load_state (&Channel::x1), x2 = load_state (&Channel::x2), x3 = load_state (&Channel::x3), x4 = load_state (&Channel::x4);
+    __m128 y1 = load_state (&Channel::y1), y2 = load_state (&Channel::y2), y3 = load_state (&Channel::y3), y4 = load_state (&Channel::y4);
+
+    const __m128 g_comp = _mm_set_ps (0.5f, 0.5f, 0.5f, 0.5f); // passband gain correction
+    const __m128 tanh_min = _mm_set_ps (-3, -3, -3, -3);
+    const __m128 tanh_max = _mm_set_ps (3, 3, 3, 3);
+    const __m128 c27 = _mm_set_ps (27, 27, 27, 27);
+    const __m128 c9 = _mm_set_ps (9, 9, 9, 9);
+
+    for (uint i = 0; i < n_samples; i++)
+      {
+        auto load_coeff = [&] (float Coeffs::*member) {
+          return _mm_set_ps (coeffs[3][i].*member, coeffs[2][i].*member, coeffs[1][i].*member, coeffs[0][i].*member);
+        };
+        const __m128 b0 = load_coeff (&Coeffs::b0);
+        const __m128 b1 = load_coeff (&Coeffs::b1);
+        const __m128 a1 = load_coeff (&Coeffs::a1);
+        const __m128 res = load_coeff (&Coeffs::res);
+        const __m128 pre_scale = load_coeff (&Coeffs::pre_scale);
+        const __m128 post_scale = load_coeff (&Coeffs::post_scale);
+
+        /* one row per lane => one row per oversampled value */
+        __m128 v0 = _mm_loadu_ps (over_samples[0] + i * 4);
+        __m128 v1 = _mm_loadu_ps (over_samples[1] + i * 4);
+        __m128 v2 = _mm_loadu_ps (over_samples[2] + i * 4);
+        __m128 v3 = _mm_loadu_ps (over_samples[3] + i * 4);
+        _MM_TRANSPOSE4_PS (v0, v1, v2, v3);
+
+        auto tick = [&] (__m128& value)
+          {
+            const __m128 x = _mm_mul_ps (value, pre_scale);
+
+            /* tanh_approx (x - (y4 - g_comp * x) * res) */
+            __m128 t = _mm_sub_ps (x, _mm_mul_ps (_mm_sub_ps (y4, _mm_mul_ps (g_comp, x)), res));
+            t = _mm_max_ps (_mm_min_ps (t, tanh_max), tanh_min);
+            const __m128 x0 = _mm_div_ps (_mm_mul_ps (t, _mm_add_ps (c27, _mm_mul_ps (t, t))),
+                                          _mm_add_ps (c27, _mm_mul_ps (_mm_mul_ps (c9, t), t)));
+
+            y1 = _mm_sub_ps (_mm_add_ps (_mm_mul_ps (b0, x0), _mm_mul_ps (b1, x1)), _mm_mul_ps (a1, y1));
+            x1 = x0;
+
+            y2 = _mm_sub_ps (_mm_add_ps (_mm_mul_ps (b0, y1), _mm_mul_ps (b1, x2)), _mm_mul_ps (a1, y2));
+            x2 = y1;
+
+            y3 = _mm_sub_ps (_mm_add_ps (_mm_mul_ps (b0, y2), _mm_mul_ps (b1, x3)), _mm_mul_ps (a1, y3));
+            x3 = y2;
+
+            y4 = _mm_sub_ps (_mm_add_ps (_mm_mul_ps (b0, y3), _mm_mul_ps (b1, x4)), _mm_mul_ps (a1, y4));
+            x4 = y3;
+
+            switch (MODE)
+              {
+                case LP1: value = _mm_mul_ps (y1, post_scale);
+                          break;
+                case LP2: value = _mm_mul_ps (y2, post_scale);
+                          break;
+                case LP3: value = _mm_mul_ps (y3, post_scale);
+                          break;
+                case LP4: value = _mm_mul_ps (y4, post_scale);
+                          break;
+              }
+          };
+        tick (v0);
+        tick (v1);
+        tick (v2);
+        tick (v3);
+
+        _MM_TRANSPOSE4_PS (v0, v1, v2, v3);
+        _mm_storeu_ps (over_samples[0] + i * 4, v0);
+        _mm_storeu_ps (over_samples[1] + i * 4, v1);
+        _mm_storeu_ps (over_samples[2] + i * 4, v2);
+        _mm_storeu_ps (over_samples[3] + i * 4, v3);
+      }
+    store_state (&Channel::x1, x1); store_state (&Channel::x2, x2); store_state (&Channel::x3, x3); store_state (&Channel::x4, x4);
+    store_state (&Channel::y1, y1); store_state (&Channel::y2, y2); store_state (&Channel::y3, y3); store_state (&Channel::y4, y4);
+  }
+public:
+  /* filters must have the same mode and an oversampling factor of 4, unused lanes (n_lanes < LANES) are computed but discarded */
+  static void
+  process_lanes (uint n_lanes, LadderVCF **filters, const Coeffs **coeffs, float **over_samples, uint n_samples)
+  {
+    assert (n_lanes >= 1 && n_lanes <= LANES);
+
+    Channel  dummy_channel {};
+    float    dummy_samples[n_samples * 4 + 1]; // +1: avoid zero sized array
+    std::fill_n (dummy_samples, n_samples * 4, 0.f);
+
+    Channel      *lane_channels[LANES];
+    const Coeffs *lane_coeffs[LANES];
+    float        *lane_samples[LANES];
+    for (uint l = 0; l < LANES; l++)
+      {
+        if (l < n_lanes)
+          {
+            assert (filters[l]->over_ == 4 && filters[l]->mode_ == filters[0]->mode_);
+
+            lane_channels[l] = &filters[l]->channels_[0];
+            lane_coeffs[l]   = coeffs[l];
+            lane_samples[l]  = over_samples[l];
+          }
+        else
+          {
+            lane_channels[l] = &dummy_channel;
+            lane_coeffs[l]   = coeffs[0];
+            lane_samples[l]  = dummy_samples;
+          }
+      }
+    switch (filters[0]->mode_)
+      {
+        case LP1: process_lanes_mode<LP1> (lane_channels, lane_coeffs, lane_samples, n_samples);
+                  break;
+        case LP2: process_lanes_mode<LP2> (lane_channels, lane_coeffs, lane_samples, n_samples);
+                  break;
+        case LP3: process_lanes_mode<LP3> (lane_channels, lane_coeffs, lane_samples, n_samples);
+                  break;
+        case LP4: process_lanes_mode<LP4> (lane_channels, lane_coeffs, lane_samples, n_samples);
+                  break;
+      }
+  }
+#endif
 };
 
 } // SpectMorph
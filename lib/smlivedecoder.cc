@@ -2,11 +2,14 @@
 
 #include "smlivedecoder.hh"
 #include "smlivedecoderfilter.hh"
+#include "smspectralbus.hh"
 #include "smmath.hh"
 #include "smleakdebugger.hh"
 #include "smutils.hh"
 #include "smrtmemory.hh"
 
+#include <algorithm>
+
 #include <stdio.h>
 #include <assert.h>
 
@@ -63,6 +66,7 @@ LiveDecoder::LiveDecoder (float mix_freq) :
   audio (NULL),
   block_size (NoiseDecoder::preferred_block_size (mix_freq)),
   ifft_synth (block_size, mix_freq, IFFTSynth::WIN_HANNING),
+  side_ifft_synth (block_size, mix_freq, IFFTSynth::WIN_HANNING),
   noise_decoder (mix_freq, block_size),
   source (NULL),
   sines_enabled (true),
@@ -86,6 +90,8 @@ LiveDecoder::LiveDecoder (float mix_freq) :
   unison_phases[0].reserve (PARTIAL_STATE_RESERVE * MAX_UNISON_VOICES);
   unison_phases[1].reserve (PARTIAL_STATE_RESERVE * MAX_UNISON_VOICES);
   unison_freq_factor.reserve (MAX_UNISON_VOICES);
+  unison_mid_gain.reserve (MAX_UNISON_VOICES);
+  unison_side_gain.reserve (MAX_UNISON_VOICES);
 
   portamento_state.buffer.reserve (MAX_N_VALUES * 16 /* 4 octaves */ + 256 /* buffer shrink boundary */ + 100);
 
@@ -164,7 +170,10 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity)
       zero_float_block (block_size, &sse_samples[0]);
 
       if (noise_seed != -1)
-        noise_decoder.set_seed (noise_seed);
+        {
+          noise_decoder.set_seed (noise_seed);
+          unison_phase_random_gen.set_seed (noise_seed);
+        }
 
       have_samples = 0;
       pos = 0;
@@ -247,6 +256,282 @@ LiveDecoder::compute_loop_frame_index (size_t frame_idx, Audio *audio)
   return frame_idx;
 }
 
+/*
+ * level of detail: returns the magnitude below which partials of the frame
+ * are not rendered, which is relative to the loudest partial of the frame
+ * (lod_threshold) and/or the magnitude of the strongest lod_max_partials
+ * partials; the loudest partial is always rendered
+ */
+double
+LiveDecoder::lod_cull_mag (const AudioFrameView& frame)
+{
+  double cull_mag = 0;
+
+  if (lod_threshold > 0)
+    {
+      double max_mag = 0;
+      for (size_t partial = 0; partial < frame.n_partials; partial++)
+        max_mag = max (max_mag, frame.mags_f (partial));
+
+      cull_mag = max_mag * min<double> (lod_threshold, 1);
+    }
+  if (lod_max_partials > 0 && frame.n_partials > size_t (lod_max_partials))
+    {
+      RTVector<double> mags (rt_memory_area);
+      mags.set_capacity (frame.n_partials);
+      for (size_t partial = 0; partial < frame.n_partials; partial++)
+        mags.push_back (frame.mags_f (partial));
+
+      /* magnitude of the strongest lod_max_partials partials: partials with equal magnitude are all rendered */
+      double *nth = mags.data() + lod_max_partials - 1;
+      std::nth_element (mags.data(), nth, mags.data() + mags.size(), std::greater<double>());
+
+      cull_mag = max (cull_mag, *nth);
+    }
+  return cull_mag;
+}
+
+/* renders the frame at env_pos into the spectrum of ifft_synth (without inverse fft) */
+bool
+LiveDecoder::render_frame (double want_freq, float portamento_stretch)
+{
+  /* frames before the start of the audio (see start_spectrum) are silent */
+  if (env_pos < 0)
+    return false;
+
+  if (get_loop_type() == Audio::LOOP_TIME_FORWARD)
+    {
+      size_t xenv_pos = env_pos;
+
+      if (xenv_pos > loop_start_scaled)
+        {
+          xenv_pos = (xenv_pos - loop_start_scaled) % (loop_end_scaled - loop_start_scaled);
+          xenv_pos += loop_start_scaled;
+        }
+      frame_idx = xenv_pos / frame_step;
+    }
+  else if (get_loop_type() == Audio::LOOP_FRAME_FORWARD || get_loop_type() == Audio::LOOP_FRAME_PING_PONG)
+    {
+      frame_idx = compute_loop_frame_index (env_pos / frame_step, audio);
+    }
+  else
+    {
+      frame_idx = env_pos / frame_step;
+      if (loop_point != -1 && frame_idx > size_t (loop_point)) /* if in loop mode: loop current frame */
+        frame_idx = loop_point;
+    }
+
+  /* frames from a source are computed into audio_block, frames of the audio are read in place */
+  RTAudioBlock   audio_block (rt_memory_area);
+  AudioFrameView frame;
+  bool           have_frame = false;
+  if (source)
+    {
+      have_frame = source->rt_audio_block (frame_idx, audio_block);
+      if (have_frame)
+        {
+          assert (audio_block.freqs.size() == audio_block.mags.size());
+          frame = audio_block.view();
+        }
+    }
+  else if (frame_idx < audio->frame_count())
+    {
+      frame = audio->frame (frame_idx);
+      have_frame = true;
+    }
+  if (have_frame)
+    {
+      ifft_synth.clear_partials();
+      if (render_side)
+        side_ifft_synth.clear_partials();
+
+      // point n_pstate to pstate[0] and pstate[1] alternately (one holds points to last state and the other points to new state)
+      bool lps_zero = (last_pstate == &pstate[0]);
+      vector<PartialState>& new_pstate = lps_zero ? pstate[1] : pstate[0];
+      const vector<PartialState>& old_pstate = lps_zero ? pstate[0] : pstate[1];
+      vector<float>& unison_new_phases = lps_zero ? unison_phases[1] : unison_phases[0];
+      const vector<float>& unison_old_phases = lps_zero ? unison_phases[0] : unison_phases[1];
+
+      if (unison_voices != 1)
+        {
+          // check unison phases size corresponds to old partial state size
+          assert (unison_voices * old_pstate.size() == unison_old_phases.size());
+        }
+      new_pstate.clear();         // clear old partial state
+      unison_new_phases.clear();  // and old unison phase information
+
+      if (sines_enabled)
+        {
+          /* level of detail: partials below cull_mag keep their phase state, but are not rendered */
+          const double cull_mag = lod_cull_mag (frame);
+
+          const double phase_factor = block_size * M_PI / mix_freq;
+          const double filter_fact = 18000.0 / 44100.0;  // for 44.1 kHz, filter at 18 kHz (higher mix freq => higher filter)
+          const double filter_min_freq = filter_fact * mix_freq;
+
+          // partials are collected first and rendered in one batch
+          const size_t max_partials = frame.n_partials * unison_voices;
+          RTVector<float> ifft_freqs (rt_memory_area), ifft_mags (rt_memory_area), ifft_phases (rt_memory_area);
+          ifft_freqs.set_capacity (max_partials);
+          ifft_mags.set_capacity (max_partials);
+          ifft_phases.set_capacity (max_partials);
+
+          RTVector<float> side_mags (rt_memory_area);
+          if (render_side)
+            side_mags.set_capacity (max_partials);
+
+          size_t old_partial = 0;
+          for (size_t partial = 0; partial < frame.n_partials; partial++)
+            {
+              const double freq = frame.freqs_f (partial) * want_freq;
+
+              // anti alias filter:
+              double mag         = frame.mags_f (partial);
+              double phase       = 0; //atan2 (smag, cmag); FIXME: Does initial phase matter? I think not.
+
+              // portamento:
+              //  - portamento_stretch > 1 means we read out faster
+              //  => this means the aliasing starts at lower frequencies
+              const double portamento_freq = freq * max (portamento_stretch, 1.0f);
+              if (portamento_freq > filter_min_freq)
+                {
+                  double norm_freq = portamento_freq / mix_freq;
+                  if (norm_freq > 0.5)
+                    {
+                      // above nyquist freq -> since partials are sorted, there is nothing more to do for this frame
+                      break;
+                    }
+                  else
+                    {
+                      // between filter_fact and 0.5 (db linear filter)
+                      int index = sm_round_positive (ANTIALIAS_FILTER_TABLE_SIZE * (norm_freq - filter_fact) / (0.5 - filter_fact));
+                      if (index >= 0)
+                        {
+                          if (index < ANTIALIAS_FILTER_TABLE_SIZE)
+                            mag *= antialias_filter_table[index];
+                          else
+                            mag = 0;
+                        }
+                      else
+                        {
+                          // filter magnitude is supposed to be 1.0
+                        }
+                    }
+                }
+
+              /*
+               * increment old_partial as long as there is a better candidate (closer to freq)
+               */
+              bool freq_match = false;
+              if (!old_pstate.empty())
+                {
+                  double best_fdiff = fabs (old_pstate[old_partial].freq - freq);
+
+                  while ((old_partial + 1) < old_pstate.size())
+                    {
+                      double fdiff = fabs (old_pstate[old_partial + 1].freq - freq);
+                      if (fdiff < best_fdiff)
+                        {
+                          old_partial++;
+                          best_fdiff = fdiff;
+                        }
+                      else
+                        {
+                          break;
+                        }
+                    }
+                  const double lfreq = old_pstate[old_partial].freq;
+                  freq_match = fmatch (lfreq, freq);
+                }
+              if (DEBUG)
+                printf ("%d:F %.17g %.17g\n", int (env_pos), freq, mag);
+
+              const bool culled = frame.mags_f (partial) < cull_mag;
+              if (culled)
+                lod_culled_partials++;
+              else
+                lod_rendered_partials++;
+
+              if (unison_voices == 1)
+                {
+                  if (freq_match)
+                    {
+                      // matching freq -> compute new phase
+                      const double lfreq = old_pstate[old_partial].freq;
+                      const double lphase = old_pstate[old_partial].phase;
+
+                      phase = truncate_phase (lphase + lfreq * phase_factor);
+
+                      if (DEBUG)
+                        printf ("%d:L %.17g %.17g %.17g\n", int (env_pos), lfreq, freq, mag);
+                    }
+                  if (!culled)
+                    {
+                      ifft_freqs.push_back (freq);
+                      ifft_mags.push_back (mag);
+                      ifft_phases.push_back (phase);
+                    }
+                }
+              else
+                {
+                  mag *= unison_gain;
+
+                  for (int i = 0; i < unison_voices; i++)
+                    {
+                      if (freq_match)
+                        {
+                          const double lfreq = old_pstate[old_partial].freq;
+                          const double lphase = unison_old_phases[old_partial * unison_voices + i];
+
+                          phase = truncate_phase (lphase + lfreq * phase_factor * unison_freq_factor[i]);
+                        }
+                      else
+                        {
+                          // randomize start phase for unison
+
+                          phase = unison_phase_random_gen.random_double_range (0, 2 * M_PI);
+                        }
+
+                      unison_new_phases.push_back (phase);
+                      if (culled)
+                        continue;
+
+                      ifft_freqs.push_back (freq * unison_freq_factor[i]);
+                      ifft_phases.push_back (phase);
+                      if (render_side)
+                        {
+                          ifft_mags.push_back (mag * unison_mid_gain[i]);
+                          side_mags.push_back (mag * unison_side_gain[i]);
+                        }
+                      else
+                        {
+                          ifft_mags.push_back (mag);
+                        }
+                    }
+                }
+
+              PartialState ps;
+              ps.freq = freq;
+              ps.phase = phase;
+              new_pstate.push_back (ps);
+            }
+          ifft_synth.render_partials (ifft_freqs.size(), ifft_freqs.data(), ifft_mags.data(), ifft_phases.data());
+          if (render_side)
+            side_ifft_synth.render_partials (ifft_freqs.size(), ifft_freqs.data(), side_mags.data(), ifft_phases.data());
+        }
+      last_pstate = &new_pstate;
+
+      if (noise_enabled)
+        noise_decoder.process (frame, ifft_synth.fft_buffer(), NoiseDecoder::FFT_SPECTRUM, portamento_stretch);
+    }
+  else
+    {
+      if (done_state == DoneState::ACTIVE)
+        done_state = DoneState::ALMOST_DONE;
+    }
+  return have_frame;
+}
+
 void
 LiveDecoder::process_internal (size_t n_values, float *audio_out, float portamento_stretch)
 {
@@ -307,199 +592,14 @@ LiveDecoder::process_internal (size_t n_values, float *audio_out, float portamen
     {
       if (have_samples == 0)
         {
-          double want_freq = current_freq;
-
           std::copy (&sse_samples[block_size / 2], &sse_samples[block_size], &sse_samples[0]);
           zero_float_block (block_size / 2, &sse_samples[block_size / 2]);
 
-          if (get_loop_type() == Audio::LOOP_TIME_FORWARD)
-            {
-              size_t xenv_pos = env_pos;
-
-              if (xenv_pos > loop_start_scaled)
-                {
-                  xenv_pos = (xenv_pos - loop_start_scaled) % (loop_end_scaled - loop_start_scaled);
-                  xenv_pos += loop_start_scaled;
-                }
-              frame_idx = xenv_pos / frame_step;
-            }
-          else if (get_loop_type() == Audio::LOOP_FRAME_FORWARD || get_loop_type() == Audio::LOOP_FRAME_PING_PONG)
-            {
-              frame_idx = compute_loop_frame_index (env_pos / frame_step, audio);
-            }
-          else
-            {
-              frame_idx = env_pos / frame_step;
-              if (loop_point != -1 && frame_idx > size_t (loop_point)) /* if in loop mode: loop current frame */
-                frame_idx = loop_point;
-            }
-
-          RTAudioBlock audio_block (rt_memory_area);
-          bool         have_audio_block = false;
-          if (source)
-            {
-              have_audio_block = source->rt_audio_block (frame_idx, audio_block);
-            }
-          else if (frame_idx < audio->contents.size())
-            {
-              audio_block.assign (audio->contents[frame_idx]);
-              have_audio_block = true;
-            }
-          if (have_audio_block)
-            {
-              assert (audio_block.freqs.size() == audio_block.mags.size());
-
-              ifft_synth.clear_partials();
-
-              // point n_pstate to pstate[0] and pstate[1] alternately (one holds points to last state and the other points to new state)
-              bool lps_zero = (last_pstate == &pstate[0]);
-              vector<PartialState>& new_pstate = lps_zero ? pstate[1] : pstate[0];
-              const vector<PartialState>& old_pstate = lps_zero ? pstate[0] : pstate[1];
-              vector<float>& unison_new_phases = lps_zero ? unison_phases[1] : unison_phases[0];
-              const vector<float>& unison_old_phases = lps_zero ? unison_phases[0] : unison_phases[1];
-
-              if (unison_voices != 1)
-                {
-                  // check unison phases size corresponds to old partial state size
-                  assert (unison_voices * old_pstate.size() == unison_old_phases.size());
-                }
-              new_pstate.clear();         // clear old partial state
-              unison_new_phases.clear();  // and old unison phase information
-
-              if (sines_enabled)
-                {
-                  const double phase_factor = block_size * M_PI / mix_freq;
-                  const double filter_fact = 18000.0 / 44100.0;  // for 44.1 kHz, filter at 18 kHz (higher mix freq => higher filter)
-                  const double filter_min_freq = filter_fact * mix_freq;
-
-                  size_t old_partial = 0;
-                  for (size_t partial = 0; partial < audio_block.freqs.size(); partial++)
-                    {
-                      const double freq = audio_block.freqs_f (partial) * want_freq;
-
-                      // anti alias filter:
-                      double mag         = audio_block.mags_f (partial);
-                      double phase       = 0; //atan2 (smag, cmag); FIXME: Does initial phase matter? I think not.
-
-                      // portamento:
-                      //  - portamento_stretch > 1 means we read out faster
-                      //  => this means the aliasing starts at lower frequencies
-                      const double portamento_freq = freq * max (portamento_stretch, 1.0f);
-                      if (portamento_freq > filter_min_freq)
-                        {
-                          double norm_freq = portamento_freq / mix_freq;
-                          if (norm_freq > 0.5)
-                            {
-                              // above nyquist freq -> since partials are sorted, there is nothing more to do for this frame
-                              break;
-                            }
-                          else
-                            {
-                              // between filter_fact and 0.5 (db linear filter)
-                              int index = sm_round_positive (ANTIALIAS_FILTER_TABLE_SIZE * (norm_freq - filter_fact) / (0.5 - filter_fact));
-                              if (index >= 0)
-                                {
-                                  if (index < ANTIALIAS_FILTER_TABLE_SIZE)
-                                    mag *= antialias_filter_table[index];
-                                  else
-                                    mag = 0;
-                                }
-                              else
-                                {
-                                  // filter magnitude is supposed to be 1.0
-                                }
-                            }
-                        }
-
-                      /*
-                       * increment old_partial as long as there is a better candidate (closer to freq)
-                       */
-                      bool freq_match = false;
-                      if (!old_pstate.empty())
-                        {
-                          double best_fdiff = fabs (old_pstate[old_partial].freq - freq);
-
-                          while ((old_partial + 1) < old_pstate.size())
-                            {
-                              double fdiff = fabs (old_pstate[old_partial + 1].freq - freq);
-                              if (fdiff < best_fdiff)
-                                {
-                                  old_partial++;
-                                  best_fdiff = fdiff;
-                                }
-                              else
-                                {
-                                  break;
-                                }
-                            }
-                          const double lfreq = old_pstate[old_partial].freq;
-                          freq_match = fmatch (lfreq, freq);
-                        }
-                      if (DEBUG)
-                        printf ("%d:F %.17g %.17g\n", int (env_pos), freq, mag);
-
-                      if (unison_voices == 1)
-                        {
-                          if (freq_match)
-                            {
-                              // matching freq -> compute new phase
-                              const double lfreq = old_pstate[old_partial].freq;
-                              const double lphase = old_pstate[old_partial].phase;
-
-                              phase = truncate_phase (lphase + lfreq * phase_factor);
-
-                              if (DEBUG)
-                                printf ("%d:L %.17g %.17g %.17g\n", int (env_pos), lfreq, freq, mag);
-                            }
-                          ifft_synth.render_partial (freq, mag, phase);
-                        }
-                      else
-                        {
-                          mag *= unison_gain;
-
-                          for (int i = 0; i < unison_voices; i++)
-                            {
-                              if (freq_match)
-                                {
-                                  const double lfreq = old_pstate[old_partial].freq;
-                                  const double lphase = unison_old_phases[old_partial * unison_voices + i];
-
-                                  phase = truncate_phase (lphase + lfreq * phase_factor * unison_freq_factor[i]);
-                                }
-                              else
-                                {
-                                  // randomize start phase for unison
-
-                                  phase = unison_phase_random_gen.random_double_range (0, 2 * M_PI);
-                                }
-
-                              ifft_synth.render_partial (freq * unison_freq_factor[i], mag, phase);
-
-                              unison_new_phases.push_back (phase);
-                            }
-                        }
-
-                      PartialState ps;
-                      ps.freq = freq;
-                      ps.phase = phase;
-                      new_pstate.push_back (ps);
-                    }
-                }
-              last_pstate = &new_pstate;
-
-              if (noise_enabled)
-                noise_decoder.process (audio_block, ifft_synth.fft_buffer(), NoiseDecoder::FFT_SPECTRUM, portamento_stretch);
-
-              if (noise_enabled || sines_enabled || debug_fft_perf_enabled)
-                {
-                  float *samples = &sse_samples[0];
-                  ifft_synth.get_samples (samples, IFFTSynth::ADD);
-                }
-            }
-          else
+          const bool have_frame = render_frame (current_freq, portamento_stretch);
+          if (have_frame && (noise_enabled || sines_enabled || debug_fft_perf_enabled))
             {
-              if (done_state == DoneState::ACTIVE)
-                done_state = DoneState::ALMOST_DONE;
+              float *samples = &sse_samples[0];
+              ifft_synth.get_samples (samples, IFFTSynth::ADD);
             }
           pos = 0;
           have_samples = block_size / 2;
@@ -705,7 +805,10 @@ LiveDecoder::process_with_filter (size_t n_values, const float *freq_in, float *
 
           filter->process (ramp_len, audio_ramp);
         }
-      filter->process (n_values, audio_out);
+      /* the ramp needs to be filtered immediately, other blocks can be deferred
+       * if the filter has a FilterJob (see FilterBatch)
+       */
+      filter->process (n_values, audio_out, !ramp);
     }
 }
 
@@ -796,6 +899,121 @@ LiveDecoder::process (RTMemoryArea& rt_memory_area, size_t n_values, const float
   in_process = false;
 }
 
+/*
+ * spectral bus mode: called after retrigger(), the first frame added by
+ * process_spectrum() is centered start_offset samples before the start of the
+ * note; this way notes which start within a hop are not moved to the hop grid
+ */
+void
+LiveDecoder::start_spectrum (size_t start_offset)
+{
+  env_pos = double (zero_values_at_start_scaled) - block_size / 2 - start_offset;
+}
+
+/*
+ * spectral bus mode: instead of producing samples, add the spectrum of the
+ * next frame to a spectrum that is shared by many voices
+ *
+ * each call advances by half a block, the caller needs to perform the
+ * inverse fft and overlap-add for the shared spectrum; the frame is weighted
+ * with gain and the attack envelope at the center of the frame, since
+ * sample accurate envelopes can not be applied before the inverse fft
+ *
+ * with unison spread, each unison voice gets its own position in the stereo
+ * field; this only changes the magnitudes of the unison partials (not the
+ * phases), so the frame is rendered as mid and side spectrum, and mixed into
+ * the left and right spectrum of the bus as mid + side and mid - side
+ */
+void
+LiveDecoder::process_spectrum (RTMemoryArea& rt_memory_area, float freq, float gain_left, float gain_right, SpectralBus *bus)
+{
+  if (source)
+    audio = source->audio();  // sources can stop providing audio data while playing
+
+  if (!audio)   // nothing loaded
+    {
+      done_state = DoneState::DONE;
+      return;
+    }
+  /* original samples can only be played by process() */
+  assert (!original_samples_enabled);
+
+  assert (!this->rt_memory_area);
+  this->rt_memory_area = &rt_memory_area;
+
+  assert (!in_process);
+  in_process = true;
+
+  start_env_pos = env_pos;
+  current_freq = freq;
+
+  const bool almost_done = done_state == DoneState::ALMOST_DONE;
+
+  render_side = unison_voices > 1 && unison_spread > 0;
+  const bool have_frame = render_frame (current_freq, 1);
+  if (have_frame && (noise_enabled || sines_enabled))
+    {
+      const double time_ms = (env_pos + block_size / 2) * 1000.0 / mix_freq;
+      if (time_ms < audio->attack_start_ms)
+        {
+          gain_left = 0;
+          gain_right = 0;
+        }
+      else if (time_ms < audio->attack_end_ms)
+        {
+          const double attack = (time_ms - audio->attack_start_ms) / (audio->attack_end_ms - audio->attack_start_ms);
+          gain_left *= attack;
+          gain_right *= attack;
+        }
+
+      const float *frame_spectrum = ifft_synth.fft_buffer();
+      if (render_side)
+        {
+          const float *side_spectrum = side_ifft_synth.fft_buffer();
+          float *left = bus->stereo_spectrum (0);
+          float *right = bus->stereo_spectrum (1);
+
+          for (size_t i = 0; i < block_size; i++)
+            {
+              left[i] += (frame_spectrum[i] + side_spectrum[i]) * gain_left;
+              right[i] += (frame_spectrum[i] - side_spectrum[i]) * gain_right;
+            }
+        }
+      else if (gain_left == gain_right)
+        {
+          if (gain_left != 0)
+            {
+              float *spectrum = bus->center_spectrum();
+
+              for (size_t i = 0; i < block_size; i++)
+                spectrum[i] += frame_spectrum[i] * gain_left;
+            }
+        }
+      else
+        {
+          float *left = bus->stereo_spectrum (0);
+          float *right = bus->stereo_spectrum (1);
+
+          for (size_t i = 0; i < block_size; i++)
+            {
+              left[i] += frame_spectrum[i] * gain_left;
+              right[i] += frame_spectrum[i] * gain_right;
+            }
+        }
+    }
+  else if (!have_frame && almost_done)
+    {
+      /* the last frame has been added to the spectrum one call ago */
+      done_state = DoneState::DONE;
+    }
+  env_pos += block_size / 2;
+  render_side = false;
+
+  rt_memory_area.free_all();
+  this->rt_memory_area = nullptr;
+  in_process = false;
+}
+
 
 void
 LiveDecoder::enable_noise (bool en)
@@ -870,11 +1088,12 @@ LiveDecoder::get_loop_type()
 }
 
 void
-LiveDecoder::set_unison_voices (int voices, float detune)
+LiveDecoder::set_unison_voices (int voices, float detune, float spread)
 {
   assert (voices > 0);
 
   unison_voices = voices;
+  unison_spread = voices > 1 ? spread : 0;
 
   if (voices == 1)
     return;
@@ -896,6 +1115,21 @@ LiveDecoder::set_unison_voices (int voices, float detune)
    */
   unison_gain = 1 / sqrt (voices);
 
+  /* setup stereo positions for unison voices: spread from left to right,
+   * as mid/side gains (left = mid + side, right = mid - side)
+   */
+  unison_mid_gain.resize (voices);
+  unison_side_gain.resize (voices);
+
+  for (int i = 0; i < voices; i++)
+    {
+      float left_gain, right_gain;
+      sm_pan_gains (unison_spread * (2.0 * i / (voices - 1) - 1), &left_gain, &right_gain);
+
+      unison_mid_gain[i] = (left_gain + right_gain) / 2;
+      unison_side_gain[i] = (left_gain - right_gain) / 2;
+    }
+
   /* resize unison phase array to match pstate */
   const bool lps_zero = (last_pstate == &pstate[0]);
   const vector<PartialState>& old_pstate = lps_zero ? pstate[0] : pstate[1];
@@ -914,6 +1148,29 @@ LiveDecoder::set_unison_voices (int voices, float detune)
     }
 }
 
+/*
+ * level of detail: threshold is relative to the loudest partial of each frame
+ * (0 disables culling by magnitude), max_partials limits the number of
+ * partials per frame (0 disables the limit)
+ */
+void
+LiveDecoder::set_lod (float threshold, int max_partials)
+{
+  lod_threshold = threshold;
+  lod_max_partials = max_partials;
+}
+
+/* adds the partial counts since the last call */
+void
+LiveDecoder::collect_lod_stats (uint64& rendered_partials, uint64& culled_partials)
+{
+  rendered_partials += lod_rendered_partials;
+  culled_partials += lod_culled_partials;
+
+  lod_rendered_partials = 0;
+  lod_culled_partials = 0;
+}
+
 void
 LiveDecoder::set_vibrato (bool enabled, float depth, float frequency, float attack)
 {
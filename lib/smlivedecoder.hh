@@ -15,6 +15,7 @@
 namespace SpectMorph {
 
 class LiveDecoderFilter;
+class SpectralBus;
 class LiveDecoder
 {
   static constexpr size_t PARTIAL_STATE_RESERVE = 2048; // maximum number of partials to expect
@@ -41,6 +42,7 @@ class LiveDecoder
 
   size_t              block_size;
   IFFTSynth           ifft_synth;
+  IFFTSynth           side_ifft_synth;  // unison spread: side (left - right) part of the frame
   NoiseDecoder        noise_decoder;
   LiveDecoderSource  *source;
   PolyPhaseInter     *pp_inter;
@@ -70,7 +72,7 @@ class LiveDecoder
   double              original_sample_pos;
   double              original_samples_norm_factor;
 
-  int                 noise_seed;
+  int                 noise_seed;     // fixed seed for noise and unison phases at retrigger, -1: random
 
   AlignedArray<float,16> sse_samples;
 
@@ -79,6 +81,10 @@ class LiveDecoder
   std::vector<float>  unison_phases[2];
   std::vector<float>  unison_freq_factor;
   float               unison_gain;
+  float               unison_spread;
+  std::vector<float>  unison_mid_gain;
+  std::vector<float>  unison_side_gain;
+  bool                render_side = false;
   Random              unison_phase_random_gen;
 
   // vibrato
@@ -89,6 +95,14 @@ class LiveDecoder
   float               vibrato_phase;   // state
   float               vibrato_env;     // state
 
+  // level of detail
+  float               lod_threshold = 0;     // cull partials below threshold * loudest partial (0: off)
+  int                 lod_max_partials = 0;  // render at most this number of partials (0: no limit)
+  uint64              lod_rendered_partials = 0;
+  uint64              lod_culled_partials = 0;
+
+  double lod_cull_mag (const AudioFrameView& frame);
+
   // timing related
   double              start_env_pos = 0;
   bool                in_process    = false;
@@ -103,6 +117,8 @@ class LiveDecoder
 
   Audio::LoopType     get_loop_type();
 
+  bool render_frame (double want_freq, float portamento_stretch);
+
   void process_internal (size_t       n_values,
                          float       *audio_out,
                          float        portamento_stretch);
@@ -134,8 +150,10 @@ public:
   void enable_loop (bool eloop);
   void enable_start_skip (bool ess);
   void set_noise_seed (int seed);
-  void set_unison_voices (int voices, float detune);
+  void set_unison_voices (int voices, float detune, float spread = 0);
   void set_vibrato (bool enable_vibrato, float depth, float frequency, float attack);
+  void set_lod (float threshold, int max_partials);
+  void collect_lod_stats (uint64& rendered_partials, uint64& culled_partials);
   void set_filter (LiveDecoderFilter *filter);
   void set_source (LiveDecoderSource *source);
 
@@ -145,6 +163,12 @@ public:
                 size_t        n_values,
                 const float  *freq_in,
                 float        *audio_out);
+  void start_spectrum (size_t start_offset);
+  void process_spectrum (RTMemoryArea& rt_memory_area,
+                         float         freq,
+                         float         gain_left,
+                         float         gain_right,
+                         SpectralBus  *bus);
 
   double current_pos() const;
   double fundamental_note() const;
@@ -2,6 +2,7 @@
 
 #include "smlivedecoderfilter.hh"
 #include "smmorphoutputmodule.hh"
+#include "smmain.hh"
 
 using namespace SpectMorph;
 
@@ -103,7 +104,7 @@ LiveDecoderFilter::set_config (MorphOutputModule *output_module, const MorphOutp
 }
 
 void
-LiveDecoderFilter::process (size_t n_values, float *audio)
+LiveDecoderFilter::process (size_t n_values, float *audio, bool allow_defer)
 {
   if (!n_values)
     return;
@@ -148,44 +149,85 @@ LiveDecoderFilter::process (size_t n_values, float *audio)
 
   smooth_first = false;
 
-  auto filter_process_block = [&] (auto& filter)
+  auto gen_filter_input = [&] (float *freq_in, float *reso_in, float *drive_in, uint count)
     {
-      auto gen_filter_input = [&] (float *freq_in, float *reso_in, float *drive_in, uint count)
+      envelope.process (freq_in, count);
+      for (uint i = 0; i < count; i++)
         {
-          envelope.process (freq_in, count);
-          for (uint i = 0; i < count; i++)
-            {
-              log_cutoff_smooth.value += log_cutoff_smooth.delta;
-              resonance_smooth.value += resonance_smooth.delta;
-              drive_smooth.value += drive_smooth.delta;
+          log_cutoff_smooth.value += log_cutoff_smooth.delta;
+          resonance_smooth.value += resonance_smooth.delta;
+          drive_smooth.value += drive_smooth.delta;
 
-              freq_in[i] = exp2f (log_cutoff_smooth.value + freq_in[i] * depth_octaves);
-              reso_in[i] = resonance_smooth.value;
-              drive_in[i] = drive_smooth.value;
-            }
-        };
-      const bool const_freq = log_cutoff_smooth.constant && envelope.is_constant();
-      const bool const_reso = resonance_smooth.constant;
-      const bool const_drive = drive_smooth.constant;
+          freq_in[i] = exp2f (log_cutoff_smooth.value + freq_in[i] * depth_octaves);
+          reso_in[i] = resonance_smooth.value;
+          drive_in[i] = drive_smooth.value;
+        }
+    };
+  const bool const_freq = log_cutoff_smooth.constant && envelope.is_constant();
+  const bool const_reso = resonance_smooth.constant;
+  const bool const_drive = drive_smooth.constant;
 
-      if (const_freq && const_reso && const_drive)
+  FilterJob::Segment segment;
+  segment.audio = audio;
+  segment.n_values = n_values;
+  segment.const_params = const_freq && const_reso && const_drive;
+  segment.params_offset = 0;
+
+  if (m_job && allow_defer && m_job->n_segments < FilterJob::MAX_SEGMENTS && m_job->n_params + n_values <= FilterJob::MAX_VALUES)
+    {
+      /* defer filtering: FilterBatch will run the filters of many voices at once */
+      if (segment.const_params)
         {
-          /* use more efficient version of the filter computation if all parameters are constants */
-          float freq, reso, drive;
-          gen_filter_input (&freq, &reso, &drive, 1);
-
-          filter.set_freq (freq);
-          filter.set_reso (reso);
-          filter.set_drive (drive);
-          filter.process_block (n_values, audio);
+          gen_filter_input (&segment.freq, &segment.reso, &segment.drive, 1);
         }
       else
         {
-          /* generic version: pass per-sample values for freq, reso and drive */
-          float freq_in[n_values], reso_in[n_values], drive_in[n_values];
-          gen_filter_input (freq_in, reso_in, drive_in, n_values);
+          segment.params_offset = m_job->n_params;
+          gen_filter_input (m_job->freq_in + m_job->n_params, m_job->reso_in + m_job->n_params, m_job->drive_in + m_job->n_params, n_values);
+          m_job->n_params += n_values;
+        }
+      m_job->segments[m_job->n_segments++] = segment;
+      m_job->filter = this;
+      return;
+    }
+
+  /* segments that have been deferred before need to be processed first */
+  flush_job();
 
-          filter.process_block (n_values, audio, nullptr, freq_in, reso_in, drive_in);
+  if (segment.const_params)
+    {
+      /* use more efficient version of the filter computation if all parameters are constants */
+      gen_filter_input (&segment.freq, &segment.reso, &segment.drive, 1);
+
+      run_segment (segment, nullptr, nullptr, nullptr);
+    }
+  else
+    {
+      /* generic version: pass per-sample values for freq, reso and drive */
+      float freq_in[n_values], reso_in[n_values], drive_in[n_values];
+      gen_filter_input (freq_in, reso_in, drive_in, n_values);
+
+      run_segment (segment, freq_in, reso_in, drive_in);
+    }
+}
+
+void
+LiveDecoderFilter::run_segment (const FilterJob::Segment& segment, const float *freq_in, const float *reso_in, const float *drive_in)
+{
+  auto filter_process_block = [&] (auto& filter)
+    {
+      if (segment.const_params)
+        {
+          filter.set_freq (segment.freq);
+          filter.set_reso (segment.reso);
+          filter.set_drive (segment.drive);
+          filter.process_block (segment.n_values, segment.audio);
+        }
+      else
+        {
+          const uint offset = segment.params_offset;
+
+          filter.process_block (segment.n_values, segment.audio, nullptr, freq_in + offset, reso_in + offset, drive_in + offset);
         }
     };
 
@@ -194,7 +236,116 @@ LiveDecoderFilter::process (size_t n_values, float *audio)
   else
     filter_process_block (sk_filter);
 
-  dc_blocker.process (n_values, audio);
+  dc_blocker.process (segment.n_values, segment.audio);
+}
+
+void
+LiveDecoderFilter::set_job (FilterJob *job)
+{
+  /* segments that are already deferred stay in the old job (which is processed by FilterBatch) */
+  m_job = job;
+}
+
+void
+LiveDecoderFilter::flush_job()
+{
+  if (m_job && m_job->filter)
+    process_jobs (&m_job, 1);
+}
+
+int
+LiveDecoderFilter::batch_mode() const
+{
+  if (filter_type == MorphOutput::FILTER_TYPE_LADDER)
+    return ladder_filter.mode();
+  else
+    return 100 + sk_filter.mode();
+}
+
+template<class Filter> void
+LiveDecoderFilter::process_lanes (FilterJob **jobs, size_t n_jobs, Filter LiveDecoderFilter::*filter_member)
+{
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+  static_assert (FILTER_OVERSAMPLE == 4); // required by Filter::process_lanes
+
+  Filter *filters[BATCH_LANES];
+  for (size_t j = 0; j < n_jobs; j++)
+    filters[j] = &(jobs[j]->filter->*filter_member);
+
+  /* all jobs have the same segment sizes (see FilterBatch::make_groups) */
+  for (uint s = 0; s < jobs[0]->n_segments; s++)
+    {
+      const uint n_values = jobs[0]->segments[s].n_values;
+
+      typename Filter::Coeffs coeffs[n_jobs * n_values];
+      float                   over_samples[n_jobs * n_values * FILTER_OVERSAMPLE];
+
+      const typename Filter::Coeffs *lane_coeffs[BATCH_LANES];
+      float                         *lane_samples[BATCH_LANES];
+      for (size_t j = 0; j < n_jobs; j++)
+        {
+          const FilterJob&          job = *jobs[j];
+          const FilterJob::Segment& segment = job.segments[s];
+          Filter&                   filter = *filters[j];
+
+          lane_coeffs[j] = coeffs + j * n_values;
+          lane_samples[j] = over_samples + j * n_values * FILTER_OVERSAMPLE;
+
+          if (segment.const_params)
+            {
+              filter.set_freq (segment.freq);
+              filter.set_reso (segment.reso);
+              filter.set_drive (segment.drive);
+              filter.compute_coeffs (n_values, coeffs + j * n_values);
+            }
+          else
+            {
+              const uint offset = segment.params_offset;
+
+              filter.compute_coeffs (n_values, coeffs + j * n_values, job.freq_in + offset, job.reso_in + offset, job.drive_in + offset);
+            }
+          filter.upsample (n_values, segment.audio, lane_samples[j]);
+        }
+
+      Filter::process_lanes (n_jobs, filters, lane_coeffs, lane_samples, n_values);
+
+      for (size_t j = 0; j < n_jobs; j++)
+        {
+          float *audio = jobs[j]->segments[s].audio;
+
+          filters[j]->downsample (n_values, lane_samples[j], audio);
+          jobs[j]->filter->dc_blocker.process (n_values, audio);
+        }
+    }
+  for (size_t j = 0; j < n_jobs; j++)
+    jobs[j]->clear_segments();
+#endif
+}
+
+void
+LiveDecoderFilter::process_jobs (FilterJob **jobs, size_t n_jobs)
+{
+  assert (n_jobs >= 1 && n_jobs <= BATCH_LANES);
+
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+  if (n_jobs > 1 && sm_sse())
+    {
+      if (jobs[0]->filter->filter_type == MorphOutput::FILTER_TYPE_LADDER)
+        process_lanes (jobs, n_jobs, &LiveDecoderFilter::ladder_filter);
+      else
+        process_lanes (jobs, n_jobs, &LiveDecoderFilter::sk_filter);
+      return;
+    }
+#endif
+  for (size_t j = 0; j < n_jobs; j++)
+    {
+      FilterJob& job = *jobs[j];
+
+      for (uint s = 0; s < job.n_segments; s++)
+        job.filter->run_segment (job.segments[s], job.freq_in, job.reso_in, job.drive_in);
+
+      job.clear_segments();
+    }
 }
 
 int
@@ -9,6 +9,7 @@
 #include "smlinearsmooth.hh"
 #include "smflexadsr.hh"
 #include "smdcblocker.hh"
+#include "smfilterbatch.hh"
 
 namespace SpectMorph
 {
@@ -40,13 +41,29 @@ class LiveDecoderFilter
   LadderVCF                 ladder_filter { FILTER_OVERSAMPLE };
   SKFilter                  sk_filter { FILTER_OVERSAMPLE };
   DCBlocker                 dc_blocker;
+  FilterJob                *m_job = nullptr;
+
+  void run_segment (const FilterJob::Segment& segment, const float *freq_in, const float *reso_in, const float *drive_in);
+
+  template<class Filter>
+  static void process_lanes (FilterJob **jobs, size_t n_jobs, Filter LiveDecoderFilter::*filter_member);
 
 public:
   LiveDecoderFilter();
 
+  /* number of voices FilterBatch processes at once (one SIMD lane per voice) */
+  static constexpr size_t BATCH_LANES = LadderVCF::LANES;
+  static_assert (SKFilter::LANES == BATCH_LANES);
+
   void retrigger (float note);
   void release();
-  void process (size_t n_values, float *audio);
+  void process (size_t n_values, float *audio, bool allow_defer = false);
+
+  void set_job (FilterJob *job);
+  void flush_job();
+  int  batch_mode() const;
+
+  static void process_jobs (FilterJob **jobs, size_t n_jobs);
 
   void set_config (MorphOutputModule *output_module, const MorphOutput::Config *cfg, float mix_freq);
 
@@ -7,3 +7,9 @@ using SpectMorph::LiveDecoderSource;
 LiveDecoderSource::~LiveDecoderSource()
 {
 }
+
+bool
+LiveDecoderSource::rt_audio_block_id (size_t index, const void **block_id)
+{
+  return false;
+}
@@ -14,6 +14,10 @@ public:
   virtual void retrigger (int channel, float freq, int midi_velocity) = 0;
   virtual Audio *audio() = 0;
   virtual bool rt_audio_block (size_t index, RTAudioBlock& rt_audio_block) = 0;
+
+  /* identify the block rt_audio_block (index) would return without copying it
+   * (nullptr: no block); returns false if the source can't do this */
+  virtual bool rt_audio_block_id (size_t index, const void **block_id);
   virtual ~LiveDecoderSource();
 };
 
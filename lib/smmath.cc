@@ -129,6 +129,27 @@ sm_xparam_inv (double x, double slope)
   return pow (x, 1 / slope);
 }
 
+/*
+ * constant power pan law for pan in [-1, 1]
+ *
+ * the gains are scaled so that a centered source (pan = 0) gets exactly 1.0
+ * for both channels, so centered voices have the same level as in mono output
+ */
+void
+sm_pan_gains (double pan, float *left_gain, float *right_gain)
+{
+  if (pan == 0)
+    {
+      *left_gain = 1;
+      *right_gain = 1;
+      return;
+    }
+  const double angle = (sm_clamp (pan, -1.0, 1.0) + 1) * M_PI / 4;
+
+  *left_gain = M_SQRT2 * cos (angle);
+  *right_gain = M_SQRT2 * sin (angle);
+}
+
 double
 sm_bessel_i0 (double x)
 {
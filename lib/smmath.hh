@@ -529,6 +529,7 @@ float  sm_freq_to_note (float freq);
 
 double sm_bessel_i0 (double x);
 double velocity_to_gain (double velocity, double vrange_db);
+void   sm_pan_gains (double pan, float *left_gain, float *right_gain);
 
 /* FIXME: FILTER: get rid of sm_bound */
 template<typename T>
@@ -8,6 +8,7 @@
 
 #include <arm_neon.h>
 typedef float32x4_t __m128;
+typedef float32x2_t __m64;
 
 static inline __attribute__((always_inline)) __m128 _mm_set_ps(float e3, float e2, float e1, float e0)
 {
@@ -34,6 +35,55 @@ static inline __attribute__((always_inline)) __m128 _mm_sub_ps(__m128 a, __m128
   return vsubq_f32(a, b);
 }
 
+static inline __attribute__((always_inline)) __m128 _mm_div_ps(__m128 a, __m128 b)
+{
+#if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#else
+  alignas(16) float fa[4], fb[4];
+  vst1q_f32(fa, a);
+  vst1q_f32(fb, b);
+  for (int i = 0; i < 4; i++)
+    fa[i] /= fb[i];
+  return vld1q_f32(fa);
+#endif
+}
+
+static inline __attribute__((always_inline)) __m128 _mm_min_ps(__m128 a, __m128 b)
+{
+  return vminq_f32(a, b);
+}
+
+static inline __attribute__((always_inline)) __m128 _mm_max_ps(__m128 a, __m128 b)
+{
+  return vmaxq_f32(a, b);
+}
+
+static inline __attribute__((always_inline)) __m128 _mm_loadu_ps(const float *p)
+{
+  return vld1q_f32(p);
+}
+
+static inline __attribute__((always_inline)) void _mm_storeu_ps(float *p, __m128 a)
+{
+  vst1q_f32(p, a);
+}
+
+static inline __attribute__((always_inline)) __m128 _mm_setzero_ps()
+{
+  return vdupq_n_f32(0.f);
+}
+
+static inline __attribute__((always_inline)) __m128 _mm_loadl_pi(__m128 a, const __m64 *p)
+{
+  return vcombine_f32(vld1_f32(reinterpret_cast<const float *>(p)), vget_high_f32(a));
+}
+
+static inline __attribute__((always_inline)) __m128 _mm_loadh_pi(__m128 a, const __m64 *p)
+{
+  return vcombine_f32(vget_low_f32(a), vld1_f32(reinterpret_cast<const float *>(p)));
+}
+
 static inline __attribute__((always_inline)) __m128 _mm_set_ss(float a)
 {
   return vsetq_lane_f32(a, vdupq_n_f32(0.f), 0);
@@ -49,6 +99,18 @@ static inline __attribute__((always_inline)) __m128 _mm_set_ss(float a)
     shuffle_ps_ret_ = vsetq_lane_f32(vgetq_lane_f32(shuffle_ps_b_, ((imm8) >> 4) & 0x3), shuffle_ps_ret_, 2);  \
     shuffle_ps_ret_ = vsetq_lane_f32(vgetq_lane_f32(shuffle_ps_b_, ((imm8) >> 6) & 0x3), shuffle_ps_ret_, 3);  \
   })
+
+#define _MM_TRANSPOSE4_PS(row0, row1, row2, row3)                                                              \
+  do {                                                                                                         \
+    __m128 transpose_tmp0_ = _mm_shuffle_ps((row0), (row1), _MM_SHUFFLE(1, 0, 1, 0));                          \
+    __m128 transpose_tmp2_ = _mm_shuffle_ps((row0), (row1), _MM_SHUFFLE(3, 2, 3, 2));                          \
+    __m128 transpose_tmp1_ = _mm_shuffle_ps((row2), (row3), _MM_SHUFFLE(1, 0, 1, 0));                          \
+    __m128 transpose_tmp3_ = _mm_shuffle_ps((row2), (row3), _MM_SHUFFLE(3, 2, 3, 2));                          \
+    (row0) = _mm_shuffle_ps(transpose_tmp0_, transpose_tmp1_, _MM_SHUFFLE(2, 0, 2, 0));                        \
+    (row1) = _mm_shuffle_ps(transpose_tmp0_, transpose_tmp1_, _MM_SHUFFLE(3, 1, 3, 1));                        \
+    (row2) = _mm_shuffle_ps(transpose_tmp2_, transpose_tmp3_, _MM_SHUFFLE(2, 0, 2, 0));                        \
+    (row3) = _mm_shuffle_ps(transpose_tmp2_, transpose_tmp3_, _MM_SHUFFLE(3, 1, 3, 1));                        \
+  } while (0)
 #endif
 
 #endif
@@ -0,0 +1,364 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidifile.hh"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+namespace
+{
+
+struct TrackEvent
+{
+  uint64        tick;
+  int           track;
+  size_t        index;      // position in track, for stable ordering of events with the same tick
+  bool          tempo;
+  double        bpm;
+  unsigned char data[3];
+  size_t        size;
+};
+
+class Reader
+{
+  const vector<unsigned char>& m_data;
+  size_t                       m_pos;
+  size_t                       m_end;
+public:
+  Reader (const vector<unsigned char>& data, size_t pos, size_t end) :
+    m_data (data),
+    m_pos (pos),
+    m_end (end)
+  {
+  }
+  bool
+  at_end() const
+  {
+    return m_pos >= m_end;
+  }
+  size_t
+  pos() const
+  {
+    return m_pos;
+  }
+  bool
+  read_byte (unsigned char& byte)
+  {
+    if (m_pos >= m_end)
+      return false;
+    byte = m_data[m_pos++];
+    return true;
+  }
+  bool
+  read_uint (size_t n_bytes, uint32& value)
+  {
+    value = 0;
+    for (size_t i = 0; i < n_bytes; i++)
+      {
+        unsigned char byte;
+        if (!read_byte (byte))
+          return false;
+        value = (value << 8) + byte;
+      }
+    return true;
+  }
+  /* variable length quantity: 7 bits per byte, msb set for all bytes except the last */
+  bool
+  read_var_len (uint32& value)
+  {
+    value = 0;
+    for (int i = 0; i < 4; i++)
+      {
+        unsigned char byte;
+        if (!read_byte (byte))
+          return false;
+        value = (value << 7) + (byte & 0x7f);
+        if ((byte & 0x80) == 0)
+          return true;
+      }
+    return false;
+  }
+  bool
+  skip (size_t n_bytes)
+  {
+    if (n_bytes > m_end - m_pos)
+      return false;
+    m_pos += n_bytes;
+    return true;
+  }
+};
+
+}
+
+static bool
+parse_track (Reader& reader, int track, vector<TrackEvent>& events, uint64& end_tick)
+{
+  uint64        tick = 0;
+  unsigned char running_status = 0;
+  size_t        index = 0;
+
+  while (!reader.at_end())
+    {
+      uint32 delta;
+      if (!reader.read_var_len (delta))
+        return false;
+      tick += delta;
+
+      unsigned char status;
+      if (!reader.read_byte (status))
+        return false;
+
+      TrackEvent event;
+      event.tick = tick;
+      event.track = track;
+      event.index = index++;
+      event.tempo = false;
+      event.bpm = 0;
+      event.data[0] = event.data[1] = event.data[2] = 0;
+      event.size = 0;
+
+      if (status == 0xff)
+        {
+          /* meta event */
+          unsigned char type;
+          uint32 len;
+          if (!reader.read_byte (type) || !reader.read_var_len (len))
+            return false;
+
+          if (type == 0x2f) // end of track
+            {
+              end_tick = std::max (end_tick, tick);
+              return reader.skip (len);
+            }
+
+          if (type == 0x51 && len == 3)
+            {
+              uint32 usec_per_quarter;
+              if (!reader.read_uint (3, usec_per_quarter))
+                return false;
+              if (usec_per_quarter > 0)
+                {
+                  event.tempo = true;
+                  event.bpm = 60e6 / usec_per_quarter;
+                  events.push_back (event);
+                }
+            }
+          else if (!reader.skip (len))
+            {
+              return false;
+            }
+        }
+      else if (status == 0xf0 || status == 0xf7)
+        {
+          /* sysex: ignored, cancels running status */
+          uint32 len;
+          if (!reader.read_var_len (len) || !reader.skip (len))
+            return false;
+          running_status = 0;
+        }
+      else
+        {
+          unsigned char data1;
+          if (status & 0x80)
+            {
+              if (status >= 0xf0) // system common / realtime messages are not allowed in files
+                return false;
+              running_status = status;
+              if (!reader.read_byte (data1))
+                return false;
+            }
+          else
+            {
+              if (!running_status)
+                return false;
+              data1 = status;
+              status = running_status;
+            }
+          event.data[0] = status;
+          event.data[1] = data1;
+          event.size = 2;
+
+          /* program change and channel pressure have only one data byte */
+          const unsigned char type = status & 0xf0;
+          if (type != 0xc0 && type != 0xd0)
+            {
+              if (!reader.read_byte (event.data[2]))
+                return false;
+              event.size = 3;
+            }
+          events.push_back (event);
+        }
+    }
+  /* missing end of track: accept what we have */
+  end_tick = std::max (end_tick, tick);
+  return true;
+}
+
+Error
+MidiFile::parse (const vector<unsigned char>& data)
+{
+  m_events.clear();
+  m_tempos.clear();
+  m_length = 0;
+
+  Reader header (data, 0, data.size());
+
+  uint32 magic, header_len, format, n_tracks, division;
+  if (!header.read_uint (4, magic) || magic != 0x4d546864) // "MThd"
+    return Error (Error::Code::FORMAT_INVALID);
+  if (!header.read_uint (4, header_len) || header_len < 6)
+    return Error (Error::Code::PARSE_ERROR);
+  if (!header.read_uint (2, format) || !header.read_uint (2, n_tracks) || !header.read_uint (2, division))
+    return Error (Error::Code::PARSE_ERROR);
+  if (format > 1)
+    return Error (string_printf ("Unsupported MIDI file format %u", format));
+  if (division & 0x8000)
+    return Error ("SMPTE time division is not supported");
+  if (division == 0)
+    return Error (Error::Code::PARSE_ERROR);
+  if (!header.skip (header_len - 6))
+    return Error (Error::Code::PARSE_ERROR);
+
+  vector<TrackEvent> track_events;
+  size_t pos = header.pos();
+  uint64 end_tick = 0;
+  for (uint32 track = 0; track < n_tracks; track++)
+    {
+      Reader chunk (data, pos, data.size());
+
+      uint32 chunk_type, chunk_len;
+      if (!chunk.read_uint (4, chunk_type) || !chunk.read_uint (4, chunk_len) || chunk_len > data.size() - chunk.pos())
+        return Error (Error::Code::PARSE_ERROR);
+
+      pos = chunk.pos() + chunk_len;
+      if (chunk_type != 0x4d54726b) // "MTrk", unknown chunks must be ignored
+        {
+          track--;
+          continue;
+        }
+      Reader reader (data, chunk.pos(), pos);
+      if (!parse_track (reader, track, track_events, end_tick))
+        return Error (Error::Code::PARSE_ERROR);
+    }
+  std::sort (track_events.begin(), track_events.end(), [] (const TrackEvent& a, const TrackEvent& b) {
+    if (a.tick != b.tick)
+      return a.tick < b.tick;
+    if (a.track != b.track)
+      return a.track < b.track;
+    return a.index < b.index;
+  });
+
+  /* apply tempo map */
+  double tempo_time = 0;
+  uint64 tempo_tick = 0;
+  double bpm = 120;
+
+  auto tick_to_time = [&] (uint64 tick) {
+    return tempo_time + (tick - tempo_tick) * 60 / (bpm * division);
+  };
+  for (const auto& te : track_events)
+    {
+      const double time = tick_to_time (te.tick);
+      const double ppq_pos = double (te.tick) / division;
+
+      if (te.tempo)
+        {
+          tempo_time = time;
+          tempo_tick = te.tick;
+          bpm = te.bpm;
+
+          m_tempos.push_back ({ time, ppq_pos, bpm });
+        }
+      else
+        {
+          Event event;
+          event.time = time;
+          event.ppq_pos = ppq_pos;
+          std::copy (te.data, te.data + 3, event.data);
+          event.size = te.size;
+
+          m_events.push_back (event);
+        }
+    }
+  m_length = tick_to_time (end_tick);
+  return Error::Code::NONE;
+}
+
+Error
+MidiFile::load (const string& filename)
+{
+  FILE *file = fopen (filename.c_str(), "rb");
+  if (!file)
+    return Error::Code::FILE_NOT_FOUND;
+
+  vector<unsigned char> data;
+  vector<unsigned char> buffer (4096);
+  size_t len;
+  do
+    {
+      len = fread (&buffer[0], 1, buffer.size(), file);
+      data.insert (data.end(), buffer.begin(), buffer.begin() + len);
+    }
+  while (len > 0);
+
+  bool read_error = ferror (file);
+  fclose (file);
+
+  if (read_error)
+    return Error (string_printf ("Error reading file '%s'", filename.c_str()));
+
+  return parse (data);
+}
+
+const vector<MidiFile::Event>&
+MidiFile::events() const
+{
+  return m_events;
+}
+
+const vector<MidiFile::Tempo>&
+MidiFile::tempos() const
+{
+  return m_tempos;
+}
+
+double
+MidiFile::tempo_at (double time) const
+{
+  double bpm = 120;
+  for (const auto& tempo : m_tempos)
+    {
+      if (tempo.time > time)
+        break;
+      bpm = tempo.bpm;
+    }
+  return bpm;
+}
+
+double
+MidiFile::ppq_pos_at (double time) const
+{
+  double tempo_time = 0, tempo_ppq_pos = 0, bpm = 120;
+  for (const auto& tempo : m_tempos)
+    {
+      if (tempo.time > time)
+        break;
+      tempo_time = tempo.time;
+      tempo_ppq_pos = tempo.ppq_pos;
+      bpm = tempo.bpm;
+    }
+  return tempo_ppq_pos + (time - tempo_time) * bpm / 60;
+}
+
+/* time of the last event (including end of track) in seconds */
+double
+MidiFile::length() const
+{
+  return m_length;
+}
@@ -0,0 +1,54 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smutils.hh"
+
+#include <vector>
+#include <string>
+
+namespace SpectMorph
+{
+
+/*
+ * Standard MIDI File (format 0 and 1) reader
+ *
+ * all tracks are merged into one list of channel events, sorted by time; the
+ * tempo map is applied, so event times are available in seconds and in
+ * quarter notes (ppq_pos); SMPTE time division is not supported
+ */
+class MidiFile
+{
+public:
+  struct Event
+  {
+    double        time;         // in seconds
+    double        ppq_pos;      // in quarter notes
+    unsigned char data[3];      // channel message (status, data bytes), unused bytes are 0
+    size_t        size;
+  };
+  struct Tempo
+  {
+    double time;
+    double ppq_pos;
+    double bpm;
+  };
+
+private:
+  std::vector<Event> m_events;
+  std::vector<Tempo> m_tempos;
+  double             m_length = 0;
+
+public:
+  Error load (const std::string& filename);
+  Error parse (const std::vector<unsigned char>& data);
+
+  const std::vector<Event>& events() const;
+  const std::vector<Tempo>& tempos() const;
+
+  double tempo_at (double time) const;
+  double ppq_pos_at (double time) const;
+  double length() const;
+};
+
+}
@@ -2,9 +2,11 @@
 
 #include "smmidisynth.hh"
 #include "smmorphoutputmodule.hh"
+#include "smblockutils.hh"
 #include "smdebug.hh"
 
 #include <mutex>
+#include <thread>
 #include <cinttypes>
 
 #include <assert.h>
@@ -18,6 +20,7 @@ using std::string;
 
 #define MIDI_DEBUG(...) Debug::debug ("midi", __VA_ARGS__)
 
+#define SM_MIDI_CTL_PAN           0x0a
 #define SM_MIDI_CTL_SUSTAIN       0x40
 #define SM_MIDI_CTL_ALL_NOTES_OFF 0x7b
 
@@ -28,7 +31,7 @@ using std::string;
 #define SM_MIDI_CTL_CONTROL_4     19
 
 MidiSynth::MidiSynth (double mix_freq, size_t n_voices) :
-  morph_plan_synth (mix_freq, n_voices),
+  morph_plan_synth (mix_freq, std::min<size_t> (n_voices + STEAL_FADE_VOICES, MAX_VOICES)),
   m_inst_edit_synth (mix_freq),
   m_mix_freq (mix_freq),
   m_time_info_gen (mix_freq),
@@ -36,16 +39,25 @@ MidiSynth::MidiSynth (double mix_freq, size_t n_voices) :
   audio_time_stamp (0),
   mono_enabled (false),
   portamento_note_id (0),
-  next_note_id (1)
+  next_note_id (1),
+  m_voice_scheduler (mix_freq)
 {
   assert (n_voices <= MAX_VOICES);
+  m_n_voices = n_voices;
+
+  /* pan/gain changes are smoothed over 10 ms */
+  m_mix_ramp_len = std::max (sm_round_positive (mix_freq * 0.010), 1);
+  m_channel_pan.fill (0);
+
+  /* stolen voices need to be faded out while the new note is already playing */
+  const size_t n_alloc_voices = std::min<size_t> (n_voices + STEAL_FADE_VOICES, MAX_VOICES);
 
   voices.clear();
-  voices.resize (n_voices);
-  active_voices.reserve (n_voices);
+  voices.resize (n_alloc_voices);
+  active_voices.reserve (n_alloc_voices);
   events.reserve (1024);
 
-  for (size_t i = 0; i < n_voices; i++)
+  for (size_t i = 0; i < n_alloc_voices; i++)
     {
       voices[i].mp_voice = morph_plan_synth.voice (i);
       idle_voices.push_back (&voices[i]);
@@ -56,8 +68,56 @@ MidiSynth::MidiSynth (double mix_freq, size_t n_voices) :
 MidiSynth::Voice *
 MidiSynth::alloc_voice()
 {
-  if (idle_voices.empty()) // out of voices?
-    return NULL;
+  /* voice budget exceeded: make room for the new voice by fading out another voice */
+  const int budget = m_voice_scheduler.voice_budget();
+  if (budget >= 0 && playing_voice_count() >= budget)
+    {
+      Voice *victim = find_steal_victim (false);
+      if (victim)
+        {
+          victim->fading = true;
+          m_voice_scheduler.stats().faded_voices++;
+        }
+    }
+  size_t n_stolen = 0;
+  for (Voice *voice : active_voices)
+    {
+      if (voice->stolen)
+        n_stolen++;
+    }
+  if (active_voices.size() - n_stolen >= m_n_voices) // out of voices?
+    {
+      Voice *victim = find_steal_victim (true);
+      if (!victim)
+        return NULL;
+
+      /* steal voice: the new note is more important than the one that is playing,
+       * the old note is faded out (like for the voice budget) to avoid clicks
+       */
+      victim->fading = true;
+      victim->stolen = true;
+
+      m_voice_scheduler.stats().stolen_voices++;
+    }
+  if (idle_voices.empty())
+    {
+      /* more steals than STEAL_FADE_VOICES during one fade: stop a stolen voice immediately */
+      Voice *victim = nullptr;
+      for (Voice *voice : active_voices)
+        {
+          if (voice->stolen)
+            {
+              victim = voice;
+              break;
+            }
+        }
+      if (!victim)
+        return NULL;
+
+      victim->state = Voice::STATE_IDLE;
+      victim->pedal = false;
+      free_unused_voices();
+    }
 
   Voice *voice = idle_voices.back();
   assert (voice->state == Voice::STATE_IDLE);   // every item in idle_voices should be idle
@@ -106,6 +166,93 @@ MidiSynth::active_voice_count() const
   return active_voices.size();
 }
 
+/* voices that are playing and not being faded out (only polyphonic voices can be stolen/faded) */
+int
+MidiSynth::playing_voice_count() const
+{
+  int count = 0;
+  for (Voice *voice : active_voices)
+    {
+      if (voice->mono_type == Voice::MonoType::POLY && voice->state != Voice::STATE_IDLE && !voice->fading)
+        count++;
+    }
+  return count;
+}
+
+MidiSynth::Voice *
+MidiSynth::find_steal_victim (bool include_fading)
+{
+  if (m_voice_scheduler.config().steal_policy == VoiceScheduler::StealPolicy::NONE)
+    return nullptr;
+
+  Voice *victim = nullptr;
+  VoiceScheduler::Candidate victim_candidate;
+  for (Voice *voice : active_voices)
+    {
+      if (voice->mono_type != Voice::MonoType::POLY || voice->state == Voice::STATE_IDLE)
+        continue;
+      if (voice->stolen || (voice->fading && !include_fading))
+        continue;
+
+      /* voices which are fading out or only held by the pedal are stolen first */
+      VoiceScheduler::Candidate candidate;
+      candidate.released = voice->fading || voice->pedal || voice->state == Voice::STATE_RELEASE;
+      candidate.level = voice->fading ? 0 : voice->gain * voice->mp_voice->output()->envelope_level();
+      candidate.note_id = voice->note_id;
+
+      if (!victim || m_voice_scheduler.steal_before (candidate, victim_candidate))
+        {
+          victim = voice;
+          victim_candidate = candidate;
+        }
+    }
+  return victim;
+}
+
+/*
+ * called after each block: if more voices are playing than the voice budget
+ * allows, the next block would miss its deadline; so unison is reduced first
+ * (if enabled), and if that is not enough, voices are faded out
+ */
+void
+MidiSynth::schedule_voices()
+{
+  if (!morph_plan_synth.have_output())
+    return;
+
+  /* level of detail: collect partial counts, update threshold for the next block */
+  VoiceScheduler::Stats& stats = m_voice_scheduler.stats();
+  for (Voice *voice : active_voices)
+    voice->mp_voice->output()->collect_lod_stats (stats.rendered_partials, stats.culled_partials);
+
+  m_lod_threshold = m_voice_scheduler.lod_threshold();
+
+  const int  n_playing = playing_voice_count();
+  const bool have_unison = voices[0].mp_voice->output()->unison();
+
+  if (m_voice_scheduler.update_unison (n_playing, have_unison))
+    m_unison_limit = m_voice_scheduler.unison_reduced() ? 1 : 0;
+
+  /* modules can be replaced by plan updates, so the limit is set for each block */
+  for (Voice *voice : active_voices)
+    voice->mp_voice->output()->set_unison_limit (m_unison_limit);
+
+  const int budget = m_voice_scheduler.voice_budget();
+  if (budget < 0 || n_playing <= budget)
+    return;
+
+  stats.overload_blocks++;
+  for (int i = budget; i < n_playing; i++)
+    {
+      Voice *victim = find_steal_victim (false);
+      if (!victim)
+        break;
+
+      victim->fading = true;
+      stats.faded_voices++;
+    }
+}
+
 float
 MidiSynth::freq_from_note (float note)
 {
@@ -138,6 +285,11 @@ MidiSynth::process_note_on (const NoteEvent& note)
       voice->channel           = note.channel;
       voice->clap_id           = note.clap_id;
       voice->modulation        = global_modulation;
+      voice->pan               = (note.channel >= 0 && note.channel < MIDI_CHANNELS) ? m_channel_pan[note.channel] : 0;
+      voice->fading            = false;
+      voice->stolen            = false;
+      voice->spectral_bus      = false;
+      voice->mix_gain.reset();
 
       const int midi_velocity = std::clamp<int> (lrint (note.velocity * 127), 0, 127);
       if (!mono_enabled)
@@ -146,8 +298,19 @@ MidiSynth::process_note_on (const NoteEvent& note)
 
           voice->mp_voice->set_velocity (note.velocity);
           voice->mono_type = Voice::MonoType::POLY;
+          voice->spectral_bus = m_spectral_bus && output->spectral_bus_ok();
 
+          output->set_unison_limit (m_unison_limit);
+          seed_voice (voice, note);
           output->retrigger (time_info, 0 /* channel */, voice->freq, midi_velocity);
+          if (voice->spectral_bus)
+            {
+              /* offset the frames of the voice so that the note starts exactly
+               * (block_size - 1) samples after the note on event
+               */
+              voice->bus_note_on = audio_time_stamp;
+              output->start_spectrum (m_spectral_bus->hop_size() - 1 - m_spectral_bus->available());
+            }
         }
       else
         {
@@ -170,9 +333,15 @@ MidiSynth::process_note_on (const NoteEvent& note)
                   mono_voice->gain              = voice->gain;
                   mono_voice->channel           = voice->channel;
                   mono_voice->clap_id           = voice->clap_id;
+                  mono_voice->pan               = voice->pan;
+                  mono_voice->fading            = false;
+                  mono_voice->stolen            = false;
+                  mono_voice->mix_gain.reset();
 
                   mono_voice->mono_type = Voice::MonoType::MONO;
+                  mono_voice->spectral_bus = false; // portamento needs sample accurate frequencies
 
+                  seed_voice (mono_voice, note);
                   output->retrigger (time_info, 0 /* channel */, voice->freq, midi_velocity);
                 }
             }
@@ -180,6 +349,30 @@ MidiSynth::process_note_on (const NoteEvent& note)
     }
 }
 
+/*
+ * deterministic rendering: the seed of a voice only depends on the note on event
+ * (not on the voice or on other notes), so the output is the same if notes are
+ * distributed over several MidiSynth instances (see smrender)
+ */
+void
+MidiSynth::seed_voice (Voice *voice, const NoteEvent& note)
+{
+  if (m_random_seed == -1)
+    return;
+
+  uint64 h = m_random_seed;
+  for (uint64 x : { audio_time_stamp, uint64 (note.channel), uint64 (note.key) })
+    {
+      /* splitmix64 finalizer */
+      h = (h ^ x) + 0x9e3779b97f4a7c15ULL;
+      h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+      h = h ^ (h >> 31);
+    }
+  voice->mp_voice->random_gen()->set_seed (h);
+  voice->mp_voice->output()->set_noise_seed ((h >> 32) & 0x7fffffff);
+}
+
 bool
 MidiSynth::update_mono_voice()
 {
@@ -236,6 +429,23 @@ MidiSynth::start_pitch_bend (Voice *voice, double dest_freq, double time_ms)
   voice->pitch_bend_factor = exp (log (dest_freq / voice->pitch_bend_freq) / voice->pitch_bend_steps);
 }
 
+void
+MidiSynth::release_voice (Voice *voice)
+{
+  voice->state = Voice::STATE_RELEASE;
+
+  MorphOutputModule *output_module = voice->mp_voice->output();
+  if (voice->spectral_bus)
+    {
+      /* the envelope of a spectral bus voice runs ahead of the output, so the release is scheduled */
+      output_module->release_spectrum (audio_time_stamp - voice->bus_note_on);
+    }
+  else
+    {
+      output_module->release();
+    }
+}
+
 void
 MidiSynth::process_note_off (int channel, int midi_note)
 {
@@ -270,10 +480,7 @@ MidiSynth::process_note_off (int channel, int midi_note)
             }
           else
             {
-              voice->state = Voice::STATE_RELEASE;
-
-              MorphOutputModule *output_module = voice->mp_voice->output();
-              output_module->release();
+              release_voice (voice);
             }
         }
     }
@@ -305,8 +512,16 @@ MidiSynth::process_mod_value (const ModValueEvent& mod)
 }
 
 void
-MidiSynth::process_midi_controller (int controller, int value)
+MidiSynth::process_midi_controller (int channel, int controller, int value)
 {
+  if (controller == SM_MIDI_CTL_PAN && channel >= 0 && channel < MIDI_CHANNELS)
+    {
+      /* 0 = hard left, 64 = center, 127 = hard right */
+      const float pan = (value - 64) / (value < 64 ? 64.f : 63.f);
+
+      m_channel_pan[channel] = pan;
+      process_pan (channel, -1, pan);
+    }
   if (controller == SM_MIDI_CTL_SUSTAIN)
     {
       pedal_down = value > 0x40;
@@ -317,10 +532,7 @@ MidiSynth::process_midi_controller (int controller, int value)
             {
               if (voice->pedal && voice->state == Voice::STATE_ON)
                 {
-                  voice->state = Voice::STATE_RELEASE;
-
-                  MorphOutputModule *output_module = voice->mp_voice->output();
-                  output_module->release();
+                  release_voice (voice);
                 }
             }
         }
@@ -328,7 +540,7 @@ MidiSynth::process_midi_controller (int controller, int value)
   if (controller == SM_MIDI_CTL_ALL_NOTES_OFF)
     {
       /* release sustain pedal, otherwise note off events will have no effect */
-      process_midi_controller (SM_MIDI_CTL_SUSTAIN, 0);
+      process_midi_controller (channel, SM_MIDI_CTL_SUSTAIN, 0);
 
       /* check which notes are active */
       std::set<std::pair<int, int>> channel_note_set;
@@ -363,6 +575,17 @@ MidiSynth::process_midi_controller (int controller, int value)
     }
 }
 
+/* set pan for all voices of one channel (key == -1) or for one note */
+void
+MidiSynth::process_pan (int channel, int key, float pan)
+{
+  for (auto voice : active_voices)
+    {
+      if (voice->state != Voice::STATE_IDLE && voice->channel == channel && (key == -1 || voice->midi_note == key))
+        voice->pan = std::clamp (pan, -1.f, 1.f);
+    }
+}
+
 void
 MidiSynth::process_pitch_bend (int channel, double semi_tones)
 {
@@ -424,6 +647,18 @@ MidiSynth::add_pitch_expression_event (uint offset, float value, int channel, in
   events.push_back (event);
 }
 
+void
+MidiSynth::add_pan_expression_event (uint offset, float value, int channel, int key)
+{
+  Event event;
+  event.type = EVENT_PAN_EXPRESSION;
+  event.offset = offset;
+  event.expr.channel = channel;
+  event.expr.key = key;
+  event.expr.value = value;
+  events.push_back (event);
+}
+
 void
 MidiSynth::add_modulation_event (uint offset, int i, float value, int clap_id, int channel, int key)
 {
@@ -476,6 +711,7 @@ MidiSynth::add_midi_event (size_t offset, const unsigned char *midi_data)
       Event event;
       event.offset = offset;
       event.type = EVENT_CC;
+      event.cc.channel = channel;
       event.cc.controller = midi_data[1];
       event.cc.value = midi_data[2];
       events.push_back (event);
@@ -487,75 +723,273 @@ MidiSynth::add_midi_event (size_t offset, const unsigned char *midi_data)
 }
 
 void
-MidiSynth::process_audio (float *output, size_t n_values)
+MidiSynth::set_voice_control_inputs (Voice *voice)
+{
+  voice->mp_voice->set_control_input (0, std::clamp (control[0] + voice->modulation[0], -1.f, 1.f));
+  voice->mp_voice->set_control_input (1, std::clamp (control[1] + voice->modulation[1], -1.f, 1.f));
+  voice->mp_voice->set_control_input (2, std::clamp (control[2] + voice->modulation[2], -1.f, 1.f));
+  voice->mp_voice->set_control_input (3, std::clamp (control[3] + voice->modulation[3], -1.f, 1.f));
+}
+
+void
+MidiSynth::set_voice_lod (Voice *voice)
+{
+  /* partials of quiet voices (low velocity) are culled earlier */
+  const double threshold = m_lod_threshold / std::max (voice->gain, 1e-3);
+
+  voice->mp_voice->output()->set_lod (threshold, m_voice_scheduler.config().lod_max_partials);
+}
+
+bool
+MidiSynth::render_voice (Voice *voice, RTMemoryArea& rt_memory_area, float *frequencies, float *samples, size_t n_values, FilterJob *filter_job)
+{
+  if (voice->spectral_bus) // rendered by process_spectral_bus()
+    return false;
+
+  set_voice_control_inputs (voice);
+
+  const float *freq_in = nullptr;
+  if (fabs (voice->pitch_bend_freq - voice->freq) > 1e-3 || voice->pitch_bend_steps > 0)
+    {
+      for (unsigned int i = 0; i < n_values; i++)
+        {
+          frequencies[i] = voice->pitch_bend_freq;
+          if (voice->pitch_bend_steps > 0)
+            {
+              voice->pitch_bend_freq *= voice->pitch_bend_factor;
+              voice->pitch_bend_steps--;
+            }
+        }
+      freq_in = frequencies;
+    }
+  if (voice->mono_type == Voice::MonoType::SHADOW)
+    {
+      /* skip: shadow voices are not rendered */
+    }
+  else if (voice->state == Voice::STATE_ON || voice->state == Voice::STATE_RELEASE)
+    {
+      MorphOutputModule *output_module = voice->mp_voice->output();
+
+      /* need to check done because in some cases voices jump to done state
+       * (i.e. full updates, adsr envelope toggled...) and we don't want
+       * to process these
+       */
+      if (!output_module->done())
+        {
+          float *values[1] = { samples };
+
+          /* with a filter job, filtering (and the envelope) is deferred until process_filter_batch() */
+          set_voice_lod (voice);
+
+          output_module->set_filter_job (filter_job);
+          output_module->process (m_time_info_gen, rt_memory_area, n_values, values, 1, freq_in);
+          output_module->set_filter_job (nullptr);
+          return true;
+        }
+    }
+  else
+    {
+      g_assert_not_reached();
+    }
+  return false;
+}
+
+void
+MidiSynth::RenderTask::render (size_t worker, size_t job)
+{
+  VoiceRenderPool *pool = synth->m_render_pool.get();
+
+  FilterJob *filter_job = synth->m_filter_batch ? synth->m_filter_batch->job (job) : nullptr;
+
+  rendered[job] = synth->render_voice (synth->active_voices[job], pool->rt_memory_area (worker),
+                                       pool->scratch (worker), pool->job_output (job), n_values, filter_job);
+}
+
+void
+MidiSynth::FilterTask::render (size_t worker, size_t group)
+{
+  synth->m_filter_batch->process_group (group);
+}
+
+void
+MidiSynth::MixGain::reset()
+{
+  m_valid = false;
+}
+
+void
+MidiSynth::MixGain::set_target (float left, float right, size_t ramp_len)
+{
+  if (!m_valid)
+    {
+      /* first block: start with the target gain */
+      m_left = m_target_left = left;
+      m_right = m_target_right = right;
+      m_steps = 0;
+      m_valid = true;
+    }
+  else if (left != m_target_left || right != m_target_right)
+    {
+      /* start a new ramp from the current gain */
+      m_target_left = left;
+      m_target_right = right;
+      m_steps = ramp_len;
+    }
+}
+
+/* true if the gain reached zero (for both channels) */
+bool
+MidiSynth::MixGain::silent() const
+{
+  return m_valid && m_steps == 0 && m_left == 0 && m_right == 0;
+}
+
+/* returns the number of values (at most n_values) for which the gain goes linearly from start to end */
+size_t
+MidiSynth::MixGain::ramp (size_t n_values, float *start_left, float *end_left, float *start_right, float *end_right)
+{
+  *start_left = m_left;
+  *start_right = m_right;
+
+  if (m_steps == 0)
+    {
+      *end_left = m_left;
+      *end_right = m_right;
+      return n_values;
+    }
+  const size_t n = std::min (n_values, m_steps);
+  if (n == m_steps)
+    {
+      m_left = m_target_left;
+      m_right = m_target_right;
+    }
+  else
+    {
+      m_left += (m_target_left - m_left) * n / m_steps;
+      m_right += (m_target_right - m_right) * n / m_steps;
+    }
+  m_steps -= n;
+
+  *end_left = m_left;
+  *end_right = m_right;
+  return n;
+}
+
+void
+MidiSynth::mix_voice (Voice *voice, const float *samples, float *out_left, float *out_right, size_t n_values)
+{
+  float pan_left, pan_right;
+  sm_pan_gains (voice->pan, &pan_left, &pan_right);
+
+  if (voice->fading) // stolen by the voice scheduler: fade out
+    voice->mix_gain.set_target (0, 0, m_mix_ramp_len);
+  else
+    voice->mix_gain.set_target (voice->gain * m_gain * pan_left, voice->gain * m_gain * pan_right, m_mix_ramp_len);
+
+  size_t i = 0;
+  while (i < n_values)
+    {
+      float start_left, end_left, start_right, end_right;
+      const size_t n = voice->mix_gain.ramp (n_values - i, &start_left, &end_left, &start_right, &end_right);
+
+      /* mono voice: same input for both channels */
+      Block::mix_stereo (n, out_left + i, out_right + i, samples + i, samples + i, start_left, end_left, start_right, end_right);
+      i += n;
+    }
+}
+
+void
+MidiSynth::process_audio (float *out_left, float *out_right, size_t n_values)
 {
   if (!n_values)    /* this can happen if multiple midi events occur at the same time */
     return;
 
+  static_assert (FilterJob::MAX_VALUES == VoiceRenderPool::MAX_BLOCK_SIZE);
+  if ((m_render_pool || m_filter_batch) && n_values > VoiceRenderPool::MAX_BLOCK_SIZE)
+    {
+      /* the render pool / filter batch buffers have a fixed size, so we split large blocks */
+      const size_t n = VoiceRenderPool::MAX_BLOCK_SIZE;
+
+      process_audio (out_left, out_right, n);
+      process_audio (out_left + n, out_right + n, n_values - n);
+      return;
+    }
+
   bool  need_free = false;
-  float samples[n_values];
-  float *values[1] = { samples };
 
-  zero_float_block (n_values, output);
+  zero_float_block (n_values, out_left);
+  zero_float_block (n_values, out_right);
 
   // prevent crash without output: just return zeros and don't do anything else
   if (!morph_plan_synth.have_output())
     return;
 
-  for (Voice *voice : active_voices)
+  if (m_render_pool || m_filter_batch)
     {
-      voice->mp_voice->set_control_input (0, std::clamp (control[0] + voice->modulation[0], -1.f, 1.f));
-      voice->mp_voice->set_control_input (1, std::clamp (control[1] + voice->modulation[1], -1.f, 1.f));
-      voice->mp_voice->set_control_input (2, std::clamp (control[2] + voice->modulation[2], -1.f, 1.f));
-      voice->mp_voice->set_control_input (3, std::clamp (control[3] + voice->modulation[3], -1.f, 1.f));
-
-      const float gain = voice->gain * m_gain;
-      const float *freq_in = nullptr;
-      float frequencies[n_values];
-      if (fabs (voice->pitch_bend_freq - voice->freq) > 1e-3 || voice->pitch_bend_steps > 0)
-        {
-          for (unsigned int i = 0; i < n_values; i++)
-            {
-              frequencies[i] = voice->pitch_bend_freq;
-              if (voice->pitch_bend_steps > 0)
-                {
-                  voice->pitch_bend_freq *= voice->pitch_bend_factor;
-                  voice->pitch_bend_steps--;
-                }
-            }
-          freq_in = frequencies;
-        }
-      if (voice->mono_type == Voice::MonoType::SHADOW)
+      /* render voices in parallel and/or batch the filters, but sum them in
+       * active_voices order to produce the same output as the serial code below
+       */
+      if (m_render_pool)
         {
-          /* skip: shadow voices are not rendered */
+          m_render_task.synth = this;
+          m_render_task.n_values = n_values;
+          m_render_pool->run (&m_render_task, active_voices.size());
         }
-      else if (voice->state == Voice::STATE_ON || voice->state == Voice::STATE_RELEASE)
+      else
         {
-          MorphOutputModule *output_module = voice->mp_voice->output();
+          float frequencies[n_values];
 
-          /* need to check done because in some cases voices jump to done state
-           * (i.e. full updates, adsr envelope toggled...) and we don't want
-           * to process these
-           */
-          if (!output_module->done())
+          for (size_t v = 0; v < active_voices.size(); v++)
             {
-              output_module->process (m_time_info_gen, m_rt_memory_area, n_values, values, 1, freq_in);
-              for (size_t i = 0; i < n_values; i++)
-                output[i] += samples[i] * gain;
+              m_render_task.rendered[v] = render_voice (active_voices[v], m_rt_memory_area, frequencies,
+                                                        m_filter_batch->job_output (v), n_values, m_filter_batch->job (v));
             }
+        }
+      if (m_filter_batch)
+        process_filter_batch();
 
-          if (output_module->done())
+      for (size_t v = 0; v < active_voices.size(); v++)
+        {
+          if (m_render_task.rendered[v])
             {
-              /* envelope reached zero -> voice can be reused later */
-              voice->state = Voice::STATE_IDLE;
-              voice->pedal = false;
+              m_voice_values += n_values;
 
-              need_free = true; // need to recompute active_voices and idle_voices vectors
+              const float *samples = m_render_pool ? m_render_pool->job_output (v) : m_filter_batch->job_output (v);
+
+              mix_voice (active_voices[v], samples, out_left, out_right, n_values);
             }
         }
-      else
+    }
+  else
+    {
+      float samples[n_values];
+      float frequencies[n_values];
+
+      for (Voice *voice : active_voices)
+        {
+          if (render_voice (voice, m_rt_memory_area, frequencies, samples, n_values, nullptr))
+            {
+              m_voice_values += n_values;
+              mix_voice (voice, samples, out_left, out_right, n_values);
+            }
+        }
+    }
+  if (m_spectral_bus)
+    process_spectral_bus (out_left, out_right, n_values);
+
+  for (Voice *voice : active_voices)
+    {
+      if (voice->mono_type == Voice::MonoType::SHADOW)
+        continue;
+
+      /* envelope reached zero or fade out done -> voice can be reused later */
+      const bool fade_done = voice->fading && (voice->spectral_bus || voice->mix_gain.silent());
+      if (fade_done || voice->mp_voice->output()->done())
         {
-          g_assert_not_reached();
+          voice->state = Voice::STATE_IDLE;
+          voice->pedal = false;
+
+          need_free = true; // need to recompute active_voices and idle_voices vectors
         }
     }
   if (need_free)
@@ -565,8 +999,114 @@ MidiSynth::process_audio (float *output, size_t n_values)
   m_time_info_gen.update_time_stamp (audio_time_stamp);
 }
 
+/*
+ * filter batch: render_voice() only records the filter work of each voice,
+ * the filters are then processed for groups of voices at once (one SIMD lane
+ * per voice), optionally using the render pool threads for the groups
+ */
+void
+MidiSynth::process_filter_batch()
+{
+  m_filter_batch->clear();
+  for (size_t v = 0; v < active_voices.size(); v++)
+    {
+      FilterJob *job = m_filter_batch->job (v);
+      if (job->filter)
+        m_filter_batch->add_pending (job);
+    }
+  const size_t n_groups = m_filter_batch->make_groups();
+
+  if (m_render_pool)
+    {
+      m_filter_task.synth = this;
+      m_render_pool->run (&m_filter_task, n_groups);
+    }
+  else
+    {
+      for (size_t g = 0; g < n_groups; g++)
+        m_filter_batch->process_group (g);
+    }
+}
+
+/*
+ * spectral bus: voices on the bus add their spectra to one shared spectrum
+ * at each hop boundary, so the number of inverse ffts per hop is one,
+ * independent of the number of voices
+ *
+ * voices join the bus at the next hop boundary after the note on event, but
+ * their frames are offset by the position of the note on event within the hop,
+ * so every note starts (and is released) exactly block_size - 1 samples after
+ * its event; envelope and pan are updated once per hop (the overlapping
+ * frames interpolate between the hops)
+ */
+void
+MidiSynth::process_spectral_bus (float *out_left, float *out_right, size_t n_values)
+{
+  const size_t hop_size = m_spectral_bus->hop_size();
+
+  m_spectral_bus_gain.set_target (m_gain, m_gain, m_mix_ramp_len);
+
+  size_t i = 0;
+  while (i < n_values)
+    {
+      if (m_spectral_bus->need_hop())
+        {
+          /* modules evaluated for this hop should see the time of the hop boundary */
+          m_time_info_gen.update_time_stamp (audio_time_stamp + i);
+
+          m_spectral_bus->begin_hop();
+          for (Voice *voice : active_voices)
+            {
+              /* fading voices are removed from the bus immediately, the overlapping frames fade them out */
+              if (!voice->spectral_bus || voice->state == Voice::STATE_IDLE || voice->fading)
+                continue;
+
+              MorphOutputModule *output_module = voice->mp_voice->output();
+              if (output_module->done())
+                continue;
+
+              /* frequency is updated once per hop */
+              const float freq = voice->pitch_bend_freq;
+              for (size_t s = 0; s < hop_size && voice->pitch_bend_steps > 0; s++)
+                {
+                  voice->pitch_bend_freq *= voice->pitch_bend_factor;
+                  voice->pitch_bend_steps--;
+                }
+              set_voice_control_inputs (voice);
+              set_voice_lod (voice);
+
+              float pan_left, pan_right;
+              sm_pan_gains (voice->pan, &pan_left, &pan_right);
+
+              output_module->process_spectrum (m_time_info_gen, m_rt_memory_area, hop_size, freq,
+                                               voice->gain * pan_left, voice->gain * pan_right, m_spectral_bus.get());
+              m_voice_values += hop_size;
+            }
+          m_spectral_bus->end_hop();
+        }
+      float start_left, end_left, start_right, end_right;
+      const size_t n = m_spectral_bus_gain.ramp (std::min (n_values - i, m_spectral_bus->available()),
+                                                 &start_left, &end_left, &start_right, &end_right);
+
+      i += m_spectral_bus->read (n, out_left + i, out_right + i, start_left, end_left, start_right, end_right);
+    }
+  m_time_info_gen.update_time_stamp (audio_time_stamp);
+}
+
+/* mono output: downmix of the stereo output (which is identical to left and right for centered voices) */
 void
 MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_callbacks)
+{
+  float right[n_values + AVOID_ARRAY_UB];
+
+  process (output, right, n_values, process_callbacks);
+
+  for (size_t i = 0; i < n_values; i++)
+    output[i] = (output[i] + right[i]) * 0.5f;
+}
+
+void
+MidiSynth::process (float *out_left, float *out_right, size_t n_values, MidiSynthCallbacks *process_callbacks)
 {
   if (inst_edit) // inst edit mode? -> delegate
     {
@@ -583,13 +1123,17 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
         }
       events.clear();
 
-      m_inst_edit_synth.process (output, n_values, m_rt_memory_area, m_notify_buffer, process_callbacks);
+      m_inst_edit_synth.process (out_left, n_values, m_rt_memory_area, m_notify_buffer, process_callbacks);
+      std::copy_n (out_left, n_values, out_right);
       return;
     }
 
   assert (m_process_callbacks == nullptr);
   m_process_callbacks = process_callbacks;
 
+  const double start_time = get_time();
+  m_voice_values = 0;
+
   uint32_t offset = 0;
 
   m_time_info_gen.start_block (audio_time_stamp, n_values, m_ppq_pos, m_tempo);
@@ -613,7 +1157,7 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
       uint32_t new_offset = min <uint32_t> (event.offset, n_values);
 
       // process any audio that is before the event
-      process_audio (output + offset, new_offset - offset);
+      process_audio (out_left + offset, out_right + offset, new_offset - offset);
       offset = new_offset;
 
       switch (event.type)
@@ -664,6 +1208,14 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
                 }
             }
             break;
+          case EVENT_PAN_EXPRESSION:
+            {
+              MIDI_DEBUG ("%" PRIu64 " | pan expression event: channel %d, note %d, pan %.2f\n",
+                          audio_time_stamp, event.expr.channel, event.expr.key, event.expr.value);
+
+              process_pan (event.expr.channel, event.expr.key, event.expr.value);
+            }
+            break;
           case EVENT_PITCH_BEND:
             {
               const MorphOutputModule *output = voices[0].mp_voice->output();
@@ -675,21 +1227,24 @@ MidiSynth::process (float *output, size_t n_values, MidiSynthCallbacks *process_
             break;
           case EVENT_CC:
             {
-              MIDI_DEBUG ("%" PRIu64 " | controller event, %d %d\n", audio_time_stamp, event.cc.controller, event.cc.value);
-              process_midi_controller (event.cc.controller, event.cc.value);
+              MIDI_DEBUG ("%" PRIu64 " | controller event, channel %d, %d %d\n", audio_time_stamp, event.cc.channel, event.cc.controller, event.cc.value);
+              process_midi_controller (event.cc.channel, event.cc.controller, event.cc.value);
             }
             break;
         }
     }
 
   // process frames after last event
-  process_audio (output + offset, n_values - offset);
+  process_audio (out_left + offset, out_right + offset, n_values - offset);
 
   events.clear();
 
   m_ppq_pos += n_values * m_tempo / (60. * m_mix_freq);
   m_process_callbacks = nullptr;
 
+  m_voice_scheduler.add_block (get_time() - start_time, n_values, m_voice_values);
+  schedule_voices();
+
   notify_active_voice_status();
 }
 
@@ -792,6 +1347,102 @@ MidiSynth::set_control_by_cc (bool control_by_cc)
   m_control_by_cc = control_by_cc;
 }
 
+void
+MidiSynth::set_render_threads (size_t n_threads)
+{
+  /* not rt safe, needs to be called when synthesis thread is not running */
+  n_threads = std::min<size_t> (n_threads, std::max (std::thread::hardware_concurrency(), 1u));
+  if (n_threads > 1)
+    m_render_pool.reset (new VoiceRenderPool (n_threads, voices.size()));
+  else
+    m_render_pool.reset();
+}
+
+size_t
+MidiSynth::render_threads() const
+{
+  return m_render_pool ? m_render_pool->n_workers() : 1;
+}
+
+void
+MidiSynth::set_spectral_bus (bool enable)
+{
+  /* not rt safe, needs to be called when synthesis thread is not running */
+  if (enable && !m_spectral_bus)
+    m_spectral_bus.reset (new SpectralBus (m_mix_freq));
+
+  if (!enable)
+    {
+      m_spectral_bus.reset();
+
+      /* voices that are still active continue without bus */
+      for (auto& voice : voices)
+        voice.spectral_bus = false;
+    }
+}
+
+bool
+MidiSynth::spectral_bus() const
+{
+  return m_spectral_bus != nullptr;
+}
+
+void
+MidiSynth::set_filter_batch (bool enable)
+{
+  /* not rt safe, needs to be called when synthesis thread is not running */
+  if (enable && !m_filter_batch)
+    m_filter_batch.reset (new FilterBatch (voices.size()));
+
+  if (!enable)
+    m_filter_batch.reset();
+}
+
+bool
+MidiSynth::filter_batch() const
+{
+  return m_filter_batch != nullptr;
+}
+
+void
+MidiSynth::set_voice_scheduler_config (const VoiceScheduler::Config& config)
+{
+  /* unison limit is updated by schedule_voices() */
+  m_voice_scheduler.set_config (config);
+
+  m_lod_threshold = m_voice_scheduler.lod_threshold();
+}
+
+/*
+ * fixed seed for noise, unison phases and LFOs (-1: random), for reproducible
+ * output; like MorphPlanSynth::set_random_seed, this needs to be set before the
+ * first update
+ */
+void
+MidiSynth::set_random_seed (int seed)
+{
+  m_random_seed = seed;
+  morph_plan_synth.set_random_seed (seed);
+}
+
+const VoiceScheduler::Config&
+MidiSynth::voice_scheduler_config() const
+{
+  return m_voice_scheduler.config();
+}
+
+void
+MidiSynth::block_cache_stats (uint64& hits, uint64& misses) const
+{
+  morph_plan_synth.block_cache_stats (hits, misses);
+}
+
+void
+MidiSynth::invalidate_block_caches()
+{
+  morph_plan_synth.invalidate_block_caches();
+}
+
 void
 MidiSynth::notify_active_voice_status()
 {
@@ -833,7 +1484,23 @@ MidiSynth::notify_active_voice_status()
 
           m_notify_buffer.write_seq (control_input_seq, n_voices);
         }
+
+      VoiceScheduler::Stats& stats = m_voice_scheduler.stats();
+
+      m_notify_buffer.write_int (VOICE_SCHEDULER_EVENT);
+      m_notify_buffer.write_float (m_voice_scheduler.load());
+      m_notify_buffer.write_int (m_voice_scheduler.voice_budget());
+      m_notify_buffer.write_int (stats.stolen_voices);
+      m_notify_buffer.write_int (stats.faded_voices);
+      m_notify_buffer.write_int (stats.overload_blocks);
+      m_notify_buffer.write_int (m_voice_scheduler.unison_reduced());
+
+      const uint64 n_partials = stats.rendered_partials + stats.culled_partials;
+      m_notify_buffer.write_float (n_partials ? stats.culled_partials / double (n_partials) : 0);
+      m_notify_buffer.write_float (m_voice_scheduler.lod_boost_db());
       m_notify_buffer.end_write();
+
+      stats = VoiceScheduler::Stats(); // counts are reported since the last event
     }
 }
 
@@ -854,6 +1521,7 @@ SynthNotifyEvent::create (NotifyBuffer& buffer)
       case INST_EDIT_VOICE_EVENT:     return new InstEditVoiceEvent (buffer);
       case VOICE_OP_VALUES_EVENT:     return new VoiceOpValuesEvent (buffer);
       case ACTIVE_VOICE_STATUS_EVENT: return new ActiveVoiceStatusEvent (buffer);
+      case VOICE_SCHEDULER_EVENT:     return new VoiceSchedulerEvent (buffer);
       default:                        printf ("unsupported SynthNotifyEvent %d\n", type);
     }
   return nullptr;
@@ -7,6 +7,10 @@
 #include "smnotifybuffer.hh"
 #include "sminsteditsynth.hh"
 #include "smrtmemory.hh"
+#include "smvoicerenderpool.hh"
+#include "smspectralbus.hh"
+#include "smfilterbatch.hh"
+#include "smvoicescheduler.hh"
 
 #include <array>
 
@@ -32,6 +36,7 @@ private:
     EVENT_CONTROL_VALUE,
     EVENT_MOD_VALUE,
     EVENT_PITCH_EXPRESSION,
+    EVENT_PAN_EXPRESSION,
     EVENT_PITCH_BEND,
     EVENT_CC
   };
@@ -69,6 +74,7 @@ private:
   };
   struct CCEvent
   {
+    int   channel;
     int   controller;
     int   value;
   };
@@ -79,7 +85,7 @@ private:
 
     union {
       NoteEvent       note;       // EVENT_NOTE_ON, EVENT_NOTE_OFF
-      ExpressionEvent expr;       // EVENT_PITCH_EXPRESSION
+      ExpressionEvent expr;       // EVENT_PITCH_EXPRESSION, EVENT_PAN_EXPRESSION
       ValueEvent      value;      // EVENT_CONTROL_VALUE
       ModValueEvent   mod;        // EVENT_MOD_VALUE
       PitchBendEvent  pitch_bend; // EVENT_PITCH_BEND
@@ -90,6 +96,26 @@ private:
 
   typedef std::array<float, MorphPlan::N_CONTROL_INPUTS> ModArray;
 
+  /*
+   * gain of a stereo mixer input: whenever the target gain changes, the gain
+   * is ramped linearly to the new target (to avoid zipper noise)
+   */
+  class MixGain
+  {
+    float  m_left = 0;
+    float  m_right = 0;
+    float  m_target_left = 0;
+    float  m_target_right = 0;
+    size_t m_steps = 0;       // remaining values of the current ramp
+    bool   m_valid = false;
+
+  public:
+    void   reset();
+    bool   silent() const;
+    void   set_target (float left, float right, size_t ramp_len);
+    size_t ramp (size_t n_values, float *start_left, float *end_left, float *start_right, float *end_right);
+  };
+
   class Voice
   {
   public:
@@ -117,13 +143,24 @@ private:
     int          pitch_bend_steps;
     int          note_id;
     int          clap_id;
+    float        pan;           // -1 (left) ... 1 (right)
+    MixGain      mix_gain;
+    bool         fading;        // fade out started by the voice scheduler
+    bool         stolen;        // fading out because the voice was taken for a new note
+    bool         spectral_bus;  // rendered by the spectral bus (not by render_voice)
+    uint64       bus_note_on;   // spectral bus: time stamp of the note on event
 
     ModArray     modulation;
 
     Voice() :
       mp_voice (NULL),
       state (STATE_IDLE),
-      pedal (false)
+      pedal (false),
+      pan (0),
+      fading (false),
+      stolen (false),
+      spectral_bus (false),
+      bus_note_on (0)
     {
       modulation.fill (0);
     }
@@ -133,7 +170,26 @@ private:
     }
   };
 
+public:
   constexpr static int  MAX_VOICES = 256;
+private:
+  constexpr static int  MIDI_CHANNELS = 16;
+  constexpr static int  STEAL_FADE_VOICES = 4;  // extra voices to fade out stolen notes
+
+  struct RenderTask : public VoiceRenderPool::Task
+  {
+    MidiSynth                   *synth = nullptr;
+    size_t                       n_values = 0;
+    std::array<bool, MAX_VOICES> rendered;
+
+    void render (size_t worker, size_t job) override;
+  };
+  struct FilterTask : public VoiceRenderPool::Task
+  {
+    MidiSynth                   *synth = nullptr;
+
+    void render (size_t worker, size_t group) override;
+  };
 
   MorphPlanSynth        morph_plan_synth;
   InstEditSynth         m_inst_edit_synth;
@@ -141,6 +197,7 @@ private:
   std::vector<Voice>    voices;
   std::vector<Voice *>  idle_voices;
   std::vector<Voice *>  active_voices;
+  size_t                m_n_voices;       // polyphony (voices.size() includes voices for steal fades)
   ModArray              global_modulation;
   double                m_mix_freq;
   double                m_gain = 1;
@@ -159,19 +216,49 @@ private:
   NotifyBuffer          m_notify_buffer;
   MidiSynthCallbacks   *m_process_callbacks = nullptr;
 
+  std::unique_ptr<VoiceRenderPool> m_render_pool;
+  RenderTask            m_render_task;
+
+  std::unique_ptr<SpectralBus> m_spectral_bus;
+  MixGain               m_spectral_bus_gain;
+
+  std::array<float, MIDI_CHANNELS> m_channel_pan;
+  size_t                m_mix_ramp_len;
+
+  VoiceScheduler        m_voice_scheduler;
+  size_t                m_voice_values = 0;   // values rendered by voices in the current block
+  int                   m_unison_limit = 0;
+  double                m_lod_threshold = 0;  // level of detail threshold for voices at full level
+  int                   m_random_seed = -1;
+
+  std::unique_ptr<FilterBatch> m_filter_batch;
+  FilterTask            m_filter_task;
+
   std::vector<float>    control = std::vector<float> (MorphPlan::N_CONTROL_INPUTS);
 
   Voice  *alloc_voice();
+  Voice  *find_steal_victim (bool include_fading);
+  int     playing_voice_count() const;
+  void    schedule_voices();
   void    free_unused_voices();
   bool    update_mono_voice();
   float   freq_from_note (float note);
   void    notify_active_voice_status();
+  void    seed_voice (Voice *voice, const NoteEvent& note);
 
   void set_mono_enabled (bool new_value);
-  void process_audio (float *output, size_t n_values);
+  void process_audio (float *out_left, float *out_right, size_t n_values);
+  void process_spectral_bus (float *out_left, float *out_right, size_t n_values);
+  void mix_voice (Voice *voice, const float *samples, float *out_left, float *out_right, size_t n_values);
+  void process_filter_batch();
+  void set_voice_control_inputs (Voice *voice);
+  void set_voice_lod (Voice *voice);
+  bool render_voice (Voice *voice, RTMemoryArea& rt_memory_area, float *frequencies, float *samples, size_t n_values, FilterJob *filter_job);
   void process_note_on (const NoteEvent& note);
+  void release_voice (Voice *voice);
   void process_note_off (int channel, int midi_note);
-  void process_midi_controller (int controller, int value);
+  void process_midi_controller (int channel, int controller, int value);
+  void process_pan (int channel, int key, float pan);
   void process_pitch_bend (int channel, double semi_tones);
   void process_mod_value (const ModValueEvent& mod);
   void start_pitch_bend (Voice *voice, double dest_freq, double time_ms);
@@ -182,11 +269,13 @@ public:
 
   void add_midi_event (size_t offset, const unsigned char *midi_data);
   void process (float *output, size_t n_values, MidiSynthCallbacks *process_callbacks = nullptr);
+  void process (float *out_left, float *out_right, size_t n_values, MidiSynthCallbacks *process_callbacks = nullptr);
 
   void add_note_on_event (uint offset, int clap_id, int channel, int key, float velocity);
   void add_note_off_event (uint offset, int channel, int key);
   void add_control_input_event (uint offset, int i, float value);
   void add_pitch_expression_event (uint offset, float value, int channel, int key);
+  void add_pan_expression_event (uint offset, float value, int channel, int key);
   void add_modulation_event (uint offset, int i, float value, int clap_id, int channel, int key);
 
   void set_control_input (int i, float value);
@@ -202,6 +291,17 @@ public:
   void set_inst_edit (bool inst_edit);
   void set_gain (double gain);
   void set_control_by_cc (bool control_by_cc);
+  void set_render_threads (size_t n_threads);
+  size_t render_threads() const;
+  void set_spectral_bus (bool enable);
+  bool spectral_bus() const;
+  void set_filter_batch (bool enable);
+  bool filter_batch() const;
+  void set_voice_scheduler_config (const VoiceScheduler::Config& config);
+  const VoiceScheduler::Config& voice_scheduler_config() const;
+  void set_random_seed (int seed);
+  void block_cache_stats (uint64& hits, uint64& misses) const;
+  void invalidate_block_caches();
   InstEditSynth *inst_edit_synth();
   NotifyBuffer *notify_buffer();
 };
@@ -221,7 +321,8 @@ enum NotifyEventType
 {
   INST_EDIT_VOICE_EVENT = 748293, // some random number
   VOICE_OP_VALUES_EVENT,
-  ACTIVE_VOICE_STATUS_EVENT
+  ACTIVE_VOICE_STATUS_EVENT,
+  VOICE_SCHEDULER_EVENT
 };
 
 struct InstEditVoiceEvent : public SynthNotifyEvent
@@ -271,6 +372,29 @@ struct ActiveVoiceStatusEvent : public SynthNotifyEvent
   std::vector<float>     control[MorphPlan::N_CONTROL_INPUTS];
 };
 
+struct VoiceSchedulerEvent : public SynthNotifyEvent
+{
+  VoiceSchedulerEvent (NotifyBuffer& buffer) :
+    load (buffer.read_float()),
+    voice_budget (buffer.read_int()),
+    stolen_voices (buffer.read_int()),
+    faded_voices (buffer.read_int()),
+    overload_blocks (buffer.read_int()),
+    unison_reduced (buffer.read_int()),
+    culled_partials (buffer.read_float()),
+    lod_boost_db (buffer.read_float())
+  {
+  }
+  float load;             // render time / audio time of the last block
+  int   voice_budget;     // -1: no limit
+  int   stolen_voices;    // counts since the last event
+  int   faded_voices;
+  int   overload_blocks;
+  bool  unison_reduced;
+  float culled_partials;  // fraction of partials culled since the last event (level of detail)
+  float lod_boost_db;
+};
+
 }
 
 #endif /* SPECTMORPH_MIDI_SYNTH_HH */
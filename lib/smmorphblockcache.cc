@@ -0,0 +1,242 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmorphblockcache.hh"
+
+#include <cstring>
+
+using namespace SpectMorph;
+
+MorphBlockCache::MorphBlockCache() :
+  m_entries (MAX_ENTRIES),
+  m_hash (HASH_SIZE, -1),
+  m_data (MAX_ENTRIES * SLOT_SIZE)
+{
+  clear();
+}
+
+MorphBlockCache::~MorphBlockCache()
+{
+}
+
+void
+MorphBlockCache::invalidate()
+{
+  /* called in the audio thread if the config or the wav sets changed: if we
+   * can't get the lock, the next lookup() or insert() clears the cache
+   */
+  m_clear_pending.store (true);
+  if (try_lock()) // clears the cache
+    unlock();
+}
+
+/* must be called with lock held */
+void
+MorphBlockCache::clear()
+{
+  m_clear_pending.store (false);
+
+  std::fill (m_hash.begin(), m_hash.end(), -1);
+
+  /* all entries are free */
+  for (size_t i = 0; i < m_entries.size(); i++)
+    m_entries[i].hash_next = i + 1 < m_entries.size() ? i + 1 : -1;
+
+  m_free = 0;
+  m_lru_first = -1;
+  m_lru_last = -1;
+}
+
+size_t
+MorphBlockCache::hash (const Key& key)
+{
+  size_t h = 0;
+  for (auto b : key.blocks)
+    h = h * 31 + (uintptr_t (b) >> 4);
+  for (auto m : key.morphing)
+    {
+      /* m + 0.0 maps -0.0 to 0.0, as both compare equal */
+      const double d = m + 0.0;
+      uint64 bits;
+      memcpy (&bits, &d, sizeof (bits));
+      h = h * 31 + (bits ^ (bits >> 32));
+    }
+  return (h ^ (h >> 16)) & (HASH_SIZE - 1);
+}
+
+int
+MorphBlockCache::find (const Key& key) const
+{
+  for (int idx = m_hash[hash (key)]; idx >= 0; idx = m_entries[idx].hash_next)
+    {
+      if (m_entries[idx].key == key)
+        return idx;
+    }
+  return -1;
+}
+
+void
+MorphBlockCache::lru_unlink (int idx)
+{
+  Entry& e = m_entries[idx];
+
+  if (e.lru_prev >= 0)
+    m_entries[e.lru_prev].lru_next = e.lru_next;
+  else
+    m_lru_first = e.lru_next;
+
+  if (e.lru_next >= 0)
+    m_entries[e.lru_next].lru_prev = e.lru_prev;
+  else
+    m_lru_last = e.lru_prev;
+}
+
+void
+MorphBlockCache::lru_push_front (int idx)
+{
+  Entry& e = m_entries[idx];
+
+  e.lru_prev = -1;
+  e.lru_next = m_lru_first;
+  if (m_lru_first >= 0)
+    m_entries[m_lru_first].lru_prev = idx;
+  else
+    m_lru_last = idx;
+
+  m_lru_first = idx;
+}
+
+/* returns a free entry, if necessary by removing the least recently used entry */
+int
+MorphBlockCache::alloc_entry()
+{
+  if (m_free >= 0)
+    {
+      const int idx = m_free;
+      m_free = m_entries[idx].hash_next;
+      return idx;
+    }
+  const int idx = m_lru_last;
+  lru_unlink (idx);
+
+  /* remove from hash bucket */
+  int *link = &m_hash[hash (m_entries[idx].key)];
+  while (*link != idx)
+    link = &m_entries[*link].hash_next;
+  *link = m_entries[idx].hash_next;
+
+  return idx;
+}
+
+bool
+MorphBlockCache::try_lock()
+{
+  if (m_lock.exchange (true, std::memory_order_acquire))
+    return false;
+
+  if (m_clear_pending.load())
+    clear();
+  return true;
+}
+
+void
+MorphBlockCache::unlock()
+{
+  m_lock.store (false, std::memory_order_release);
+}
+
+bool
+MorphBlockCache::lookup (const Key& key, RTAudioBlock& out_block, bool& have_block)
+{
+  /* never wait for other workers, computing the block is cheaper */
+  if (!try_lock())
+    {
+      m_misses.fetch_add (1, std::memory_order_relaxed);
+      return false;
+    }
+
+  const int idx = find (key);
+  if (idx < 0)
+    {
+      unlock();
+
+      m_misses.fetch_add (1, std::memory_order_relaxed);
+      return false;
+    }
+
+  const Entry& e = m_entries[idx];
+  have_block = e.have_block;
+  if (have_block)
+    {
+      const uint16_t *data = &m_data[idx * SLOT_SIZE];
+
+      out_block.freqs.assign (data, e.n_freqs);
+      out_block.mags.assign (data + e.n_freqs, e.n_freqs);
+      out_block.noise.assign (data + 2 * e.n_freqs, e.n_noise);
+    }
+  if (idx != m_lru_first)
+    {
+      lru_unlink (idx);
+      lru_push_front (idx);
+    }
+  unlock();
+
+  m_hits.fetch_add (1, std::memory_order_relaxed);
+  return true;
+}
+
+void
+MorphBlockCache::insert (const Key& key, const RTAudioBlock& block, bool have_block)
+{
+  const size_t n_freqs = have_block ? block.freqs.size() : 0;
+  const size_t n_noise = have_block ? block.noise.size() : 0;
+
+  if (2 * n_freqs + n_noise > SLOT_SIZE) // too large to be cached
+    return;
+
+  if (!try_lock()) // another worker is using the cache: don't wait, just don't store the block
+    return;
+
+  if (find (key) >= 0)
+    {
+      /* already inserted by another worker */
+      unlock();
+      return;
+    }
+
+  const int idx = alloc_entry();
+
+  Entry& e = m_entries[idx];
+  e.key        = key;
+  e.have_block = have_block;
+  e.n_freqs    = n_freqs;
+  e.n_noise    = n_noise;
+
+  uint16_t *data = &m_data[idx * SLOT_SIZE];
+  for (size_t i = 0; i < n_freqs; i++)
+    {
+      data[i] = block.freqs[i];
+      data[n_freqs + i] = block.mags[i];
+    }
+  for (size_t i = 0; i < n_noise; i++)
+    data[2 * n_freqs + i] = block.noise[i];
+
+  const size_t h = hash (key);
+  e.hash_next = m_hash[h];
+  m_hash[h] = idx;
+
+  lru_push_front (idx);
+
+  unlock();
+}
+
+uint64
+MorphBlockCache::hits() const
+{
+  return m_hits.load (std::memory_order_relaxed);
+}
+
+uint64
+MorphBlockCache::misses() const
+{
+  return m_misses.load (std::memory_order_relaxed);
+}
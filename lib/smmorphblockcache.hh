@@ -0,0 +1,97 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smmorphoperatormodule.hh"
+#include "smaudio.hh"
+#include "smrtmemory.hh"
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace SpectMorph
+{
+
+/*
+ * MorphBlockCache is the shared state of the linear and grid morph modules:
+ * voices which morph the same input frames with exactly the same morph
+ * parameters get the same output block, so it is computed only once and
+ * copied for the other voices. Since keys are not quantized, using the cache
+ * never changes the output.
+ *
+ * Entries are kept across process cycles, so notes which are retriggered or
+ * looped at a constant morph position reuse the morphed blocks; if the cache
+ * is full, the least recently used entry is replaced. All memory is
+ * allocated in the constructor (main thread). Since the result depends on
+ * the operator config and the wav sets, invalidate() is called by
+ * MorphPlanSynth whenever these change.
+ *
+ * Voices may be rendered in parallel (VoiceRenderPool), so the cache is
+ * protected by a lock. To never block the audio thread, the lock is only
+ * tried: if another worker holds it, lookup() returns a miss (so the block
+ * is computed) and insert() does not store the block.
+ */
+class MorphBlockCache : public MorphModuleSharedState
+{
+public:
+  struct Key
+  {
+    std::array<const void *, 4> blocks {};   // input frames (Audio::frame_id), unused: nullptr
+    std::array<double, 2>       morphing {}; // morph positions, unused: 0
+
+    bool
+    operator== (const Key& other) const
+    {
+      return blocks == other.blocks && morphing == other.morphing;
+    }
+  };
+
+  MorphBlockCache();
+  ~MorphBlockCache();
+
+  void invalidate();
+  bool lookup (const Key& key, RTAudioBlock& out_block, bool& have_block);
+  void insert (const Key& key, const RTAudioBlock& block, bool have_block);
+
+  uint64 hits() const;
+  uint64 misses() const;
+
+private:
+  static constexpr size_t MAX_ENTRIES    = 512;
+  static constexpr size_t HASH_SIZE      = 1024;        // power of two
+  static constexpr size_t SLOT_SIZE      = 1024;        // uint16_t values for freqs, mags and noise per entry
+
+  struct Entry
+  {
+    Key    key;
+    bool   have_block;
+    size_t n_freqs;
+    size_t n_noise;
+    int    hash_next;   // next entry in hash bucket (or free list), -1: none
+    int    lru_prev;    // more recently used entry, -1: none
+    int    lru_next;    // less recently used entry, -1: none
+  };
+  std::vector<Entry>    m_entries;
+  std::vector<int>      m_hash;     // first entry index of bucket or -1
+  std::vector<uint16_t> m_data;     // SLOT_SIZE values for each entry
+  int                   m_free = -1;
+  int                   m_lru_first = -1;
+  int                   m_lru_last = -1;
+
+  std::atomic<bool>     m_lock { false };
+  std::atomic<bool>     m_clear_pending { false };
+  std::atomic<uint64>   m_hits { 0 };
+  std::atomic<uint64>   m_misses { 0 };
+
+  static size_t hash (const Key& key);
+  int  find (const Key& key) const;
+  void lru_unlink (int idx);
+  void lru_push_front (int idx);
+  int  alloc_entry();
+  void clear();
+  bool try_lock();
+  void unlock();
+};
+
+}
@@ -114,24 +114,26 @@ get_normalized_block (MorphGridModule::InputNode& input_node, size_t index, RTAu
   return MorphUtils::get_normalized_block (source, time_ms, out_audio_block);
 }
 
-namespace
-{
-struct MagData
-{
-  enum {
-    BLOCK_LEFT  = 0,
-    BLOCK_RIGHT = 1
-  }       block;
-  size_t   index;
-  uint16_t mag;
-};
-
 static bool
-md_cmp (const MagData& m1, const MagData& m2)
+get_normalized_block_id (MorphGridModule::InputNode& input_node, size_t index, const void **block_id)
 {
-  return m1.mag > m2.mag;  // sort with biggest magnitude first
+  LiveDecoderSource *source = NULL;
+
+  if (input_node.mod)
+    {
+      source = input_node.mod->source();
+    }
+  else if (input_node.has_source)
+    {
+      source = &input_node.source;
+    }
+  const double time_ms = index; // 1ms frame step
+
+  return MorphUtils::get_normalized_block_id (source, time_ms, block_id);
 }
 
+namespace
+{
 static void
 interp_mag_one (double interp, uint16_t *left, uint16_t *right)
 {
@@ -189,96 +191,55 @@ morph (RTAudioBlock& out_block,
   out_block.mags.set_capacity (max_partials);
 
   // FIXME: lpc stuff
-  MagData mds[max_partials + AVOID_ARRAY_UB];
-  size_t  mds_size = 0;
-  for (size_t i = 0; i < left_block.freqs.size(); i++)
-    {
-      MagData& md = mds[mds_size];
-
-      md.block = MagData::BLOCK_LEFT;
-      md.index = i;
-      md.mag   = left_block.mags[i];
-      mds_size++;
-    }
-  for (size_t i = 0; i < right_block.freqs.size(); i++)
-    {
-      MagData& md = mds[mds_size];
-
-      md.block = MagData::BLOCK_RIGHT;
-      md.index = i;
-      md.mag   = right_block.mags[i];
-      mds_size++;
-    }
-  sort (mds, mds + mds_size, md_cmp);
-
   size_t    left_freqs_size = left_block.freqs.size();
   size_t    right_freqs_size = right_block.freqs.size();
 
   MorphUtils::FreqState   left_freqs[left_freqs_size + AVOID_ARRAY_UB];
   MorphUtils::FreqState   right_freqs[right_freqs_size + AVOID_ARRAY_UB];
+  MorphUtils::MatchPair   matches[min (left_freqs_size, right_freqs_size) + AVOID_ARRAY_UB];
 
-  init_freq_state (left_block.freqs, left_freqs);
-  init_freq_state (right_block.freqs, right_freqs);
-
-  for (size_t m = 0; m < mds_size; m++)
+  const size_t n_matches = MorphUtils::match_partials (left_block, right_block, left_freqs, right_freqs, matches);
+  for (size_t m = 0; m < n_matches; m++)
     {
-      size_t i, j;
-      bool match = false;
-      if (mds[m].block == MagData::BLOCK_LEFT)
-        {
-          i = mds[m].index;
+      const size_t i = matches[m].left;
+      const size_t j = matches[m].right;
+
+      /* prefer frequency of louder partial:
+       *
+       * if the magnitudes are similar, mfact will be close to 1, and freq will become approx.
+       *
+       *   freq = (1 - interp) * lfreq + interp * rfreq
+       *
+       * if the magnitudes are very different, mfact will be close to 0, and freq will become
+       *
+       *   freq ~= lfreq         // if left partial is louder
+       *   freq ~= rfreq         // if right partial is louder
+       */
+      const double lfreq = left_block.freqs[i];
+      const double rfreq = right_block.freqs[j];
+      double freq;
 
-          if (!left_freqs[i].used)
-            match = MorphUtils::find_match (left_freqs[i].freq_f, right_freqs, right_freqs_size, &j);
-        }
-      else // (mds[m].block == MagData::BLOCK_RIGHT)
+      if (left_block.mags[i] > right_block.mags[j])
         {
-          j = mds[m].index;
-          if (!right_freqs[j].used)
-            match = MorphUtils::find_match (right_freqs[j].freq_f, left_freqs, left_freqs_size, &i);
+          const double mfact = right_block.mags_f (j) / left_block.mags_f (i);
+
+          freq = lfreq + mfact * interp * (rfreq - lfreq);
         }
-      if (match)
+      else
         {
-          /* prefer frequency of louder partial:
-           *
-           * if the magnitudes are similar, mfact will be close to 1, and freq will become approx.
-           *
-           *   freq = (1 - interp) * lfreq + interp * rfreq
-           *
-           * if the magnitudes are very different, mfact will be close to 0, and freq will become
-           *
-           *   freq ~= lfreq         // if left partial is louder
-           *   freq ~= rfreq         // if right partial is louder
-           */
-          const double lfreq = left_block.freqs[i];
-          const double rfreq = right_block.freqs[j];
-          double freq;
-
-          if (left_block.mags[i] > right_block.mags[j])
-            {
-              const double mfact = right_block.mags_f (j) / left_block.mags_f (i);
+          const double mfact = left_block.mags_f (i) / right_block.mags_f (j);
 
-              freq = lfreq + mfact * interp * (rfreq - lfreq);
-            }
-          else
-            {
-              const double mfact = left_block.mags_f (i) / right_block.mags_f (j);
-
-              freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
-            }
-          // FIXME: lpc
-          // FIXME: non-db
-
-          const uint16_t lmag_idb = max (left_block.mags[i], SM_IDB_CONST_M96);
-          const uint16_t rmag_idb = max (right_block.mags[j], SM_IDB_CONST_M96);
-          const uint16_t mag_idb = sm_round_positive ((1 - interp) * lmag_idb + interp * rmag_idb);
+          freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
+        }
+      // FIXME: lpc
+      // FIXME: non-db
 
-          out_block.freqs.push_back (freq);
-          out_block.mags.push_back (mag_idb);
+      const uint16_t lmag_idb = max (left_block.mags[i], SM_IDB_CONST_M96);
+      const uint16_t rmag_idb = max (right_block.mags[j], SM_IDB_CONST_M96);
+      const uint16_t mag_idb = sm_round_positive ((1 - interp) * lmag_idb + interp * rmag_idb);
 
-          left_freqs[i].used = 1;
-          right_freqs[j].used = 1;
-        }
+      out_block.freqs.push_back (freq);
+      out_block.mags.push_back (mag_idb);
     }
   for (size_t i = 0; i < left_freqs_size; i++)
     {
@@ -362,9 +323,50 @@ apply_delta_db (RTAudioBlock& block, double delta_db)
 bool
 MorphGridModule::MySource::rt_audio_block (size_t index, RTAudioBlock& out_block)
 {
-  const double x_morphing = module->apply_modulation (module->cfg->x_morphing_mod);
-  const double y_morphing = module->apply_modulation (module->cfg->y_morphing_mod);
+  double x_morphing = module->apply_modulation (module->cfg->x_morphing_mod);
+  double y_morphing = module->apply_modulation (module->cfg->y_morphing_mod);
+
+  MorphBlockCache *cache = module->block_cache;
+  MorphBlockCache::Key cache_key;
+  if (cache && !make_cache_key (index, x_morphing, y_morphing, cache_key))
+    cache = nullptr;
+
+  bool have_block;
+  if (cache && cache->lookup (cache_key, out_block, have_block))
+    return have_block;
+
+  have_block = morph_block (index, x_morphing, y_morphing, out_block);
+  if (cache)
+    cache->insert (cache_key, out_block, have_block);
+
+  return have_block;
+}
+
+bool
+MorphGridModule::MySource::make_cache_key (size_t index, double x_morphing, double y_morphing, MorphBlockCache::Key& key)
+{
+  /* the result can only be shared between voices if we know which frames are morphed */
+  const LocalMorphParams x_morph_params = global_to_local_params (x_morphing, module->cfg->width);
+  const LocalMorphParams y_morph_params = global_to_local_params (y_morphing, module->cfg->height);
+
+  const int nodes[4][2] = {
+    { x_morph_params.start, y_morph_params.start },
+    { x_morph_params.end,   y_morph_params.start },
+    { x_morph_params.start, y_morph_params.end },
+    { x_morph_params.end,   y_morph_params.end }
+  };
+  for (size_t n = 0; n < 4; n++)
+    {
+      if (!get_normalized_block_id (module->input_nodes (nodes[n][0], nodes[n][1]), index, &key.blocks[n]))
+        return false;
+    }
+  key.morphing = { x_morphing, y_morphing };
+  return true;
+}
 
+bool
+MorphGridModule::MySource::morph_block (size_t index, double x_morphing, double y_morphing, RTAudioBlock& out_block)
+{
   const LocalMorphParams x_morph_params = global_to_local_params (x_morphing, module->cfg->width);
   const LocalMorphParams y_morph_params = global_to_local_params (y_morphing, module->cfg->height);
 
@@ -477,3 +479,16 @@ MorphGridModule::source()
 {
   return &my_source;
 }
+
+MorphModuleSharedState *
+MorphGridModule::create_shared_state()
+{
+  return new MorphBlockCache();
+}
+
+void
+MorphGridModule::set_shared_state (MorphModuleSharedState *new_shared_state)
+{
+  block_cache = dynamic_cast<MorphBlockCache *> (new_shared_state);
+  assert (block_cache);
+}
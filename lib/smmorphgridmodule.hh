@@ -7,6 +7,7 @@
 #include "smmorphgrid.hh"
 #include "smwavset.hh"
 #include "smmorphsourcemodule.hh"
+#include "smmorphblockcache.hh"
 
 #include <array>
 
@@ -41,6 +42,7 @@ private:
 
   // output
   Audio               audio;
+  MorphBlockCache    *block_cache = nullptr;
 
   struct MySource : public LiveDecoderSource
   {
@@ -49,6 +51,8 @@ private:
     void retrigger (int channel, float freq, int midi_velocity) override;
     Audio* audio() override;
     bool rt_audio_block (size_t index, RTAudioBlock& out_block) override;
+    bool make_cache_key (size_t index, double x_morphing, double y_morphing, MorphBlockCache::Key& key);
+    bool morph_block (size_t index, double x_morphing, double y_morphing, RTAudioBlock& out_block);
   } my_source;
 
 public:
@@ -57,6 +61,9 @@ public:
 
   void set_config (const MorphOperatorConfig *cfg);
   LiveDecoderSource *source();
+
+  MorphModuleSharedState *create_shared_state() override;
+  void set_shared_state (MorphModuleSharedState *new_shared_state) override;
 };
 
 }
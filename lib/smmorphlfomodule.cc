@@ -56,7 +56,11 @@ MorphLFOModule::set_config (const MorphOperatorConfig *op_cfg)
 
   if (!shared_state->initialized)
     {
-      restart_lfo (shared_state->global_lfo_state, /* start from zero time */ TimeInfo());
+      const int seed = morph_plan_voice->morph_plan_synth()->random_seed();
+      if (seed != -1)
+        shared_state->random_gen.set_seed (seed);
+
+      restart_lfo (shared_state->global_lfo_state, /* start from zero time */ TimeInfo(), &shared_state->random_gen);
       shared_state->initialized = true;
     }
 }
@@ -68,15 +72,16 @@ MorphLFOModule::value()
 
   if (cfg->sync_voices)
     {
+      /* random values computed here are discarded with the copy, so we use the voice generator */
       auto lfo_state = shared_state->global_lfo_state;
-      update_lfo_value (lfo_state, time);
+      update_lfo_value (lfo_state, time, random_gen());
       set_notify_value (lfo_state.value);
 
       return lfo_state.value;
     }
   else
     {
-      update_lfo_value (local_lfo_state, time);
+      update_lfo_value (local_lfo_state, time, random_gen());
       set_notify_value (local_lfo_state.value);
 
       return local_lfo_state.value;
@@ -86,24 +91,24 @@ MorphLFOModule::value()
 void
 MorphLFOModule::reset_value (const TimeInfo& time_info)
 {
-  restart_lfo (local_lfo_state, time_info);
+  restart_lfo (local_lfo_state, time_info, random_gen());
 }
 
 void
-MorphLFOModule::restart_lfo (LFOState& state, const TimeInfo& time_info)
+MorphLFOModule::restart_lfo (LFOState& state, const TimeInfo& time_info, Random *random)
 {
   state = LFOState(); /* reset to defaults */
-  state.last_random_value = random_gen()->random_double_range (-1, 1);
-  state.random_value = random_gen()->random_double_range (-1, 1);
+  state.last_random_value = random->random_double_range (-1, 1);
+  state.random_value = random->random_double_range (-1, 1);
   /* compute initial value */
   TimeInfo zero_time;
-  update_lfo_value (state, zero_time);
+  update_lfo_value (state, zero_time, random);
   state.last_time_ms = time_info.time_ms;
   state.last_ppq_pos = time_info.ppq_pos;
 }
 
 void
-MorphLFOModule::update_lfo_value (LFOState& state, const TimeInfo& time_info)
+MorphLFOModule::update_lfo_value (LFOState& state, const TimeInfo& time_info, Random *random)
 {
   if (!cfg->beat_sync)
     {
@@ -150,7 +155,7 @@ MorphLFOModule::update_lfo_value (LFOState& state, const TimeInfo& time_info)
     {
       // retrigger random lfo
       state.last_random_value = state.random_value;
-      state.random_value = random_gen()->random_double_range (-1, 1);
+      state.random_value = random->random_double_range (-1, 1);
     }
 
   if (cfg->wave_type == MorphLFO::WAVE_SINE)
@@ -207,5 +212,5 @@ MorphLFOModule::update_lfo_value (LFOState& state, const TimeInfo& time_info)
 void
 MorphLFOModule::update_shared_state (const TimeInfo& time_info)
 {
-  update_lfo_value (shared_state->global_lfo_state, time_info);
+  update_lfo_value (shared_state->global_lfo_state, time_info, &shared_state->random_gen);
 }
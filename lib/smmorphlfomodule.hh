@@ -30,13 +30,14 @@ class MorphLFOModule : public MorphOperatorModule
   {
     bool     initialized = false;
     LFOState global_lfo_state;
+    Random   random_gen;   // independent of voices (which may be reseeded for each note)
   };
   SharedState *shared_state = nullptr;
   MorphModuleSharedState *create_shared_state() override;
   void set_shared_state (MorphModuleSharedState *new_shared_state) override;
 
-  void update_lfo_value (LFOState& state, const TimeInfo& time_info);
-  void restart_lfo (LFOState& state, const TimeInfo& time_info);
+  void update_lfo_value (LFOState& state, const TimeInfo& time_info, Random *random);
+  void restart_lfo (LFOState& state, const TimeInfo& time_info, Random *random);
 public:
   MorphLFOModule (MorphPlanVoice *voice);
   ~MorphLFOModule();
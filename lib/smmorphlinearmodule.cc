@@ -112,22 +112,6 @@ dump_line (size_t index, const char *what, double start, double end)
     }
 }
 
-struct MagData
-{
-  enum {
-    BLOCK_LEFT  = 0,
-    BLOCK_RIGHT = 1
-  }        block;
-  size_t   index;
-  uint16_t mag;
-};
-
-static bool
-md_cmp (const MagData& m1, const MagData& m2)
-{
-  return m1.mag > m2.mag;  // sort with biggest magnitude first
-}
-
 void
 MorphLinearModule::MySource::interp_mag_one (double interp, uint16_t *left, uint16_t *right)
 {
@@ -154,10 +138,50 @@ MorphLinearModule::MySource::interp_mag_one (double interp, uint16_t *left, uint
 
 bool
 MorphLinearModule::MySource::rt_audio_block (size_t index, RTAudioBlock& out_audio_block)
+{
+  double morphing = module->apply_modulation (module->cfg->morphing_mod);
+
+  MorphBlockCache *cache = module->block_cache;
+  MorphBlockCache::Key cache_key;
+  if (cache && !make_cache_key (index, morphing, cache_key))
+    cache = nullptr;
+
+  bool have_block;
+  if (cache && cache->lookup (cache_key, out_audio_block, have_block))
+    return have_block;
+
+  have_block = morph_block (index, morphing, out_audio_block);
+  if (cache)
+    cache->insert (cache_key, out_audio_block, have_block);
+
+  return have_block;
+}
+
+bool
+MorphLinearModule::MySource::make_cache_key (size_t index, double morphing, MorphBlockCache::Key& key)
+{
+  /* the result can only be shared between voices if we know which frames are morphed */
+  LiveDecoderSource *left = module->left_mod ? module->left_mod->source() : nullptr;
+  LiveDecoderSource *right = module->right_mod ? module->right_mod->source() : nullptr;
+  if (module->have_left_source)
+    left = &module->left_source;
+  if (module->have_right_source)
+    right = &module->right_source;
+
+  const double time_ms = index; // 1ms frame step
+  if (!MorphUtils::get_normalized_block_id (left, time_ms, &key.blocks[0]) ||
+      !MorphUtils::get_normalized_block_id (right, time_ms, &key.blocks[1]))
+    return false;
+
+  key.morphing = { morphing, 0 };
+  return true;
+}
+
+bool
+MorphLinearModule::MySource::morph_block (size_t index, double morphing, RTAudioBlock& out_audio_block)
 {
   bool have_left = false, have_right = false;
 
-  const double morphing = module->apply_modulation (module->cfg->morphing_mod);
   const double interp = (morphing + 1) / 2; /* examples => 0: only left; 0.5 both equally; 1: only right */
   const double time_ms = index; // 1ms frame step
 
@@ -200,98 +224,54 @@ MorphLinearModule::MySource::rt_audio_block (size_t index, RTAudioBlock& out_aud
       dump_block (index, "A", left_block);
       dump_block (index, "B", right_block);
 
-      MagData mds[max_partials + AVOID_ARRAY_UB];
-      size_t  mds_size = 0;
-      for (size_t i = 0; i < left_block.freqs.size(); i++)
-        {
-          MagData& md = mds[mds_size];
+      MorphUtils::FreqState left_freqs[left_block.freqs.size() + AVOID_ARRAY_UB];
+      MorphUtils::FreqState right_freqs[right_block.freqs.size() + AVOID_ARRAY_UB];
+      MorphUtils::MatchPair matches[min (left_block.freqs.size(), right_block.freqs.size()) + AVOID_ARRAY_UB];
 
-          md.block = MagData::BLOCK_LEFT;
-          md.index = i;
-          md.mag   = left_block.mags[i];
-          mds_size++;
-        }
-      for (size_t i = 0; i < right_block.freqs.size(); i++)
+      const size_t n_matches = MorphUtils::match_partials (left_block, right_block, left_freqs, right_freqs, matches);
+      for (size_t m = 0; m < n_matches; m++)
         {
-          MagData& md = mds[mds_size];
-
-          md.block = MagData::BLOCK_RIGHT;
-          md.index = i;
-          md.mag   = right_block.mags[i];
-          mds_size++;
-        }
-      sort (mds, mds + mds_size, md_cmp);
-
-      size_t    left_freqs_size = left_block.freqs.size();
-      size_t    right_freqs_size = right_block.freqs.size();
+          const size_t i = matches[m].left;
+          const size_t j = matches[m].right;
+          double freq;
 
-      MorphUtils::FreqState   left_freqs[left_freqs_size + AVOID_ARRAY_UB];
-      MorphUtils::FreqState   right_freqs[right_freqs_size + AVOID_ARRAY_UB];
+          /* prefer frequency of louder partial */
+          const double lfreq = left_block.freqs[i];
+          const double rfreq = right_block.freqs[j];
 
-      init_freq_state (left_block.freqs, left_freqs);
-      init_freq_state (right_block.freqs, right_freqs);
+          if (left_block.mags[i] > right_block.mags[j])
+            {
+              const double mfact = right_block.mags_f (j) / left_block.mags_f (i);
 
-      for (size_t m = 0; m < mds_size; m++)
-        {
-          size_t i, j;
-          bool match = false;
-          if (mds[m].block == MagData::BLOCK_LEFT)
+              freq = lfreq + mfact * interp * (rfreq - lfreq);
+            }
+          else
             {
-              i = mds[m].index;
+              const double mfact = left_block.mags_f (i) / right_block.mags_f (j);
 
-              if (!left_freqs[i].used)
-                match = MorphUtils::find_match (left_freqs[i].freq_f, right_freqs, right_freqs_size, &j);
+              freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
             }
-          else // (mds[m].block == MagData::BLOCK_RIGHT)
+
+          double mag;
+          if (module->cfg->db_linear)
             {
-              j = mds[m].index;
-              if (!right_freqs[j].used)
-                match = MorphUtils::find_match (right_freqs[j].freq_f, left_freqs, left_freqs_size, &i);
+              // FIXME: this could be faster if we avoided db conversion (see grid morph)
+
+              double lmag_db = db_from_factor (left_block.mags_f (i), -100);
+              double rmag_db = db_from_factor (right_block.mags_f (j), -100);
+
+              double mag_db = (1 - interp) * lmag_db + interp * rmag_db;
+
+              mag = db_to_factor (mag_db);
             }
-          if (match)
+          else
             {
-              double freq;
-
-              /* prefer frequency of louder partial */
-              const double lfreq = left_block.freqs[i];
-              const double rfreq = right_block.freqs[j];
-
-              if (left_block.mags[i] > right_block.mags[j])
-                {
-                  const double mfact = right_block.mags_f (j) / left_block.mags_f (i);
-
-                  freq = lfreq + mfact * interp * (rfreq - lfreq);
-                }
-              else
-                {
-                  const double mfact = left_block.mags_f (i) / right_block.mags_f (j);
-
-                  freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
-                }
-
-              double mag;
-              if (module->cfg->db_linear)
-                {
-                  // FIXME: this could be faster if we avoided db conversion (see grid morph)
-
-                  double lmag_db = db_from_factor (left_block.mags_f (i), -100);
-                  double rmag_db = db_from_factor (right_block.mags_f (j), -100);
-
-                  double mag_db = (1 - interp) * lmag_db + interp * rmag_db;
-
-                  mag = db_to_factor (mag_db);
-                }
-              else
-                {
-                  mag = (1 - interp) * left_block.mags_f (i) + interp * right_block.mags_f (j);
-                }
-              out_audio_block.freqs.push_back (freq);
-              out_audio_block.mags.push_back (sm_factor2idb (mag));
-
-              dump_line (index, "L", left_block.freqs[i], right_block.freqs[j]);
-              left_freqs[i].used = 1;
-              right_freqs[j].used = 1;
+              mag = (1 - interp) * left_block.mags_f (i) + interp * right_block.mags_f (j);
             }
+          out_audio_block.freqs.push_back (freq);
+          out_audio_block.mags.push_back (sm_factor2idb (mag));
+
+          dump_line (index, "L", left_block.freqs[i], right_block.freqs[j]);
         }
       for (size_t i = 0; i < left_block.freqs.size(); i++)
         {
@@ -356,3 +336,16 @@ MorphLinearModule::source()
 {
   return &my_source;
 }
+
+MorphModuleSharedState *
+MorphLinearModule::create_shared_state()
+{
+  return new MorphBlockCache();
+}
+
+void
+MorphLinearModule::set_shared_state (MorphModuleSharedState *new_shared_state)
+{
+  block_cache = dynamic_cast<MorphBlockCache *> (new_shared_state);
+  assert (block_cache);
+}
@@ -8,6 +8,7 @@
 #include "smmorphoperatormodule.hh"
 #include "smmorphlinear.hh"
 #include "smmorphsourcemodule.hh"
+#include "smmorphblockcache.hh"
 
 namespace SpectMorph
 {
@@ -24,12 +25,15 @@ class MorphLinearModule : public MorphOperatorModule
   bool                 have_right_source;
 
   Audio                audio;
+  MorphBlockCache     *block_cache = nullptr;
 
   struct MySource : public LiveDecoderSource
   {
     MorphLinearModule    *module;
 
     void interp_mag_one (double interp, uint16_t *left, uint16_t *right);
+    bool make_cache_key (size_t index, double morphing, MorphBlockCache::Key& key);
+    bool morph_block (size_t index, double morphing, RTAudioBlock& out_audio_block);
     void retrigger (int channel, float freq, int midi_velocity) override;
     Audio* audio() override;
     bool rt_audio_block (size_t index, RTAudioBlock& block) override;
@@ -41,6 +45,9 @@ public:
 
   void set_config (const MorphOperatorConfig *cfg);
   LiveDecoderSource *source();
+
+  MorphModuleSharedState *create_shared_state() override;
+  void set_shared_state (MorphModuleSharedState *new_shared_state) override;
 };
 
 }
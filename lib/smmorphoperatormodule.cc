@@ -95,7 +95,7 @@ MorphOperatorModule::set_shared_state (MorphModuleSharedState *new_shared_state)
 Random *
 MorphOperatorModule::random_gen() const
 {
-  return morph_plan_voice->morph_plan_synth()->random_gen();
+  return morph_plan_voice->random_gen();
 }
 
 RTMemoryArea *
@@ -31,6 +31,7 @@ MorphOutput::MorphOutput (MorphPlan *morph_plan) :
   add_property (&m_config.unison, P_UNISON, "Enable Unison Effect", false);
   add_property (&m_config.unison_voices, P_UNISON_VOICES, "Voices", "%d", 2, 2, 7);
   add_property (&m_config.unison_detune, P_UNISON_DETUNE, "Detune", "%.1f Cent", 6, 0.5, 50);
+  add_property (&m_config.unison_spread, P_UNISON_SPREAD, "Spread", "%.0f %%", 0, 0, 100);
 
   add_property (&m_config.adsr, P_ADSR, "Enable custom ADSR Envelope", false);
   add_property (&m_config.adsr_skip, P_ADSR_SKIP, "Skip", "%.1f ms", 500, 0, 1000);
@@ -62,6 +62,7 @@ public:
     bool                          unison;
     int                           unison_voices;
     float                         unison_detune;
+    float                         unison_spread;
 
     bool                          adsr;
     float                         adsr_skip;
@@ -103,6 +104,7 @@ public:
   static constexpr auto P_UNISON        = "unison";
   static constexpr auto P_UNISON_VOICES = "unison_voices";
   static constexpr auto P_UNISON_DETUNE = "unison_detune";
+  static constexpr auto P_UNISON_SPREAD = "unison_spread";
 
   static constexpr auto P_ADSR         = "adsr";
   static constexpr auto P_ADSR_SKIP    = "adsr_skip";
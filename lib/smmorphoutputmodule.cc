@@ -48,6 +48,18 @@ MorphOutputModule::portamento() const
   return cfg->portamento;
 }
 
+bool
+MorphOutputModule::unison() const
+{
+  return cfg->unison;
+}
+
+double
+MorphOutputModule::envelope_level() const
+{
+  return decoder.envelope_level();
+}
+
 float
 MorphOutputModule::portamento_glide() const
 {
@@ -101,6 +113,63 @@ MorphOutputModule::process (const TimeInfoGenerator& time_info_gen, RTMemoryArea
   m_rt_memory_area = nullptr;
 }
 
+void
+MorphOutputModule::start_spectrum (size_t start_offset)
+{
+  decoder.start_spectrum (start_offset);
+}
+
+void
+MorphOutputModule::process_spectrum (const TimeInfoGenerator& time_info_gen, RTMemoryArea& rt_memory_area, size_t hop_size, float freq, float gain_left, float gain_right, SpectralBus *bus)
+{
+  const bool have_cycle = morph_plan_voice->morph_plan_synth()->have_cycle();
+
+  this->time_info_gen = &time_info_gen;
+  m_rt_memory_area = &rt_memory_area;
+
+  if (!have_cycle)
+    decoder.process_spectrum (rt_memory_area, hop_size, freq, gain_left, gain_right, bus);
+
+  this->time_info_gen = nullptr;
+  m_rt_memory_area = nullptr;
+}
+
+bool
+MorphOutputModule::spectral_bus_ok() const
+{
+  return decoder.spectral_bus_ok();
+}
+
+void
+MorphOutputModule::set_filter_job (FilterJob *job)
+{
+  decoder.set_filter_job (job);
+}
+
+void
+MorphOutputModule::set_unison_limit (int max_voices)
+{
+  decoder.set_unison_limit (max_voices);
+}
+
+void
+MorphOutputModule::set_lod (float threshold, int max_partials)
+{
+  decoder.set_lod (threshold, max_partials);
+}
+
+void
+MorphOutputModule::set_noise_seed (int seed)
+{
+  decoder.set_noise_seed (seed);
+}
+
+void
+MorphOutputModule::collect_lod_stats (uint64& rendered_partials, uint64& culled_partials)
+{
+  decoder.collect_lod_stats (rendered_partials, culled_partials);
+}
+
 RTMemoryArea *
 MorphOutputModule::rt_memory_area() const
 {
@@ -131,6 +200,12 @@ MorphOutputModule::release()
   decoder.release();
 }
 
+void
+MorphOutputModule::release_spectrum (size_t release_pos)
+{
+  decoder.release_spectrum (release_pos);
+}
+
 bool
 MorphOutputModule::done()
 {
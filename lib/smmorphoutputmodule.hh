@@ -23,11 +23,22 @@ public:
 
   void set_config (const MorphOperatorConfig *op_cfg);
   void process (const TimeInfoGenerator& time_info, RTMemoryArea& rt_memory_area, size_t n_samples, float **values, size_t n_ports, const float *freq_in = nullptr);
+  void start_spectrum (size_t start_offset);
+  void process_spectrum (const TimeInfoGenerator& time_info, RTMemoryArea& rt_memory_area, size_t hop_size, float freq, float gain_left, float gain_right, SpectralBus *bus);
+  bool spectral_bus_ok() const;
+  void set_filter_job (FilterJob *job);
+  void set_unison_limit (int max_voices);
+  void set_lod (float threshold, int max_partials);
+  void set_noise_seed (int seed);
+  void collect_lod_stats (uint64& rendered_partials, uint64& culled_partials);
   void retrigger (const TimeInfo& time_info, int channel, float freq, int midi_velocity);
   void release();
+  void release_spectrum (size_t release_pos);
   bool done();
 
   bool  portamento() const;
+  bool  unison() const;
+  double envelope_level() const;
   float portamento_glide() const;
   float velocity_sensitivity() const;
   int   pitch_bend_range() const;
@@ -4,6 +4,7 @@
 #include "smmorphplanvoice.hh"
 #include "smleakdebugger.hh"
 #include "smmorphoutputmodule.hh"
+#include "smmorphblockcache.hh"
 
 using namespace SpectMorph;
 
@@ -157,6 +158,9 @@ MorphPlanSynth::apply_update (MorphPlanSynth::UpdateP update) /* audio thread */
     {
       for (size_t i = 0; i < voices.size(); i++)
         voices[i]->cheap_update (update);
+
+      /* configs changed: cached morph results are no longer valid */
+      invalidate_block_caches();
     }
   else
     {
@@ -175,16 +179,63 @@ MorphPlanSynth::update_shared_state (const TimeInfo& time_info)
   voices[0]->update_shared_state (time_info);
 }
 
-float
-MorphPlanSynth::mix_freq() const
+void
+MorphPlanSynth::block_cache_stats (uint64& hits, uint64& misses) const
 {
-  return m_mix_freq;
+  hits = 0;
+  misses = 0;
+
+  for (const auto& shared_state : voices_shared_states)
+    {
+      auto block_cache = dynamic_cast<MorphBlockCache *> (shared_state.get());
+      if (block_cache)
+        {
+          hits += block_cache->hits();
+          misses += block_cache->misses();
+        }
+    }
+}
+
+void
+MorphPlanSynth::invalidate_block_caches() /* audio thread */
+{
+  for (const auto& shared_state : voices_shared_states)
+    {
+      auto block_cache = dynamic_cast<MorphBlockCache *> (shared_state.get());
+      if (block_cache)
+        block_cache->invalidate();
+    }
 }
 
-Random *
-MorphPlanSynth::random_gen()
+/*
+ * fixed seed for the random generators (LFO), -1: random
+ *
+ * needs to be set before the first update, because shared states (global LFOs)
+ * are seeded when they are created
+ */
+void
+MorphPlanSynth::set_random_seed (int seed)
 {
-  return &m_random_gen;
+  assert (seed >= -1);
+  m_random_seed = seed;
+
+  if (seed != -1)
+    {
+      for (size_t i = 0; i < voices.size(); i++)
+        voices[i]->random_gen()->set_seed (seed + i);
+    }
+}
+
+int
+MorphPlanSynth::random_seed() const
+{
+  return m_random_seed;
+}
+
+float
+MorphPlanSynth::mix_freq() const
+{
+  return m_mix_freq;
 }
 
 bool
@@ -27,8 +27,8 @@ protected:
   std::vector<std::unique_ptr<MorphOperatorConfig>> m_active_configs;
 
   float           m_mix_freq;
-  Random          m_random_gen;
   bool            m_have_cycle = false;
+  int             m_random_seed = -1;
 
 public:
   struct OpModule {
@@ -65,12 +65,16 @@ public:
   void apply_update (UpdateP update);
 
   void update_shared_state (const TimeInfo& time_info);
+  void block_cache_stats (uint64& hits, uint64& misses) const;
+  void invalidate_block_caches();
+
+  void set_random_seed (int seed);
+  int  random_seed() const;
 
   MorphPlanVoice *voice (size_t i) const;
 
   float   mix_freq() const;
   bool    have_output() const;
-  Random *random_gen();
   bool    have_cycle() const;
 };
 
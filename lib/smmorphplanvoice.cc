@@ -137,6 +137,12 @@ MorphPlanVoice::morph_plan_synth() const
   return m_morph_plan_synth;
 }
 
+Random *
+MorphPlanVoice::random_gen()
+{
+  return &m_random_gen;
+}
+
 void
 MorphPlanVoice::update_shared_state (const TimeInfo& time_info)
 {
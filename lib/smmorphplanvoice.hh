@@ -22,6 +22,7 @@ protected:
   float                         m_mix_freq;
   float                         m_velocity;
   MorphPlanSynth               *m_morph_plan_synth;
+  Random                        m_random_gen;   // per voice: voices may be rendered by different threads
 
   void configure_modules();
 
@@ -43,6 +44,7 @@ public:
 
   MorphOutputModule *output();
   MorphPlanSynth *morph_plan_synth() const;
+  Random         *random_gen();
 
   void update_shared_state (const TimeInfo& time_info);
   void reset_value (const TimeInfo& time_info);
@@ -68,9 +68,9 @@ SimpleWavSetSource::audio()
 bool
 SimpleWavSetSource::rt_audio_block (size_t index, RTAudioBlock& out_block)
 {
-  if (active_audio && index < active_audio->contents.size())
+  if (active_audio && index < active_audio->frame_count())
     {
-      out_block.assign (active_audio->contents[index]);
+      out_block.assign (*active_audio, index);
       return true;
     }
   else
@@ -79,6 +79,17 @@ SimpleWavSetSource::rt_audio_block (size_t index, RTAudioBlock& out_block)
     }
 }
 
+bool
+SimpleWavSetSource::rt_audio_block_id (size_t index, const void **block_id)
+{
+  if (active_audio && index < active_audio->frame_count())
+    *block_id = active_audio->frame_id (index);
+  else
+    *block_id = nullptr;
+
+  return true;
+}
+
 MorphSourceModule::MorphSourceModule (MorphPlanVoice *voice) :
   MorphOperatorModule (voice)
 {
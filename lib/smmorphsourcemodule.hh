@@ -23,6 +23,7 @@ public:
   void        retrigger (int channel, float freq, int midi_velocity) override;
   Audio      *audio() override;
   bool        rt_audio_block (size_t index, RTAudioBlock& out_block) override;
+  bool        rt_audio_block_id (size_t index, const void **block_id) override;
 };
 
 class MorphSourceModule : public MorphOperatorModule
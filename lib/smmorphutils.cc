@@ -20,19 +20,15 @@ fs_cmp (const FreqState& fs1, const FreqState& fs2)
   return fs1.freq_f < fs2.freq_f;
 }
 
-bool
-find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index)
+/* find closest unused partial in [freq - 0.5, freq + 0.5], starting the search at index i */
+static bool
+find_match_from (float freq, const FreqState *freq_state, size_t freq_state_size, size_t i, size_t *index)
 {
-  const float freq_start = freq - 0.5;
   const float freq_end   = freq + 0.5;
 
   double min_diff = 1e20;
   size_t best_index = 0; // initialized to avoid compiler warning
 
-  FreqState start_freq_state = {freq_start, 0};
-  const FreqState *start_ptr = std::lower_bound (freq_state, freq_state + freq_state_size, start_freq_state, fs_cmp);
-  size_t i = start_ptr - freq_state;
-
   while (i < freq_state_size && freq_state[i].freq_f < freq_end)
     {
       if (!freq_state[i].used)
@@ -54,6 +50,137 @@ find_match (float freq, const FreqState *freq_state, size_t freq_state_size, siz
   return false;
 }
 
+bool
+find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index)
+{
+  const float freq_start = freq - 0.5;
+
+  FreqState start_freq_state = {freq_start, 0};
+  const FreqState *start_ptr = std::lower_bound (freq_state, freq_state + freq_state_size, start_freq_state, fs_cmp);
+
+  return find_match_from (freq, freq_state, freq_state_size, start_ptr - freq_state, index);
+}
+
+/* for each partial in a, compute the index of the first partial in b with b.freq_f >= a.freq_f - 0.5
+ *
+ * since both arrays are sorted by frequency, this is a merge-like pass over both
+ * arrays (the result is the same as doing std::lower_bound for each partial)
+ */
+static void
+window_start (const FreqState *a, size_t a_size, const FreqState *b, size_t b_size, size_t *start)
+{
+  size_t j = 0;
+  for (size_t i = 0; i < a_size; i++)
+    {
+      const float freq_start = a[i].freq_f - 0.5;
+
+      while (j < b_size && b[j].freq_f < freq_start)
+        j++;
+      start[i] = j;
+    }
+}
+
+namespace
+{
+struct MagData
+{
+  enum {
+    BLOCK_LEFT  = 0,
+    BLOCK_RIGHT = 1
+  }        block;
+  size_t   index;
+  uint16_t mag;
+};
+
+static bool
+md_cmp (const MagData& m1, const MagData& m2)
+{
+  return m1.mag > m2.mag;  // sort with biggest magnitude first
+}
+
+}
+
+/*
+ * match partials of two blocks for morphing: starting with the loudest partial,
+ * each partial is paired with the closest unused partial of the other block
+ * (within half the fundamental frequency)
+ *
+ *  - left_freqs/right_freqs must have space for all partials of the blocks;
+ *    after matching, used is set for all partials that have been matched
+ *  - matches must have space for min (left partials, right partials) pairs;
+ *    pairs are stored in the order they have been matched
+ *
+ * returns the number of matches
+ */
+size_t
+match_partials (const RTAudioBlock& left_block, const RTAudioBlock& right_block,
+                FreqState *left_freqs, FreqState *right_freqs, MatchPair *matches)
+{
+  const size_t left_freqs_size = left_block.freqs.size();
+  const size_t right_freqs_size = right_block.freqs.size();
+
+  init_freq_state (left_block.freqs, left_freqs);
+  init_freq_state (right_block.freqs, right_freqs);
+
+  size_t left_start[left_freqs_size + AVOID_ARRAY_UB];
+  size_t right_start[right_freqs_size + AVOID_ARRAY_UB];
+
+  window_start (left_freqs, left_freqs_size, right_freqs, right_freqs_size, left_start);
+  window_start (right_freqs, right_freqs_size, left_freqs, left_freqs_size, right_start);
+
+  MagData mds[left_freqs_size + right_freqs_size + AVOID_ARRAY_UB];
+  size_t  mds_size = 0;
+  for (size_t i = 0; i < left_freqs_size; i++)
+    {
+      MagData& md = mds[mds_size];
+
+      md.block = MagData::BLOCK_LEFT;
+      md.index = i;
+      md.mag   = left_block.mags[i];
+      mds_size++;
+    }
+  for (size_t i = 0; i < right_freqs_size; i++)
+    {
+      MagData& md = mds[mds_size];
+
+      md.block = MagData::BLOCK_RIGHT;
+      md.index = i;
+      md.mag   = right_block.mags[i];
+      mds_size++;
+    }
+  std::sort (mds, mds + mds_size, md_cmp);
+
+  size_t n_matches = 0;
+  for (size_t m = 0; m < mds_size; m++)
+    {
+      size_t i, j;
+      bool match = false;
+      if (mds[m].block == MagData::BLOCK_LEFT)
+        {
+          i = mds[m].index;
+
+          if (!left_freqs[i].used)
+            match = find_match_from (left_freqs[i].freq_f, right_freqs, right_freqs_size, left_start[i], &j);
+        }
+      else // (mds[m].block == MagData::BLOCK_RIGHT)
+        {
+          j = mds[m].index;
+          if (!right_freqs[j].used)
+            match = find_match_from (right_freqs[j].freq_f, left_freqs, left_freqs_size, right_start[j], &i);
+        }
+      if (match)
+        {
+          matches[n_matches].left = i;
+          matches[n_matches].right = j;
+          n_matches++;
+
+          left_freqs[i].used = 1;
+          right_freqs[j].used = 1;
+        }
+    }
+  return n_matches;
+}
+
 void
 init_freq_state (const vector<uint16_t>& fint, FreqState *freq_state)
 {
@@ -74,16 +201,9 @@ init_freq_state (const RTVector<uint16_t>& fint, FreqState *freq_state)
     }
 }
 
-bool
-get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& out_audio_block)
+static int
+normalized_source_index (Audio *audio, double time_ms)
 {
-  if (!source)
-    return false;
-
-  Audio *audio = source->audio();
-  if (!audio)
-    return false;
-
   if (audio->loop_type == Audio::LOOP_TIME_FORWARD)
     {
       const double loop_start_ms = audio->loop_start * 1000.0 / audio->mix_freq;
@@ -108,8 +228,36 @@ get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& o
     {
       source_index = LiveDecoder::compute_loop_frame_index (source_index, audio);
     }
+  return source_index;
+}
+
+bool
+get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& out_audio_block)
+{
+  if (!source)
+    return false;
+
+  Audio *audio = source->audio();
+  if (!audio)
+    return false;
+
+  return source->rt_audio_block (normalized_source_index (audio, time_ms), out_audio_block);
+}
+
+/* like get_normalized_block, but only identifies the block (for caching) */
+bool
+get_normalized_block_id (LiveDecoderSource *source, double time_ms, const void **block_id)
+{
+  *block_id = nullptr;
+
+  if (!source)
+    return true;
+
+  Audio *audio = source->audio();
+  if (!audio)
+    return true;
 
-  return source->rt_audio_block (source_index, out_audio_block);
+  return source->rt_audio_block_id (normalized_source_index (audio, time_ms), block_id);
 }
 
 }
@@ -23,12 +23,22 @@ struct FreqState
   int   used;
 };
 
+struct MatchPair
+{
+  size_t left;
+  size_t right;
+};
+
 bool find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index);
 void init_freq_state (const std::vector<uint16_t>& fint, FreqState *freq_state);
 void init_freq_state (const RTVector<uint16_t>& fint, FreqState *freq_state);
 
+size_t match_partials (const RTAudioBlock& left_block, const RTAudioBlock& right_block,
+                       FreqState *left_freqs, FreqState *right_freqs, MatchPair *matches);
+
 AudioBlock* get_normalized_block_ptr (LiveDecoderSource *source, double time_ms);
 bool get_normalized_block (LiveDecoderSource *source, double time_ms, RTAudioBlock& out_audio_block);
+bool get_normalized_block_id (LiveDecoderSource *source, double time_ms, const void **block_id);
 
 }
 
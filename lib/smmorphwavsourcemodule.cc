@@ -57,8 +57,8 @@ MorphWavSourceModule::InstrumentSource::audio()
   return active_audio;
 }
 
-bool
-MorphWavSourceModule::InstrumentSource::rt_audio_block (size_t index, RTAudioBlock& out_block)
+size_t
+MorphWavSourceModule::InstrumentSource::play_index (size_t index)
 {
   WavSet *wav_set = project->get_wav_set (object_id);
   if (!wav_set)
@@ -73,7 +73,7 @@ MorphWavSourceModule::InstrumentSource::rt_audio_block (size_t index, RTAudioBlo
         {
           // play everything
           start = 0;
-          end = active_audio->contents.size() - 1;
+          end = active_audio->frame_count() - 1;
         }
       else
         {
@@ -83,9 +83,17 @@ MorphWavSourceModule::InstrumentSource::rt_audio_block (size_t index, RTAudioBlo
         }
       index = sm_bound (start, sm_round_positive ((1 - position) * start + position * end), end);
     }
-  if (active_audio && index < active_audio->contents.size())
+  return index;
+}
+
+bool
+MorphWavSourceModule::InstrumentSource::rt_audio_block (size_t index, RTAudioBlock& out_block)
+{
+  index = play_index (index);
+
+  if (active_audio && index < active_audio->frame_count())
     {
-      out_block.assign (active_audio->contents[index]);
+      out_block.assign (*active_audio, index);
       return true;
     }
   else
@@ -94,6 +102,19 @@ MorphWavSourceModule::InstrumentSource::rt_audio_block (size_t index, RTAudioBlo
     }
 }
 
+bool
+MorphWavSourceModule::InstrumentSource::rt_audio_block_id (size_t index, const void **block_id)
+{
+  index = play_index (index);
+
+  if (active_audio && index < active_audio->frame_count())
+    *block_id = active_audio->frame_id (index);
+  else
+    *block_id = nullptr;
+
+  return true;
+}
+
 void
 MorphWavSourceModule::InstrumentSource::update_project_and_object_id (Project *new_project, int new_object_id)
 {
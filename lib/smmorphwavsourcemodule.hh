@@ -23,12 +23,15 @@ class MorphWavSourceModule : public MorphOperatorModule
     Audio                  *active_audio = nullptr;
     int                     object_id = 0;
     Project                *project = nullptr;
+
+    size_t play_index (size_t index);
   public:
     MorphWavSourceModule   *module = nullptr;
 
     void retrigger (int channel, float freq, int midi_velocity) override;
     Audio *audio() override;
     bool rt_audio_block (size_t index, RTAudioBlock& out_block) override;
+    bool rt_audio_block_id (size_t index, const void **block_id) override;
 
     void update_project_and_object_id (Project *project, int object_id);
   };
@@ -6,6 +6,7 @@
 
 #include "smnoisebandpartition.hh"
 #include "smmath.hh"
+#include "smmain.hh"
 
 using namespace SpectMorph;
 using std::vector;
@@ -79,10 +80,31 @@ NoiseBandPartition::n_spectrum_bins()
   return spectrum_size;
 }
 
+namespace
+{
+
+/* (cos, sin) pairs for all 256 phases: one random byte selects one complex value */
+struct SinCosPairTable
+{
+  float values[256 * 2];
+
+  SinCosPairTable()
+  {
+    for (int r = 0; r < 256; r++)
+      {
+        values[r * 2]     = int_cosf (r);
+        values[r * 2 + 1] = int_sinf (r);
+      }
+  }
+};
+
+}
+
 void
-NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const RTVector<uint16_t>& envelope, float *spectrum, double scale)
+NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const uint16_t *envelope, float *spectrum, double scale)
 {
-  assert (envelope.size() == n_bands());
+  static const SinCosPairTable sin_cos_table; // int_sincos_table needs to be initialized before the first call
+  const float *sin_cos = sin_cos_table.values;
 
   guint32 random_data[(spectrum_size + 7) / 8];
 
@@ -96,18 +118,64 @@ NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const RTVect
     {
       const float value = sm_idb2factor (envelope[b]) * scale;
 
-      size_t start = band_start[b];
-      size_t end = start + band_count[b] * 2;
-      for (size_t d = start; d < end; d += 2)
+      size_t d = band_start[b];
+      size_t end = d + band_count[b] * 2;
+
+      /* Generate complex numbers with:
+       *  - phase:     r / 256.0 * 2 * M_PI
+       *  - magnitude: value
+       */
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+      if (sm_sse())
+        {
+          /* two complex values per step */
+          const __m128 value4 = _mm_set_ps (value, value, value, value);
+
+          for (; d + 4 <= end; d += 4)
+            {
+              const float *cs0 = &sin_cos[random_data_byte[d / 2] * 2];
+              const float *cs1 = &sin_cos[random_data_byte[d / 2 + 1] * 2];
+
+              __m128 cs = _mm_loadl_pi (_mm_setzero_ps(), reinterpret_cast<const __m64 *> (cs0));
+              cs = _mm_loadh_pi (cs, reinterpret_cast<const __m64 *> (cs1));
+
+              _mm_storeu_ps (spectrum + d, _mm_mul_ps (cs, value4));
+            }
+        }
+#endif
+      for (; d < end; d += 2)
+        {
+          const float *cs = &sin_cos[random_data_byte[d / 2] * 2];
+
+          spectrum[d]   = cs[0] * value;
+          spectrum[d+1] = cs[1] * value;
+        }
+    }
+}
+
+/* same as above, but the unit magnitude random phase values are read from a precomputed texture */
+void
+NoiseBandPartition::noise_envelope_to_spectrum (const float *texture, const uint16_t *envelope, float *spectrum, double scale)
+{
+  zero_float_block (spectrum_size, spectrum);
+
+  for (size_t b = 0; b < n_bands(); b++)
+    {
+      const float value = sm_idb2factor (envelope[b]) * scale;
+
+      size_t d = band_start[b];
+      size_t end = d + band_count[b] * 2;
+
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+      if (sm_sse())
         {
-          /* Generate complex number with:
-           *  - phase:     r / 256.0 * 2 * M_PI
-           *  - magnitude: value
-           */
-          const guint8 r = random_data_byte[d / 2];
-
-          spectrum[d]   = int_cosf (r) * value;
-          spectrum[d+1] = int_sinf (r) * value;
+          const __m128 value4 = _mm_set_ps (value, value, value, value);
+
+          for (; d + 4 <= end; d += 4)
+            _mm_storeu_ps (spectrum + d, _mm_mul_ps (_mm_loadu_ps (texture + d), value4));
         }
+#endif
+      for (; d < end; d++)
+        spectrum[d] = texture[d] * value;
     }
 }
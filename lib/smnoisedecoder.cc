@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <map>
 #include <mutex>
+#include <atomic>
 
 using std::vector;
 using SpectMorph::NoiseDecoder;
@@ -18,6 +19,8 @@ using SpectMorph::sm_sse;
 
 static std::mutex cos_window_mutex;
 static map<size_t, float *> cos_window_for_block_size;
+static map<size_t, float *> noise_textures_for_block_size;
+static std::atomic<bool>    noise_texture_enabled;
 
 static size_t
 next_power2 (size_t i)
@@ -48,6 +51,7 @@ NoiseDecoder::NoiseDecoder (double mix_freq, size_t block_size) :
         win[i] = window_cos (2.0 * i / block_size - 1.0);
     }
   cos_window = win;
+  noise_textures = make_noise_textures (block_size);
 
   make_k_array();
 
@@ -80,13 +84,36 @@ NoiseDecoder::process (const RTAudioBlock& audio_block,
                        OutputMode          output_mode,
                        float               portamento_stretch)
 {
-  assert (noise_band_partition.n_bands() == audio_block.noise.size());
+  process (audio_block.view(), samples, output_mode, portamento_stretch);
+}
+
+void
+NoiseDecoder::process (const AudioFrameView& frame,
+                       float                *samples,
+                       OutputMode            output_mode,
+                       float                 portamento_stretch)
+{
+  assert (noise_band_partition.n_bands() == frame.n_noise);
   assert (noise_band_partition.n_spectrum_bins() == block_size + 2);
 
   const double Eww = 0.375; // expected value of the energy of the window
   const double norm = mix_freq / (Eww * block_size);
 
-  noise_band_partition.noise_envelope_to_spectrum (random_gen, audio_block.noise, interpolated_spectrum, sqrt (norm) / 2);
+  if (noise_texture_enabled.load (std::memory_order_relaxed))
+    {
+      /* pick one of the textures and a random (even) start bin, so a texture rarely repeats with the same alignment */
+      const size_t spectrum_size = block_size + 2;
+      const uint32_t r = random_gen.random_uint32();
+      const size_t texture = r % N_NOISE_TEXTURES;
+      const size_t offset = 2 * ((r / N_NOISE_TEXTURES) % (spectrum_size / 2));
+
+      noise_band_partition.noise_envelope_to_spectrum (noise_textures + texture * 2 * spectrum_size + offset,
+                                                       frame.noise, interpolated_spectrum, sqrt (norm) / 2);
+    }
+  else
+    {
+      noise_band_partition.noise_envelope_to_spectrum (random_gen, frame.noise, interpolated_spectrum, sqrt (norm) / 2);
+    }
 
   if (portamento_stretch > 1.01) // avoid aliasing during portamento
     {
@@ -169,6 +196,51 @@ NoiseDecoder::preferred_block_size (double mix_freq)
   return bs;
 }
 
+void
+NoiseDecoder::set_noise_texture (bool enable)
+{
+  noise_texture_enabled.store (enable);
+}
+
+bool
+NoiseDecoder::noise_texture()
+{
+  return noise_texture_enabled.load();
+}
+
+/* must be called with cos_window_mutex locked
+ *
+ * each texture contains spectrum_size unit magnitude complex values with random
+ * phase, stored twice so that reading spectrum_size values from any offset
+ * < spectrum_size doesn't need to wrap around
+ */
+const float *
+NoiseDecoder::make_noise_textures (size_t block_size)
+{
+  const size_t spectrum_size = block_size + 2;
+
+  float*& textures = noise_textures_for_block_size[block_size];
+  if (!textures)
+    {
+      Random random;
+      random.set_seed (block_size); // deterministic output
+
+      textures = FFT::new_array_float (N_NOISE_TEXTURES * 2 * spectrum_size);
+      for (size_t t = 0; t < N_NOISE_TEXTURES; t++)
+        {
+          float *texture = textures + t * 2 * spectrum_size;
+          for (size_t d = 0; d < spectrum_size; d += 2)
+            {
+              const double phase = random.random_double_range (0, 2 * M_PI);
+
+              texture[d]     = texture[d + spectrum_size]     = cos (phase);
+              texture[d + 1] = texture[d + 1 + spectrum_size] = sin (phase);
+            }
+        }
+    }
+  return textures;
+}
+
 float *
 NoiseDecoder::make_k_array()
 {
@@ -20,12 +20,14 @@ class NoiseDecoder
 
   float *cos_window;
   float *interpolated_spectrum;
+  const float *noise_textures;
 
   Random random_gen;
   NoiseBandPartition noise_band_partition;
 
   void apply_window (float *spectrum, float *fft_buffer);
   static float *make_k_array();
+  static const float *make_noise_textures (size_t block_size);
 
 public:
   NoiseDecoder (double mix_freq,
@@ -39,9 +41,19 @@ public:
                 float *samples,
                 OutputMode output_mode = REPLACE,
                 float portamento_stretch = 1.0);
+  void process (const AudioFrameView& frame,
+                float *samples,
+                OutputMode output_mode = REPLACE,
+                float portamento_stretch = 1.0);
   void precompute_tables();
 
   static size_t preferred_block_size (double mix_freq);
+
+  /* use precomputed random phase spectra instead of generating random phases for each frame */
+  static void set_noise_texture (bool enable);
+  static bool noise_texture();
+
+  static constexpr size_t N_NOISE_TEXTURES = 16;
 };
 
 }
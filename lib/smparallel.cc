@@ -0,0 +1,124 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smparallel.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace SpectMorph;
+
+void
+SpectMorph::parallel_for (size_t n_threads, size_t n, const std::function<void (size_t worker, size_t index)>& function)
+{
+  n_threads = std::max<size_t> (std::min (n_threads, n), 1);
+
+  if (n_threads == 1)
+    {
+      for (size_t i = 0; i < n; i++)
+        function (0, i);
+      return;
+    }
+
+  std::atomic<size_t> next_index { 0 };
+  auto work = [&] (size_t worker)
+    {
+      size_t i;
+      while ((i = next_index.fetch_add (1)) < n)
+        function (worker, i);
+    };
+
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < n_threads; t++)
+    threads.emplace_back (work, t);
+
+  work (0);
+
+  for (auto& t : threads)
+    t.join();
+}
+
+size_t
+SpectMorph::parallel_default_threads()
+{
+  return std::max (std::thread::hardware_concurrency(), 1u);
+}
+
+ParallelWorkers::ParallelWorkers (size_t n_threads)
+{
+  for (size_t t = 1; t < n_threads; t++)
+    m_threads.emplace_back (&ParallelWorkers::thread_main, this, t);
+}
+
+ParallelWorkers::~ParallelWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_quit = true;
+  }
+  m_start_cond.notify_all();
+
+  for (auto& t : m_threads)
+    t.join();
+}
+
+void
+ParallelWorkers::work (size_t worker)
+{
+  size_t i;
+  while ((i = m_next_index.fetch_add (1)) < m_n)
+    (*m_function) (worker, i);
+}
+
+void
+ParallelWorkers::thread_main (size_t worker)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+
+  size_t last_job = 0;
+  for (;;)
+    {
+      m_start_cond.wait (lock, [&] { return m_quit || m_job != last_job; });
+      if (m_quit)
+        return;
+
+      last_job = m_job;
+
+      lock.unlock();
+      work (worker);
+      lock.lock();
+
+      /* parallel_for() waits until all threads are done, so no thread misses a job */
+      if (--m_busy == 0)
+        m_done_cond.notify_one();
+    }
+}
+
+void
+ParallelWorkers::parallel_for (size_t n, const std::function<void (size_t worker, size_t index)>& function)
+{
+  if (m_threads.empty() || n < 2)
+    {
+      for (size_t i = 0; i < n; i++)
+        function (0, i);
+      return;
+    }
+
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+
+    m_function = &function;
+    m_n = n;
+    m_next_index = 0;
+    m_busy = m_threads.size();
+    m_job++;
+  }
+  m_start_cond.notify_all();
+
+  work (0);
+
+  std::unique_lock<std::mutex> lock (m_mutex);
+  m_done_cond.wait (lock, [&] { return m_busy == 0; });
+  m_function = nullptr;
+}
@@ -0,0 +1,63 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_PARALLEL_HH
+#define SPECTMORPH_PARALLEL_HH
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+namespace SpectMorph
+{
+
+/**
+ * Calls function (worker, index) once for each index in [0, n), using up to
+ * n_threads threads. The calling thread is worker 0, the worker index can be
+ * used to access per thread scratch data. Indices are handed out dynamically,
+ * so the order of the calls is unspecified, unless n_threads is 1, in which
+ * case everything runs in the calling thread in ascending index order.
+ *
+ * This is not intended for realtime code: threads are started for each call.
+ */
+void parallel_for (size_t n_threads, size_t n, const std::function<void (size_t worker, size_t index)>& function);
+
+/**
+ * Number of threads to use by default: the number of cpus.
+ */
+size_t parallel_default_threads();
+
+/**
+ * Like parallel_for(), but the threads are started once and reused for each
+ * call, which is better for code that runs many short loops one after another.
+ * Only one thread may call parallel_for() at a time.
+ */
+class ParallelWorkers
+{
+  std::mutex               m_mutex;
+  std::condition_variable  m_start_cond;
+  std::condition_variable  m_done_cond;
+  std::vector<std::thread> m_threads;
+
+  const std::function<void (size_t, size_t)> *m_function = nullptr;
+  size_t                   m_n = 0;
+  std::atomic<size_t>      m_next_index { 0 };
+  size_t                   m_job = 0;
+  size_t                   m_busy = 0;
+  bool                     m_quit = false;
+
+  void work (size_t worker);
+  void thread_main (size_t worker);
+public:
+  ParallelWorkers (size_t n_threads);
+  ~ParallelWorkers();
+
+  void parallel_for (size_t n, const std::function<void (size_t worker, size_t index)>& function);
+};
+
+}
+
+#endif
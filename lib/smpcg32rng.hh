@@ -86,6 +86,37 @@ public:
     accu_ = A * accu_ + increment_;
     return pcg_xsh_rr (lcgout);         // PCG XOR-shift + random rotation
   }
+  /// Generate @a n_values random numbers, the result is the same as calling random() @a n_values times.
+  void
+  random_block (size_t n_values, uint32_t *values)
+  {
+    // four interleaved generator states: the multiplications of the states don't depend on
+    // each other, so they can be executed in parallel (unlike the serial chain in random())
+    constexpr const uint64_t A2 = A * A;
+    constexpr const uint64_t A4 = A2 * A2;
+    const uint64_t increment4 = (A2 * A + A2 + A + 1) * increment_;
+
+    uint64_t accu0 = accu_;
+    uint64_t accu1 = A * accu0 + increment_;
+    uint64_t accu2 = A * accu1 + increment_;
+    uint64_t accu3 = A * accu2 + increment_;
+    while (n_values >= 4)
+      {
+        values[0] = pcg_xsh_rr (accu0);
+        values[1] = pcg_xsh_rr (accu1);
+        values[2] = pcg_xsh_rr (accu2);
+        values[3] = pcg_xsh_rr (accu3);
+        accu0 = A4 * accu0 + increment4;
+        accu1 = A4 * accu1 + increment4;
+        accu2 = A4 * accu2 + increment4;
+        accu3 = A4 * accu3 + increment4;
+        values += 4;
+        n_values -= 4;
+      }
+    accu_ = accu0;
+    while (n_values--)
+      *values++ = random();
+  }
 };
 
 }
@@ -10,6 +10,8 @@
 #include "smuserinstrumentindex.hh"
 #include "smproject.hh"
 #include "smhexstring.hh"
+#include "smconfig.hh"
+#include "smnoisedecoder.hh"
 
 using namespace SpectMorph;
 
@@ -18,64 +20,114 @@ using std::vector;
 using std::set;
 using std::map;
 
+ControlEventQueue::~ControlEventQueue()
+{
+  destroy_all_events();
+}
+
+void
+ControlEventQueue::take (SynthControlEvent *ev)
+{
+  std::lock_guard<std::mutex> lg (producer_mutex);
+
+  overflow.push_back (ev);
+  flush_L();
+}
+
+void
+ControlEventQueue::flush()
+{
+  std::lock_guard<std::mutex> lg (producer_mutex);
+
+  flush_L();
+}
+
 void
-ControlEventVector::take (SynthControlEvent *ev)
+ControlEventQueue::flush_L()
 {
   // we'd rather run destructors in non-rt part of the code
-  if (clear)
-    {
-      events.clear();
-      clear = false;
-    }
+  SynthControlEvent *ev;
+  while (done.pop (ev))
+    delete ev;
 
-  events.emplace_back (ev);
+  // if the audio thread didn't keep up, events wait here (in order) until there is space
+  size_t n_sent = 0;
+  while (n_sent < overflow.size() && pending.push (overflow[n_sent]))
+    n_sent++;
+  overflow.erase (overflow.begin(), overflow.begin() + n_sent);
 }
 
 void
-ControlEventVector::run_rt (Project *project)
+ControlEventQueue::run_rt (Project *project)
 {
-  if (!clear)
-    {
-      for (const auto& ev : events)
-        ev->run_rt (project);
+  SynthControlEvent *ev;
 
-      clear = true;
+  // only take an event if we can return it, the audio thread must not free it
+  while (done.can_push() && pending.pop (ev))
+    {
+      ev->run_rt (project);
+      done.push (ev);
     }
 }
 
 void
-ControlEventVector::destroy_all_events()
+ControlEventQueue::destroy_all_events()
 {
-  events.clear();
-  clear = false;
-}
+  /* only safe if the audio thread is not running */
+  std::lock_guard<std::mutex> lg (producer_mutex);
 
+  SynthControlEvent *ev;
+  while (done.pop (ev))
+    delete ev;
+  while (pending.pop (ev))
+    delete ev;
+  for (auto overflow_ev : overflow)
+    delete overflow_ev;
+  overflow.clear();
+}
 
 bool
 Project::try_update_synth()
 {
-  bool state_changed = false;
-  // handle synth updates (if locking is possible without blocking)
+  // handle synth updates (never blocks)
   //  - apply new parameters
   //  - process events
-  if (m_synth_mutex.try_lock())
+  m_control_events.run_rt (this);
+
+  return m_state_changed.exchange (false);
+}
+
+/*
+ * offline rendering (not rt safe): runs the synthesis side of the control event
+ * queue in the calling thread until all instruments are built, so that the synth
+ * is complete before the first note is rendered
+ */
+void
+Project::wait_for_rebuilds()
+{
+  while (m_builder_thread.job_count() > 0)
     {
-      m_control_events.run_rt (this);
-      state_changed = m_state_changed;
-      m_state_changed = false;
+      synth_flush_control_events();
+      try_update_synth();
 
-      m_synth_mutex.unlock();
+      std::this_thread::sleep_for (std::chrono::milliseconds (10));
     }
-  return state_changed;
+  synth_flush_control_events();
+  try_update_synth();
 }
 
 void
 Project::synth_take_control_event (SynthControlEvent *event)
 {
-  std::lock_guard<std::mutex> lg (m_synth_mutex);
   m_control_events.take (event);
 }
 
+void
+Project::synth_flush_control_events()
+{
+  m_control_events.flush();
+}
+
 void
 Project::rebuild (MorphWavSource *wav_source)
 {
@@ -95,6 +147,11 @@ Project::rebuild (MorphWavSource *wav_source)
   m_builder_thread.add_job (builder, object_id,
     [this, object_id] (WavSet *wav_set)
       {
+        // the synthesis engine only reads the frames, so we can use the compact frame store
+        for (auto& wave : wav_set->waves)
+          if (wave.audio)
+            wave.audio->pack_frames();
+
         synth_interface()->emit_add_rebuild_result (object_id, wav_set);
       });
 }
@@ -107,6 +164,12 @@ Project::rebuild_active (int object_id)
   return m_builder_thread.search_job (object_id);
 }
 
+double
+Project::rebuild_progress (int object_id)
+{
+  return m_builder_thread.job_progress (object_id);
+}
+
 void
 Project::add_rebuild_result (int object_id, std::unique_ptr<WavSet>& wav_set)
 {
@@ -116,6 +179,10 @@ Project::add_rebuild_result (int object_id, std::unique_ptr<WavSet>& wav_set)
     wav_sets.resize (s);
 
   wav_sets[object_id].swap (wav_set);
+
+  // morph results are cached by frame address, which may be reused after the old wav set is freed
+  if (m_midi_synth)
+    m_midi_synth->invalidate_block_caches();
 }
 
 void
@@ -123,6 +190,9 @@ Project::clear_wav_sets (vector<std::unique_ptr<WavSet>>& new_wav_sets)
 {
   // this function runs in audio thread
   wav_sets.swap (new_wav_sets);
+
+  if (m_midi_synth)
+    m_midi_synth->invalidate_block_caches();
 }
 
 Instrument *
@@ -216,6 +286,24 @@ Project::set_mix_freq (double mix_freq)
   auto update = m_midi_synth->prepare_update (m_morph_plan);
   m_midi_synth->apply_update (update);
   m_midi_synth->set_gain (db_to_factor (m_volume));
+
+  // not rt safe either: starts render threads, if configured
+  Config cfg;
+  m_midi_synth->set_render_threads (std::max (cfg.render_threads(), 1));
+  m_midi_synth->set_filter_batch (cfg.filter_batch());
+  m_midi_synth->set_spectral_bus (cfg.spectral_bus());
+
+  VoiceScheduler::Config vs_config;
+  if (!VoiceScheduler::parse_steal_policy (cfg.voice_steal(), vs_config.steal_policy))
+    fprintf (stderr, "SpectMorph: unsupported voice_steal policy '%s' in config\n", cfg.voice_steal().c_str());
+  vs_config.cpu_budget = std::clamp (cfg.voice_cpu_budget(), 0, 100) / 100.0;
+  vs_config.reduce_unison = cfg.voice_reduce_unison();
+  vs_config.lod_threshold = cfg.lod_threshold_db() < 0 ? db_to_factor (cfg.lod_threshold_db()) : 0; // 0 dB: off
+  vs_config.lod_max_partials = std::max (cfg.lod_max_partials(), 0);
+  m_midi_synth->set_voice_scheduler_config (vs_config);
+
+  // applies to all noise decoders, existing and new ones
+  NoiseDecoder::set_noise_texture (cfg.noise_texture());
 }
 
 void
@@ -10,6 +10,7 @@
 #include "smmorphplan.hh"
 #include "smuserinstrumentindex.hh"
 #include "smnotifybuffer.hh"
+#include "smspscqueue.hh"
 
 #include <thread>
 #include <mutex>
@@ -53,12 +54,30 @@ public:
   }
 };
 
-class ControlEventVector
+/**
+ * \brief Passes control events from non-realtime threads to the audio thread
+ *
+ * Events are sent to the audio thread using a wait-free queue. After running an
+ * event, the audio thread sends it back using a second queue, so that it can be
+ * freed in a non-realtime thread (along with anything the event has swapped out
+ * of the synthesis engine). The audio thread never blocks and never frees memory.
+ */
+class ControlEventQueue
 {
-  std::vector<std::unique_ptr<SynthControlEvent>> events;
-  bool clear = false;
+  static constexpr size_t QUEUE_SIZE = 1024;
+
+  SPSCQueue<SynthControlEvent *>   pending { QUEUE_SIZE };  // non-rt -> audio thread
+  SPSCQueue<SynthControlEvent *>   done { QUEUE_SIZE };     // audio thread -> non-rt (for freeing)
+
+  std::mutex                       producer_mutex;          // serializes non-rt threads (ui, builder thread)
+  std::vector<SynthControlEvent *> overflow;                // protected by producer mutex
+
+  void flush_L();
 public:
+  ~ControlEventQueue();
+
   void take (SynthControlEvent *ev);
+  void flush();
   void run_rt (Project *project);
   void destroy_all_events();
 };
@@ -83,10 +102,8 @@ private:
   bool                        m_state_changed_notify = false;
   StorageModel                m_storage_model = StorageModel::COPY;
 
-  std::mutex                  m_synth_mutex;
-  ControlEventVector          m_control_events;          // protected by synth mutex
-  NotifyBuffer                m_notify_buffer;           // protected by synth mutex
-  bool                        m_state_changed = false;   // protected by synth mutex
+  ControlEventQueue           m_control_events;
+  std::atomic<bool>           m_state_changed { false };
 
   std::unique_ptr<SynthInterface> m_synth_interface;
 
@@ -113,28 +130,21 @@ public:
   void add_rebuild_result (int object_id, std::unique_ptr<WavSet>& wav_set);
   void clear_wav_sets (std::vector<std::unique_ptr<WavSet>>& wav_sets);
   bool rebuild_active (int object_id);
+  double rebuild_progress (int object_id);
 
   WavSet *get_wav_set (int object_id);
 
   void synth_take_control_event (SynthControlEvent *event);
-
-  std::mutex&
-  synth_mutex()
-  {
-    /* the synthesis thread will typically not block on synth_mutex
-     * instead, it tries locking it, and if that fails, continues
-     *
-     * the ui thread will block on the synth_mutex to enqueue events,
-     * parameter changes (in form of a new morph plan, volume, ...)
-     * and so on
-     *
-     * if the synthesis thread can obtain a lock, it will then be
-     * able to process these events to update its internal state
-     * and also send notifications back to the ui
-     */
-    return m_synth_mutex;
-  }
+  void synth_flush_control_events();
+
+  /* the ui thread (or another non-rt thread) sends events with parameter changes
+   * (in form of a new morph plan, volume, ...) and so on using the control event queue
+   *
+   * the synthesis thread calls try_update_synth() to run these events, to update
+   * its internal state; this never blocks, so updates are never delayed
+   */
   bool try_update_synth();
+  void wait_for_rebuilds();
   void set_mix_freq (double mix_freq);
   void set_storage_model (StorageModel model);
   void set_state_changed_notify (bool notify);
@@ -36,8 +36,7 @@ public:
   inline void
   random_block (size_t n_values, uint32_t *values)
   {
-    while (n_values--)
-      *values++ = random_uint32();
+    rand_gen.random_block (n_values, values);
   }
 };
 
@@ -99,6 +99,15 @@ public:
     std::copy (vec.m_start, vec.m_start + vec.m_size, m_start);
     m_size = vec.size();
   }
+  void
+  assign (const T *data, size_t n)
+  {
+    assert (m_size == 0 && m_capacity == 0);
+
+    set_capacity (n);
+    std::copy (data, data + n, m_start);
+    m_size = n;
+  }
   size_t
   size() const
   {
@@ -118,6 +127,16 @@ public:
     assert (m_size < m_capacity);
     m_start[m_size++] = t;
   }
+  T *
+  data()
+  {
+    return m_start;
+  }
+  const T *
+  data() const
+  {
+    return m_start;
+  }
   T&
   back()
   {
@@ -158,6 +177,29 @@ public:
     mags.assign (audio_block.mags);
     noise.assign (audio_block.noise);
   }
+  void
+  assign (const AudioFrameView& frame)
+  {
+    freqs.assign (frame.freqs, frame.n_partials);
+    mags.assign (frame.mags, frame.n_partials);
+    noise.assign (frame.noise, frame.n_noise);
+  }
+  void
+  assign (const Audio& audio, size_t frame)
+  {
+    assign (audio.frame (frame));
+  }
+  AudioFrameView
+  view() const
+  {
+    AudioFrameView view;
+    view.freqs      = freqs.data();
+    view.mags       = mags.data();
+    view.noise      = noise.data();
+    view.n_partials = freqs.size();
+    view.n_noise    = noise.size();
+    return view;
+  }
   RTVector<uint16_t> freqs;
   RTVector<uint16_t> mags;
   RTVector<uint16_t> noise;
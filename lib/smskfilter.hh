@@ -3,8 +3,15 @@
 #pragma once
 
 #include "smpandaresampler.hh"
+#include "smmatharm.hh"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #include <algorithm>
+#include <array>
+#include <cassert>
 
 namespace SpectMorph {
 
@@ -18,6 +25,17 @@ public:
     BP2, BP4, BP6, BP8,
     HP1, HP2, HP3, HP4, HP6, HP8
   };
+  static constexpr int MAX_STAGES = 4;
+
+  /* filter coefficients for one input sample (used by process_lanes) */
+  struct Coeffs
+  {
+    float G;
+    std::array<float, MAX_STAGES> xnorm;
+    std::array<float, MAX_STAGES> s1feedback;
+    std::array<float, MAX_STAGES> s2feedback;
+    float pre_scale, post_scale;
+  };
 private:
   static constexpr size_t LAST_MODE = HP8;
   Mode mode_ = Mode::LP2;
@@ -34,7 +52,6 @@ private:
   float clamp_freq_max_ = 0;
   float rate_ = 0;
 
-  static constexpr int MAX_STAGES = 4;
   static constexpr uint MAX_BLOCK_SIZE = 1024;
 
   struct Channel
@@ -343,21 +360,40 @@ private:
 
     return x * (27.0f + x * x) / (27.0f + 9.0f * x * x);
   }
-  template<Mode MODE, bool STEREO>
-  [[gnu::flatten]]
   void
-  process (float *left, float *right, float freq, uint n_samples)
+  setup_coeffs (Coeffs& coeffs, float freq)
   {
     float g = cutoff_warp (std::clamp (freq, clamp_freq_min_, clamp_freq_max_));
     float G = g / (1 + g);
 
-    for (int stage = 0; stage < mode2stages (MODE); stage++)
+    coeffs.G = G;
+    for (int stage = 0; stage < mode2stages (mode_); stage++)
       {
         const float k = fparams_.k[stage];
 
         float xnorm = 1.f / (1 - k * G + k * G * G);
-        float s1feedback = -xnorm * k * (G - 1) / (1 + g);
-        float s2feedback = -xnorm * k / (1 + g);
+        coeffs.xnorm[stage] = xnorm;
+        coeffs.s1feedback[stage] = -xnorm * k * (G - 1) / (1 + g);
+        coeffs.s2feedback[stage] = -xnorm * k / (1 + g);
+      }
+    coeffs.pre_scale = fparams_.pre_scale;
+    coeffs.post_scale = fparams_.post_scale;
+  }
+  template<Mode MODE, bool STEREO>
+  [[gnu::flatten]]
+  void
+  process (float *left, float *right, float freq, uint n_samples)
+  {
+    Coeffs coeffs;
+    setup_coeffs (coeffs, freq);
+
+    const float G = coeffs.G;
+
+    for (int stage = 0; stage < mode2stages (MODE); stage++)
+      {
+        const float xnorm = coeffs.xnorm[stage];
+        const float s1feedback = coeffs.s1feedback[stage];
+        const float s2feedback = coeffs.s2feedback[stage];
 
         auto lowpass = [G] (float in, float& state)
           {
@@ -604,6 +640,268 @@ public:
         n_samples -= todo;
       }
   }
+  /*
+   * Batched processing: up to LANES mono filters with the same mode can be
+   * processed at once, using one SIMD lane per filter. This produces the same
+   * output as calling process_block() for each filter (left channel only):
+   *
+   *  - compute_coeffs() computes the filter coefficients for each input sample
+   *  - upsample() computes the oversampled filter input
+   *  - process_lanes() runs the filters on the oversampled input (in place)
+   *  - downsample() computes the filter output
+   */
+  static constexpr uint LANES = 4;
+
+  void
+  compute_coeffs (uint n_samples, Coeffs *coeffs, const float *freq_in = nullptr, const float *reso_in = nullptr, const float *drive_in = nullptr)
+  {
+    /* this needs to match process_block() / process_block_mode() exactly */
+    const int stages = mode2stages (mode_);
+
+    while (n_samples)
+      {
+        const uint todo = std::min (n_samples, MAX_BLOCK_SIZE);
+
+        if (!fparams_valid_)
+          {
+            setup_reso_drive (fparams_, reso_in ? reso_in[0] : reso_, drive_in ? drive_in[0] : drive_);
+            fparams_valid_ = true;
+          }
+        if (reso_in || drive_in)
+          {
+            uint n_remaining_samples = todo;
+            while (n_remaining_samples)
+              {
+                const uint block_todo = std::min<uint> (n_remaining_samples, 64);
+
+                FParams fparams_end;
+                setup_reso_drive (fparams_end, reso_in ? reso_in[block_todo - 1] : reso_, drive_in ? drive_in[block_todo - 1] : drive_);
+
+                float todo_inv = 1.f / block_todo;
+                float delta_pre_scale = (fparams_end.pre_scale - fparams_.pre_scale) * todo_inv;
+                float delta_post_scale = (fparams_end.post_scale - fparams_.post_scale) * todo_inv;
+                float delta_k[MAX_STAGES];
+                for (int stage = 0; stage < stages; stage++)
+                  delta_k[stage] = (fparams_end.k[stage] - fparams_.k[stage]) * todo_inv;
+
+                for (uint i = 0; i < block_todo; i++)
+                  {
+                    fparams_.pre_scale += delta_pre_scale;
+                    fparams_.post_scale += delta_post_scale;
+
+                    for (int stage = 0; stage < stages; stage++)
+                      fparams_.k[stage] += delta_k[stage];
+
+                    setup_coeffs (*coeffs++, freq_in ? freq_in[i] : freq_);
+                  }
+
+                n_remaining_samples -= block_todo;
+
+                if (freq_in)
+                  freq_in += block_todo;
+                if (reso_in)
+                  reso_in += block_todo;
+                if (drive_in)
+                  drive_in += block_todo;
+              }
+          }
+        else
+          {
+            for (uint i = 0; i < todo; i++)
+              setup_coeffs (*coeffs++, freq_in ? freq_in[i] : freq_);
+
+            if (freq_in)
+              freq_in += todo;
+          }
+        n_samples -= todo;
+      }
+  }
+  void
+  upsample (uint n_samples, const float *input, float *over_samples)
+  {
+    channels_[0].res_up->process_block (input, n_samples, over_samples);
+  }
+  void
+  downsample (uint n_samples, const float *over_samples, float *output)
+  {
+    channels_[0].res_down->process_block (over_samples, n_samples * over_, output);
+  }
+  Mode
+  mode() const
+  {
+    return mode_;
+  }
+  int
+  oversample() const
+  {
+    return over_;
+  }
+#if defined(__SSE__) || defined(SM_ARM_SSE)
+private:
+  template<Mode MODE>
+  static void
+  process_lanes_mode (Channel **channels, const Coeffs **coeffs, float **over_samples, uint n_samples)
+  {
+    constexpr int STAGES = mode2stages (MODE);
+
+    __m128 s1[STAGES], s2[STAGES];
+    for (int stage = 0; stage < STAGES; stage++)
+      {
+        s1[stage] = _mm_set_ps (channels[3]->s1[stage], channels[2]->s1[stage], channels[1]->s1[stage], channels[0]->s1[stage]);
+        s2[stage] = _mm_set_ps (channels[3]->s2[stage], channels[2]->s2[stage], channels[1]->s2[stage], channels[0]->s2[stage]);
+      }
+
+    const __m128 tanh_min = _mm_set_ps (-3, -3, -3, -3);
+    const __m128 tanh_max = _mm_set_ps (3, 3, 3, 3);
+    const __m128 c27 = _mm_set_ps (27, 27, 27, 27);
+    const __m128 c9 = _mm_set_ps (9, 9, 9, 9);
+
+    auto mode_out = [] (__m128 y0, __m128 y1, __m128 y2, bool last_stage) -> __m128
+      {
+        const __m128 y1hp = _mm_sub_ps (y0, y1);
+        const __m128 y2hp = _mm_sub_ps (y1, y2);
+
+        switch (MODE)
+          {
+            case LP2:
+            case LP4:
+            case LP6:
+            case LP8: return y2;
+            case BP2:
+            case BP4:
+            case BP6:
+            case BP8: return y2hp;
+            case HP2:
+            case HP4:
+            case HP6:
+            case HP8: return _mm_sub_ps (y1hp, y2hp);
+            case LP1:
+            case LP3: return last_stage ? y1 : y2;
+            case HP1:
+            case HP3: return last_stage ? y1hp : _mm_sub_ps (y1hp, y2hp);
+          }
+      };
+
+    for (uint i = 0; i < n_samples; i++)
+      {
+        auto load_coeff = [&] (auto get) {
+          return _mm_set_ps (get (coeffs[3][i]), get (coeffs[2][i]), get (coeffs[1][i]), get (coeffs[0][i]));
+        };
+        const __m128 G = load_coeff ([] (const Coeffs& c) { return c.G; });
+        const __m128 pre_scale = load_coeff ([] (const Coeffs& c) { return c.pre_scale; });
+        const __m128 post_scale = load_coeff ([] (const Coeffs& c) { return c.post_scale; });
+
+        /* one row per lane => one row per oversampled value */
+        __m128 v[4] = {
+          _mm_loadu_ps (over_samples[0] + i * 4),
+          _mm_loadu_ps (over_samples[1] + i * 4),
+          _mm_loadu_ps (over_samples[2] + i * 4),
+          _mm_loadu_ps (over_samples[3] + i * 4)
+        };
+        _MM_TRANSPOSE4_PS (v[0], v[1], v[2], v[3]);
+
+        for (int stage = 0; stage < STAGES; stage++)
+          {
+            const __m128 xnorm = load_coeff ([stage] (const Coeffs& c) { return c.xnorm[stage]; });
+            const __m128 s1feedback = load_coeff ([stage] (const Coeffs& c) { return c.s1feedback[stage]; });
+            const __m128 s2feedback = load_coeff ([stage] (const Coeffs& c) { return c.s2feedback[stage]; });
+            const bool last_stage = STAGES == (stage + 1);
+
+            auto lowpass = [G] (__m128 in, __m128& state)
+              {
+                __m128 v = _mm_mul_ps (G, _mm_sub_ps (in, state));
+                __m128 y = _mm_add_ps (v, state);
+                state = _mm_add_ps (y, v);
+                return y;
+              };
+            for (int os = 0; os < 4; os++)
+              {
+                __m128 x = v[os];
+                if (last_stage)
+                  x = _mm_mul_ps (x, pre_scale);
+
+                __m128 y0 = _mm_add_ps (_mm_add_ps (_mm_mul_ps (x, xnorm), _mm_mul_ps (s1[stage], s1feedback)), _mm_mul_ps (s2[stage], s2feedback));
+                if (last_stage)
+                  {
+                    /* tanh_approx (y0) */
+                    y0 = _mm_max_ps (_mm_min_ps (y0, tanh_max), tanh_min);
+                    y0 = _mm_div_ps (_mm_mul_ps (y0, _mm_add_ps (c27, _mm_mul_ps (y0, y0))),
+                                     _mm_add_ps (c27, _mm_mul_ps (_mm_mul_ps (c9, y0), y0)));
+                  }
+                const __m128 y1 = lowpass (y0, s1[stage]);
+                const __m128 y2 = lowpass (y1, s2[stage]);
+
+                v[os] = mode_out (y0, y1, y2, last_stage);
+                if (last_stage)
+                  v[os] = _mm_mul_ps (v[os], post_scale);
+              }
+          }
+
+        _MM_TRANSPOSE4_PS (v[0], v[1], v[2], v[3]);
+        _mm_storeu_ps (over_samples[0] + i * 4, v[0]);
+        _mm_storeu_ps (over_samples[1] + i * 4, v[1]);
+        _mm_storeu_ps (over_samples[2] + i * 4, v[2]);
+        _mm_storeu_ps (over_samples[3] + i * 4, v[3]);
+      }
+    for (int stage = 0; stage < STAGES; stage++)
+      {
+        alignas (16) float f1[4], f2[4];
+        _mm_storeu_ps (f1, s1[stage]);
+        _mm_storeu_ps (f2, s2[stage]);
+        for (uint l = 0; l < LANES; l++)
+          {
+            channels[l]->s1[stage] = f1[l];
+            channels[l]->s2[stage] = f2[l];
+          }
+      }
+  }
+
+  using ProcessLanesFunc = decltype (&SKFilter::process_lanes_mode<LP2>);
+
+  template<size_t... INDICES>
+  static constexpr std::array<ProcessLanesFunc, LAST_MODE + 1>
+  make_lanes_jump_table (std::integer_sequence<size_t, INDICES...>)
+  {
+    auto mk_func = [] (auto I) { return &SKFilter::process_lanes_mode<Mode (I.value)>; };
+
+    return { mk_func (std::integral_constant<int, INDICES>{})... };
+  }
+public:
+  /* filters must have the same mode and an oversampling factor of 4, unused lanes (n_lanes < LANES) are computed but discarded */
+  static void
+  process_lanes (uint n_lanes, SKFilter **filters, const Coeffs **coeffs, float **over_samples, uint n_samples)
+  {
+    static constexpr auto jump_table { make_lanes_jump_table (std::make_index_sequence<LAST_MODE + 1>()) };
+
+    assert (n_lanes >= 1 && n_lanes <= LANES);
+
+    Channel  dummy_channel {};
+    float    dummy_samples[n_samples * 4 + 1]; // +1: avoid zero sized array
+    std::fill_n (dummy_samples, n_samples * 4, 0.f);
+
+    Channel      *lane_channels[LANES];
+    const Coeffs *lane_coeffs[LANES];
+    float        *lane_samples[LANES];
+    for (uint l = 0; l < LANES; l++)
+      {
+        if (l < n_lanes)
+          {
+            assert (filters[l]->over_ == 4 && filters[l]->mode_ == filters[0]->mode_);
+
+            lane_channels[l] = &filters[l]->channels_[0];
+            lane_coeffs[l]   = coeffs[l];
+            lane_samples[l]  = over_samples[l];
+          }
+        else
+          {
+            lane_channels[l] = &dummy_channel;
+            lane_coeffs[l]   = coeffs[0];
+            lane_samples[l]  = dummy_samples;
+          }
+      }
+    jump_table[filters[0]->mode_] (lane_channels, lane_coeffs, lane_samples, n_samples);
+  }
+#endif
 };
 
 } // SpectMorph
@@ -0,0 +1,137 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smspectralbus.hh"
+#include "smnoisedecoder.hh"
+#include "smblockutils.hh"
+
+#include <algorithm>
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+SpectralBus::SpectralBus (float mix_freq) :
+  m_block_size (NoiseDecoder::preferred_block_size (mix_freq)), // same block size as LiveDecoder
+  m_ifft_synth (m_block_size, mix_freq, IFFTSynth::WIN_HANNING),
+  m_ifft_synth_left (m_block_size, mix_freq, IFFTSynth::WIN_HANNING),
+  m_ifft_synth_right (m_block_size, mix_freq, IFFTSynth::WIN_HANNING),
+  m_hop_samples (m_block_size),
+  m_samples_left (m_block_size),
+  m_samples_right (m_block_size),
+  m_pos (m_block_size / 2)
+{
+}
+
+size_t
+SpectralBus::hop_size() const
+{
+  return m_block_size / 2;
+}
+
+size_t
+SpectralBus::block_size() const
+{
+  return m_block_size;
+}
+
+/* notes rendered by the bus start latency() samples after their note on event */
+size_t
+SpectralBus::latency() const
+{
+  return m_block_size - 1;
+}
+
+bool
+SpectralBus::need_hop() const
+{
+  return m_pos == m_block_size / 2;
+}
+
+/* number of samples that can be read before the next hop */
+size_t
+SpectralBus::available() const
+{
+  return m_block_size / 2 - m_pos;
+}
+
+void
+SpectralBus::begin_hop()
+{
+  assert (need_hop());
+
+  for (float *samples : { &m_samples_left[0], &m_samples_right[0] })
+    {
+      std::copy (samples + m_block_size / 2, samples + m_block_size, samples);
+      zero_float_block (m_block_size / 2, samples + m_block_size / 2);
+    }
+  m_ifft_synth.clear_partials();
+  m_stereo_hop = false;
+}
+
+float *
+SpectralBus::center_spectrum()
+{
+  return m_ifft_synth.fft_buffer();
+}
+
+float *
+SpectralBus::stereo_spectrum (int channel)
+{
+  assert (channel == 0 || channel == 1);
+
+  /* the stereo spectra are only cleared if some voice needs them during this hop */
+  if (!m_stereo_hop)
+    {
+      m_ifft_synth_left.clear_partials();
+      m_ifft_synth_right.clear_partials();
+      m_stereo_hop = true;
+    }
+  return channel == 0 ? m_ifft_synth_left.fft_buffer() : m_ifft_synth_right.fft_buffer();
+}
+
+void
+SpectralBus::end_hop()
+{
+  if (m_stereo_hop)
+    {
+      const float *center = m_ifft_synth.fft_buffer();
+
+      Block::add (m_block_size, m_ifft_synth_left.fft_buffer(), center);
+      Block::add (m_block_size, m_ifft_synth_right.fft_buffer(), center);
+
+      m_ifft_synth_left.get_samples (&m_samples_left[0], IFFTSynth::ADD);
+      m_ifft_synth_right.get_samples (&m_samples_right[0], IFFTSynth::ADD);
+    }
+  else
+    {
+      m_ifft_synth.get_samples (&m_hop_samples[0], IFFTSynth::REPLACE);
+
+      Block::add (m_block_size, &m_samples_left[0], &m_hop_samples[0]);
+      Block::add (m_block_size, &m_samples_right[0], &m_hop_samples[0]);
+    }
+  m_pos = 0;
+  m_hop_count++;
+}
+
+/*
+ * the gains are ramped linearly from start to end over the samples that are
+ * read (which may be less than n_values if the hop ends before)
+ */
+size_t
+SpectralBus::read (size_t n_values, float *out_left, float *out_right,
+                   float gain_start_left, float gain_end_left, float gain_start_right, float gain_end_right)
+{
+  const size_t n = std::min (n_values, available());
+
+  Block::mix_stereo (n, out_left, out_right, &m_samples_left[m_pos], &m_samples_right[m_pos],
+                     gain_start_left, gain_end_left, gain_start_right, gain_end_right);
+
+  m_pos += n;
+  return n;
+}
+
+uint64
+SpectralBus::hop_count() const
+{
+  return m_hop_count;
+}
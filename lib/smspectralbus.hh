@@ -0,0 +1,64 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smifftsynth.hh"
+#include "smalignedarray.hh"
+
+namespace SpectMorph
+{
+
+/*
+ * SpectralBus sums the spectra of many voices and performs one inverse fft
+ * per hop for all of them (instead of one inverse fft per voice and hop)
+ *
+ *  - all voices share one global hop grid: each hop is block_size / 2 samples
+ *  - at each hop boundary, begin_hop() clears the spectra, voices add
+ *    their frames to them, and end_hop() does the inverse fft + overlap-add
+ *  - read() adds the output samples of the current hop to the output
+ *
+ * the output is stereo: voices which have the same level in both channels add
+ * their frames to center_spectrum(), other voices use stereo_spectrum(); as long
+ * as no voice uses the stereo spectra, each hop needs only one inverse fft, and
+ * two otherwise
+ *
+ * notes on the bus start latency() = block_size - 1 samples after their note on
+ * event (about 21 ms at 48 kHz), since frames can only start at hop boundaries;
+ * this is not reported to the host, as voices which are not on the bus (filter,
+ * vibrato, portamento) are rendered without latency
+ */
+class SpectralBus
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (SpectralBus);
+
+  size_t                  m_block_size;
+  IFFTSynth               m_ifft_synth;
+  IFFTSynth               m_ifft_synth_left;
+  IFFTSynth               m_ifft_synth_right;
+  bool                    m_stereo_hop = false;
+  AlignedArray<float, 16> m_hop_samples;
+  AlignedArray<float, 16> m_samples_left;
+  AlignedArray<float, 16> m_samples_right;
+  size_t                  m_pos;
+  uint64                  m_hop_count = 0;
+
+public:
+  SpectralBus (float mix_freq);
+
+  size_t hop_size() const;
+  size_t block_size() const;
+  size_t latency() const;
+  bool   need_hop() const;
+  size_t available() const;
+
+  void   begin_hop();
+  float *center_spectrum();
+  float *stereo_spectrum (int channel);
+  void   end_hop();
+  size_t read (size_t n_values, float *out_left, float *out_right,
+               float gain_start_left, float gain_end_left, float gain_start_right, float gain_end_right);
+
+  uint64 hop_count() const;
+};
+
+}
@@ -0,0 +1,82 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_SPSC_QUEUE_HH
+#define SPECTMORPH_SPSC_QUEUE_HH
+
+#include "smutils.hh"
+
+#include <atomic>
+#include <vector>
+
+namespace SpectMorph
+{
+
+/**
+ * \brief Wait-free fixed size queue for one producer thread and one consumer thread
+ *
+ * push() and pop() never block and never allocate memory, so either side can be
+ * the audio thread. If more than one thread needs to push (or pop), these threads
+ * need to be serialized by the caller.
+ */
+template<class T>
+class SPSCQueue
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (SPSCQueue);
+
+  std::vector<T>      m_items;          // one slot is always unused to distinguish full from empty
+  std::atomic<size_t> m_read_pos { 0 };
+  std::atomic<size_t> m_write_pos { 0 };
+
+  size_t
+  next_pos (size_t pos) const
+  {
+    pos++;
+    return pos == m_items.size() ? 0 : pos;
+  }
+public:
+  SPSCQueue (size_t capacity) :
+    m_items (capacity + 1)
+  {
+  }
+  /* producer */
+  bool
+  can_push() const
+  {
+    return next_pos (m_write_pos.load (std::memory_order_relaxed)) != m_read_pos.load (std::memory_order_acquire);
+  }
+  bool
+  push (const T& item)
+  {
+    const size_t write_pos = m_write_pos.load (std::memory_order_relaxed);
+    const size_t new_write_pos = next_pos (write_pos);
+
+    if (new_write_pos == m_read_pos.load (std::memory_order_acquire))
+      return false; // full
+
+    m_items[write_pos] = item;
+    m_write_pos.store (new_write_pos, std::memory_order_release);
+    return true;
+  }
+  /* consumer */
+  bool
+  pop (T& item)
+  {
+    const size_t read_pos = m_read_pos.load (std::memory_order_relaxed);
+
+    if (read_pos == m_write_pos.load (std::memory_order_acquire))
+      return false; // empty
+
+    item = m_items[read_pos];
+    m_read_pos.store (next_pos (read_pos), std::memory_order_release);
+    return true;
+  }
+  size_t
+  capacity() const
+  {
+    return m_items.size() - 1;
+  }
+};
+
+}
+
+#endif
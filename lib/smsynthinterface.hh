@@ -156,6 +156,9 @@ public:
   void
   generate_notify_events()
   {
+    /* free control events the synthesis thread is done with, send events that didn't fit into the queue */
+    m_project->synth_flush_control_events();
+
     NotifyBuffer *notify_buffer = m_project->notify_buffer();
     if (notify_buffer->start_read())
       {
@@ -13,6 +13,10 @@
 #include <sys/stat.h>
 #include <glib.h>
 
+#ifndef SM_OS_WINDOWS
+#include <sys/resource.h>
+#endif
+
 #ifdef SM_OS_MACOS
 #include <xlocale.h>
 #include <CoreFoundation/CoreFoundation.h>
@@ -502,6 +506,23 @@ get_time()
   return tv.tv_sec + tv.tv_usec / 1000000.0;
 }
 
+uint64
+sm_peak_memory_usage()
+{
+#ifdef SM_OS_WINDOWS
+  return 0;
+#else
+  rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef SM_OS_MACOS
+  return usage.ru_maxrss;          // bytes
+#else
+  return usage.ru_maxrss * 1024;   // kilobytes
+#endif
+#endif
+}
+
 string
 to_utf8 (const u32string& str)
 {
@@ -189,6 +189,7 @@ std::string sha1_hash (const unsigned char *data, size_t len);
 std::string sha1_hash (const std::string& str);
 
 double get_time();
+uint64 sm_peak_memory_usage(); // peak resident memory of the process in bytes (0 if not supported)
 
 std::string to_utf8 (const std::u32string& str);
 std::u32string to_utf32 (const std::string& utf8);
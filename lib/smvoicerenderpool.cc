@@ -0,0 +1,170 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smvoicerenderpool.hh"
+#include "smleakdebugger.hh"
+
+#include <algorithm>
+#include <climits>
+
+#ifdef SM_OS_MACOS
+#include <dispatch/dispatch.h>
+#endif
+#ifdef SM_OS_LINUX
+#include <semaphore.h>
+#endif
+
+using namespace SpectMorph;
+
+static LeakDebugger leak_debugger ("SpectMorph::VoiceRenderPool");
+
+/* counting semaphore: post() and try_wait() never block, so they can be used
+ * from the audio thread (std::counting_semaphore would need C++20)
+ */
+class VoiceRenderPool::Semaphore
+{
+#ifdef SM_OS_LINUX
+  sem_t sem;
+public:
+  Semaphore()           { sem_init (&sem, 0, 0); }
+  ~Semaphore()          { sem_destroy (&sem); }
+  void post()           { sem_post (&sem); }
+  void wait()           { while (sem_wait (&sem) != 0); /* retry on EINTR */ }
+  bool try_wait()       { return sem_trywait (&sem) == 0; }
+#endif
+#ifdef SM_OS_MACOS
+  dispatch_semaphore_t sem;
+public:
+  Semaphore()           { sem = dispatch_semaphore_create (0); }
+  ~Semaphore()          { dispatch_release (sem); }
+  void post()           { dispatch_semaphore_signal (sem); }
+  void wait()           { dispatch_semaphore_wait (sem, DISPATCH_TIME_FOREVER); }
+  bool try_wait()       { return dispatch_semaphore_wait (sem, DISPATCH_TIME_NOW) == 0; }
+#endif
+#ifdef SM_OS_WINDOWS
+  HANDLE sem;
+public:
+  Semaphore()           { sem = CreateSemaphore (nullptr, 0, LONG_MAX, nullptr); }
+  ~Semaphore()          { CloseHandle (sem); }
+  void post()           { ReleaseSemaphore (sem, 1, nullptr); }
+  void wait()           { WaitForSingleObject (sem, INFINITE); }
+  bool try_wait()       { return WaitForSingleObject (sem, 0) == WAIT_OBJECT_0; }
+#endif
+};
+
+VoiceRenderPool::VoiceRenderPool (size_t n_workers, size_t max_jobs) :
+  m_start_sem (new Semaphore()),
+  m_job_output (max_jobs * MAX_BLOCK_SIZE),
+  m_max_jobs (max_jobs)
+{
+  leak_debugger.add (this);
+
+  assert (n_workers >= 1);
+
+  for (size_t w = 0; w < n_workers; w++)
+    m_workers.emplace_back (new Worker());
+
+  /* worker 0 is the audio thread, so we only need to start helpers for the other workers */
+  for (size_t w = 1; w < n_workers; w++)
+    m_workers[w]->thread = std::thread (&VoiceRenderPool::helper_run, this, w);
+}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+  m_quit.store (true);
+
+  for (size_t w = 1; w < m_workers.size(); w++)
+    m_start_sem->post();
+
+  for (size_t w = 1; w < m_workers.size(); w++)
+    m_workers[w]->thread.join();
+
+  leak_debugger.del (this);
+}
+
+size_t
+VoiceRenderPool::n_workers() const
+{
+  return m_workers.size();
+}
+
+size_t
+VoiceRenderPool::max_jobs() const
+{
+  return m_max_jobs;
+}
+
+RTMemoryArea&
+VoiceRenderPool::rt_memory_area (size_t worker)
+{
+  return m_workers[worker]->rt_memory_area;
+}
+
+float *
+VoiceRenderPool::scratch (size_t worker)
+{
+  return &m_workers[worker]->scratch[0];
+}
+
+float *
+VoiceRenderPool::job_output (size_t job)
+{
+  return &m_job_output[job * MAX_BLOCK_SIZE];
+}
+
+void
+VoiceRenderPool::work (size_t worker)
+{
+  size_t job;
+  while ((job = m_next_job.fetch_add (1)) < m_n_jobs)
+    m_task->render (worker, job);
+}
+
+void
+VoiceRenderPool::helper_run (size_t worker)
+{
+  for (;;)
+    {
+      m_start_sem->wait();
+
+      if (m_quit.load())
+        return;
+
+      work (worker);
+      m_helpers_done.fetch_add (1, std::memory_order_release);
+    }
+}
+
+void
+VoiceRenderPool::run (Task *task, size_t n_jobs)
+{
+  assert (n_jobs <= m_max_jobs);
+
+  /* these are published to the helpers by the semaphore post */
+  m_task = task;
+  m_n_jobs = n_jobs;
+  m_next_job.store (0);
+  m_helpers_done.store (0);
+
+  /* wake only as many helpers as can be useful: the audio thread takes one job itself */
+  const size_t n_wake = std::min (m_workers.size() - 1, n_jobs > 0 ? n_jobs - 1 : 0);
+  for (size_t i = 0; i < n_wake; i++)
+    m_start_sem->post();
+
+  work (0);
+
+  /* at this point, all jobs have been taken; helpers that have not woken up yet
+   * would find nothing to do, so we take back their wake ups
+   */
+  size_t n_revoked = 0;
+  while (n_revoked < n_wake && m_start_sem->try_wait())
+    n_revoked++;
+
+  /* the remaining helpers are awake and will finish their last job soon;
+   * yield() is not a lock, but lets them run if they share our cpu
+   */
+  const size_t n_running = n_wake - n_revoked;
+  while (m_helpers_done.load (std::memory_order_acquire) < n_running)
+    std::this_thread::yield();
+
+  m_task = nullptr;
+}
@@ -0,0 +1,75 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smrtmemory.hh"
+#include "smalignedarray.hh"
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace SpectMorph
+{
+
+/*
+ * VoiceRenderPool distributes independent render jobs (voices) of one audio
+ * block over a fixed set of worker threads.
+ *
+ *  - the thread calling run() (the audio thread) is worker 0, so a pool with
+ *    one worker renders everything serially without any thread switches
+ *  - each worker has its own RTMemoryArea and scratch buffer
+ *  - each job renders into its own output buffer; summing the outputs is left
+ *    to the caller, so the result does not depend on which worker ran which job
+ *  - run() does not allocate memory and does not take locks: helpers are woken
+ *    using a semaphore, and completion is detected via atomic counters
+ */
+class VoiceRenderPool
+{
+  SPECTMORPH_CLASS_NON_COPYABLE (VoiceRenderPool);
+public:
+  class Task
+  {
+  public:
+    virtual void render (size_t worker, size_t job) = 0;
+  };
+  static constexpr size_t MAX_BLOCK_SIZE = 1024; // maximum number of samples per job and run
+
+private:
+  class Semaphore;
+  struct Worker
+  {
+    RTMemoryArea             rt_memory_area;
+    AlignedArray<float, 16>  scratch { MAX_BLOCK_SIZE };
+    std::thread              thread;
+  };
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::unique_ptr<Semaphore>           m_start_sem;
+  AlignedArray<float, 16>              m_job_output;
+  size_t                               m_max_jobs = 0;
+
+  Task                                *m_task = nullptr;
+  size_t                               m_n_jobs = 0;
+  std::atomic<size_t>                  m_next_job { 0 };
+  std::atomic<size_t>                  m_helpers_done { 0 };
+  std::atomic<bool>                    m_quit { false };
+
+  void work (size_t worker);
+  void helper_run (size_t worker);
+
+public:
+  VoiceRenderPool (size_t n_workers, size_t max_jobs);
+  ~VoiceRenderPool();
+
+  size_t n_workers() const;
+  size_t max_jobs() const;
+
+  RTMemoryArea& rt_memory_area (size_t worker);
+  float        *scratch (size_t worker);
+  float        *job_output (size_t job);
+
+  void run (Task *task, size_t n_jobs);
+};
+
+}
@@ -0,0 +1,187 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smvoicescheduler.hh"
+#include "smmath.hh"
+
+#include <algorithm>
+
+using namespace SpectMorph;
+
+using std::string;
+
+VoiceScheduler::VoiceScheduler (double mix_freq) :
+  m_mix_freq (mix_freq)
+{
+}
+
+void
+VoiceScheduler::set_config (const Config& config)
+{
+  m_config = config;
+}
+
+const VoiceScheduler::Config&
+VoiceScheduler::config() const
+{
+  return m_config;
+}
+
+/*
+ * render_time:  time needed to compute the block (in seconds)
+ * voice_values: number of values rendered by all voices (one voice rendering
+ *               the whole block counts as n_values)
+ */
+void
+VoiceScheduler::add_block (double render_time, size_t n_values, size_t voice_values)
+{
+  if (!n_values)
+    return;
+
+  const double audio_time = n_values / m_mix_freq;
+
+  m_load = render_time / audio_time;
+  if (voice_values)
+    {
+      /* estimate the load caused by one voice: increase quickly (to react before
+       * the deadline is missed), decrease slowly (to avoid starting too many
+       * voices after a few cheap blocks)
+       */
+      const double voice_load = render_time * m_mix_freq / voice_values;
+      const double weight = voice_load > m_voice_load ? 0.5 : 0.05;
+
+      if (m_voice_load > 0)
+        m_voice_load += (voice_load - m_voice_load) * weight;
+      else
+        m_voice_load = voice_load; // first measurement
+    }
+  if (m_load < m_config.cpu_budget / 2)
+    m_underload_time += audio_time;
+  else
+    m_underload_time = 0;
+
+  /* raise lod threshold quickly if the load gets close to the budget, lower it slowly */
+  if (m_config.cpu_budget > 0 && m_config.lod_threshold > 0)
+    {
+      const double boost_up_db_per_sec = 200;
+      const double boost_down_db_per_sec = 20;
+
+      if (m_load > m_config.cpu_budget * 0.75)
+        m_lod_boost_db += boost_up_db_per_sec * audio_time;
+      else if (m_load < m_config.cpu_budget / 2)
+        m_lod_boost_db -= boost_down_db_per_sec * audio_time;
+
+      m_lod_boost_db = std::clamp (m_lod_boost_db, 0.0, LOD_MAX_BOOST_DB);
+    }
+  else
+    {
+      m_lod_boost_db = 0;
+    }
+}
+
+/* returns the number of voices that can be rendered without exceeding the cpu budget (-1: no limit) */
+int
+VoiceScheduler::voice_budget() const
+{
+  if (m_config.cpu_budget <= 0 || m_voice_load <= 0)
+    return -1;
+
+  return std::max (int (m_config.cpu_budget / m_voice_load), 1);
+}
+
+double
+VoiceScheduler::load() const
+{
+  return m_load;
+}
+
+/* lod threshold for voices at full level, including the cpu driven boost */
+double
+VoiceScheduler::lod_threshold() const
+{
+  return m_config.lod_threshold * db_to_factor (m_lod_boost_db);
+}
+
+double
+VoiceScheduler::lod_boost_db() const
+{
+  return m_lod_boost_db;
+}
+
+/* returns true if candidate a should be stolen before candidate b */
+bool
+VoiceScheduler::steal_before (const Candidate& a, const Candidate& b) const
+{
+  if (a.released != b.released)
+    return a.released;
+
+  if (m_config.steal_policy == StealPolicy::QUIETEST && a.level != b.level)
+    return a.level < b.level;
+
+  return a.note_id < b.note_id;
+}
+
+bool
+VoiceScheduler::unison_reduced() const
+{
+  return m_unison_reduced;
+}
+
+/*
+ * decides if unison should be reduced (n_voices exceeds the voice budget) or
+ * can be restored (low load for one second); returns true if this changed
+ */
+bool
+VoiceScheduler::update_unison (int n_voices, bool have_unison)
+{
+  const int budget = voice_budget();
+
+  bool reduce = m_unison_reduced;
+  if (!m_config.reduce_unison || m_config.cpu_budget <= 0)
+    reduce = false;
+  else if (!m_unison_reduced && have_unison && budget >= 0 && n_voices > budget)
+    reduce = true;
+  else if (m_unison_reduced && m_underload_time > 1)
+    reduce = false;
+
+  if (reduce == m_unison_reduced)
+    return false;
+
+  m_unison_reduced = reduce;
+
+  /* the cost of a voice changes a lot: start a new estimate */
+  m_voice_load = 0;
+  m_underload_time = 0;
+  return true;
+}
+
+VoiceScheduler::Stats&
+VoiceScheduler::stats()
+{
+  return m_stats;
+}
+
+bool
+VoiceScheduler::parse_steal_policy (const string& str, StealPolicy& policy)
+{
+  for (auto p : { StealPolicy::NONE, StealPolicy::OLDEST, StealPolicy::QUIETEST })
+    {
+      if (str == steal_policy_name (p))
+        {
+          policy = p;
+          return true;
+        }
+    }
+  return false;
+}
+
+string
+VoiceScheduler::steal_policy_name (StealPolicy policy)
+{
+  switch (policy)
+    {
+      case StealPolicy::NONE:     return "none";
+      case StealPolicy::OLDEST:   return "oldest";
+      case StealPolicy::QUIETEST: return "quietest";
+    }
+  return "";
+}
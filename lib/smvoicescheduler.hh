@@ -0,0 +1,97 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#pragma once
+
+#include "smutils.hh"
+
+#include <string>
+
+namespace SpectMorph
+{
+
+/*
+ * VoiceScheduler decides which voices MidiSynth should give up under load
+ *
+ *  - voice stealing (off by default): if a note on needs a voice and no voice
+ *    is available, a playing voice is quickly faded out to make room, chosen
+ *    according to the steal policy
+ *  - voice budget: the render time of each block is measured to estimate the
+ *    cpu cost of one voice; if the voices that are playing would need more
+ *    than the configured fraction of the block duration (cpu_budget), the
+ *    next blocks would miss their deadline, so unison is reduced first (if
+ *    enabled) and then the excess voices are faded out
+ *  - level of detail: partials below lod_threshold (relative to the loudest
+ *    partial) are not rendered; if the load gets close to the cpu budget,
+ *    the threshold is raised (up to LOD_MAX_BOOST_DB) to degrade quality
+ *    gracefully before voices need to be faded out
+ *
+ * the cpu budget is disabled by default, because the output depends on the
+ * timing then (which is not acceptable for offline rendering)
+ */
+class VoiceScheduler
+{
+public:
+  enum class StealPolicy {
+    NONE,       // don't steal: notes are dropped if there are no voices left
+    OLDEST,     // steal the voice with the oldest note on
+    QUIETEST    // steal the voice with the lowest level (velocity gain * envelope)
+  };
+  struct Config
+  {
+    StealPolicy steal_policy  = StealPolicy::NONE;
+    double      cpu_budget    = 0;     // max render time / block duration, 0: no budget
+    bool        reduce_unison = true;  // reduce unison before fading voices
+    double      lod_threshold = 0;     // cull partials below lod_threshold * loudest partial, 0: off
+    int         lod_max_partials = 0;  // max partials per voice, 0: no limit
+  };
+  /* properties of a voice which can be stolen */
+  struct Candidate
+  {
+    bool   released;  // note off received: always stolen before voices that are still on
+    double level;
+    int    note_id;   // increases with each note on
+  };
+  struct Stats
+  {
+    int    stolen_voices = 0;    // voices taken for a new note (no voice left)
+    int    faded_voices = 0;     // voices faded out because of the voice budget
+    int    overload_blocks = 0;  // blocks which exceeded the voice budget
+    uint64 rendered_partials = 0;
+    uint64 culled_partials = 0;  // partials not rendered (level of detail)
+  };
+  static constexpr double LOD_MAX_BOOST_DB = 40;
+
+private:
+  Config m_config;
+  double m_mix_freq;
+  double m_voice_load = 0;     // estimated cpu load of one voice (render time / audio time)
+  double m_load = 0;           // render time / audio time of the last block
+  double m_underload_time = 0; // time (in seconds of audio) since the load was above cpu_budget / 2
+  bool   m_unison_reduced = false;
+  double m_lod_boost_db = 0;   // cpu driven increase of the lod threshold
+  Stats  m_stats;
+
+public:
+  VoiceScheduler (double mix_freq);
+
+  void          set_config (const Config& config);
+  const Config& config() const;
+
+  void   add_block (double render_time, size_t n_values, size_t voice_values);
+  int    voice_budget() const;
+  double load() const;
+  double lod_threshold() const;
+  double lod_boost_db() const;
+
+  bool   steal_before (const Candidate& a, const Candidate& b) const;
+
+  bool   unison_reduced() const;
+  bool   update_unison (int n_voices, bool have_unison);
+
+  Stats& stats();
+
+  static bool        parse_steal_policy (const std::string& str, StealPolicy& policy);
+  static std::string steal_policy_name (StealPolicy policy);
+};
+
+}
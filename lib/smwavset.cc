@@ -1,6 +1,7 @@
 // Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
 
 #include "smwavset.hh"
+#include "smflatwavset.hh"
 #include "smoutfile.hh"
 #include "sminfile.hh"
 #include "smmemout.hh"
@@ -83,11 +84,21 @@ WavSet::save (const string& filename, bool embed_models)
   return Error::Code::NONE;
 }
 
+/* save in flat format (which can be memory mapped while loading, see FlatWavSet) */
+Error
+WavSet::save_flat (const string& filename) const
+{
+  return FlatWavSet::save (*this, filename);
+}
+
 Error
 WavSet::load (const string& filename, AudioLoadOptions load_options)
 {
   clear();        // delete old contents (if any)
 
+  if (FlatWavSet::is_flat_file (filename))
+    return FlatWavSet::load (*this, filename, load_options);
+
   map<string, Audio *> blob_map;
 
   WavSetWave *wave = NULL;
@@ -38,6 +38,7 @@ public:
 
   Error load (const std::string& filename, AudioLoadOptions load_options = AUDIO_LOAD_DEBUG);
   Error save (const std::string& filename, bool embed_models = false);
+  Error save_flat (const std::string& filename) const;
 };
 
 }
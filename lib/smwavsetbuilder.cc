@@ -5,8 +5,12 @@
 #include "smbinbuffer.hh"
 #include "sminstenccache.hh"
 #include "smaudiotool.hh"
+#include "smparallel.hh"
 
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 using namespace SpectMorph;
 
@@ -16,6 +20,7 @@ using std::vector;
 using std::max;
 
 WavSetBuilder::WavSetBuilder (const Instrument *instrument, bool keep_samples) :
+  n_threads (parallel_default_threads()),
   keep_samples (keep_samples)
 {
   wav_set = new WavSet();
@@ -71,35 +76,130 @@ WavSetBuilder::killed()
   return kill_function && kill_function();
 }
 
-WavSet *
-WavSetBuilder::run()
+Audio *
+WavSetBuilder::encode_sample (const SampleData& sd, const std::function<bool()>& sample_kill_function)
 {
-  for (auto& sd : sample_data_vec)
+  /* clipping */
+  const WavData& wav_data = sd.shared->wav_data();
+  assert (wav_data.n_channels() == 1);
+
+  /* if we have a loop, the loop end determines the real end of the recording */
+  int iclipend = wav_data.n_values();
+  if (sd.loop == Sample::Loop::NONE)
+    iclipend = sm_bound<int> (0, sm_round_positive (sd.clip_end_ms * wav_data.mix_freq() / 1000.0), wav_data.n_values());
+
+  int iclipstart = sm_bound<int> (0, sm_round_positive (sd.clip_start_ms * wav_data.mix_freq() / 1000.0), iclipend);
+
+  Instrument::EncoderConfig cfg = encoder_config;
+  return InstEncCache::the()->encode (cache_group, wav_data, sd.shared->wav_data_hash(), sd.midi_note, iclipstart, iclipend, cfg, sample_kill_function);
+}
+
+/*
+ * Encodes all samples, up to n_threads at the same time. The user supplied kill function
+ * and progress function are only called from the thread that runs the builder: it waits
+ * for the workers, polls the kill function and forwards kill requests to the encoders.
+ */
+bool
+WavSetBuilder::encode_samples (vector<std::unique_ptr<Audio>>& audios)
+{
+  const size_t n_total = sample_data_vec.size();
+  const size_t n_workers = std::min (n_threads, n_total);
+
+  audios.clear();
+  audios.resize (n_total);
+
+  if (n_workers <= 1)
+    {
+      for (size_t i = 0; i < n_total; i++)
+        {
+          audios[i].reset (encode_sample (sample_data_vec[i], kill_function));
+          if (!audios[i]) // killed?
+            return false;
+
+          if (progress_function)
+            progress_function (i + 1, n_total);
+        }
+      return true;
+    }
+
+  std::mutex              mutex;
+  std::condition_variable cond;
+  size_t                  n_done = 0;
+  bool                    workers_done = false;
+  std::atomic<bool>       quit { false };
+
+  auto sample_kill_function = [&quit]() { return quit.load(); };
+
+  std::thread pool_thread ([&]()
+    {
+      parallel_for (n_workers, n_total, [&] (size_t worker, size_t i)
+        {
+          if (quit.load())
+            return;
+
+          Audio *audio = encode_sample (sample_data_vec[i], sample_kill_function);
+
+          std::lock_guard<std::mutex> lg (mutex);
+          audios[i].reset (audio);
+          if (audio)
+            n_done++;
+          cond.notify_one();
+        });
+
+      std::lock_guard<std::mutex> lg (mutex);
+      workers_done = true;
+      cond.notify_one();
+    });
+
+  size_t n_reported = 0;
+  std::unique_lock<std::mutex> lock (mutex);
+  while (!workers_done)
     {
-      /* clipping */
-      const WavData& wav_data = sd.shared->wav_data();
-      assert (wav_data.n_channels() == 1);
+      /* wake up when a sample is done, or periodically to check the kill function */
+      cond.wait_for (lock, std::chrono::milliseconds (10));
 
-      /* if we have a loop, the loop end determines the real end of the recording */
-      int iclipend = wav_data.n_values();
-      if (sd.loop == Sample::Loop::NONE)
-        iclipend = sm_bound<int> (0, sm_round_positive (sd.clip_end_ms * wav_data.mix_freq() / 1000.0), wav_data.n_values());
+      const size_t n = n_done;
+      lock.unlock();
 
-      int iclipstart = sm_bound<int> (0, sm_round_positive (sd.clip_start_ms * wav_data.mix_freq() / 1000.0), iclipend);
+      if (!quit.load() && killed())
+        quit.store (true);
 
+      if (progress_function && n != n_reported && !quit.load())
+        {
+          progress_function (n, n_total);
+          n_reported = n;
+        }
+
+      lock.lock();
+    }
+  lock.unlock();
+  pool_thread.join();
+
+  return !quit.load() && n_done == n_total;
+}
+
+WavSet *
+WavSetBuilder::run()
+{
+  vector<std::unique_ptr<Audio>> audios;
+
+  if (!encode_samples (audios))
+    return nullptr;
+
+  /* build waves in sample order, so the result doesn't depend on which sample finished first */
+  for (size_t i = 0; i < sample_data_vec.size(); i++)
+    {
+      const SampleData& sd = sample_data_vec[i];
 
       WavSetWave new_wave;
       new_wave.midi_note = sd.midi_note;
       new_wave.channel = 0;
       new_wave.velocity_range_min = 0;
       new_wave.velocity_range_max = 127;
-      new_wave.audio = InstEncCache::the()->encode (cache_group, wav_data, sd.shared->wav_data_hash(), sd.midi_note, iclipstart, iclipend, encoder_config, kill_function);
-
-      if (!new_wave.audio) // killed?
-        return nullptr;
+      new_wave.audio = audios[i].release();
 
       if (keep_samples)
-        new_wave.audio->original_samples = wav_data.samples(); // FIXME: clipping?
+        new_wave.audio->original_samples = sd.shared->wav_data().samples(); // FIXME: clipping?
 
       wav_set->waves.push_back (new_wave);
     }
@@ -265,3 +365,22 @@ WavSetBuilder::set_cache_group (InstEncCache::Group *group)
 {
   cache_group = group;
 }
+
+/**
+ * Sets the maximum number of samples that are encoded at the same time (default: number of cpus).
+ */
+void
+WavSetBuilder::set_n_threads (size_t new_n_threads)
+{
+  n_threads = std::max<size_t> (new_n_threads, 1);
+}
+
+/**
+ * Sets a function that gets called with the number of samples that are done,
+ * from the thread that calls run().
+ */
+void
+WavSetBuilder::set_progress_function (const std::function<void (size_t n_done, size_t n_total)>& new_progress_function)
+{
+  progress_function = new_progress_function;
+}
@@ -31,6 +31,9 @@ class WavSetBuilder
   std::function<bool()>      kill_function;
   bool killed();
 
+  size_t                     n_threads = 1;
+  std::function<void (size_t n_done, size_t n_total)> progress_function;
+
   double                     global_volume = 0;
   Instrument::AutoVolume     auto_volume;
   Instrument::AutoTune       auto_tune;
@@ -43,12 +46,16 @@ class WavSetBuilder
   void apply_auto_tune();
 
   void add_sample (const Sample *sample);
+  Audio *encode_sample (const SampleData& sd, const std::function<bool()>& sample_kill_function);
+  bool encode_samples (std::vector<std::unique_ptr<Audio>>& audios);
 public:
   WavSetBuilder (const Instrument *instrument, bool keep_samples);
   ~WavSetBuilder();
 
   void set_kill_function (const std::function<bool()>& kill_function);
   void set_cache_group (InstEncCache::Group *group);
+  void set_n_threads (size_t n_threads);
+  void set_progress_function (const std::function<void (size_t n_done, size_t n_total)>& progress_function);
   WavSet *run();
 };
 
@@ -22,7 +22,7 @@ WavSetRepo::get (const string& filename)
   if (!wav_set)
     {
       wav_set = new WavSet();
-      wav_set->load (filename, AUDIO_SKIP_DEBUG);
+      wav_set->load (filename, AUDIO_MAP_FRAMES);
     }
   return wav_set;
 }
@@ -2,6 +2,7 @@
 #include "smadsrenvelope.hh"
 #include "smalignedarray.hh"
 #include "smaudio.hh"
+#include "smaudioframestore.hh"
 #include "smaudiotool.hh"
 #include "smbinbuffer.hh"
 #include "smblockutils.hh"
@@ -12,6 +13,8 @@
 #include "smeffectdecoder.hh"
 #include "smencoder.hh"
 #include "smfft.hh"
+#include "smfilterbatch.hh"
+#include "smflatwavset.hh"
 #include "smflexadsr.hh"
 #include "smgenericin.hh"
 #include "smgenericout.hh"
@@ -35,10 +38,12 @@
 #include "smmath.hh"
 #include "smmemout.hh"
 #include "smmicroconf.hh"
+#include "smmidifile.hh"
 #include "smmidisynth.hh"
 #include "smminiresampler.hh"
 #include "smmmapin.hh"
 #include "smmodulationlist.hh"
+#include "smmorphblockcache.hh"
 #include "smmorphgrid.hh"
 #include "smmorphgridmodule.hh"
 #include "smmorphlfo.hh"
@@ -62,6 +67,7 @@
 #include "smnotifybuffer.hh"
 #include "smoutfile.hh"
 #include "smpandaresampler.hh"
+#include "smparallel.hh"
 #include "smpcg32rng.hh"
 #include "smpolyphaseinter.hh"
 #include "smproject.hh"
@@ -70,6 +76,8 @@
 #include "smsignal.hh"
 #include "smsinedecoder.hh"
 #include "smskfilter.hh"
+#include "smspectralbus.hh"
+#include "smspscqueue.hh"
 #include "smstdioin.hh"
 #include "smstdioout.hh"
 #include "smstdiosubin.hh"
@@ -77,6 +85,8 @@
 #include "smtimeinfo.hh"
 #include "smuserinstrumentindex.hh"
 #include "smutils.hh"
+#include "smvoicerenderpool.hh"
+#include "smvoicescheduler.hh"
 #include "smwavdata.hh"
 #include "smwavsetbuilder.hh"
 #include "smwavset.hh"
@@ -240,10 +240,7 @@ run (LV2_Handle instance, uint32_t n_samples)
   midi_synth->set_control_input (1, control_2);
   midi_synth->set_control_input (2, control_3);
   midi_synth->set_control_input (3, control_4);
-  midi_synth->process (left_out, n_samples);
-
-  // proper stereo support will be added later
-  std::copy (left_out, left_out + n_samples, right_out);
+  midi_synth->process (left_out, right_out, n_samples);
 
   // send LV2_STATE__StateChanged if project state was modified
   if (state_changed)
@@ -10,6 +10,7 @@
 #include "smdebug.hh"
 #include "smutils.hh"
 #include "smfft.hh"
+#include "smstdioout.hh"
 
 #include "config.h"
 
@@ -79,6 +80,9 @@ struct Options
   bool          loop_unit_seconds;
   string        debug_decode_filename;
   string        config_filename;
+  int           n_threads;
+  bool          profile;
+  bool          stream;
 
   Options ();
   void parse (int *argc_p, char **argv_p[]);
@@ -103,6 +107,9 @@ Options::Options ()
   loop_end = -1;
   loop_type = Audio::LOOP_NONE;
   loop_unit_seconds = false;
+  n_threads = 1;
+  profile = false;
+  stream = false;
 }
 
 void
@@ -162,6 +169,10 @@ Options::parse (int   *argc_p,
         {
           optimization_level = atoi (opt_arg);
         }
+      else if (check_arg (argc, argv, &i, "-j", &opt_arg))
+        {
+          n_threads = atoi (opt_arg);
+        }
       else if (check_arg (argc, argv, &i, "-s"))
         {
           strip_models = true;
@@ -178,6 +189,14 @@ Options::parse (int   *argc_p,
         {
           track_sines = false;
         }
+      else if (check_arg (argc, argv, &i, "--profile"))
+        {
+          profile = true;
+        }
+      else if (check_arg (argc, argv, &i, "--stream"))
+        {
+          stream = true;
+        }
       else if (check_arg (argc, argv, &i, "--debug-decode", &opt_arg))
         {
           debug_decode_filename = opt_arg;
@@ -241,6 +260,7 @@ Options::print_usage ()
   sm_printf (" -f <freq>                   specify fundamental frequency in Hz\n");
   sm_printf (" -m <note>                   specify midi note for fundamental frequency\n");
   sm_printf (" -O <level>                  set optimization level\n");
+  sm_printf (" -j <threads>                use multiple threads for encoding\n");
   sm_printf (" -s                          produced stripped models\n");
   sm_printf (" --no-attack                 skip attack time optimization\n");
   sm_printf (" --no-sines                  skip partial tracking\n");
@@ -248,6 +268,8 @@ Options::print_usage ()
   sm_printf (" --loop-end                  set timeloop end\n");
   sm_printf (" --debug-decode              debug decode sm file using unquantized values\n");
   sm_printf (" -d                          dump encoder debug information\n");
+  sm_printf (" --profile                   print time needed for each encoder step\n");
+  sm_printf (" --stream                    write stripped model while encoding (for long inputs)\n");
   sm_printf (" --text-input-file <rate>    set input file format to human readable text values\n");
   sm_printf (" --config <config>           set additional parameters for analysis\n");
   sm_printf ("\n");
@@ -373,6 +395,11 @@ main (int argc, char **argv)
       fprintf (stderr, "%s: fundamental frequency is required (can be set using -m or -f)\n", options.program_name.c_str());
       exit (1);
     }
+  if (options.stream && (options.keep_samples || options.debug_decode_filename != ""))
+    {
+      fprintf (stderr, "%s: --stream can not be combined with --keep-samples or --debug-decode\n", options.program_name.c_str());
+      exit (1);
+    }
 
   /* open input */
   string input_file = argv[1];
@@ -395,6 +422,8 @@ main (int argc, char **argv)
     }
   /* use defaults, but customize window */
   enc_params.setup_params (wav_data, options.fundamental_freq);
+  enc_params.set_n_threads (options.n_threads);
+  enc_params.set_profile (options.profile);
 
   /* compute encoder window */
   vector<float> window (enc_params.block_size);
@@ -466,21 +495,6 @@ main (int argc, char **argv)
         }
 
       Encoder encoder (enc_params);
-      encoder.encode (wav_data, channel, options.optimization_level, options.attack, options.track_sines);
-      if (options.strip_models)
-        {
-          vector<EncoderBlock>& audio_blocks = encoder.audio_blocks;
-
-          for (size_t i = 0; i < audio_blocks.size(); i++)
-            {
-              audio_blocks[i].debug_samples.clear();
-              audio_blocks[i].original_fft.clear();
-            }
-          if (!options.keep_samples)
-            {
-              encoder.original_samples.clear();
-            }
-        }
       if (options.loop_type == Audio::LOOP_NONE && options.loop_start == -1 && options.loop_end == -1)
         {
           // no loop
@@ -499,6 +513,39 @@ main (int argc, char **argv)
               encoder.set_loop (options.loop_type, options.loop_start, options.loop_end);
             }
         }
+
+      /* long inputs: stripped models can be written while encoding, which needs a lot less memory */
+      const double input_seconds = wav_data.n_values() / wav_data.n_channels() / wav_data.mix_freq();
+      const bool   stream_input  = options.strip_models && !options.keep_samples && options.debug_decode_filename == "" &&
+                                   input_seconds > 60;
+      if (options.stream || stream_input)
+        {
+          GenericOut *out = StdioOut::open (sm_file);
+          if (!out)
+            {
+              fprintf (stderr, "%s: can't open output file '%s'.\n", options.program_name.c_str(), sm_file.c_str());
+              exit (1);
+            }
+          encoder.encode_stream (wav_data, channel, options.optimization_level, options.attack, options.track_sines, out);
+          delete out; // close file
+          continue;
+        }
+
+      encoder.encode (wav_data, channel, options.optimization_level, options.attack, options.track_sines);
+      if (options.strip_models)
+        {
+          vector<EncoderBlock>& audio_blocks = encoder.audio_blocks;
+
+          for (size_t i = 0; i < audio_blocks.size(); i++)
+            {
+              audio_blocks[i].debug_samples.clear();
+              audio_blocks[i].original_fft.clear();
+            }
+          if (!options.keep_samples)
+            {
+              encoder.original_samples.clear();
+            }
+        }
       if (options.debug_decode_filename != "")
         encoder.debug_decode (options.debug_decode_filename);
 
@@ -0,0 +1,383 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmidisynth.hh"
+#include "smmidifile.hh"
+#include "smmorphoutput.hh"
+#include "smwavdata.hh"
+#include "smparallel.hh"
+#include "smconfig.hh"
+#include "smmath.hh"
+#include "smrandom.hh"
+#include "config.h"
+
+#include <algorithm>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+using std::max;
+using std::min;
+
+/// @cond
+struct Options
+{
+  string  program_name = "smrender";
+  int     rate         = 48000;
+  int     bits         = 16;
+  int     n_threads    = 0;    // 0: one thread per cpu
+  int     n_shards     = 16;
+  int     n_voices     = 64;
+  int     seed         = 0;
+  int     block_size   = 256;
+  double  max_tail     = 10;   // seconds
+
+  void parse (int *argc_p, char **argv_p[]);
+  static void print_usage ();
+} options;
+/// @endcond
+
+#include "stwutils.hh"
+
+void
+Options::parse (int   *argc_p,
+                char **argv_p[])
+{
+  guint argc = *argc_p;
+  gchar **argv = *argv_p;
+  unsigned int i, e;
+
+  for (i = 1; i < argc; i++)
+    {
+      const char *opt_arg;
+      if (strcmp (argv[i], "--help") == 0 ||
+          strcmp (argv[i], "-h") == 0)
+        {
+          print_usage();
+          exit (0);
+        }
+      else if (strcmp (argv[i], "--version") == 0 || strcmp (argv[i], "-v") == 0)
+        {
+          printf ("%s %s\n", program_name.c_str(), VERSION);
+          exit (0);
+        }
+      else if (check_arg (argc, argv, &i, "--rate", &opt_arg) || check_arg (argc, argv, &i, "-r", &opt_arg))
+        {
+          rate = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--bits", &opt_arg))
+        {
+          bits = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--threads", &opt_arg) || check_arg (argc, argv, &i, "-j", &opt_arg))
+        {
+          n_threads = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--shards", &opt_arg))
+        {
+          n_shards = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--voices", &opt_arg))
+        {
+          n_voices = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--seed", &opt_arg))
+        {
+          seed = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--block-size", &opt_arg))
+        {
+          block_size = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--max-tail", &opt_arg))
+        {
+          max_tail = sm_atof (opt_arg);
+        }
+    }
+
+  /* resort argc/argv */
+  e = 1;
+  for (i = 1; i < argc; i++)
+    if (argv[i])
+      {
+        argv[e++] = argv[i];
+        if (i >= e)
+          argv[i] = NULL;
+      }
+  *argc_p = e;
+}
+
+void
+Options::print_usage ()
+{
+  printf ("usage: %s [ <options> ] <plan> <midi_file> <wav_file>\n", options.program_name.c_str());
+  printf ("\n");
+  printf ("renders a midi file offline, using a spectmorph plan (.smplan)\n");
+  printf ("\n");
+  printf ("options:\n");
+  printf (" -h, --help                  help for %s\n", options.program_name.c_str());
+  printf (" -v, --version               print version\n");
+  printf (" -r, --rate <sampling rate>  set sampling rate (default: %d)\n", options.rate);
+  printf (" --bits <bits>               set output bit depth (default: %d)\n", options.bits);
+  printf (" -j, --threads <threads>     number of render threads (default: number of cpus)\n");
+  printf (" --shards <shards>           distribute notes over this many synths (1..64, default: %d)\n", options.n_shards);
+  printf (" --voices <voices>           max voices per shard (default: %d)\n", options.n_voices);
+  printf (" --seed <seed>               random seed for noise, unison and lfos, -1: random (default: %d)\n", options.seed);
+  printf (" --block-size <size>         render block size (default: %d)\n", options.block_size);
+  printf (" --max-tail <seconds>        max release time after the last event (default: %.0f)\n", options.max_tail);
+  printf ("\n");
+  printf ("the output only depends on the number of shards, not on the number of threads\n");
+  printf ("\n");
+}
+
+/*
+ * Each shard is rendered by its own MidiSynth, so shards can be rendered in
+ * parallel. Notes are distributed round robin over the shards; all other
+ * events (controllers, pitch bend, ...) are sent to every shard. Notes are
+ * independent, but time segments are not (release tails, LFOs, portamento),
+ * so we don't split by time.
+ *
+ * To keep the memory usage independent of the length of the midi file, all
+ * shards render one segment (SEGMENT_BLOCKS blocks) at a time, which is mixed
+ * into the output before the next segment is rendered.
+ */
+struct Shard
+{
+  vector<MidiFile::Event> events;
+  size_t                  next_event = 0;
+  bool                    done = false;
+  vector<float>           left;   // samples of the current segment
+  vector<float>           right;
+  std::unique_ptr<MidiSynth> midi_synth;
+};
+
+static const size_t SEGMENT_BLOCKS = 64;
+
+static void
+assign_events (const MidiFile& midi_file, vector<Shard>& shards)
+{
+  const size_t n_shards = shards.size();
+
+  /* for each channel/key: shards with note on (the same key can play in more than one shard) */
+  vector<uint64> note_shards (16 * 128);
+
+  size_t n_notes = 0;
+  for (const auto& event : midi_file.events())
+    {
+      const int status = event.data[0] & 0xf0;
+      const int index = (event.data[0] & 0xf) * 128 + event.data[1];
+
+      if (status == 0x90 && event.data[2] != 0)
+        {
+          const size_t s = n_notes++ % n_shards;
+
+          note_shards[index] |= uint64 (1) << s;
+          shards[s].events.push_back (event);
+        }
+      else if (status == 0x80 || status == 0x90)
+        {
+          for (size_t s = 0; s < n_shards; s++)
+            if (note_shards[index] & (uint64 (1) << s))
+              shards[s].events.push_back (event);
+          note_shards[index] = 0;
+        }
+      else
+        {
+          for (size_t s = 0; s < n_shards; s++)
+            shards[s].events.push_back (event);
+        }
+    }
+}
+
+/* renders the blocks of one segment, starting at start_pos; shard.left/right contain the samples until the shard is done */
+static void
+render_segment (const MidiFile& midi_file, Shard& shard, uint64 start_pos)
+{
+  shard.left.clear();
+  shard.right.clear();
+
+  if (shard.done)
+    return;
+
+  MidiSynth& midi_synth = *shard.midi_synth;
+
+  const size_t block_size = options.block_size;
+  const uint64 end_pos = llrint (midi_file.length() * options.rate);
+  const uint64 max_pos = end_pos + llrint (options.max_tail * options.rate);
+
+  vector<float> left (block_size), right (block_size);
+  for (uint64 pos = start_pos; pos < start_pos + SEGMENT_BLOCKS * block_size; pos += block_size)
+    {
+      /* after the last event: stop if all voices are done */
+      if (pos >= max_pos || (pos >= end_pos && shard.next_event == shard.events.size() && midi_synth.active_voice_count() == 0))
+        {
+          shard.done = true;
+
+          /* free memory early */
+          shard.midi_synth.reset();
+          return;
+        }
+
+      const double time = double (pos) / options.rate;
+      midi_synth.set_tempo (midi_file.tempo_at (time));
+      midi_synth.set_ppq_pos (midi_file.ppq_pos_at (time));
+
+      while (shard.next_event < shard.events.size())
+        {
+          const auto& event = shard.events[shard.next_event];
+          const uint64 event_pos = llrint (event.time * options.rate);
+          if (event_pos >= pos + block_size)
+            break;
+
+          midi_synth.add_midi_event (event_pos > pos ? event_pos - pos : 0, event.data);
+          shard.next_event++;
+        }
+      midi_synth.process (left.data(), right.data(), block_size);
+
+      shard.left.insert (shard.left.end(), left.begin(), left.end());
+      shard.right.insert (shard.right.end(), right.begin(), right.end());
+    }
+}
+
+static bool
+have_portamento (MorphPlan *morph_plan)
+{
+  for (auto op : morph_plan->operators())
+    {
+      auto output = dynamic_cast<MorphOutput *> (op);
+      if (output && output->property (MorphOutput::P_PORTAMENTO)->get_bool())
+        return true;
+    }
+  return false;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  options.parse (&argc, &argv);
+
+  if (argc != 4)
+    {
+      options.print_usage();
+      exit (1);
+    }
+  if (options.rate <= 0 || options.block_size <= 0 || options.n_voices <= 0 || options.n_voices > MidiSynth::MAX_VOICES)
+    {
+      fprintf (stderr, "%s: bad rate, block size or voice count\n", argv[0]);
+      exit (1);
+    }
+  if (options.n_shards < 1 || options.n_shards > 64)
+    {
+      fprintf (stderr, "%s: number of shards must be in range 1..64\n", argv[0]);
+      exit (1);
+    }
+
+  Project project;
+  project.set_mix_freq (options.rate);
+
+  Error error = project.load (argv[1]);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't load plan '%s': %s\n", argv[0], argv[1], error.message());
+      exit (1);
+    }
+  project.wait_for_rebuilds();
+
+  MidiFile midi_file;
+  error = midi_file.load (argv[2]);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't load midi file '%s': %s\n", argv[0], argv[2], error.message());
+      exit (1);
+    }
+
+  /* synth settings: like Project::set_mix_freq, but without anything that depends on timing */
+  Config cfg;
+  VoiceScheduler::Config vs_config;
+  if (!VoiceScheduler::parse_steal_policy (cfg.voice_steal(), vs_config.steal_policy))
+    fprintf (stderr, "%s: unsupported voice_steal policy '%s' in config\n", argv[0], cfg.voice_steal().c_str());
+  vs_config.cpu_budget = 0;
+  vs_config.lod_threshold = cfg.lod_threshold_db() < 0 ? db_to_factor (cfg.lod_threshold_db()) : 0;
+  vs_config.lod_max_partials = max (cfg.lod_max_partials(), 0);
+
+  /* one seed for all shards, so that all shards use the same global LFOs */
+  int seed = max (options.seed, -1);
+  if (seed == -1)
+    {
+      Random random;
+      seed = random.random_uint32() >> 8;
+      fprintf (stderr, "%s: using random seed %d\n", argv[0], seed);
+    }
+
+  /* portamento needs to see all notes: use one synth */
+  const bool mono = have_portamento (project.morph_plan());
+  vector<Shard> shards (mono ? 1 : options.n_shards);
+  for (auto& shard : shards)
+    {
+      shard.midi_synth.reset (new MidiSynth (options.rate, options.n_voices));
+
+      MidiSynth& midi_synth = *shard.midi_synth;
+      midi_synth.set_random_seed (seed); // before the first update
+      midi_synth.apply_update (midi_synth.prepare_update (*project.morph_plan()));
+      midi_synth.set_gain (db_to_factor (project.volume()));
+      midi_synth.set_filter_batch (cfg.filter_batch());
+      midi_synth.set_spectral_bus (cfg.spectral_bus());
+      midi_synth.set_voice_scheduler_config (vs_config);
+    }
+  assign_events (midi_file, shards);
+
+  const size_t n_threads = options.n_threads > 0 ? options.n_threads : parallel_default_threads();
+  const double start_time = get_time();
+
+  ParallelWorkers workers (n_threads);
+
+  vector<float> samples;
+  for (uint64 pos = 0; ; pos += SEGMENT_BLOCKS * options.block_size)
+    {
+      workers.parallel_for (shards.size(), [&] (size_t worker, size_t s)
+        {
+          render_segment (midi_file, shards[s], pos);
+        });
+
+      /* mix in fixed order, so the result doesn't depend on the thread count */
+      size_t n_samples = 0;
+      for (const auto& shard : shards)
+        n_samples = max (n_samples, shard.left.size());
+
+      if (!n_samples)
+        break;
+
+      const size_t offset = samples.size();
+      samples.resize (offset + n_samples * 2);
+      for (const auto& shard : shards)
+        {
+          for (size_t i = 0; i < shard.left.size(); i++)
+            {
+              samples[offset + i * 2] += shard.left[i];
+              samples[offset + i * 2 + 1] += shard.right[i];
+            }
+        }
+    }
+  const size_t n_samples = samples.size() / 2;
+  const double render_time = get_time() - start_time;
+  const double audio_time = double (n_samples) / options.rate;
+
+  fprintf (stderr, "%s: rendered %.2f seconds in %.2f seconds (%.1fx realtime, %zd shards, %zd threads)\n",
+           argv[0], audio_time, render_time, audio_time / max (render_time, 1e-9), shards.size(), n_threads);
+
+  WavData wav_data (samples, 2, options.rate, options.bits);
+  if (!wav_data.save (argv[3]))
+    {
+      fprintf (stderr, "%s: export to file %s failed: %s\n", argv[0], argv[3], wav_data.error_blurb());
+      exit (1);
+    }
+}
@@ -16,9 +16,12 @@
 #include "smwavdata.hh"
 #include "sminstrument.hh"
 #include "smwavsetbuilder.hh"
+#include "smencoder.hh"
+#include "smparallel.hh"
 
 #include <string>
 #include <map>
+#include <memory>
 
 using std::string;
 using std::vector;
@@ -59,9 +62,10 @@ struct Options
   int             max_velocity;
   vector<string>  format;
   int             max_jobs;
+  bool            in_process = false;
   bool            loop_markers = false;
   bool            loop_markers_ms = false;
-  enum { NONE, INIT, ADD, LIST, ENCODE, DECODE, DELTA, LINK, EXTRACT, GET_MARKERS, SET_MARKERS, SET_NAMES, GET_NAMES, BUILD } command;
+  enum { NONE, INIT, ADD, LIST, ENCODE, DECODE, DELTA, LINK, EXTRACT, GET_MARKERS, SET_MARKERS, SET_NAMES, GET_NAMES, BUILD, FLATTEN } command;
 
   Options ();
   void parse (int *argc_p, char **argv_p[]);
@@ -149,6 +153,10 @@ Options::parse (int   *argc_p,
         {
           max_jobs = atoi (opt_arg);
         }
+      else if (check_arg (argc, argv, &i, "--in-process"))
+        {
+          in_process = true;
+        }
       else if (check_arg (argc, argv, &i, "--loop"))
         {
           loop_markers = true;
@@ -230,6 +238,10 @@ Options::parse (int   *argc_p,
             {
               command = BUILD;
             }
+          else if (strcmp (argv[1], "flatten") == 0)
+            {
+              command = FLATTEN;
+            }
 
           if (command != NONE)
             {
@@ -257,6 +269,7 @@ Options::print_usage ()
   sm_printf (" smwavset get-markers [ <options> ] <wset_filename>\n");
   sm_printf (" smwavset set-markers [ <options> ] <wset_filename> <marker_filename>\n");
   sm_printf (" smwavset build <inst_filename> <smset_filename>\n");
+  sm_printf (" smwavset flatten <smset_filename> <flat_smset_filename>\n");
   sm_printf ("\n");
   sm_printf ("options:\n");
   sm_printf (" -h, --help                  help for %s\n", options.program_name.c_str());
@@ -267,6 +280,7 @@ Options::print_usage ()
   sm_printf (" --format <f1>,...,<fN>      set fields to display in list\n");
   sm_printf (" -j <jobs>                   run <jobs> commands simultaneously (use multiple cpus for encoding)\n");
   sm_printf (" --smenc <cmd>               use <cmd> as smenc command\n");
+  sm_printf (" --in-process                encode in this process, using <jobs> threads, and embed the models\n");
   sm_printf (" --loop                      also extract loop markers (for smwavset get-markers)\n");
   sm_printf ("\n");
 }
@@ -337,6 +351,106 @@ delta (vector<float>& d0, vector<float>& d1)
   return error / MAX (d0.size(), d1.size());
 }
 
+/// @cond
+/* subset of smenc options that are supported for encoding without smenc */
+struct InProcessEncoder
+{
+  EncoderParams enc_params;
+  int           optimization_level = 0;
+  bool          attack = true;
+  bool          track_sines = true;
+  bool          strip_models = false;
+  bool          keep_samples = false;
+
+  bool   parse_args (const string& args);
+  Audio *encode (const WavData& wav_data, int midi_note, int channel) const;
+};
+/// @endcond
+
+bool
+InProcessEncoder::parse_args (const string& args)
+{
+  int     argc = 0;
+  char  **argv = nullptr;
+  GError *error = nullptr;
+
+  if (args.find_first_not_of (" \t") == string::npos) /* g_shell_parse_argv fails on empty strings */
+    return true;
+
+  if (!g_shell_parse_argv (args.c_str(), &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s: can't parse encoder arguments: %s\n", options.program_name.c_str(), error->message);
+      g_error_free (error);
+      return false;
+    }
+
+  bool ok = true;
+  for (uint i = 0; i < uint (argc); i++)
+    {
+      const char *opt_arg;
+      if (check_arg (argc, argv, &i, "-O0"))
+        optimization_level = 0;
+      else if (check_arg (argc, argv, &i, "-O1"))
+        optimization_level = 1;
+      else if (check_arg (argc, argv, &i, "-O2"))
+        optimization_level = 2;
+      else if (check_arg (argc, argv, &i, "-O", &opt_arg))
+        optimization_level = atoi (opt_arg);
+      else if (check_arg (argc, argv, &i, "-s"))
+        strip_models = true;
+      else if (check_arg (argc, argv, &i, "--keep-samples"))
+        keep_samples = true;
+      else if (check_arg (argc, argv, &i, "--no-attack"))
+        attack = false;
+      else if (check_arg (argc, argv, &i, "--no-sines"))
+        track_sines = false;
+      else if (check_arg (argc, argv, &i, "--config", &opt_arg))
+        {
+          if (!enc_params.load_config (opt_arg))
+            {
+              fprintf (stderr, "%s: can't open config file '%s'\n", options.program_name.c_str(), opt_arg);
+              ok = false;
+            }
+        }
+      else
+        {
+          fprintf (stderr, "%s: encoder argument '%s' is not supported with --in-process\n", options.program_name.c_str(), argv[i]);
+          ok = false;
+        }
+    }
+  g_strfreev (argv);
+
+  string window_type;
+  if (ok && enc_params.get_param ("window", window_type) && window_type != "hann")
+    {
+      fprintf (stderr, "%s: window type '%s' is not supported with --in-process\n", options.program_name.c_str(), window_type.c_str());
+      ok = false;
+    }
+  return ok;
+}
+
+/* this does the same as running "smenc -m <midi_note> <args>" */
+Audio *
+InProcessEncoder::encode (const WavData& wav_data, int midi_note, int channel) const
+{
+  EncoderParams params = enc_params;
+  params.setup_params (wav_data, 440 * exp (log (2) * (midi_note - 69) / 12.0));
+
+  Encoder encoder (params);
+  encoder.encode (wav_data, channel, optimization_level, attack, track_sines);
+  if (strip_models)
+    {
+      for (auto& audio_block : encoder.audio_blocks)
+        {
+          audio_block.debug_samples.clear();
+          audio_block.original_fft.clear();
+        }
+      if (!keep_samples)
+        encoder.original_samples.clear();
+    }
+  return encoder.save_as_audio();
+}
+
 void
 load_or_die (WavSet& wset, string name)
 {
@@ -438,6 +552,65 @@ main (int argc, char **argv)
       WavSet wset, smset;
       load_or_die (wset, argv[1]);
 
+      if (options.in_process)
+        {
+          InProcessEncoder encoder;
+          if (!encoder.parse_args (options.args))
+            exit (1);
+
+          /* decode each input file once, even if it is used by more than one wave */
+          vector<string> paths;
+          map<string, size_t> path_index;
+          for (const auto& wave : wset.waves)
+            {
+              if (path_index.insert ({ wave.path, paths.size() }).second)
+                paths.push_back (wave.path);
+            }
+          const size_t n_threads = std::max (options.max_jobs, 1);
+          vector<WavData> wav_data (paths.size());
+          vector<char>    wav_data_ok (paths.size());
+          parallel_for (n_threads, paths.size(), [&] (size_t worker, size_t i)
+            {
+              wav_data_ok[i] = wav_data[i].load (paths[i]);
+            });
+          for (size_t i = 0; i < paths.size(); i++)
+            {
+              if (!wav_data_ok[i])
+                {
+                  fprintf (stderr, "%s: can't open the input file %s: %s\n", options.program_name.c_str(), paths[i].c_str(), wav_data[i].error_blurb());
+                  exit (1);
+                }
+            }
+          for (const auto& wave : wset.waves)
+            {
+              const WavData& wd = wav_data[path_index[wave.path]];
+              if (wave.channel < 0 || wave.channel >= wd.n_channels())
+                {
+                  fprintf (stderr, "%s: input file %s has no channel %d\n", options.program_name.c_str(), wave.path.c_str(), wave.channel);
+                  exit (1);
+                }
+            }
+
+          vector<std::unique_ptr<Audio>> audios (wset.waves.size());
+          parallel_for (n_threads, wset.waves.size(), [&] (size_t worker, size_t i)
+            {
+              const WavSetWave& wave = wset.waves[i];
+
+              audios[i].reset (encoder.encode (wav_data[path_index.at (wave.path)], wave.midi_note, wave.channel));
+              sm_printf ("[%s] ## encoded %s (midi note %d)\n", time2str (get_time() - start_time).c_str(), wave.path.c_str(), wave.midi_note);
+            });
+
+          for (size_t i = 0; i < wset.waves.size(); i++)
+            {
+              WavSetWave new_wave = wset.waves[i];
+              new_wave.path = options.data_dir + "/" + int2str (new_wave.midi_note) + ".sm";
+              new_wave.audio = audios[i].release();
+              smset.waves.push_back (new_wave);
+            }
+          smset.save (argv[2]);
+          return 0;
+        }
+
       JobQueue job_queue (options.max_jobs);
 
       for (vector<WavSetWave>::iterator wi = wset.waves.begin(); wi != wset.waves.end(); wi++)
@@ -683,14 +856,31 @@ main (int argc, char **argv)
         }
 
       WavSetBuilder builder (&inst, /* keep_samples */ false);
+      builder.set_progress_function ([] (size_t n_done, size_t n_total) {
+        fprintf (stderr, "%zd/%zd samples encoded\n", n_done, n_total);
+      });
       std::unique_ptr<WavSet> smset (builder.run());
       assert (smset);
 
       smset->save (out_filename);
     }
+  else if (options.command == Options::FLATTEN)
+    {
+      assert (argc == 3);
+
+      WavSet wset;
+      load_or_die (wset, argv[1]);
+
+      Error error = wset.save_flat (argv[2]);
+      if (error)
+        {
+          fprintf (stderr, "%s: can't write flat wav set: %s: %s\n", options.program_name.c_str(), argv[2], error.message());
+          exit (1);
+        }
+    }
   else
     {
-      sm_printf ("You need to specify a command (init, add, list, encode, decode, delta, build).\n\n");
+      sm_printf ("You need to specify a command (init, add, list, encode, decode, delta, build, flatten).\n\n");
       Options::print_usage();
       exit (1);
     }
@@ -0,0 +1,114 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smcachestore.hh"
+#include "smmain.hh"
+
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+static vector<unsigned char>
+make_data (int seed, size_t size)
+{
+  vector<unsigned char> data (size);
+  for (size_t i = 0; i < size; i++)
+    data[i] = (seed * 7 + i * 13) & 0xff;
+  return data;
+}
+
+static void
+test_lookup()
+{
+  CacheStore store (".", "testcachestore.tmp", 1000 * 1000);
+  store.clear();
+
+  vector<unsigned char> data;
+  assert (!store.lookup ("a", data));
+
+  assert (store.insert ("a", make_data (1, 1000)));
+  assert (store.insert ("b", make_data (2, 2000)));
+  assert (store.lookup ("a", data) && data == make_data (1, 1000));
+  assert (store.lookup ("b", data) && data == make_data (2, 2000));
+
+  /* entries are persistent */
+  CacheStore store2 (".", "testcachestore.tmp", 1000 * 1000);
+  assert (store2.lookup ("b", data) && data == make_data (2, 2000));
+
+  auto stats = store.stats();
+  assert (stats.hits == 2 && stats.misses == 1 && stats.inserts == 2 && stats.evictions == 0);
+}
+
+static void
+test_lru()
+{
+  /* room for about 4 entries */
+  CacheStore store (".", "testcachestore.tmp", 45 * 1000);
+  store.clear();
+
+  vector<unsigned char> data;
+  for (int i = 0; i < 4; i++)
+    assert (store.insert (string_printf ("key%d", i), make_data (i, 10000)));
+
+  /* key0 was used recently, so key1 is removed first */
+  assert (store.lookup ("key0", data));
+  assert (store.insert ("key4", make_data (4, 10000)));
+
+  assert (store.lookup ("key0", data) && data == make_data (0, 10000));
+  assert (!store.lookup ("key1", data));
+  assert (store.lookup ("key4", data) && data == make_data (4, 10000));
+  assert (store.stats().evictions == 1);
+
+  /* compaction: all remaining entries must still be valid */
+  for (int i = 5; i < 100; i++)
+    assert (store.insert (string_printf ("key%d", i), make_data (i, 10000)));
+  for (int i = 96; i < 100; i++)
+    assert (store.lookup (string_printf ("key%d", i), data) && data == make_data (i, 10000));
+
+  /* too large */
+  assert (!store.insert ("large", make_data (0, 100 * 1000)));
+}
+
+static void
+test_damaged()
+{
+  CacheStore store (".", "testcachestore.tmp", 1000 * 1000);
+  store.clear();
+
+  vector<unsigned char> data;
+  assert (store.insert ("a", make_data (1, 1000)));
+
+  /* change one byte of the data: entry must not be used */
+  FILE *pack = fopen ("testcachestore.tmp.pack", "r+b");
+  assert (pack);
+  fseek (pack, -10, SEEK_END);
+  fputc (0, pack);
+  fclose (pack);
+  assert (!store.lookup ("a", data));
+
+  /* pack file removed */
+  assert (store.insert ("b", make_data (2, 1000)));
+  unlink ("testcachestore.tmp.pack");
+  assert (!store.lookup ("b", data));
+  assert (store.insert ("c", make_data (3, 1000)));
+  assert (store.lookup ("c", data) && data == make_data (3, 1000));
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_lookup();
+  test_lru();
+  test_damaged();
+
+  unlink ("testcachestore.tmp.idx");
+  unlink ("testcachestore.tmp.pack");
+
+  printf ("ok\n");
+}
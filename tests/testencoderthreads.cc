@@ -0,0 +1,76 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smencoder.hh"
+#include "smmemout.hh"
+#include "smparallel.hh"
+#include "smmain.hh"
+#include "smmath.hh"
+
+#include <memory>
+#include <random>
+
+#include <stdio.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+static vector<unsigned char>
+encode (const WavData& wav_data, size_t n_threads, double& time)
+{
+  EncoderParams enc_params;
+  enc_params.setup_params (wav_data, 220);
+  enc_params.set_n_threads (n_threads);
+
+  Encoder encoder (enc_params);
+
+  const double start = get_time();
+  bool ok = encoder.encode (wav_data, 0, 1, /* attack */ true, /* sines */ true);
+  time = get_time() - start;
+  assert (ok);
+
+  std::unique_ptr<Audio> audio (encoder.save_as_audio());
+
+  vector<unsigned char> data;
+  MemOut mem_out (&data);
+  audio->save (&mem_out);
+  return data;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  /* decaying harmonic tone with some noise */
+  const double mix_freq = 48000;
+  std::mt19937 rand_gen (42);
+  std::uniform_real_distribution<float> noise_dist (-0.01, 0.01);
+
+  vector<float> signal (mix_freq * 2);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      const double t = i / mix_freq;
+      double value = 0;
+      for (int h = 1; h <= 20; h++)
+        value += sin (2 * M_PI * 220 * h * t) / h;
+      signal[i] = value * 0.3 * exp (-t * 2) + noise_dist (rand_gen);
+    }
+  WavData wav_data (signal, 1, mix_freq, 32);
+
+  double time_1;
+  vector<unsigned char> data_1 = encode (wav_data, 1, time_1);
+
+  for (size_t n_threads : { 2, 4, 7 })
+    {
+      double time_n;
+      vector<unsigned char> data_n = encode (wav_data, n_threads, time_n);
+
+      /* result must not depend on the number of threads */
+      assert (data_1 == data_n);
+
+      printf ("%zd threads: %.2f ms (1 thread: %.2f ms, speedup %.2f)\n", n_threads, time_n * 1000, time_1 * 1000, time_1 / time_n);
+    }
+  printf ("default threads: %zd\n", parallel_default_threads());
+}
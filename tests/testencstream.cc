@@ -0,0 +1,129 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smencoder.hh"
+#include "smmemout.hh"
+#include "smmain.hh"
+#include "smmath.hh"
+#include "smparallel.hh"
+
+#include <memory>
+#include <random>
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* harmonic tone with slow amplitude modulation and some noise */
+static WavData
+make_signal (double seconds)
+{
+  const double mix_freq = 48000;
+  std::mt19937 rand_gen (42);
+  std::uniform_real_distribution<float> noise_dist (-0.01, 0.01);
+
+  vector<float> signal (mix_freq * seconds);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      const double t = i / mix_freq;
+      double value = 0;
+      for (int h = 1; h <= 20; h++)
+        value += sin (2 * M_PI * 220 * h * t) / h;
+      signal[i] = value * 0.3 * (0.6 + 0.4 * sin (t * 0.7)) + noise_dist (rand_gen);
+    }
+  return WavData (signal, 1, mix_freq, 32);
+}
+
+static EncoderParams
+make_params (const WavData& wav_data, size_t n_threads)
+{
+  EncoderParams enc_params;
+  enc_params.setup_params (wav_data, 220);
+  enc_params.set_n_threads (n_threads);
+  return enc_params;
+}
+
+static vector<unsigned char>
+encode (const WavData& wav_data, size_t n_threads, bool attack, bool sines)
+{
+  Encoder encoder (make_params (wav_data, n_threads));
+  encoder.set_loop (Audio::LOOP_TIME_FORWARD, 10000, 20000);
+
+  bool ok = encoder.encode (wav_data, 0, 1, attack, sines);
+  assert (ok);
+
+  /* strip debug data, like smenc -s */
+  for (auto& block : encoder.audio_blocks)
+    {
+      block.debug_samples.clear();
+      block.original_fft.clear();
+    }
+  encoder.original_samples.clear();
+
+  std::unique_ptr<Audio> audio (encoder.save_as_audio());
+
+  vector<unsigned char> data;
+  MemOut mem_out (&data);
+  audio->save (&mem_out);
+  return data;
+}
+
+static vector<unsigned char>
+encode_stream (const WavData& wav_data, size_t n_threads, bool attack, bool sines)
+{
+  Encoder encoder (make_params (wav_data, n_threads));
+  encoder.set_loop (Audio::LOOP_TIME_FORWARD, 10000, 20000);
+
+  vector<unsigned char> data;
+  MemOut mem_out (&data);
+  bool ok = encoder.encode_stream (wav_data, 0, 1, attack, sines, &mem_out);
+  assert (ok);
+
+  return data;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  if (argc == 3 && strcmp (argv[1], "bench") == 0)
+    {
+      /* memory needed for encoding long inputs, like: testencstream bench 600 */
+      WavData wav_data = make_signal (atof (argv[2]));
+
+      vector<unsigned char> data;
+      MemOut mem_out (&data);
+
+      EncoderParams enc_params = make_params (wav_data, parallel_default_threads());
+      enc_params.set_profile (true);
+
+      Encoder encoder (enc_params);
+      encoder.encode_stream (wav_data, 0, 1, true, true, &mem_out);
+
+      printf ("%.0f seconds: output %.1f MB, peak memory %.1f MB\n", atof (argv[2]), data.size() / 1e6, sm_peak_memory_usage() / 1e6);
+      return 0;
+    }
+
+  /* short input: only the first frames (attack), long input: more than one chunk */
+  for (double seconds : { 0.1, 2.0 })
+    {
+      WavData wav_data = make_signal (seconds);
+
+      for (bool attack : { false, true })
+        {
+          for (bool sines : { false, true })
+            {
+              vector<unsigned char> data = encode (wav_data, 1, attack, sines);
+
+              /* streaming must produce the same file as encoding in memory */
+              assert (data == encode_stream (wav_data, 1, attack, sines));
+              assert (data == encode_stream (wav_data, 3, attack, sines));
+            }
+        }
+      printf ("%.1f seconds: ok\n", seconds);
+    }
+}
@@ -0,0 +1,107 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmorphoutput.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+static double
+perf (Project& project, size_t n_voices, bool filter_batch)
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 256;
+
+  MidiSynth midi_synth (mix_freq, n_voices);
+  midi_synth.apply_update (midi_synth.prepare_update (*project.morph_plan()));
+  midi_synth.set_filter_batch (filter_batch);
+
+  /* spread notes over a few octaves, all notes are sustained during the measurement */
+  for (size_t v = 0; v < n_voices; v++)
+    {
+      const unsigned char note_on[3] = { 0x90, (unsigned char) (36 + v % 48), 100 };
+      midi_synth.add_midi_event (0, note_on);
+    }
+
+  vector<float> output (block_size);
+
+  /* warm up: start voices and ignore the attack */
+  for (int i = 0; i < 50; i++)
+    midi_synth.process (output.data(), output.size());
+
+  assert (midi_synth.active_voice_count() == n_voices);
+
+  const int RUNS = 375; // 2 seconds of audio
+  double min_time = 1e20;
+  for (int rep = 0; rep < 3; rep++)
+    {
+      double start = get_time();
+      for (int r = 0; r < RUNS; r++)
+        midi_synth.process (output.data(), output.size());
+      min_time = std::min (min_time, get_time() - start);
+    }
+  const double audio_time = RUNS * block_size / mix_freq;
+  const double cpu_percent = min_time / audio_time * 100;
+
+  const double ns_per_sec = 1e9;
+  printf ("%3zd voices, %-13s %8.2f ns/sample/voice, %7.2f%% realtime\n",
+          n_voices, filter_batch ? "filter batch:" : "per voice:", min_time * ns_per_sec / (RUNS * block_size * n_voices),
+          cpu_percent);
+  return min_time;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  if (argc != 2)
+    {
+      printf ("usage: %s <plan>\n", argv[0]);
+      return 1;
+    }
+
+  Project project;
+  project.set_mix_freq (48000);
+
+  Error error = project.load (argv[1]);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't load plan '%s': %s\n", argv[0], argv[1], error.message());
+      return 1;
+    }
+
+  MorphOutput *output = nullptr;
+  for (MorphOperator *op : project.morph_plan()->operators())
+    {
+      if (op->type_name() == "Output")
+        output = dynamic_cast<MorphOutput *> (op);
+    }
+  if (!output)
+    {
+      fprintf (stderr, "%s: plan '%s' has no output operator\n", argv[0], argv[1]);
+      return 1;
+    }
+
+  /* the plan filter settings are replaced: measure both filter types */
+  output->property (MorphOutput::P_FILTER)->set_bool (true);
+  for (auto filter_type : { MorphOutput::FILTER_TYPE_LADDER, MorphOutput::FILTER_TYPE_SALLEN_KEY })
+    {
+      output->property (MorphOutput::P_FILTER_TYPE)->set (filter_type);
+      project.try_update_synth();
+
+      printf ("%s filter:\n", filter_type == MorphOutput::FILTER_TYPE_LADDER ? "ladder" : "sallen-key");
+      for (size_t n_voices : { 16, 32, 64, 128 })
+        {
+          double voice_time = perf (project, n_voices, false);
+          double batch_time = perf (project, n_voices, true);
+          printf ("%3zd voices: speedup %.2f\n\n", n_voices, voice_time / batch_time);
+        }
+    }
+}
@@ -0,0 +1,182 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smwavset.hh"
+#include "smmain.hh"
+
+#include <memory>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::string;
+
+struct Result
+{
+  double time;
+  double read_time;
+  double rss_load_mb;
+  double rss_touch_mb;
+  size_t frames;
+};
+
+static double
+rss_mb()
+{
+  long pages_total = 0, pages_resident = 0;
+
+  FILE *statm = fopen ("/proc/self/statm", "r");
+  if (statm)
+    {
+      if (fscanf (statm, "%ld %ld", &pages_total, &pages_resident) != 2)
+        pages_resident = 0;
+      fclose (statm);
+    }
+  return pages_resident * double (sysconf (_SC_PAGESIZE)) / (1024 * 1024);
+}
+
+static Result
+load_all (const vector<string>& files, AudioLoadOptions load_options)
+{
+  Result result;
+  vector<std::unique_ptr<WavSet>> wav_sets;
+
+  const double rss_start = rss_mb();
+  const double start = get_time();
+  for (const auto& file : files)
+    {
+      wav_sets.emplace_back (new WavSet());
+
+      Error error = wav_sets.back()->load (file, load_options);
+      if (error)
+        {
+          fprintf (stderr, "can't load %s: %s\n", file.c_str(), error.message());
+          exit (1);
+        }
+    }
+  result.time = get_time() - start;
+  result.rss_load_mb = rss_mb() - rss_start;
+
+  /* read all frames the way LiveDecoder does it (for mapped files, this pages in all frame data) */
+  double sum = 0;
+  result.frames = 0;
+  const double read_start = get_time();
+  for (const auto& wav_set : wav_sets)
+    {
+      for (const auto& wave : wav_set->waves)
+        {
+          for (size_t f = 0; f < wave.audio->frame_count(); f++)
+            {
+              AudioFrameView frame = wave.audio->frame (f);
+              for (size_t p = 0; p < frame.n_partials; p++)
+                sum += frame.freqs_f (p) * frame.mags_f (p);
+              for (size_t b = 0; b < frame.n_noise; b++)
+                sum += frame.noise_f (b);
+              result.frames++;
+            }
+        }
+    }
+  result.read_time = get_time() - read_start;
+  result.rss_touch_mb = rss_mb() - rss_start;
+  if (sum == 42) /* avoid optimizing the loop away */
+    printf ("*");
+  return result;
+}
+
+/* measure each run in a new process, so that RSS and malloc state of one run don't affect the next */
+static Result
+measure (const vector<string>& files, AudioLoadOptions load_options)
+{
+  Result best;
+  best.time = 1e20;
+
+  for (int rep = 0; rep < 5; rep++)
+    {
+      int fds[2];
+      if (pipe (fds) != 0)
+        {
+          perror ("pipe");
+          exit (1);
+        }
+      pid_t pid = fork();
+      if (pid == 0)
+        {
+          Result result = load_all (files, load_options);
+          if (write (fds[1], &result, sizeof (result)) != sizeof (result))
+            _exit (1);
+          _exit (0);
+        }
+      close (fds[1]);
+
+      Result result;
+      bool ok = read (fds[0], &result, sizeof (result)) == sizeof (result);
+      close (fds[0]);
+      waitpid (pid, nullptr, 0);
+
+      if (!ok)
+        {
+          fprintf (stderr, "measurement failed\n");
+          exit (1);
+        }
+      if (result.time < best.time)
+        best = result;
+    }
+  return best;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  if (argc != 3)
+    {
+      printf ("usage: %s <smset_dir> <flat_out_dir>\n", argv[0]);
+      return 1;
+    }
+  const string smset_dir = argv[1];
+  const string flat_dir = argv[2];
+
+  vector<string> names;
+  Error error = read_dir (smset_dir, names);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't read directory %s: %s\n", argv[0], smset_dir.c_str(), error.message());
+      return 1;
+    }
+
+  vector<string> legacy_files, flat_files;
+  for (const auto& name : names)
+    {
+      if (name.size() < 6 || name.substr (name.size() - 6) != ".smset")
+        continue;
+
+      WavSet wav_set;
+      error = wav_set.load (smset_dir + "/" + name, AUDIO_SKIP_DEBUG);
+      if (!error)
+        error = wav_set.save_flat (flat_dir + "/" + name);
+      if (error)
+        {
+          fprintf (stderr, "%s: can't convert %s: %s\n", argv[0], name.c_str(), error.message());
+          return 1;
+        }
+      legacy_files.push_back (smset_dir + "/" + name);
+      flat_files.push_back (flat_dir + "/" + name);
+    }
+  printf ("%zd instruments\n", legacy_files.size());
+
+  /* the files were just read/written, so this measures load time with warm page cache */
+  Result legacy = measure (legacy_files, AUDIO_SKIP_DEBUG);    // one AudioBlock per frame
+  Result packed = measure (legacy_files, AUDIO_MAP_FRAMES);    // parsed into AudioFrameStore pools
+  Result flat   = measure (flat_files, AUDIO_MAP_FRAMES);      // mapped AudioFrameStore
+
+  for (auto [label, r] : { std::make_pair ("legacy", legacy), std::make_pair ("packed", packed), std::make_pair ("flat", flat) })
+    {
+      printf ("%-8s load %8.2f ms   read %zd frames %7.2f ns/frame   rss after load %8.2f MB   rss after reading %8.2f MB\n",
+              label, r.time * 1000, r.frames, r.read_time * 1e9 / r.frames, r.rss_load_mb, r.rss_touch_mb);
+    }
+  printf ("load speedup: packed %.2f, flat %.2f\n", legacy.time / packed.time, legacy.time / flat.time);
+}
@@ -66,6 +66,26 @@ perf_test()
 
   printf ("render_partial: clocks per sample: %f\n", clocks_per_sec * t / RUNS / block_size);
 
+  const int BATCH = 500;
+  vector<float> freqs, mags, phases;
+  for (int i = 0; i < BATCH; i++)
+    {
+      freqs.push_back (freq * (1 + i * 0.1));
+      mags.push_back (mag);
+      phases.push_back (phase);
+    }
+  t = 1e30;
+  for (int reps = 0; reps < 12; reps++)
+    {
+      start = get_time();
+      for (int r = 0; r < RUNS / BATCH; r++)
+        synth.render_partials (BATCH, &freqs[0], &mags[0], &phases[0]);
+      end = get_time();
+      t = min (t, end - start);
+    }
+
+  printf ("render_partials: clocks per sample: %f\n", clocks_per_sec * t / (RUNS / BATCH * BATCH) / block_size);
+
   AlignedArray<float, 16> sse_samples (block_size);
 
   synth.get_samples (&sse_samples[0]);  // first run may be slower
@@ -284,6 +304,41 @@ test_spect()
   FFT::free_array_float (spect);
 }
 
+void
+test_batch()
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 1024;
+
+  IFFTSynth synth (block_size, mix_freq, IFFTSynth::WIN_BLACKMAN_HARRIS_92);
+
+  vector<float> freqs, mags, phases;
+  for (double freq = 5; freq < mix_freq / 2; freq = freq * 1.003 + 1.7)
+    {
+      freqs.push_back (freq);
+      mags.push_back (0.5 + freqs.size() % 7 * 0.1);
+      phases.push_back (fmod (freqs.size() * 0.37, 2 * M_PI));
+    }
+
+  vector<float> spect_scalar (block_size + 2), spect_batch (block_size + 2);
+
+  synth.clear_partials();
+  for (size_t i = 0; i < freqs.size(); i++)
+    synth.render_partial (freqs[i], mags[i], phases[i]);
+  std::copy_n (synth.fft_buffer(), block_size, spect_scalar.begin());
+
+  synth.clear_partials();
+  synth.render_partials (freqs.size(), &freqs[0], &mags[0], &phases[0]);
+  std::copy_n (synth.fft_buffer(), block_size, spect_batch.begin());
+
+  double max_diff = 0;
+  for (size_t i = 0; i < block_size; i++)
+    max_diff = max<double> (max_diff, fabs (spect_scalar[i] - spect_batch[i]));
+
+  printf ("# IFFTSynth: render_partials (%zd partials) max_diff = %.17g\n", freqs.size(), max_diff);
+  assert (max_diff < 1e-7);
+}
+
 void
 test_phase()
 {
@@ -412,4 +467,6 @@ main (int argc, char **argv)
   printf ("# IFFTSynth: max_freq_diff = %.17g\n", max_freq_diff);
   assert (max_output_diff < 9e-5);
   assert (max_freq_diff < 0.1);
+
+  test_batch();
 }
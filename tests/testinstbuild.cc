@@ -4,6 +4,9 @@
 #include "smwavsetbuilder.hh"
 #include "sminstenccache.hh"
 
+#include <algorithm>
+#include <cinttypes>
+
 #include <assert.h>
 
 using namespace SpectMorph;
@@ -35,6 +38,25 @@ main (int argc, char **argv)
       std::unique_ptr<WavSet> wav_set (builder.run());
       kill_func(); // take time at end
 
+      return 0;
+    }
+  if (argc == 4 && strcmp (argv[1], "threads") == 0)
+    {
+      // time one build with the given number of threads (clear the disk cache before running this)
+      Instrument inst;
+      inst.load (argv[3]);
+
+      WavSetBuilder builder (&inst, /* keep_samples */ false);
+      builder.set_n_threads (atoi (argv[2]));
+      builder.set_progress_function ([] (size_t n_done, size_t n_total) {
+        sm_printf ("%zd/%zd samples done\n", n_done, n_total);
+      });
+
+      double t = get_time();
+      std::unique_ptr<WavSet> wav_set (builder.run());
+      assert (wav_set);
+
+      sm_printf ("time: %.2f ms\n", (get_time() - t) * 1000);
       return 0;
     }
   assert (argc == 2);
@@ -60,4 +82,10 @@ main (int argc, char **argv)
   // report times at end of test
   for (auto t_ms : times)
       printf ("time: %.2f ms\n", t_ms);
+
+  auto stats = InstEncCache::the()->stats();
+  printf ("cache: %" PRIu64 " memory hits, %" PRIu64 " disk hits, %" PRIu64 " misses, disk lookup avg %.2f ms, max %.2f ms\n",
+          stats.memory_hits, stats.disk.hits, stats.disk.misses,
+          stats.disk.lookup_time * 1000 / std::max<uint64> (stats.disk.hits + stats.disk.misses, 1),
+          stats.disk.max_lookup_time * 1000);
 }
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 #include <cmath>
 #include <cstdio>
@@ -115,6 +116,105 @@ main (int argc, char **argv)
 
       return 0;
     }
+  if (argc == 2 && cmd == "lanes")
+    {
+      /* batched processing (one filter per SIMD lane) must produce the same output as process_block() */
+      auto test_lanes = [] (auto make_filter, const char *label)
+        {
+          using Filter = typename decltype (make_filter())::element_type;
+          using Coeffs = typename Filter::Coeffs;
+
+          const uint n_lanes = Filter::LANES;
+          const uint n_samples = 64;
+
+          vector<std::unique_ptr<Filter>> filters, batch_filters;
+          for (uint l = 0; l < n_lanes; l++)
+            {
+              filters.push_back (make_filter());
+              batch_filters.push_back (make_filter());
+            }
+          vector<float> freq_in (n_samples), reso_in (n_samples), drive_in (n_samples);
+          double max_diff = 0, block_time = 0, lanes_time = 0;
+          for (int block = 0; block < 2000; block++)
+            {
+              Filter       *lane_filters[n_lanes];
+              const Coeffs *lane_coeffs[n_lanes];
+              float        *lane_samples[n_lanes];
+              vector<Coeffs> coeffs (n_lanes * n_samples);
+              vector<float>  over_samples (n_lanes * n_samples * 4);
+              vector<float>  in (n_lanes * n_samples), out (n_lanes * n_samples);
+              for (size_t i = 0; i < in.size(); i++)
+                in[i] = sin (i * (0.01 + 0.003 * (i / n_samples))) * 0.5;
+
+              for (uint l = 0; l < n_lanes; l++)
+                {
+                  const bool modulate = (block / 50 + l) % 2;
+                  for (uint i = 0; i < n_samples; i++)
+                    {
+                      freq_in[i] = 200 + 100 * l + (block % 100) * 30 + i;
+                      reso_in[i] = 0.2 + 0.1 * l + i * 0.001;
+                      drive_in[i] = l;
+                    }
+                  auto t = get_time();
+                  std::copy_n (&in[l * n_samples], n_samples, &out[l * n_samples]);
+                  if (modulate)
+                    filters[l]->process_block (n_samples, &out[l * n_samples], nullptr, freq_in.data(), reso_in.data(), drive_in.data());
+                  else
+                    filters[l]->process_block (n_samples, &out[l * n_samples]);
+                  block_time += get_time() - t;
+
+                  t = get_time();
+                  lane_filters[l] = batch_filters[l].get();
+                  lane_coeffs[l] = &coeffs[l * n_samples];
+                  lane_samples[l] = &over_samples[l * n_samples * 4];
+                  if (modulate)
+                    lane_filters[l]->compute_coeffs (n_samples, &coeffs[l * n_samples], freq_in.data(), reso_in.data(), drive_in.data());
+                  else
+                    lane_filters[l]->compute_coeffs (n_samples, &coeffs[l * n_samples]);
+                  lane_filters[l]->upsample (n_samples, &in[l * n_samples], lane_samples[l]);
+                  lanes_time += get_time() - t;
+                }
+              auto t = get_time();
+              Filter::process_lanes (n_lanes, lane_filters, lane_coeffs, lane_samples, n_samples);
+              for (uint l = 0; l < n_lanes; l++)
+                lane_filters[l]->downsample (n_samples, lane_samples[l], &in[l * n_samples]);
+              lanes_time += get_time() - t;
+
+              for (size_t i = 0; i < in.size(); i++)
+                max_diff = std::max<double> (max_diff, std::abs (in[i] - out[i]));
+            }
+          printf ("%s: max_diff %g, process_block %.2f ns/sample, process_lanes %.2f ns/sample (per filter)\n", label, max_diff,
+                  block_time / (2000 * n_samples * n_lanes) * 1e9, lanes_time / (2000 * n_samples * n_lanes) * 1e9);
+          return max_diff == 0;
+        };
+
+      bool ok = true;
+      for (auto mode : { LadderVCF::LP1, LadderVCF::LP2, LadderVCF::LP3, LadderVCF::LP4 })
+        {
+          auto make_filter = [mode]()
+            {
+              std::unique_ptr<LadderVCF> filter (new LadderVCF (/* oversample */ 4));
+              filter->set_mode (mode);
+              filter->set_freq (440);
+              filter->set_reso (0.3);
+              return filter;
+            };
+          ok = test_lanes (make_filter, string_printf ("LadderVCF mode %d", mode).c_str()) && ok;
+        }
+      for (int mode = SKFilter::LP1; mode <= SKFilter::HP8; mode++)
+        {
+          auto make_filter = [mode]()
+            {
+              std::unique_ptr<SKFilter> filter (new SKFilter (/* oversample */ 4));
+              filter->set_mode (SKFilter::Mode (mode));
+              filter->set_freq (440);
+              filter->set_reso (0.3);
+              return filter;
+            };
+          ok = test_lanes (make_filter, string_printf ("SKFilter mode %d", mode).c_str()) && ok;
+        }
+      return ok ? 0 : 1;
+    }
   if (argc == 8 && cmd == "ffade") // <freq> <reso> <drive> <n> <xfrq> <xphase>
     {
       LadderVCF laddervcf (/* oversample */ 4);
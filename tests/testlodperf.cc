@@ -0,0 +1,133 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmath.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+struct LODResult
+{
+  double        time = 0;
+  double        culled_partials = 0;
+  vector<float> output;
+};
+
+/* fraction of culled partials reported by MidiSynth through the notify buffer */
+static void
+read_notify_events (MidiSynth& midi_synth, double& culled_sum, int& n_events)
+{
+  NotifyBuffer *notify_buffer = midi_synth.notify_buffer();
+  if (notify_buffer->start_read())
+    {
+      while (notify_buffer->remaining())
+        {
+          SynthNotifyEvent *sn_event = SynthNotifyEvent::create (*notify_buffer);
+          auto vs_event = dynamic_cast<VoiceSchedulerEvent *> (sn_event);
+          if (vs_event)
+            {
+              culled_sum += vs_event->culled_partials;
+              n_events++;
+            }
+          delete sn_event;
+        }
+      notify_buffer->end_read();
+    }
+}
+
+static LODResult
+perf (Project& project, size_t n_voices, double threshold_db, int max_partials)
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 256;
+
+  MidiSynth midi_synth (mix_freq, n_voices);
+  midi_synth.apply_update (midi_synth.prepare_update (*project.morph_plan()));
+
+  VoiceScheduler::Config config;
+  config.lod_threshold = threshold_db < 0 ? db_to_factor (threshold_db) : 0;
+  config.lod_max_partials = max_partials;
+  midi_synth.set_voice_scheduler_config (config);
+
+  /* spread notes over a few octaves with different velocities, all notes are sustained during the measurement */
+  for (size_t v = 0; v < n_voices; v++)
+    {
+      const unsigned char note_on[3] = { 0x90, (unsigned char) (36 + v % 48), (unsigned char) (30 + (v * 37) % 97) };
+      midi_synth.add_midi_event (0, note_on);
+    }
+
+  LODResult result;
+  vector<float> left (block_size), right (block_size);
+
+  /* warm up: start voices and ignore the attack */
+  for (int i = 0; i < 50; i++)
+    midi_synth.process (left.data(), right.data(), block_size);
+
+  assert (midi_synth.active_voice_count() == n_voices);
+
+  const int RUNS = 375; // 2 seconds of audio
+  double culled_sum = 0;
+  int n_events = 0;
+  double start = get_time();
+  for (int r = 0; r < RUNS; r++)
+    {
+      midi_synth.process (left.data(), right.data(), block_size);
+      read_notify_events (midi_synth, culled_sum, n_events);
+
+      result.output.insert (result.output.end(), left.begin(), left.end());
+    }
+  result.time = get_time() - start;
+  result.culled_partials = n_events ? culled_sum / n_events : 0;
+  return result;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  if (argc != 2)
+    {
+      printf ("usage: %s <plan>\n", argv[0]);
+      return 1;
+    }
+
+  Project project;
+  project.set_mix_freq (48000);
+
+  Error error = project.load (argv[1]);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't load plan '%s': %s\n", argv[0], argv[1], error.message());
+      return 1;
+    }
+  project.try_update_synth();
+
+  const size_t n_voices = 64;
+  const LODResult ref = perf (project, n_voices, 0, 0);
+
+  struct { double threshold_db; int max_partials; } settings[] = {
+    { 0, 0 }, { -100, 0 }, { -80, 0 }, { -60, 0 }, { -40, 0 }, { 0, 64 }, { 0, 32 }, { -60, 32 }
+  };
+  for (auto s : settings)
+    {
+      const LODResult lod = perf (project, n_voices, s.threshold_db, s.max_partials);
+
+      double signal = 0, noise = 0;
+      for (size_t i = 0; i < ref.output.size(); i++)
+        {
+          signal += ref.output[i] * ref.output[i];
+          noise += (ref.output[i] - lod.output[i]) * (ref.output[i] - lod.output[i]);
+        }
+      const double snr_db = noise > 0 ? 10 * log10 (signal / noise) : 999;
+
+      printf ("threshold %4.0f dB, max partials %3d: culled %5.1f%%  speedup %.2f  snr %6.1f dB\n",
+              s.threshold_db, s.max_partials, lod.culled_partials * 100, ref.time / lod.time, snr_db);
+    }
+}
@@ -0,0 +1,120 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidifile.hh"
+#include "smmain.hh"
+
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+static void
+add_chunk (vector<unsigned char>& data, const char *type, const vector<unsigned char>& chunk)
+{
+  data.insert (data.end(), type, type + 4);
+  for (int shift : { 24, 16, 8, 0 })
+    data.push_back (chunk.size() >> shift);
+  data.insert (data.end(), chunk.begin(), chunk.end());
+}
+
+static vector<unsigned char>
+make_file (int format, int division, const vector<vector<unsigned char>>& tracks)
+{
+  vector<unsigned char> data;
+  add_chunk (data, "MThd", { 0, (unsigned char) format, 0, (unsigned char) tracks.size(),
+                             (unsigned char) (division >> 8), (unsigned char) division });
+  for (const auto& track : tracks)
+    add_chunk (data, "MTrk", track);
+  return data;
+}
+
+static bool
+close (double a, double b)
+{
+  return fabs (a - b) < 1e-9;
+}
+
+static void
+test_tempo_map()
+{
+  /* format 1: tempo track + note track */
+  vector<unsigned char> tempo_track = {
+    0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,    // 120 bpm
+    0x83, 0x60, 0xff, 0x51, 0x03, 0x0f, 0x42, 0x40, // delta 480: 60 bpm
+    0x00, 0xff, 0x2f, 0x00
+  };
+  vector<unsigned char> note_track = {
+    0x00, 0xff, 0x03, 0x04, 'l', 'e', 'a', 'd', // track name (ignored)
+    0x00, 0x90, 60, 100,                        // note on
+    0x83, 0x60, 64, 90,                         // running status: note on after one quarter
+    0x00, 0xf0, 0x02, 0x01, 0xf7,               // sysex (ignored)
+    0x83, 0x60, 0x80, 60, 0,                    // note off
+    0x00, 0x90, 64, 0,                          // note on with velocity 0
+    0x00, 0xc1, 5,                              // program change: one data byte
+    0x00, 0xff, 0x2f, 0x00
+  };
+  MidiFile midi_file;
+  Error error = midi_file.parse (make_file (1, 480, { tempo_track, note_track }));
+  assert (!error);
+
+  const auto& events = midi_file.events();
+  assert (events.size() == 5);
+
+  assert (events[0].data[0] == 0x90 && events[0].data[1] == 60 && events[0].size == 3);
+  assert (close (events[0].time, 0));
+
+  /* first quarter note at 120 bpm */
+  assert (events[1].data[0] == 0x90 && events[1].data[1] == 64 && events[1].data[2] == 90);
+  assert (close (events[1].time, 0.5) && close (events[1].ppq_pos, 1));
+
+  /* second quarter note at 60 bpm */
+  assert (events[2].data[0] == 0x80 && events[2].data[1] == 60);
+  assert (close (events[2].time, 1.5) && close (events[2].ppq_pos, 2));
+
+  assert (events[4].data[0] == 0xc1 && events[4].data[1] == 5 && events[4].size == 2);
+
+  assert (midi_file.tempos().size() == 2);
+  assert (close (midi_file.tempo_at (0.4), 120) && close (midi_file.tempo_at (0.6), 60));
+  assert (close (midi_file.ppq_pos_at (1.0), 1.5));
+  assert (close (midi_file.length(), 1.5));
+}
+
+static void
+test_errors()
+{
+  MidiFile midi_file;
+
+  /* not a midi file */
+  assert (midi_file.parse ({ 'R', 'I', 'F', 'F', 0, 0, 0, 0 }));
+
+  /* SMPTE division */
+  assert (midi_file.parse (make_file (0, 0xe728, { { 0x00, 0xff, 0x2f, 0x00 } })));
+
+  /* format 2 */
+  assert (midi_file.parse (make_file (2, 96, { { 0x00, 0xff, 0x2f, 0x00 } })));
+
+  /* running status without previous status */
+  assert (midi_file.parse (make_file (0, 96, { { 0x00, 60, 100, 0x00, 0xff, 0x2f, 0x00 } })));
+
+  /* truncated event */
+  assert (midi_file.parse (make_file (0, 96, { { 0x00, 0x90, 60 } })));
+
+  /* track without end of track is accepted */
+  assert (!midi_file.parse (make_file (0, 96, { { 0x00, 0x90, 60, 100, 0x60, 0x80, 60, 0 } })));
+  assert (midi_file.events().size() == 2);
+  assert (close (midi_file.events()[1].time, 0.5));
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_tempo_map();
+  test_errors();
+
+  printf ("ok\n");
+}
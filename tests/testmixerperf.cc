@@ -0,0 +1,151 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smblockutils.hh"
+#include "smalignedarray.hh"
+#include "smmath.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+using std::vector;
+using std::min;
+using std::max;
+
+enum class Mode { MONO, STEREO_RAMP, STEREO_INPUT };
+
+static const char *
+mode_name (Mode mode)
+{
+  switch (mode)
+    {
+      case Mode::MONO:         return "mono (scalar):";
+      case Mode::STEREO_RAMP:  return "stereo ramp:";
+      case Mode::STEREO_INPUT: return "stereo input:";
+    }
+  return "";
+}
+
+/* mixes n_voices voices into the output, like MidiSynth::process_audio() */
+static void
+mix (Mode mode, size_t n_voices, size_t block_size, const vector<float>& voice_samples, const vector<float>& gains,
+     float *out_left, float *out_right)
+{
+  for (size_t v = 0; v < n_voices; v++)
+    {
+      const float *samples = &voice_samples[v * block_size];
+      const float  gain = gains[v];
+
+      if (mode == Mode::MONO)
+        {
+          /* old mixer: mono output, constant gain */
+          for (size_t i = 0; i < block_size; i++)
+            out_left[i] += samples[i] * gain;
+        }
+      else if (mode == Mode::STEREO_RAMP)
+        {
+          /* new mixer: mono voice, panned, with gain ramp */
+          Block::mix_stereo (block_size, out_left, out_right, samples, samples, gain, gain * 0.9f, gain * 0.5f, gain * 0.6f);
+        }
+      else
+        {
+          const float *samples_right = &voice_samples[((v + 1) % n_voices) * block_size];
+
+          Block::mix_stereo (block_size, out_left, out_right, samples, samples_right, gain, gain * 0.9f, gain * 0.5f, gain * 0.6f);
+        }
+    }
+}
+
+static void
+check_mix_stereo()
+{
+  Random random;
+  random.set_seed (42);
+
+  /* compare against scalar code, using unaligned pointers and odd sizes */
+  const size_t n = 1003;
+  vector<float> in_left (n), in_right (n), out_left (n), out_right (n), ref_left (n), ref_right (n);
+  for (size_t i = 0; i < n; i++)
+    {
+      in_left[i] = random.random_double_range (-1, 1);
+      in_right[i] = random.random_double_range (-1, 1);
+      out_left[i] = ref_left[i] = random.random_double_range (-1, 1);
+      out_right[i] = ref_right[i] = random.random_double_range (-1, 1);
+    }
+  for (size_t offset : { 0, 1, 3 })
+    {
+      const size_t len = n - offset;
+      const float start_left = 0.3, end_left = 0.9, start_right = 1.2, end_right = 0.1;
+
+      Block::mix_stereo (len, &out_left[offset], &out_right[offset], &in_left[offset], &in_right[offset],
+                         start_left, end_left, start_right, end_right);
+
+      for (size_t i = 0; i < len; i++)
+        {
+          ref_left[offset + i] += in_left[offset + i] * (start_left + (end_left - start_left) / len * (i + 1));
+          ref_right[offset + i] += in_right[offset + i] * (start_right + (end_right - start_right) / len * (i + 1));
+        }
+    }
+  double max_diff = 0;
+  for (size_t i = 0; i < n; i++)
+    max_diff = max<double> (max_diff, max (fabs (out_left[i] - ref_left[i]), fabs (out_right[i] - ref_right[i])));
+
+  printf ("mix_stereo: max_diff %g\n", max_diff);
+  assert (max_diff < 1e-6);
+}
+
+static double
+perf (Mode mode, size_t n_voices)
+{
+  const size_t block_size = 256;
+
+  Random random;
+  random.set_seed (42);
+
+  vector<float> voice_samples (n_voices * block_size);
+  vector<float> gains (n_voices);
+  for (auto& s : voice_samples)
+    s = random.random_double_range (-1, 1);
+  for (auto& g : gains)
+    g = random.random_double_range (0.1, 1);
+
+  AlignedArray<float, 16> out_left (block_size), out_right (block_size);
+
+  double min_time = 1e20;
+  const int RUNS = 5000, REPS = 7;
+  for (int reps = 0; reps < REPS; reps++)
+    {
+      double start = get_time();
+      for (int r = 0; r < RUNS; r++)
+        {
+          zero_float_block (block_size, &out_left[0]);
+          zero_float_block (block_size, &out_right[0]);
+
+          mix (mode, n_voices, block_size, voice_samples, gains, &out_left[0], &out_right[0]);
+        }
+      double end = get_time();
+      min_time = min (min_time, end - start);
+    }
+
+  const double ns_per_sec = 1e9;
+  const double time_norm = ns_per_sec / RUNS / block_size / n_voices;
+
+  printf ("%3zd voices, %-15s %6.3f ns/sample/voice\n", n_voices, mode_name (mode), min_time * time_norm);
+  return min_time;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  check_mix_stereo();
+
+  for (size_t n_voices : { 1, 8, 32, 128 })
+    {
+      for (auto mode : { Mode::MONO, Mode::STEREO_RAMP, Mode::STEREO_INPUT })
+        perf (mode, n_voices);
+      printf ("\n");
+    }
+}
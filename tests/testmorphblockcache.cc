@@ -0,0 +1,126 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmorphblockcache.hh"
+#include "smmain.hh"
+
+#include <stdio.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* frames are identified by address, so we use elements of this array */
+static char frames[4096];
+
+static MorphBlockCache::Key
+make_key (int frame, double morphing)
+{
+  MorphBlockCache::Key key;
+  key.blocks[0] = &frames[frame];
+  key.morphing[0] = morphing;
+  return key;
+}
+
+/* block contents are derived from the frame number, to check that lookup returns the right data */
+static void
+make_block (int frame, size_t n_freqs, RTAudioBlock& block)
+{
+  vector<uint16_t> freqs, mags, noise;
+  for (size_t i = 0; i < n_freqs; i++)
+    {
+      freqs.push_back (frame + i);
+      mags.push_back (frame * 3 + i);
+    }
+  for (size_t i = 0; i < 32; i++)
+    noise.push_back (frame * 7 + i);
+
+  block.freqs.assign (freqs.data(), freqs.size());
+  block.mags.assign (mags.data(), mags.size());
+  block.noise.assign (noise.data(), noise.size());
+}
+
+static bool
+check_lookup (MorphBlockCache& cache, int frame, double morphing)
+{
+  RTMemoryArea rt_memory_area;
+  RTAudioBlock block (&rt_memory_area);
+  bool have_block;
+
+  if (!cache.lookup (make_key (frame, morphing), block, have_block))
+    return false;
+
+  assert (have_block);
+  assert (block.freqs.size() == 10 && block.noise.size() == 32);
+  assert (block.freqs[3] == frame + 3 && block.mags[3] == frame * 3 + 3 && block.noise[5] == frame * 7 + 5);
+  return true;
+}
+
+static void
+insert (MorphBlockCache& cache, int frame, double morphing, size_t n_freqs = 10)
+{
+  RTMemoryArea rt_memory_area;
+  RTAudioBlock block (&rt_memory_area);
+
+  make_block (frame, n_freqs, block);
+  cache.insert (make_key (frame, morphing), block, true);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  MorphBlockCache cache;
+
+  /* entries are kept until the cache is full */
+  const int N = 512;
+  for (int f = 0; f < N; f++)
+    insert (cache, f, 1);
+  for (int f = 0; f < N; f++)
+    assert (check_lookup (cache, f, 1));
+  assert (!check_lookup (cache, 0, 2));
+
+  /* least recently used entries are replaced: frame 0 was used first, so touch it to keep it */
+  assert (check_lookup (cache, 0, 1));
+  for (int f = N; f < N + 10; f++)
+    insert (cache, f, 1);
+
+  assert (check_lookup (cache, 0, 1));
+  for (int f = 1; f <= 10; f++)
+    assert (!check_lookup (cache, f, 1));
+  for (int f = 11; f < N + 10; f++)
+    assert (check_lookup (cache, f, 1));
+
+  /* entries without block */
+  RTMemoryArea rt_memory_area;
+  RTAudioBlock empty_block (&rt_memory_area);
+  cache.insert (make_key (4000, 0), empty_block, false);
+
+  bool have_block = true;
+  assert (cache.lookup (make_key (4000, 0), empty_block, have_block));
+  assert (!have_block);
+
+  /* blocks which are too large are not cached */
+  insert (cache, 3000, 1, 2000);
+  assert (!check_lookup (cache, 3000, 1));
+
+  /* morph positions must match exactly, so using the cache doesn't change the output */
+  insert (cache, 3500, 0.25);
+  assert (check_lookup (cache, 3500, 0.25));
+  assert (!check_lookup (cache, 3500, 0.25 + 1e-12));
+  assert (!check_lookup (cache, 3500, 0.25 - 1e-12));
+
+  insert (cache, 3600, 0.0);
+  assert (check_lookup (cache, 3600, -0.0));
+
+  /* invalidate removes everything */
+  cache.invalidate();
+  for (int f = 0; f < N + 10; f++)
+    assert (!check_lookup (cache, f, 1));
+
+  insert (cache, 42, 1);
+  assert (check_lookup (cache, 42, 1));
+
+  printf ("hits %zd, misses %zd\n", size_t (cache.hits()), size_t (cache.misses()));
+}
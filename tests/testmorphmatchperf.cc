@@ -0,0 +1,135 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmorphutils.hh"
+#include "smrandom.hh"
+#include "smmain.hh"
+#include "smutils.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::min;
+
+/* matching as it was done before MorphUtils::match_partials: binary search for each partial */
+static size_t
+match_partials_ref (const RTAudioBlock& left_block, const RTAudioBlock& right_block,
+                    MorphUtils::FreqState *left_freqs, MorphUtils::FreqState *right_freqs, MorphUtils::MatchPair *matches)
+{
+  struct MagData
+  {
+    bool     left;
+    size_t   index;
+    uint16_t mag;
+  };
+  MagData mds[left_block.freqs.size() + right_block.freqs.size() + AVOID_ARRAY_UB];
+  size_t  mds_size = 0;
+  for (size_t i = 0; i < left_block.freqs.size(); i++)
+    mds[mds_size++] = { true, i, left_block.mags[i] };
+  for (size_t i = 0; i < right_block.freqs.size(); i++)
+    mds[mds_size++] = { false, i, right_block.mags[i] };
+  std::sort (mds, mds + mds_size, [] (const MagData& m1, const MagData& m2) { return m1.mag > m2.mag; });
+
+  MorphUtils::init_freq_state (left_block.freqs, left_freqs);
+  MorphUtils::init_freq_state (right_block.freqs, right_freqs);
+
+  size_t n_matches = 0;
+  for (size_t m = 0; m < mds_size; m++)
+    {
+      const MagData& md = mds[m];
+      size_t i, j;
+      bool match = false;
+      if (md.left)
+        {
+          i = md.index;
+          if (!left_freqs[i].used)
+            match = MorphUtils::find_match (left_freqs[i].freq_f, right_freqs, right_block.freqs.size(), &j);
+        }
+      else
+        {
+          j = md.index;
+          if (!right_freqs[j].used)
+            match = MorphUtils::find_match (right_freqs[j].freq_f, left_freqs, left_block.freqs.size(), &i);
+        }
+      if (match)
+        {
+          matches[n_matches++] = { i, j };
+          left_freqs[i].used = 1;
+          right_freqs[j].used = 1;
+        }
+    }
+  return n_matches;
+}
+
+static void
+fill_block (RTAudioBlock& block, size_t n_partials, Random& random)
+{
+  /* harmonic partials with some frequency jitter and a few extra (inharmonic) partials */
+  vector<uint16_t> freqs;
+  for (size_t i = 1; freqs.size() < n_partials; i++)
+    {
+      freqs.push_back (sm_freq2ifreq (i + random.random_double_range (-0.3, 0.3)));
+      if (freqs.size() < n_partials && random.random_double_range (0, 1) < 0.2)
+        freqs.push_back (sm_freq2ifreq (i + random.random_double_range (0.35, 0.65)));
+    }
+  std::sort (freqs.begin(), freqs.end());
+
+  block.freqs.set_capacity (n_partials);
+  block.mags.set_capacity (n_partials);
+  for (auto f : freqs)
+    {
+      block.freqs.push_back (f);
+      block.mags.push_back (sm_factor2idb (random.random_double_range (0.001, 1)));
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  Random random;
+  for (size_t n_partials : { 50, 100, 200, 500, 1000 })
+    {
+      RTMemoryArea rt_memory_area;
+      RTAudioBlock left_block (&rt_memory_area), right_block (&rt_memory_area);
+
+      fill_block (left_block, n_partials, random);
+      fill_block (right_block, n_partials, random);
+
+      vector<MorphUtils::FreqState> left_freqs (n_partials), right_freqs (n_partials);
+      vector<MorphUtils::MatchPair> matches (n_partials), ref_matches (n_partials);
+
+      /* check that we get the same match pairs */
+      size_t n_matches = MorphUtils::match_partials (left_block, right_block, left_freqs.data(), right_freqs.data(), matches.data());
+      size_t n_ref_matches = match_partials_ref (left_block, right_block, left_freqs.data(), right_freqs.data(), ref_matches.data());
+      assert (n_matches == n_ref_matches);
+      for (size_t m = 0; m < n_matches; m++)
+        assert (matches[m].left == ref_matches[m].left && matches[m].right == ref_matches[m].right);
+
+      const int RUNS = 200000 / n_partials;
+      double t[2] = { 1e30, 1e30 };
+      for (int reps = 0; reps < 10; reps++)
+        {
+          for (int ref = 0; ref < 2; ref++)
+            {
+              double start = get_time();
+              for (int r = 0; r < RUNS; r++)
+                {
+                  if (ref)
+                    match_partials_ref (left_block, right_block, left_freqs.data(), right_freqs.data(), ref_matches.data());
+                  else
+                    MorphUtils::match_partials (left_block, right_block, left_freqs.data(), right_freqs.data(), matches.data());
+                }
+              t[ref] = min (t[ref], get_time() - start);
+            }
+        }
+      const double ns_per_sec = 1e9;
+      printf ("%4zd partials, %4zd matches: match_partials %8.2f ns/partial, binary search %8.2f ns/partial, speedup %.2f\n",
+              n_partials, n_matches,
+              t[0] * ns_per_sec / RUNS / (2 * n_partials),
+              t[1] * ns_per_sec / RUNS / (2 * n_partials),
+              t[1] / t[0]);
+    }
+}
@@ -0,0 +1,84 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smnoisebandpartition.hh"
+#include "smnoisedecoder.hh"
+#include "smaudio.hh"
+#include "smmain.hh"
+#include "smmath.hh"
+#include "smrandom.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+using std::vector;
+using std::min;
+
+/* measures noise spectrum generation (random phases + band scaling) and checks that
+ * the optimized code paths produce exactly the same output as the simple ones
+ */
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  const double mix_freq = 48000;
+  const size_t block_size = NoiseDecoder::preferred_block_size (mix_freq);
+  const size_t spectrum_size = block_size + 2;
+  const int RUNS = 20000, REPS = 7;
+
+  /* random numbers: random_block vs. random_uint32 */
+  Random rand_a, rand_b;
+  rand_a.set_seed (42);
+  rand_b.set_seed (42);
+
+  const size_t n_random = (spectrum_size + 7) / 8;
+  vector<uint32_t> block_a (n_random), block_b (n_random);
+  double time_serial = 1e20, time_block = 1e20;
+  for (int reps = 0; reps < REPS; reps++)
+    {
+      double start = get_time();
+      for (int r = 0; r < RUNS; r++)
+        for (auto& value : block_a)
+          value = rand_a.random_uint32();
+      time_serial = min (time_serial, get_time() - start);
+
+      start = get_time();
+      for (int r = 0; r < RUNS; r++)
+        rand_b.random_block (block_b.size(), block_b.data());
+      time_block = min (time_block, get_time() - start);
+
+      assert (block_a == block_b);
+    }
+
+  /* noise spectrum: scalar vs. SSE */
+  NoiseBandPartition partition (Audio::N_NOISE_BANDS, spectrum_size, mix_freq);
+  vector<uint16_t> envelope;
+  for (size_t b = 0; b < partition.n_bands(); b++)
+    envelope.push_back (sm_factor2idb (rand_a.random_double_range (0.1, 1.0)));
+
+  double time_spectrum[2] = { 1e20, 1e20 };
+  vector<float> spectrum[2];
+  for (int sse = 0; sse < 2; sse++)
+    {
+      sm_enable_sse (sse);
+
+      Random random;
+      random.set_seed (42);
+      spectrum[sse].resize (spectrum_size);
+      for (int reps = 0; reps < REPS; reps++)
+        {
+          double start = get_time();
+          for (int r = 0; r < RUNS; r++)
+            partition.noise_envelope_to_spectrum (random, envelope.data(), spectrum[sse].data(), 0.5);
+          time_spectrum[sse] = min (time_spectrum[sse], get_time() - start);
+        }
+    }
+  sm_enable_sse (true);
+  assert (spectrum[0] == spectrum[1]);
+
+  const double ns_per_sec = 1e9;
+  printf ("random numbers (random_uint32): %6.3f ns/value\n", time_serial * ns_per_sec / RUNS / n_random);
+  printf ("random numbers (random_block):  %6.3f ns/value\n", time_block * ns_per_sec / RUNS / n_random);
+  printf ("noise spectrum (scalar):        %6.3f ns/bin\n", time_spectrum[0] * ns_per_sec / RUNS / (spectrum_size / 2));
+  printf ("noise spectrum (SSE):           %6.3f ns/bin\n", time_spectrum[1] * ns_per_sec / RUNS / (spectrum_size / 2));
+}
@@ -0,0 +1,142 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smnoisedecoder.hh"
+#include "smifftsynth.hh"
+#include "smwavdata.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smfft.hh"
+
+#include <complex>
+
+#include <stdio.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+using std::vector;
+using std::string;
+
+struct Stats
+{
+  vector<double> group_energy;  // mean energy for groups of spectrum bins
+  double         frame_corr;    // mean absolute correlation between the spectra of consecutive frames
+};
+
+static Stats
+measure (NoiseDecoder& noise_dec, const RTAudioBlock& block, size_t block_size, int n_frames)
+{
+  const size_t n_groups = 16;
+  const size_t group_size = block_size / n_groups;
+
+  Stats stats;
+  stats.group_energy.resize (n_groups);
+  stats.frame_corr = 0;
+
+  float *spectrum = FFT::new_array_float (block_size);
+  vector<std::complex<double>> last_spectrum (block_size / 2);
+  for (int f = 0; f < n_frames; f++)
+    {
+      zero_float_block (block_size, spectrum);
+      noise_dec.process (block, spectrum, NoiseDecoder::FFT_SPECTRUM);
+
+      std::complex<double> corr = 0;
+      double energy = 0, last_energy = 0;
+      for (size_t i = 1; i < block_size / 2; i++) // skip bin 0 (contains DC and nyquist)
+        {
+          const std::complex<double> value (spectrum[i * 2], spectrum[i * 2 + 1]);
+
+          stats.group_energy[i * 2 / group_size] += std::norm (value);
+
+          corr += value * std::conj (last_spectrum[i]);
+          energy += std::norm (value);
+          last_energy += std::norm (last_spectrum[i]);
+          last_spectrum[i] = value;
+        }
+      if (f > 0)
+        stats.frame_corr += std::abs (corr) / sqrt (energy * last_energy);
+    }
+  for (auto& e : stats.group_energy)
+    e /= double (n_frames) * group_size / 2;
+  stats.frame_corr /= n_frames - 1;
+
+  FFT::free_array_float (spectrum);
+  return stats;
+}
+
+static void
+write_wav (const string& filename, NoiseDecoder& noise_dec, const RTAudioBlock& block, size_t block_size, double mix_freq)
+{
+  IFFTSynth ifft_synth (block_size, mix_freq, IFFTSynth::WIN_HANNING);
+
+  /* overlap-add with 50% overlap, 5 seconds */
+  vector<float> samples (mix_freq * 5 + block_size);
+  for (size_t pos = 0; pos + block_size <= samples.size(); pos += block_size / 2)
+    {
+      ifft_synth.clear_partials();
+      noise_dec.process (block, ifft_synth.fft_buffer(), NoiseDecoder::FFT_SPECTRUM);
+      ifft_synth.get_samples (&samples[pos], IFFTSynth::ADD);
+    }
+  WavData wav_data (samples, 1, mix_freq, 16);
+  if (!wav_data.save (filename))
+    {
+      fprintf (stderr, "can't write %s: %s\n", filename.c_str(), wav_data.error_blurb());
+      exit (1);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  const double mix_freq = 48000;
+  const size_t block_size = NoiseDecoder::preferred_block_size (mix_freq);
+
+  /* noise envelope: bands with very different energies */
+  Random random;
+  random.set_seed (42);
+
+  AudioBlock audio_block;
+  for (int i = 0; i < 32; i++)
+    audio_block.noise.push_back (sm_factor2idb (random.random_double_range (0.01, 1.0)));
+
+  RTMemoryArea rt_memory_area;
+  RTAudioBlock rt_audio_block (&rt_memory_area);
+  rt_audio_block.assign (audio_block);
+
+  NoiseDecoder noise_dec (mix_freq, block_size);
+  noise_dec.set_seed (1);
+
+  const int n_frames = 4000;
+
+  NoiseDecoder::set_noise_texture (false);
+  const Stats rng_stats = measure (noise_dec, rt_audio_block, block_size, n_frames);
+
+  NoiseDecoder::set_noise_texture (true);
+  const Stats texture_stats = measure (noise_dec, rt_audio_block, block_size, n_frames);
+
+  /* texture noise must have the same spectral envelope as rng noise */
+  for (size_t g = 0; g < rng_stats.group_energy.size(); g++)
+    {
+      const double db = db_from_factor (texture_stats.group_energy[g] / rng_stats.group_energy[g], -200) / 2;
+
+      printf ("group %2zd: energy rng %.6e texture %.6e (%+.3f dB)\n", g, rng_stats.group_energy[g], texture_stats.group_energy[g], db);
+      assert (fabs (db) < 0.25);
+    }
+
+  /* consecutive texture frames must be as uncorrelated as rng frames */
+  printf ("frame correlation: rng %.4f texture %.4f\n", rng_stats.frame_corr, texture_stats.frame_corr);
+  assert (texture_stats.frame_corr < 0.15);
+  assert (texture_stats.frame_corr < rng_stats.frame_corr * 1.5);
+
+  /* for listening: write both versions */
+  if (argc == 2)
+    {
+      NoiseDecoder::set_noise_texture (false);
+      write_wav (string (argv[1]) + "-rng.wav", noise_dec, rt_audio_block, block_size, mix_freq);
+
+      NoiseDecoder::set_noise_texture (true);
+      write_wav (string (argv[1]) + "-texture.wav", noise_dec, rt_audio_block, block_size, mix_freq);
+    }
+  NoiseDecoder::set_noise_texture (false);
+}
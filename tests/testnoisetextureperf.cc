@@ -0,0 +1,85 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smnoisedecoder.hh"
+#include "smifftsynth.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+
+#include <memory>
+
+#include <stdio.h>
+
+using namespace SpectMorph;
+using std::vector;
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  const double mix_freq = 48000;
+  const size_t block_size = NoiseDecoder::preferred_block_size (mix_freq);
+  const int n_voices = 64;
+
+  Random random;
+  random.set_seed (42);
+
+  /* one noise decoder + ifft synth per voice, each voice with a different noise envelope */
+  RTMemoryArea rt_memory_area;
+  vector<std::unique_ptr<NoiseDecoder>> noise_decs;
+  vector<std::unique_ptr<IFFTSynth>>    ifft_synths;
+  vector<std::unique_ptr<RTAudioBlock>> blocks;
+  for (int v = 0; v < n_voices; v++)
+    {
+      AudioBlock audio_block;
+      for (int i = 0; i < 32; i++)
+        audio_block.noise.push_back (sm_factor2idb (random.random_double_range (0.1, 1.0)));
+
+      blocks.emplace_back (new RTAudioBlock (&rt_memory_area));
+      blocks.back()->assign (audio_block);
+
+      noise_decs.emplace_back (new NoiseDecoder (mix_freq, block_size));
+      noise_decs.back()->set_seed (v);
+      ifft_synths.emplace_back (new IFFTSynth (block_size, mix_freq, IFFTSynth::WIN_HANNING));
+    }
+
+  /* 10 seconds of audio, each frame covers block_size / 2 output samples */
+  const int RUNS = mix_freq * 10 / (block_size / 2), REPS = 5;
+
+  vector<float> samples (block_size);
+  double min_time[2][2] = { { 1e20, 1e20 }, { 1e20, 1e20 } };
+  for (int texture = 0; texture < 2; texture++)
+    {
+      NoiseDecoder::set_noise_texture (texture);
+      for (int ifft = 0; ifft < 2; ifft++)
+        {
+          for (int reps = 0; reps < REPS; reps++)
+            {
+              double start = get_time();
+              for (int r = 0; r < RUNS; r++)
+                {
+                  for (int v = 0; v < n_voices; v++)
+                    {
+                      ifft_synths[v]->clear_partials();
+                      noise_decs[v]->process (*blocks[v], ifft_synths[v]->fft_buffer(), NoiseDecoder::FFT_SPECTRUM);
+                      if (ifft)
+                        ifft_synths[v]->get_samples (&samples[0]);
+                    }
+                }
+              double end = get_time();
+              min_time[texture][ifft] = std::min (min_time[texture][ifft], end - start);
+            }
+        }
+    }
+  NoiseDecoder::set_noise_texture (false);
+
+  const double audio_time = RUNS * (block_size / 2) / mix_freq;
+  for (int texture = 0; texture < 2; texture++)
+    {
+      printf ("%s: %d voices: spectrum %.2f%% realtime, spectrum+ifft %.2f%% realtime\n",
+              texture ? "texture" : "rng    ", n_voices,
+              min_time[texture][0] / audio_time * 100,
+              min_time[texture][1] / audio_time * 100);
+    }
+  printf ("speedup: spectrum %.2f, spectrum+ifft %.2f\n", min_time[0][0] / min_time[1][0], min_time[0][1] / min_time[1][1]);
+}
@@ -0,0 +1,113 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* checks that events arrive in the audio thread exactly once and in order */
+struct SeqEvent : public SynthControlEvent
+{
+  int               seq;
+  std::atomic<int> *last_seq;
+
+  SeqEvent (int seq, std::atomic<int> *last_seq) :
+    seq (seq),
+    last_seq (last_seq)
+  {
+  }
+  void
+  run_rt (Project *project)
+  {
+    assert (last_seq->load() + 1 == seq);
+    last_seq->store (seq);
+  }
+};
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  Project project;
+  project.set_mix_freq (48000);
+
+  if (argc == 2)
+    {
+      Error error = project.load (argv[1]);
+      if (error)
+        {
+          fprintf (stderr, "%s: can't load plan '%s': %s\n", argv[0], argv[1], error.message());
+          return 1;
+        }
+    }
+
+  std::atomic<int>  last_seq { 0 };
+  std::atomic<bool> quit { false };
+
+  /* audio thread: render blocks as fast as possible, applying updates before each block */
+  double max_update_time = 0;
+  double max_block_time = 0;
+  size_t n_blocks = 0;
+  std::thread audio_thread ([&]()
+    {
+      MidiSynth *midi_synth = project.midi_synth();
+      vector<float> output (256);
+
+      const unsigned char note_on[3] = { 0x90, 60, 100 };
+      midi_synth->add_midi_event (0, note_on);
+
+      while (!quit.load())
+        {
+          const double t0 = get_time();
+          project.try_update_synth();
+          const double t1 = get_time();
+          midi_synth->process (output.data(), output.size());
+          const double t2 = get_time();
+
+          max_update_time = std::max (max_update_time, t1 - t0);
+          max_block_time = std::max (max_block_time, t2 - t0);
+          n_blocks++;
+        }
+    });
+
+  /* ui thread: send a new plan update, a gain change and a sequence event at 1 kHz for 3 seconds */
+  const int n_updates = 3000;
+  auto next = std::chrono::steady_clock::now();
+  for (int i = 1; i <= n_updates; i++)
+    {
+      project.synth_interface()->emit_apply_update (project.midi_synth()->prepare_update (*project.morph_plan()));
+      project.synth_interface()->emit_update_gain (0.5 + 0.5 * (i % 2));
+      project.synth_take_control_event (new SeqEvent (i, &last_seq));
+
+      if (i % 16 == 0) // ui timer
+        project.synth_interface()->generate_notify_events();
+
+      next += std::chrono::microseconds (1000);
+      std::this_thread::sleep_until (next);
+    }
+  quit.store (true);
+  audio_thread.join();
+
+  /* deliver what is left */
+  while (last_seq.load() != n_updates)
+    {
+      project.synth_flush_control_events();
+      project.try_update_synth();
+    }
+  project.synth_flush_control_events();
+
+  printf ("%d updates, %zd blocks rendered\n", n_updates, n_blocks);
+  printf ("max try_update_synth time: %.3f ms\n", max_update_time * 1000);
+  printf ("max block time (including update): %.3f ms\n", max_block_time * 1000);
+}
@@ -0,0 +1,247 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smeffectdecoder.hh"
+#include "smspectralbus.hh"
+#include "smmain.hh"
+#include "smmath.hh"
+
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::max;
+
+static const float MIX_FREQ = 48000;
+
+/* stationary harmonic sound, 1 ms frames */
+class TestSource : public LiveDecoderSource
+{
+  Audio audio_;
+public:
+  TestSource()
+  {
+    audio_.mix_freq             = MIX_FREQ;
+    audio_.frame_step_ms        = 1;
+    audio_.frame_size_ms        = 40;
+    audio_.fundamental_freq     = 440;
+    audio_.zero_values_at_start = 0;
+    audio_.loop_type            = Audio::LOOP_NONE;
+
+    for (int f = 0; f < 2000; f++)
+      {
+        AudioBlock block;
+        for (int p = 1; p <= 8; p++)
+          {
+            block.freqs.push_back (sm_freq2ifreq (p));
+            block.mags.push_back (sm_factor2idb (0.1 / p));
+            block.phases.push_back (0);
+          }
+        audio_.contents.push_back (block);
+      }
+  }
+  void
+  retrigger (int channel, float freq, int midi_velocity) override
+  {
+  }
+  Audio *
+  audio() override
+  {
+    return &audio_;
+  }
+  bool
+  rt_audio_block (size_t index, RTAudioBlock& out_block) override
+  {
+    if (index >= audio_.frame_count())
+      return false;
+
+    out_block.assign (audio_, index);
+    return true;
+  }
+};
+
+static MorphOutput::Config
+test_config()
+{
+  MorphOutput::Config cfg;
+  cfg.sines     = true;
+  cfg.noise     = false;
+  cfg.unison    = false;
+  cfg.adsr      = false;   // simple envelope: no attack, 150 ms linear release
+  cfg.filter    = false;
+  cfg.vibrato   = false;
+  cfg.portamento = false;
+  return cfg;
+}
+
+/* per voice rendering, note off release_pos samples after the note on */
+static vector<float>
+render_voice (size_t release_pos, size_t n_values)
+{
+  TestSource source;
+  MorphOutput::Config cfg = test_config();
+  RTMemoryArea rt_memory_area;
+  vector<float> out (n_values);
+
+  EffectDecoder decoder (nullptr, MIX_FREQ);
+  decoder.set_config (&cfg, &source, MIX_FREQ);
+  decoder.retrigger (0, 440, 100);
+  decoder.process (rt_memory_area, release_pos, nullptr, &out[0]);
+  decoder.release();
+  decoder.process (rt_memory_area, n_values - release_pos, nullptr, &out[release_pos]);
+  return out;
+}
+
+/* spectral bus rendering (like MidiSynth does it), note on note_pos samples
+ * after the start of the bus, note off release_pos samples after the note on
+ */
+static vector<float>
+render_bus (size_t note_pos, size_t release_pos, size_t n_values)
+{
+  TestSource source;
+  MorphOutput::Config cfg = test_config();
+  RTMemoryArea rt_memory_area;
+  SpectralBus bus (MIX_FREQ);
+  vector<float> out (n_values), dummy (n_values);
+
+  EffectDecoder decoder (nullptr, MIX_FREQ);
+  decoder.set_config (&cfg, &source, MIX_FREQ);
+
+  bool active = false;
+  size_t pos = 0;
+  auto render = [&] (size_t end)
+    {
+      while (pos < end)
+        {
+          if (bus.need_hop())
+            {
+              bus.begin_hop();
+              if (active)
+                decoder.process_spectrum (rt_memory_area, bus.hop_size(), 440, 1, 1, &bus);
+              bus.end_hop();
+            }
+          pos += bus.read (end - pos, &out[pos], &dummy[pos], 1, 1, 1, 1);
+        }
+    };
+  render (note_pos);
+
+  decoder.retrigger (0, 440, 100);
+  decoder.start_spectrum (bus.hop_size() - 1 - bus.available());
+  active = true;
+  render (note_pos + release_pos);
+
+  decoder.release_spectrum (release_pos);
+  render (n_values);
+  return out;
+}
+
+/* maximum difference between per voice output and bus output, after compensating the bus latency */
+static double
+max_diff (const vector<float>& voice_out, const vector<float>& bus_out, size_t delay, size_t start, size_t end)
+{
+  double diff = 0;
+  for (size_t i = start; i < end; i++)
+    diff = max<double> (diff, fabs (voice_out[i] - bus_out[i + delay]));
+  return diff;
+}
+
+static double
+max_abs (const vector<float>& out, size_t start, size_t end)
+{
+  double m = 0;
+  for (size_t i = start; i < end; i++)
+    m = max<double> (m, fabs (out[i]));
+  return m;
+}
+
+static void
+test_bus_vs_voice()
+{
+  SpectralBus bus (MIX_FREQ);
+
+  const size_t hop_size = bus.hop_size();
+  const size_t latency = bus.latency();
+  const size_t note_pos = 3 * hop_size + 1; // source frames of both decoders are on the same grid
+  const size_t release_pos = sm_round_positive (0.25 * MIX_FREQ);
+  const size_t n_values = sm_round_positive (0.5 * MIX_FREQ);
+
+  vector<float> voice_out = render_voice (release_pos, n_values);
+  vector<float> late_voice_out = render_voice (release_pos + hop_size, n_values);
+  vector<float> bus_out = render_bus (note_pos, release_pos, n_values + note_pos + latency);
+
+  const double peak = max_abs (voice_out, 0, n_values);
+
+  /* nothing before the note starts */
+  assert (max_abs (bus_out, 0, note_pos + latency) == 0);
+
+  /* sustain: both renderings must be identical, the note starts latency samples after the note on */
+  const double sustain_diff = max_diff (voice_out, bus_out, note_pos + latency, 0, release_pos - hop_size);
+
+  /* release: the bus interpolates the envelope between frame centers (raised cosine
+   * instead of the linear release ramp), so the difference is small but not zero
+   */
+  const double release_diff = max_diff (voice_out, bus_out, note_pos + latency, release_pos - hop_size, n_values);
+  const double late_release_diff = max_diff (late_voice_out, bus_out, note_pos + latency, release_pos - hop_size, n_values);
+
+  printf ("peak %f, sustain diff %g, release diff %g, release diff one hop late %g\n",
+          peak, sustain_diff, release_diff, late_release_diff);
+
+  assert (peak > 0.1);
+  assert (sustain_diff < 1e-4);
+  assert (release_diff < 0.02 * peak);
+
+  /* the release must start at the note off sample, not at the next hop */
+  assert (late_release_diff > 3 * release_diff);
+
+  /* after the release, the note is silent */
+  assert (max_abs (bus_out, bus_out.size() - hop_size, bus_out.size()) == 0);
+}
+
+/* voice with a pending release moves from the bus to per voice rendering */
+static void
+test_bus_to_voice()
+{
+  TestSource source;
+  MorphOutput::Config cfg = test_config();
+  RTMemoryArea rt_memory_area;
+  SpectralBus bus (MIX_FREQ);
+  vector<float> out (bus.hop_size());
+
+  EffectDecoder decoder (nullptr, MIX_FREQ);
+  decoder.set_config (&cfg, &source, MIX_FREQ);
+  decoder.retrigger (0, 440, 100);
+  decoder.start_spectrum (bus.hop_size() - 1 - bus.available());
+
+  for (int i = 0; i < 10; i++)
+    {
+      bus.begin_hop();
+      decoder.process_spectrum (rt_memory_area, bus.hop_size(), 440, 1, 1, &bus);
+      bus.end_hop();
+      bus.read (bus.hop_size(), &out[0], &out[0], 1, 1, 1, 1);
+    }
+  /* note off arrives before the envelope reached it: release is pending */
+  decoder.release_spectrum (100 * bus.hop_size());
+  assert (!decoder.done());
+
+  /* continue without bus for 200 ms, the release (150 ms) must be done */
+  const size_t n_values = sm_round_positive (0.2 * MIX_FREQ);
+  size_t pos = 0;
+  while (pos < n_values)
+    {
+      decoder.process (rt_memory_area, out.size(), nullptr, &out[0]);
+      pos += out.size();
+    }
+  assert (decoder.done());
+  printf ("bus to voice: release done\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_bus_vs_voice();
+  test_bus_to_voice();
+}
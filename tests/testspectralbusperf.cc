@@ -0,0 +1,93 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smifftsynth.hh"
+#include "smnoisedecoder.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+static double
+perf (Project& project, size_t n_voices, bool spectral_bus)
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 256;
+  const size_t hop_size = NoiseDecoder::preferred_block_size (mix_freq) / 2;
+
+  MidiSynth midi_synth (mix_freq, n_voices);
+  midi_synth.apply_update (midi_synth.prepare_update (*project.morph_plan()));
+  midi_synth.set_spectral_bus (spectral_bus);
+
+  /* spread notes over a few octaves, all notes are sustained during the measurement */
+  for (size_t v = 0; v < n_voices; v++)
+    {
+      const unsigned char note_on[3] = { 0x90, (unsigned char) (36 + v % 48), 100 };
+      midi_synth.add_midi_event (0, note_on);
+    }
+
+  vector<float> output (block_size);
+
+  /* warm up: start voices and ignore the attack */
+  for (int i = 0; i < 50; i++)
+    midi_synth.process (output.data(), output.size());
+
+  assert (midi_synth.active_voice_count() == n_voices);
+
+  const int RUNS = 375; // 2 seconds of audio
+  double min_time = 1e20;
+  uint64 ffts = 0;
+  for (int rep = 0; rep < 3; rep++)
+    {
+      const uint64 start_ffts = IFFTSynth::fft_count();
+      double start = get_time();
+      for (int r = 0; r < RUNS; r++)
+        midi_synth.process (output.data(), output.size());
+      min_time = std::min (min_time, get_time() - start);
+      ffts = IFFTSynth::fft_count() - start_ffts;
+    }
+  const double audio_time = RUNS * block_size / mix_freq;
+  const double cpu_percent = min_time / audio_time * 100;
+  const double hops = double (RUNS * block_size) / hop_size;
+
+  const double ns_per_sec = 1e9;
+  printf ("%3zd voices, %-13s %8.2f ns/sample/voice, %7.2f%% realtime, %6.2f ffts/hop\n",
+          n_voices, spectral_bus ? "spectral bus:" : "per voice:", min_time * ns_per_sec / (RUNS * block_size * n_voices),
+          cpu_percent, ffts / hops);
+  return min_time;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  if (argc != 2)
+    {
+      printf ("usage: %s <plan>\n", argv[0]);
+      return 1;
+    }
+
+  Project project;
+  project.set_mix_freq (48000);
+
+  Error error = project.load (argv[1]);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't load plan '%s': %s\n", argv[0], argv[1], error.message());
+      return 1;
+    }
+  project.try_update_synth();
+
+  for (size_t n_voices : { 32, 64, 128 })
+    {
+      double voice_time = perf (project, n_voices, false);
+      double bus_time = perf (project, n_voices, true);
+      printf ("%3zd voices: speedup %.2f\n\n", n_voices, voice_time / bus_time);
+    }
+}
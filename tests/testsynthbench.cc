@@ -0,0 +1,309 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmorphoutput.hh"
+#include "smmorphlinear.hh"
+#include "smmorphgrid.hh"
+#include "smmorphlfo.hh"
+#include "smmodulationlist.hh"
+#include "config.h"
+
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <functional>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::string;
+
+/*
+ * End-to-end synthesis benchmark: renders fixed scenarios, derived from one
+ * plan with a wav source (by default data/templates/1-instrument-wav-source.smplan,
+ * see "make synthbench"), at several polyphony levels, and reports
+ *
+ *  - ns per sample per voice
+ *  - p50 / p99 block render time
+ *  - heap allocations (operator new) per block, which should be zero
+ *
+ * results are printed and written to a JSON file, to track regressions between releases
+ */
+
+static std::atomic<uint64> n_allocs;
+
+void *
+operator new (size_t size)
+{
+  n_allocs++;
+  void *p = malloc (size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  free (p);
+}
+
+void
+operator delete (void *p, size_t) noexcept
+{
+  free (p);
+}
+
+static const double MIX_FREQ = 48000;
+static const size_t BLOCK_SIZE = 256;
+
+struct Scenario
+{
+  string name;
+  std::function<void (MorphOutput *output)> setup; // modify plan
+  bool   glide = false;                             // portamento: play a new note every 100 ms
+};
+
+struct Result
+{
+  string scenario;
+  size_t voices;
+  double ns_per_sample_voice;
+  double block_p50_us;
+  double block_p99_us;
+  double allocs_per_block;
+  double cpu_percent;
+};
+
+static Result
+run_scenario (Project& project, const Scenario& scenario, size_t n_voices)
+{
+  /* portamento: one voice is rendered, but each note needs a (shadow) voice */
+  MidiSynth midi_synth (MIX_FREQ, scenario.glide ? n_voices + 8 : n_voices);
+  midi_synth.set_random_seed (0); // same noise / unison / lfo values in every run
+  midi_synth.apply_update (midi_synth.prepare_update (*project.morph_plan()));
+
+  /* spread notes over a few octaves, all notes are sustained during the measurement */
+  for (size_t v = 0; v < n_voices; v++)
+    {
+      const unsigned char note_on[3] = { 0x90, (unsigned char) (36 + v % 48), 100 };
+      midi_synth.add_midi_event (0, note_on);
+    }
+
+  vector<float> left (BLOCK_SIZE), right (BLOCK_SIZE);
+
+  /* warm up: start voices and ignore the attack */
+  for (int i = 0; i < 50; i++)
+    midi_synth.process (left.data(), right.data(), BLOCK_SIZE);
+
+  const int RUNS = 375; // 2 seconds of audio
+  vector<double> block_times;
+  double total_time = 0;
+  uint64 voice_samples = 0;
+  uint64 allocs = 0;
+  int glide_note = 0;
+  unsigned char held_note = 36; // glide: the note started above (n_voices is 1)
+  for (int r = 0; r < RUNS; r++)
+    {
+      if (scenario.glide && r % 19 == 0)
+        {
+          glide_note = (glide_note + 7) % 24;
+
+          /* legato: note on before note off, so each note glides from the previous one */
+          const unsigned char note_on[3] = { 0x90, (unsigned char) (48 + glide_note), 100 };
+          const unsigned char note_off[3] = { 0x80, held_note, 0 };
+          midi_synth.add_midi_event (0, note_on);
+          midi_synth.add_midi_event (0, note_off);
+          held_note = note_on[1];
+        }
+      const uint64 allocs_before = n_allocs.load();
+      const double start = get_time();
+
+      midi_synth.process (left.data(), right.data(), BLOCK_SIZE);
+
+      const double time = get_time() - start;
+      allocs += n_allocs.load() - allocs_before;
+
+      block_times.push_back (time);
+      total_time += time;
+      voice_samples += (scenario.glide ? 1 : midi_synth.active_voice_count()) * BLOCK_SIZE;
+    }
+  std::sort (block_times.begin(), block_times.end());
+
+  Result result;
+  result.scenario = scenario.name;
+  result.voices = n_voices;
+  result.ns_per_sample_voice = voice_samples ? total_time * 1e9 / voice_samples : 0;
+  result.block_p50_us = block_times[block_times.size() / 2] * 1e6;
+  result.block_p99_us = block_times[block_times.size() * 99 / 100] * 1e6;
+  result.allocs_per_block = double (allocs) / RUNS;
+  result.cpu_percent = total_time / (RUNS * BLOCK_SIZE / MIX_FREQ) * 100;
+
+  printf ("%-12s %3zd voices: %8.2f ns/sample/voice, block p50 %8.2f us, p99 %8.2f us, %5.2f allocs/block, %6.2f%% cpu\n",
+          result.scenario.c_str(), result.voices, result.ns_per_sample_voice, result.block_p50_us, result.block_p99_us,
+          result.allocs_per_block, result.cpu_percent);
+  fflush (stdout);
+  return result;
+}
+
+static bool
+write_json (const string& filename, const vector<Result>& results)
+{
+  FILE *file = fopen (filename.c_str(), "w");
+  if (!file)
+    return false;
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"version\": \"%s\",\n", VERSION);
+  fprintf (file, "  \"mix_freq\": %.0f,\n", MIX_FREQ);
+  fprintf (file, "  \"block_size\": %zd,\n", BLOCK_SIZE);
+  fprintf (file, "  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++)
+    {
+      const Result& r = results[i];
+      /* string_printf: locale independent number formatting */
+      string line = string_printf ("    { \"scenario\": \"%s\", \"voices\": %zd, \"ns_per_sample_voice\": %.3f, "
+                                   "\"block_p50_us\": %.3f, \"block_p99_us\": %.3f, \"allocs_per_block\": %.3f, \"cpu_percent\": %.3f }%s\n",
+                                   r.scenario.c_str(), r.voices, r.ns_per_sample_voice, r.block_p50_us, r.block_p99_us,
+                                   r.allocs_per_block, r.cpu_percent, i + 1 < results.size() ? "," : "");
+      fputs (line.c_str(), file);
+    }
+  fprintf (file, "  ]\n");
+  fprintf (file, "}\n");
+
+  return fclose (file) == 0;
+}
+
+template<class T> T *
+add_op (MorphPlan *plan, const char *type)
+{
+  MorphOperator *op = MorphOperator::create (type, plan);
+  plan->add_operator (op);
+  return dynamic_cast<T *> (op);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  if (argc != 3)
+    {
+      printf ("usage: %s <plan> <results.json>\n", argv[0]);
+      return 1;
+    }
+
+  Project project;
+  project.set_mix_freq (MIX_FREQ);
+
+  Error error = project.load (argv[1]);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't load plan '%s': %s\n", argv[0], argv[1], error.message());
+      return 1;
+    }
+  project.wait_for_rebuilds();
+
+  MorphPlan *plan = project.morph_plan();
+  MorphOutput *output = nullptr;
+  MorphOperator *source = nullptr;
+  for (MorphOperator *op : plan->operators())
+    {
+      if (op->type_name() == "Output")
+        output = dynamic_cast<MorphOutput *> (op);
+      if (op->type_name() == "WavSource" && !source)
+        source = op;
+    }
+  if (!output || !source)
+    {
+      fprintf (stderr, "%s: plan '%s' needs an output and a wav source operator\n", argv[0], argv[1]);
+      return 1;
+    }
+
+  /* operators for all scenarios, scenarios select which one is connected to the output */
+  auto linear = add_op<MorphLinear> (plan, "SpectMorph::MorphLinear");
+  linear->set_left_op (source);
+  linear->set_right_op (source);
+  linear->property (MorphLinear::P_MORPHING)->set_float (0.3);
+
+  auto grid = add_op<MorphGrid> (plan, "SpectMorph::MorphGrid");
+  grid->set_width (3);
+  grid->set_height (3);
+  for (int x = 0; x < 3; x++)
+    {
+      for (int y = 0; y < 3; y++)
+        {
+          MorphGridNode node;
+          node.op.set (source);
+          grid->set_input_node (x, y, node);
+        }
+    }
+  grid->property (MorphGrid::P_X_MORPHING)->set_float (0.3);
+  grid->property (MorphGrid::P_Y_MORPHING)->set_float (-0.6);
+
+  auto lfo_grid = add_op<MorphGrid> (plan, "SpectMorph::MorphGrid");
+  lfo_grid->set_width (3);
+  lfo_grid->set_height (3);
+  for (int x = 0; x < 3; x++)
+    for (int y = 0; y < 3; y++)
+      lfo_grid->set_input_node (x, y, grid->input_node (x, y));
+
+  auto lfo_x = add_op<MorphLFO> (plan, "SpectMorph::MorphLFO");
+  auto lfo_y = add_op<MorphLFO> (plan, "SpectMorph::MorphLFO");
+  lfo_x->property (MorphLFO::P_FREQUENCY)->set_float (0.7);
+  lfo_y->property (MorphLFO::P_FREQUENCY)->set_float (1.9);
+  lfo_grid->property (MorphGrid::P_X_MORPHING)->modulation_list()->set_main_control_type_and_op (MorphOperator::CONTROL_OP, lfo_x);
+  lfo_grid->property (MorphGrid::P_Y_MORPHING)->modulation_list()->set_main_control_type_and_op (MorphOperator::CONTROL_OP, lfo_y);
+
+  auto connect = [output] (MorphOperator *op) {
+    output->set_channel_op (0, op);
+    output->property (MorphOutput::P_UNISON)->set_bool (false);
+    output->property (MorphOutput::P_FILTER)->set_bool (false);
+    output->property (MorphOutput::P_PORTAMENTO)->set_bool (false);
+  };
+  vector<Scenario> scenarios = {
+    { "source",     [&] (MorphOutput *o) { connect (source); } },
+    { "linear",     [&] (MorphOutput *o) { connect (linear); } },
+    { "grid3x3",    [&] (MorphOutput *o) { connect (grid); } },
+    { "lfo-grid",   [&] (MorphOutput *o) { connect (lfo_grid); } },
+    { "unison7",    [&] (MorphOutput *o) {
+        connect (source);
+        o->property (MorphOutput::P_UNISON)->set_bool (true);
+        o->property (MorphOutput::P_UNISON_VOICES)->set (7);
+      } },
+    { "filter",     [&] (MorphOutput *o) {
+        connect (source);
+        o->property (MorphOutput::P_FILTER)->set_bool (true);
+      } },
+    { "portamento", [&] (MorphOutput *o) {
+        connect (source);
+        o->property (MorphOutput::P_PORTAMENTO)->set_bool (true);
+      }, /* glide */ true }
+  };
+
+  vector<Result> results;
+  for (const auto& scenario : scenarios)
+    {
+      scenario.setup (output);
+      project.try_update_synth();
+
+      /* portamento is monophonic: only one voice is rendered */
+      vector<size_t> voice_counts { 1, 8, 32, 64 };
+      if (scenario.glide)
+        voice_counts = { 1 };
+
+      for (size_t n_voices : voice_counts)
+        results.push_back (run_scenario (project, scenario, n_voices));
+    }
+  if (!write_json (argv[2], results))
+    {
+      fprintf (stderr, "%s: can't write results to '%s'\n", argv[0], argv[2]);
+      return 1;
+    }
+}
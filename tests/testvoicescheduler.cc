@@ -0,0 +1,211 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smvoicescheduler.hh"
+#include "smmain.hh"
+#include "smmath.hh"
+
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+using namespace SpectMorph;
+
+static const double MIX_FREQ = 48000;
+static const size_t BLOCK_SIZE = 480; // 10 ms
+
+static VoiceScheduler::Config
+budget_config (double cpu_budget)
+{
+  VoiceScheduler::Config config;
+  config.cpu_budget = cpu_budget;
+  return config;
+}
+
+/* render a block with n_voices voices, each using voice_load of the block duration */
+static void
+add_blocks (VoiceScheduler& scheduler, int n_blocks, int n_voices, double voice_load)
+{
+  const double block_time = BLOCK_SIZE / MIX_FREQ;
+
+  for (int b = 0; b < n_blocks; b++)
+    scheduler.add_block (block_time * voice_load * n_voices, BLOCK_SIZE, BLOCK_SIZE * n_voices);
+}
+
+static void
+test_budget()
+{
+  VoiceScheduler scheduler (MIX_FREQ);
+
+  /* no budget configured */
+  add_blocks (scheduler, 10, 4, 0.011);
+  assert (scheduler.voice_budget() == -1);
+
+  /* budget 50%, each voice needs 1.1% */
+  scheduler.set_config (budget_config (0.5));
+  assert (scheduler.voice_budget() == 45);
+  assert (fabs (scheduler.load() - 0.044) < 1e-9);
+
+  /* voice cost increases: budget adapts quickly */
+  add_blocks (scheduler, 1, 4, 0.09);
+  const int budget_after_one_block = scheduler.voice_budget();
+  printf ("budget after load increase: %d\n", budget_after_one_block);
+  assert (budget_after_one_block < 10);
+  add_blocks (scheduler, 10, 4, 0.09);
+  assert (scheduler.voice_budget() == 5);
+
+  /* voice cost decreases: budget adapts slowly */
+  add_blocks (scheduler, 1, 4, 0.011);
+  printf ("budget after load decrease: %d\n", scheduler.voice_budget());
+  assert (scheduler.voice_budget() < 10);
+  add_blocks (scheduler, 500, 4, 0.011);
+  assert (scheduler.voice_budget() == 45);
+
+  /* at least one voice can always play */
+  add_blocks (scheduler, 10, 1, 2.0);
+  assert (scheduler.voice_budget() == 1);
+
+  /* blocks without voices don't change the estimate */
+  add_blocks (scheduler, 10, 0, 0);
+  assert (scheduler.voice_budget() == 1);
+}
+
+static void
+test_steal_order()
+{
+  VoiceScheduler scheduler (MIX_FREQ);
+
+  VoiceScheduler::Candidate loud_old { false, 1.0, 1 };
+  VoiceScheduler::Candidate quiet_new { false, 0.1, 2 };
+  VoiceScheduler::Candidate released_loud { true, 1.0, 3 };
+
+  /* voice stealing must be enabled explicitly */
+  assert (scheduler.config().steal_policy == VoiceScheduler::StealPolicy::NONE);
+
+  VoiceScheduler::Config config;
+  config.steal_policy = VoiceScheduler::StealPolicy::QUIETEST;
+  scheduler.set_config (config);
+
+  assert (scheduler.steal_before (quiet_new, loud_old));
+  assert (!scheduler.steal_before (loud_old, quiet_new));
+  assert (scheduler.steal_before (released_loud, quiet_new));
+  assert (!scheduler.steal_before (quiet_new, released_loud));
+
+  config.steal_policy = VoiceScheduler::StealPolicy::OLDEST;
+  scheduler.set_config (config);
+
+  assert (scheduler.steal_before (loud_old, quiet_new));
+  assert (!scheduler.steal_before (quiet_new, loud_old));
+  assert (scheduler.steal_before (released_loud, loud_old));
+}
+
+static void
+test_unison()
+{
+  VoiceScheduler scheduler (MIX_FREQ);
+
+  /* no budget: unison is never reduced */
+  add_blocks (scheduler, 10, 4, 0.09);
+  assert (!scheduler.update_unison (100, true));
+  assert (!scheduler.unison_reduced());
+
+  scheduler.set_config (budget_config (0.5));
+  assert (scheduler.voice_budget() == 5);
+
+  /* below budget, or no unison: nothing to do */
+  assert (!scheduler.update_unison (5, true));
+  assert (!scheduler.update_unison (8, false));
+
+  /* over budget: reduce unison, restart estimate */
+  assert (scheduler.update_unison (8, true));
+  assert (scheduler.unison_reduced());
+  assert (scheduler.voice_budget() == -1);
+
+  /* cheaper voices, but load still above cpu_budget / 2: keep reduced unison */
+  add_blocks (scheduler, 200, 8, 0.05);
+  assert (!scheduler.update_unison (8, true));
+  assert (scheduler.unison_reduced());
+
+  /* low load for more than one second: restore unison */
+  for (int b = 0; b < 99; b++)
+    {
+      add_blocks (scheduler, 1, 2, 0.05);
+      assert (!scheduler.update_unison (2, true));
+    }
+  add_blocks (scheduler, 2, 2, 0.05);
+  assert (scheduler.update_unison (2, true));
+  assert (!scheduler.unison_reduced());
+
+  /* reduce_unison disabled */
+  VoiceScheduler::Config config = budget_config (0.5);
+  config.reduce_unison = false;
+  scheduler.set_config (config);
+  add_blocks (scheduler, 10, 4, 0.09);
+  assert (!scheduler.update_unison (8, true));
+}
+
+static void
+test_lod()
+{
+  VoiceScheduler scheduler (MIX_FREQ);
+
+  VoiceScheduler::Config config = budget_config (0.5);
+  config.lod_threshold = 1e-4;
+  scheduler.set_config (config);
+
+  /* low load: no boost */
+  add_blocks (scheduler, 10, 4, 0.01);
+  assert (scheduler.lod_threshold() == 1e-4);
+
+  /* load close to the budget: threshold is raised quickly, up to LOD_MAX_BOOST_DB */
+  add_blocks (scheduler, 10, 4, 0.1);
+  printf ("lod boost after 100 ms overload: %.1f dB\n", scheduler.lod_boost_db());
+  assert (scheduler.lod_boost_db() > 10);
+  add_blocks (scheduler, 100, 4, 0.1);
+  assert (scheduler.lod_boost_db() == VoiceScheduler::LOD_MAX_BOOST_DB);
+  assert (fabs (scheduler.lod_threshold() / 1e-4 - db_to_factor (VoiceScheduler::LOD_MAX_BOOST_DB)) < 1e-6);
+
+  /* between 50% and 75% of the budget: no change */
+  add_blocks (scheduler, 10, 4, 0.15);
+  assert (scheduler.lod_boost_db() == VoiceScheduler::LOD_MAX_BOOST_DB);
+
+  /* low load: threshold is lowered slowly */
+  add_blocks (scheduler, 10, 4, 0.01);
+  assert (scheduler.lod_boost_db() > VoiceScheduler::LOD_MAX_BOOST_DB - 5);
+  add_blocks (scheduler, 300, 4, 0.01);
+  assert (scheduler.lod_boost_db() == 0);
+
+  /* no cpu budget: threshold is constant */
+  config.cpu_budget = 0;
+  scheduler.set_config (config);
+  add_blocks (scheduler, 10, 4, 0.5);
+  assert (scheduler.lod_boost_db() == 0);
+  assert (scheduler.lod_threshold() == 1e-4);
+}
+
+static void
+test_parse()
+{
+  for (auto policy : { VoiceScheduler::StealPolicy::NONE, VoiceScheduler::StealPolicy::OLDEST, VoiceScheduler::StealPolicy::QUIETEST })
+    {
+      VoiceScheduler::StealPolicy parsed;
+      assert (VoiceScheduler::parse_steal_policy (VoiceScheduler::steal_policy_name (policy), parsed));
+      assert (parsed == policy);
+    }
+  VoiceScheduler::StealPolicy parsed = VoiceScheduler::StealPolicy::OLDEST;
+  assert (!VoiceScheduler::parse_steal_policy ("loudest", parsed));
+  assert (parsed == VoiceScheduler::StealPolicy::OLDEST);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_budget();
+  test_steal_order();
+  test_unison();
+  test_lod();
+  test_parse();
+
+  printf ("ok\n");
+}
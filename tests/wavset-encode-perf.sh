@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# compare smwavset encode using smenc processes (JobQueue) with --in-process encoding
+#
+# usage: wavset-encode-perf.sh <top_builddir> [ <jobs> ]
+
+TOP_BUILDDIR="$1"
+JOBS="${2:-$(nproc)}"
+SRCDIR="$(dirname "$0")"
+
+SMWAVSET="$TOP_BUILDDIR/src/smwavset"
+SMENC="$TOP_BUILDDIR/src/smenc"
+ASCII2WAV="$TOP_BUILDDIR/tools/ascii2wav"
+SINSIGNAL="$SRCDIR/sinsignal.py"
+
+DIR=$(mktemp -d wavset-encode-perf.XXXXXX) || exit 1
+mkdir "$DIR/fork" "$DIR/in-process"
+
+# 100 samples: midi notes 24..123 with a few harmonics
+$SMWAVSET init "$DIR/test.wset"
+for NOTE in $(seq 24 123)
+do
+  FREQ=$(awk "BEGIN { print 440 * exp (log (2) * ($NOTE - 69) / 12) }")
+  $SINSIGNAL 48000 $FREQ 0.4 $(awk "BEGIN { print $FREQ * 2 }") 0.2 $(awk "BEGIN { print $FREQ * 3 }") 0.1 | \
+    $ASCII2WAV "$DIR/$NOTE.wav" -r 48000
+  $SMWAVSET add "$DIR/test.wset" $NOTE "$DIR/$NOTE.wav"
+done
+
+time_cmd()
+{
+  START=$(date +%s.%N)
+  "$@" > /dev/null || exit 1
+  END=$(date +%s.%N)
+  awk "BEGIN { printf \"%.2f\", $END - $START }"
+}
+
+# fork based encoding includes linking the models into the smset to get the same result
+T_FORK=$(time_cmd sh -c "$SMWAVSET encode -j $JOBS --smenc $SMENC -d $DIR/fork --args -O1 $DIR/test.wset $DIR/fork.smset && $SMWAVSET link $DIR/fork.smset")
+T_IN_PROCESS=$(time_cmd $SMWAVSET encode -j $JOBS --in-process -d $DIR/in-process --args -O1 "$DIR/test.wset" "$DIR/in-process.smset")
+
+echo "smwavset encode, 100 samples, $JOBS jobs:"
+echo "  fork/exec smenc: $T_FORK s"
+echo "  --in-process:    $T_IN_PROCESS s"
+awk "BEGIN { printf \"  speedup:         %.2f\n\", $T_FORK / $T_IN_PROCESS }"
+
+rm -rf "$DIR"
@@ -391,9 +391,7 @@ processReplacing (AEffect *effect, float **inputs, float **outputs, int numSampl
   midi_synth->set_control_input (1, plugin->parameters[VstPlugin::PARAM_CONTROL_2].value);
   midi_synth->set_control_input (2, plugin->parameters[VstPlugin::PARAM_CONTROL_3].value);
   midi_synth->set_control_input (3, plugin->parameters[VstPlugin::PARAM_CONTROL_4].value);
-  midi_synth->process (outputs[0], numSampleFrames);
-
-  std::copy (outputs[0], outputs[0] + numSampleFrames, outputs[1]);
+  midi_synth->process (outputs[0], outputs[1], numSampleFrames);
 }
 
 static void